@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -22,34 +22,143 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "slab.h"
 
-struct {
+// The buffers are allocated from the buf slab cache by
+// binit(): NBUF of them if the kernel was built with
+// make NBUF=n, otherwise 1/BCACHEDIV of free memory, but no
+// more than the FSSIZE blocks there are to cache. There are
+// about two buffers per hash bucket.
+//
+// A block is found through the hash chain of its bucket,
+// under that bucket's lock, which also guards the refcnt of
+// the buffers on the chain. Unused buffers (refcnt 0) are
+// also on the lru list, from which bget() takes the least
+// recently used one to recycle. Lock order: bucket, then
+// lru. Only a recycling bget() holds two bucket locks, and
+// evict makes those take turns.
+struct bbucket {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct buf *head;             // chain through hnext
+  uint hits, misses;
+};
+
+struct {
+  struct kcache bufcache;
+  int nbuf;
+
+  struct bbucket *bucket;       // nbucket of them, from kallocn()
+  uint nbucket;                 // a power of two
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+  struct spinlock evict;
+  uint evictions;               // blocks dropped for another
+
+  // Unused buffers, through prev/next.
+  // lru.next is most recent, lru.prev is least.
+  struct spinlock lrulock;
+  struct buf lru;
 } bcache;
 
+static uint
+bhash(uint dev, uint blockno)
+{
+  return (dev * 31 + blockno) & (bcache.nbucket - 1);
+}
+
+static void
+lru_remove(struct buf *b)
+{
+  b->next->prev = b->prev;
+  b->prev->next = b->next;
+}
+
+static void
+lru_push(struct buf *b)
+{
+  b->next = bcache.lru.next;
+  b->prev = &bcache.lru;
+  bcache.lru.next->prev = b;
+  bcache.lru.next = b;
+}
+
 void
 binit(void)
 {
   struct buf *b;
+  int order;
 
-  initlock(&bcache.lock, "bcache");
+#ifdef NBUF
+  bcache.nbuf = NBUF;
+#else
+  bcache.nbuf = (uint64)kfreepages() * PGSIZE / BCACHEDIV / sizeof(struct buf);
+  if(bcache.nbuf > FSSIZE)
+    bcache.nbuf = FSSIZE;
+#endif
+  if(bcache.nbuf < NBUFMIN)
+    bcache.nbuf = NBUFMIN;
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+  for(bcache.nbucket = 1; bcache.nbucket * 2 < bcache.nbuf; bcache.nbucket *= 2)
+    ;
+  for(order = 0; (PGSIZE << order) < bcache.nbucket * sizeof(struct bbucket); order++)
+    ;
+  if(order > MAXORDER || (bcache.bucket = kallocn(order)) == 0)
+    panic("binit: buckets");
+  for(int i = 0; i < bcache.nbucket; i++){
+    initlock(&bcache.bucket[i].lock, "bcache.bucket");
+    bcache.bucket[i].head = 0;
+    bcache.bucket[i].hits = bcache.bucket[i].misses = 0;
+  }
+  initlock(&bcache.evict, "bcache.evict");
+  initlock(&bcache.lrulock, "bcache.lru");
+  kcache_init(&bcache.bufcache, "buf", sizeof(struct buf));
+
+  // Every buffer starts unused and on no chain.
+  bcache.lru.prev = &bcache.lru;
+  bcache.lru.next = &bcache.lru;
+  for(int i = 0; i < bcache.nbuf; i++){
+    if((b = kcache_alloc(&bcache.bufcache)) == 0)
+      panic("binit: buffers");
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->refcnt = 0;
+    b->hashed = 0;
+    lru_push(b);
+  }
+}
+
+// The buffer of block (dev, blockno) on bucket h, with a
+// reference taken, or 0. Caller holds the bucket lock.
+static struct buf*
+blookup(uint h, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bcache.bucket[h].head; b; b = b->hnext){
+    if(b->dev == dev && b->blockno == blockno){
+      bcache.bucket[h].hits++;
+      if(b->refcnt++ == 0){
+        acquire(&bcache.lrulock);
+        lru_remove(b);
+        release(&bcache.lrulock);
+      }
+      return b;
+    }
+  }
+  return 0;
+}
+
+// Take b off the chain of bucket h. Caller holds its lock.
+static void
+bunhash(uint h, struct buf *b)
+{
+  struct buf **pp;
+
+  for(pp = &bcache.bucket[h].head; *pp; pp = &(*pp)->hnext){
+    if(*pp == b){
+      *pp = b->hnext;
+      break;
+    }
   }
+  b->hashed = 0;
 }
 
 // Look through buffer cache for block on device dev.
@@ -59,33 +168,67 @@ static struct buf*
 bget(uint dev, uint blockno)
 {
   struct buf *b;
+  uint h = bhash(dev, blockno), v;
 
-  acquire(&bcache.lock);
+  acquire(&bcache.bucket[h].lock);
 
   // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
-      b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  if((b = blookup(h, dev, blockno)) != 0){
+    release(&bcache.bucket[h].lock);
+    acquiresleep(&b->lock);
+    return b;
   }
+  release(&bcache.bucket[h].lock);
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  // Not cached. Recycle the least recently used unused
+  // buffer. Look again once recycling is ours, another
+  // process may have read the block in meanwhile.
+  acquire(&bcache.evict);
+  acquire(&bcache.bucket[h].lock);
+  if((b = blookup(h, dev, blockno)) != 0){
+    release(&bcache.bucket[h].lock);
+    release(&bcache.evict);
+    acquiresleep(&b->lock);
+    return b;
+  }
+  for(;;){
+    acquire(&bcache.lrulock);
+    b = bcache.lru.prev;
+    release(&bcache.lrulock);
+    if(b == &bcache.lru)
+      panic("bget: no buffers");
+
+    // b's refcnt is guarded by its own bucket's lock.
+    v = bhash(b->dev, b->blockno);
+    if(v != h)
+      acquire(&bcache.bucket[v].lock);
+    if(b->refcnt == 0)
+      break;
+    if(v != h)
+      release(&bcache.bucket[v].lock);  // just taken; try again
   }
-  panic("bget: no buffers");
+  if(b->hashed){
+    bunhash(v, b);
+    bcache.evictions++;
+  }
+  if(v != h)
+    release(&bcache.bucket[v].lock);
+  acquire(&bcache.lrulock);
+  lru_remove(b);
+  release(&bcache.lrulock);
+
+  bcache.bucket[h].misses++;
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 1;
+  b->hnext = bcache.bucket[h].head;
+  bcache.bucket[h].head = b;
+  b->hashed = 1;
+  release(&bcache.bucket[h].lock);
+  release(&bcache.evict);
+  acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -111,6 +254,70 @@ bwrite(struct buf *b)
   virtio_disk_rw(b, 1);
 }
 
+// Write the n locked bufs in bs to disk together, so that
+// the driver can merge adjacent blocks, and wait for all.
+void
+bwritev(struct buf **bs, int n)
+{
+  for(int i = 0; i < n; i++)
+    if(!holdingsleep(&bs[i]->lock))
+      panic("bwritev");
+  virtio_disk_submit(bs, n, 1);
+  for(int i = 0; i < n; i++)
+    virtio_disk_wait(bs[i]);
+}
+
+// Start reading the n blocks in blocknos, at most
+// READAHEAD, into the cache without waiting for them, except
+// those that are cached already. The buffers stay locked, so
+// a bread() of one waits for its read to finish, until
+// virtio_disk_intr() calls bdone().
+void
+breadahead(uint dev, uint *blocknos, int n)
+{
+  struct buf *b, *bs[READAHEAD];
+  int nb = 0;
+
+  for(int i = 0; i < n && i < READAHEAD; i++){
+    uint h = bhash(dev, blocknos[i]);
+
+    acquire(&bcache.bucket[h].lock);
+    for(b = bcache.bucket[h].head; b; b = b->hnext)
+      if(b->dev == dev && b->blockno == blocknos[i])
+        break;
+    release(&bcache.bucket[h].lock);
+    if(b)
+      continue;
+
+    b = bget(dev, blocknos[i]);
+    if(b->valid){
+      brelse(b);   // another process read it meanwhile
+      continue;
+    }
+    b->async = 1;
+    bs[nb++] = b;
+  }
+  if(nb > 0)
+    virtio_disk_submit(bs, nb, 0);
+}
+
+// Drop a reference to an unlocked buffer.
+static void
+bput(struct buf *b)
+{
+  uint h = bhash(b->dev, b->blockno);
+
+  acquire(&bcache.bucket[h].lock);
+  b->refcnt--;
+  if (b->refcnt == 0) {
+    // no one is waiting for it.
+    acquire(&bcache.lrulock);
+    lru_push(b);
+    release(&bcache.lrulock);
+  }
+  release(&bcache.bucket[h].lock);
+}
+
 // Release a locked buffer.
 // Move to the head of the most-recently-used list.
 void
@@ -120,34 +327,51 @@ brelse(struct buf *b)
     panic("brelse");
 
   releasesleep(&b->lock);
+  bput(b);
+}
 
-  acquire(&bcache.lock);
-  b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+// The read breadahead() started is done; release b for the
+// process that started it. Called from the disk interrupt.
+void
+bdone(struct buf *b)
+{
+  b->valid = 1;
+  releasesleep(&b->lock);
+  bput(b);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  uint h = bhash(b->dev, b->blockno);
+
+  acquire(&bcache.bucket[h].lock);
   b->refcnt++;
-  release(&bcache.lock);
+  release(&bcache.bucket[h].lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
-  b->refcnt--;
-  release(&bcache.lock);
+  uint h = bhash(b->dev, b->blockno);
+
+  acquire(&bcache.bucket[h].lock);
+  if(--b->refcnt == 0){
+    acquire(&bcache.lrulock);
+    lru_push(b);
+    release(&bcache.lrulock);
+  }
+  release(&bcache.bucket[h].lock);
 }
 
+// Print the size and hit rate of the cache, for ^P.
+void
+bcachedump(void)
+{
+  uint hits = 0, misses = 0;
 
+  for(int i = 0; i < bcache.nbucket; i++){
+    hits += bcache.bucket[i].hits;
+    misses += bcache.bucket[i].misses;
+  }
+  printf("bcache: %d buffers, %d buckets, %d hits, %d misses, %d evictions\n",
+         bcache.nbuf, bcache.nbucket, hits, misses, bcache.evictions);
+}
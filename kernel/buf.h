@@ -1,12 +1,17 @@
 struct buf {
   int valid;   // has data been read from disk?
   int disk;    // does disk "own" buf?
+  int async;   // read started by breadahead()?
+  int qwrite;  // queued to be written, not read
+  struct buf *qnext; // disk queue, then the rest of its request
   uint dev;
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
+  struct buf *prev; // LRU list of unused buffers
   struct buf *next;
+  struct buf *hnext; // hash chain of its bucket
+  int hashed;        // on a hash chain?
   uchar data[BSIZE];
 };
 
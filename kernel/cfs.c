@@ -0,0 +1,330 @@
+// Completely fair scheduling class (SCHED_CFS).
+//
+// Every process has a virtual run time: the cycles it has
+// run, scaled by 1024/weight, so a heavier process ages
+// more slowly. RUNNABLE processes are kept in an AVL tree
+// ordered by vruntime and the leftmost one runs next. The
+// weight comes from Static_priority (set_priority), with
+// the default of 60 as weight 1024.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NICE0_WEIGHT 1024
+
+// A process that slept may come back at most this far
+// behind the least vruntime in the tree, so it runs soon
+// after waking but cannot bank credit for the time it slept.
+#define CFS_SLEEPER_CREDIT TICKCYCLES
+
+// The running process is only preempted by a new or
+// re-prioritised process that is this far behind it.
+#define CFS_WAKEUP_GRAN TICKCYCLES
+
+// Linux's nice-to-weight table: each nice level is
+// about 1.25 times the weight of the next.
+static const int prio_to_weight[40] = {
+  /* -20 */ 88761, 71755, 56483, 46273, 36291,
+  /* -15 */ 29154, 23254, 18705, 14949, 11916,
+  /* -10 */  9548,  7620,  6100,  4904,  3906,
+  /*  -5 */  3121,  2501,  1991,  1586,  1277,
+  /*   0 */  1024,   820,   655,   526,   423,
+  /*   5 */   335,   272,   215,   172,   137,
+  /*  10 */   110,    87,    70,    56,    45,
+  /*  15 */    36,    29,    23,    18,    15,
+};
+
+struct {
+  struct spinlock lock;
+  struct proc *root;
+  uint64 min_vruntime;              // never decreases
+} cfs;
+
+// Static_priority 0..100, lower is more important.
+// 0..60 maps to nice -20..0, 60..100 to nice 0..19.
+static int
+cfs_weight(struct proc *p)
+{
+  int sp = p->Static_priority, nice;
+
+  if(sp < 60)
+    nice = (sp - 60) / 3;
+  else
+    nice = (sp - 60) / 2;
+  if(nice < -20)
+    nice = -20;
+  if(nice > 19)
+    nice = 19;
+  return prio_to_weight[nice + 20];
+}
+
+// p's vruntime including run time not yet charged,
+// for p running on this hart.
+static uint64
+cfs_curvruntime(struct proc *p)
+{
+  return p->vruntime + (sched_runtime(p) - p->cfs_charged) * NICE0_WEIGHT / p->cfs_weight;
+}
+
+static int
+cfs_before(struct proc *a, struct proc *b)
+{
+  if(a->vruntime != b->vruntime)
+    return a->vruntime < b->vruntime;
+  return a < b;
+}
+
+static int
+height(struct proc *n)
+{
+  return n ? n->cfs_height : 0;
+}
+
+static void
+fixheight(struct proc *n)
+{
+  int l = height(n->cfs_left), r = height(n->cfs_right);
+
+  n->cfs_height = 1 + (l > r ? l : r);
+}
+
+static struct proc*
+rotright(struct proc *n)
+{
+  struct proc *l = n->cfs_left;
+
+  n->cfs_left = l->cfs_right;
+  l->cfs_right = n;
+  fixheight(n);
+  fixheight(l);
+  return l;
+}
+
+static struct proc*
+rotleft(struct proc *n)
+{
+  struct proc *r = n->cfs_right;
+
+  n->cfs_right = r->cfs_left;
+  r->cfs_left = n;
+  fixheight(n);
+  fixheight(r);
+  return r;
+}
+
+// Restore the AVL balance at n after one of its
+// subtrees grew or shrank by one. Returns the new
+// subtree root.
+static struct proc*
+rebalance(struct proc *n)
+{
+  int bf;
+
+  fixheight(n);
+  bf = height(n->cfs_left) - height(n->cfs_right);
+  if(bf > 1){
+    if(height(n->cfs_left->cfs_left) < height(n->cfs_left->cfs_right))
+      n->cfs_left = rotleft(n->cfs_left);
+    return rotright(n);
+  }
+  if(bf < -1){
+    if(height(n->cfs_right->cfs_right) < height(n->cfs_right->cfs_left))
+      n->cfs_right = rotright(n->cfs_right);
+    return rotleft(n);
+  }
+  return n;
+}
+
+static struct proc*
+tree_insert(struct proc *n, struct proc *p)
+{
+  if(n == 0){
+    p->cfs_left = p->cfs_right = 0;
+    p->cfs_height = 1;
+    return p;
+  }
+  if(cfs_before(p, n))
+    n->cfs_left = tree_insert(n->cfs_left, p);
+  else
+    n->cfs_right = tree_insert(n->cfs_right, p);
+  return rebalance(n);
+}
+
+// Unlink the leftmost node of n into *min.
+static struct proc*
+tree_removemin(struct proc *n, struct proc **min)
+{
+  if(n->cfs_left == 0){
+    *min = n;
+    return n->cfs_right;
+  }
+  n->cfs_left = tree_removemin(n->cfs_left, min);
+  return rebalance(n);
+}
+
+static struct proc*
+tree_remove(struct proc *n, struct proc *p)
+{
+  struct proc *m, *r;
+
+  if(n == 0)
+    return 0;
+  if(n == p){
+    if(n->cfs_right == 0)
+      return n->cfs_left;
+    r = tree_removemin(n->cfs_right, &m);
+    m->cfs_left = n->cfs_left;
+    m->cfs_right = r;
+    return rebalance(m);
+  }
+  if(cfs_before(p, n))
+    n->cfs_left = tree_remove(n->cfs_left, p);
+  else
+    n->cfs_right = tree_remove(n->cfs_right, p);
+  return rebalance(n);
+}
+
+// The leftmost process under n that may run on hart cpu.
+static struct proc*
+tree_first(struct proc *n, int cpu)
+{
+  struct proc *p;
+
+  if(n == 0)
+    return 0;
+  if((p = tree_first(n->cfs_left, cpu)) != 0)
+    return p;
+  if(sched_allowed(n, cpu))
+    return n;
+  return tree_first(n->cfs_right, cpu);
+}
+
+// Mark p as out of the tree.
+static void
+tree_clear(struct proc *p)
+{
+  p->cfs_left = p->cfs_right = 0;
+  p->cfs_height = 0;
+}
+
+static void
+cfs_init(void)
+{
+  initlock(&cfs.lock, "cfs");
+}
+
+// Charge p for what it ran since it was last queued,
+// then insert it.
+static void
+cfs_enqueue(struct proc *p)
+{
+  uint64 now = sched_runtime(p);
+
+  p->cfs_weight = cfs_weight(p);
+  p->vruntime += (now - p->cfs_charged) * NICE0_WEIGHT / p->cfs_weight;
+  p->cfs_charged = now;
+
+  acquire(&cfs.lock);
+  if(p->vruntime + CFS_SLEEPER_CREDIT < cfs.min_vruntime)
+    p->vruntime = cfs.min_vruntime - CFS_SLEEPER_CREDIT;
+  cfs.root = tree_insert(cfs.root, p);
+  release(&cfs.lock);
+}
+
+static int
+cfs_dequeue(struct proc *p)
+{
+  int found = 0;
+
+  acquire(&cfs.lock);
+  if(p->cfs_height != 0){
+    cfs.root = tree_remove(cfs.root, p);
+    tree_clear(p);
+    found = 1;
+  }
+  release(&cfs.lock);
+  return found;
+}
+
+static struct proc*
+cfs_pick_next(int cpu)
+{
+  struct proc *p = 0;
+
+  acquire(&cfs.lock);
+  if((p = tree_first(cfs.root, cpu)) != 0){
+    cfs.root = tree_remove(cfs.root, p);
+    tree_clear(p);
+    if(p->vruntime > cfs.min_vruntime)
+      cfs.min_vruntime = p->vruntime;
+  }
+  release(&cfs.lock);
+  return p;
+}
+
+// Yield once the running process has got ahead of the
+// leftmost waiting one.
+static int
+cfs_tick(struct proc *p)
+{
+  struct proc *n;
+  int preempt = 0;
+
+  acquire(&cfs.lock);
+  if((n = cfs.root) != 0){
+    while(n->cfs_left)
+      n = n->cfs_left;
+    preempt = cfs_curvruntime(p) > n->vruntime;
+  }
+  release(&cfs.lock);
+  return preempt;
+}
+
+static int
+cfs_yield_check(struct proc *cur, struct proc *p)
+{
+  return cfs_curvruntime(cur) > p->vruntime + CFS_WAKEUP_GRAN;
+}
+
+// Only future run time is weighed with the new weight.
+// A queued process keeps its vruntime, and so its place
+// in the tree; it can't leave the tree and come back in
+// while we hold p->lock.
+static void
+cfs_prio_changed(struct proc *p)
+{
+  uint64 now = sched_runtime(p);
+
+  if(p->cfs_height == 0){
+    p->vruntime += (now - p->cfs_charged) * NICE0_WEIGHT / p->cfs_weight;
+    p->cfs_charged = now;
+  }
+  p->cfs_weight = cfs_weight(p);
+}
+
+// Run time from the old class was not fair-shared;
+// start p level with the processes already here.
+static void
+cfs_switched_to(struct proc *p)
+{
+  p->cfs_charged = sched_runtime(p);
+  p->cfs_weight = cfs_weight(p);
+  p->vruntime = cfs.min_vruntime;
+}
+
+struct sched_class cfs_class = {
+  .name = "cfs",
+  .init = cfs_init,
+  .enqueue = cfs_enqueue,
+  .dequeue = cfs_dequeue,
+  .pick_next = cfs_pick_next,
+  .tick = cfs_tick,
+  .yield_check = cfs_yield_check,
+  .prio_changed = cfs_prio_changed,
+  .switched_to = cfs_switched_to,
+};
@@ -0,0 +1,9 @@
+// Clocks for clock_gettime().
+// Needs kernel/types.h.
+#define CLOCK_MONOTONIC          0  // since boot, from the time CSR
+#define CLOCK_PROCESS_CPUTIME_ID 1  // time the caller has run
+
+struct timespec {
+  uint64 sec;
+  uint64 nsec;                 // below 1000000000
+};
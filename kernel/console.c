@@ -27,20 +27,31 @@
 
 //
 // send one character to the uart.
-// called by printf, and to echo input characters,
+// called to echo input characters,
 // but not from write().
 //
 void
 consputc(int c)
 {
+  char ch = c;
+
   if(c == BACKSPACE){
     // if the user typed backspace, overwrite with a space.
-    uartputc_sync('\b'); uartputc_sync(' '); uartputc_sync('\b');
+    uartwrite("\b \b", 3);
   } else {
-    uartputc_sync(c);
+    uartwrite(&ch, 1);
   }
 }
 
+//
+// send n characters to the uart, for printf.
+//
+void
+consputs(char *s, int n)
+{
+  uartwrite(s, n);
+}
+
 struct {
   struct spinlock lock;
   
@@ -140,6 +151,13 @@ consoleintr(int c)
   switch(c){
   case C('P'):  // Print process list.
     procdump();
+    kmemdump();
+    kcachedump();
+    bcachedump();
+    icachedump();
+    dcachedump();
+    execcachedump();
+    lockdump();
     break;
   case C('U'):  // Kill line.
     while(cons.e != cons.w &&
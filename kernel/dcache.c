@@ -0,0 +1,144 @@
+// Directory entry cache.
+//
+// Remembers what dirlookup() found for (directory, name):
+// the inode number and offset of the entry, or that there
+// is none (inum 0). It is a set-associative table of
+// NDCACHE entries in sets of DCWAYS; a new entry replaces
+// the least recently used one of its set.
+//
+// The caller holds the directory's sleep lock, which orders
+// lookups against dirlink() and unlink() of that directory;
+// dcache.lock only protects the table. dirlink() and
+// sys_unlink() keep the entry of the name they change up to
+// date, and iput() drops all entries of a directory whose
+// inode is freed, before its number can be used again.
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "defs.h"
+#include "fs.h"
+#include "file.h"
+
+#define NDCACHE 256
+#define DCWAYS  4
+#define NDCSET  (NDCACHE / DCWAYS)
+
+struct dcentry {
+  uint dev;
+  uint dinum;                 // directory; 0 if the slot is free
+  char name[DIRSIZ];
+  uint inum;                  // 0 if the name is not there
+  uint off;                   // offset of the dirent, if it is
+  uint used;                  // dcache.clock at the last use
+};
+
+struct {
+  struct spinlock lock;
+  struct dcentry ent[NDCACHE];
+  uint clock;
+  uint hits, misses;
+} dcache;
+
+void
+dcache_init(void)
+{
+  initlock(&dcache.lock, "dcache");
+}
+
+static struct dcentry*
+dcset(uint dev, uint dinum, char *name)
+{
+  uint h = dev * 31 + dinum;
+
+  for(int i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + (uchar)name[i];
+  return &dcache.ent[(h % NDCSET) * DCWAYS];
+}
+
+// The entry for name in directory (dev, dinum), or 0.
+// Caller holds dcache.lock.
+static struct dcentry*
+dcfind(uint dev, uint dinum, char *name)
+{
+  struct dcentry *e = dcset(dev, dinum, name);
+
+  for(int i = 0; i < DCWAYS; i++, e++)
+    if(e->dinum == dinum && e->dev == dev && namecmp(name, e->name) == 0)
+      return e;
+  return 0;
+}
+
+// Look name up in directory dp. Returns 1 and sets *inum
+// (0 if the name is known not to be there) and *off, or
+// returns 0 if the cache doesn't know.
+int
+dcache_lookup(struct inode *dp, char *name, uint *inum, uint *off)
+{
+  struct dcentry *e;
+  int found = 0;
+
+  acquire(&dcache.lock);
+  if((e = dcfind(dp->dev, dp->inum, name)) != 0){
+    e->used = ++dcache.clock;
+    *inum = e->inum;
+    *off = e->off;
+    found = 1;
+    dcache.hits++;
+  } else {
+    dcache.misses++;
+  }
+  release(&dcache.lock);
+  return found;
+}
+
+// Record that name in directory dp is inode inum, at offset
+// off, or that it is not there if inum is 0.
+void
+dcache_enter(struct inode *dp, char *name, uint inum, uint off)
+{
+  struct dcentry *e, *old;
+
+  acquire(&dcache.lock);
+  if((e = dcfind(dp->dev, dp->inum, name)) == 0){
+    e = old = dcset(dp->dev, dp->inum, name);
+    for(int i = 0; i < DCWAYS; i++, e++){
+      if(e->dinum == 0){
+        old = e;
+        break;
+      }
+      if(e->used < old->used)
+        old = e;
+    }
+    e = old;
+    e->dev = dp->dev;
+    e->dinum = dp->inum;
+    strncpy(e->name, name, DIRSIZ);
+  }
+  e->inum = inum;
+  e->off = off;
+  e->used = ++dcache.clock;
+  release(&dcache.lock);
+}
+
+// Forget every entry of directory (dev, dinum).
+void
+dcache_purge(uint dev, uint dinum)
+{
+  struct dcentry *e;
+
+  acquire(&dcache.lock);
+  for(e = dcache.ent; e < &dcache.ent[NDCACHE]; e++)
+    if(e->dinum == dinum && e->dev == dev)
+      e->dinum = 0;
+  release(&dcache.lock);
+}
+
+// Print the hit rate, for ^P.
+void
+dcachedump(void)
+{
+  printf("dcache: %d entries, %d hits, %d misses\n", NDCACHE, dcache.hits, dcache.misses);
+}
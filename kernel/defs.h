@@ -1,29 +1,61 @@
 struct buf;
 struct context;
+struct execseg;
 struct file;
 struct inode;
+struct iovec;
+struct kcache;
+struct memstat;
+struct vdso;
+struct vma;
+struct vproc;
 struct pipe;
 struct proc;
+struct procheap;
+struct procq;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct timespec;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bwritev(struct buf**, int);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+void            bcachedump(void);
+void            breadahead(uint, uint*, int);
+void            bdone(struct buf*);
 
 // console.c
 void            consoleinit(void);
 void            consoleintr(int);
 void            consputc(int);
+void            consputs(char*, int);
+
+// dcache.c
+void            dcache_init(void);
+int             dcache_lookup(struct inode*, char*, uint*, uint*);
+void            dcache_enter(struct inode*, char*, uint, uint);
+void            dcache_purge(uint, uint);
+void            dcachedump(void);
 
 // exec.c
 int             exec(char*, char**);
+int             execp(struct proc*, char*, char**);
+int             execreadpage(struct inode*, struct execseg*, uint64, char*);
+void            exehold(struct inode*);
+void            exeput(struct inode*);
+void            execcache_init(void);
+int             execcache_get(struct inode*, uint64*, uint64*, struct execseg*, int*);
+void            execcache_put(struct inode*, uint64, uint64, struct execseg*, int);
+void            execcache_drop(struct inode*);
+uint64          execcache_page(struct inode*, struct execseg*, uint64);
+void            execcachedump(void);
 
 // file.c
 struct file*    filealloc(void);
@@ -32,7 +64,11 @@ struct file*    filedup(struct file*);
 void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
+int             fileseek(struct file*, int, int);
 int             filewrite(struct file*, uint64, int n);
+int             filesplice(struct file*, struct file*, int);
+int             filereadv(struct file*, struct iovec*, int);
+int             filewritev(struct file*, struct iovec*, int);
 
 // fs.c
 void            fsinit(int);
@@ -40,6 +76,7 @@ int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+void            icachedump(void);
 void            iinit();
 void            ilock(struct inode*);
 void            iput(struct inode*);
@@ -61,20 +98,53 @@ void            ramdiskrw(struct buf*);
 
 // kalloc.c
 void*           kalloc(void);
+void*           kzalloc(void);
+void*           kallocn(int);
+void            kfreen(void*, int);
+void            kmemdump(void);
+int             kfreepages(void);
+int             kzero_fill(void);
+void            kref(void*);
+int             krefs(void*);
 void            kfree(void *);
 void            kinit(void);
 
+// slab.c
+void            kcache_init(struct kcache*, char*, uint);
+void*           kcache_alloc(struct kcache*);
+void            kcache_free(struct kcache*, void*);
+void            kcache_release(struct kcache*, void*);
+void            kcachedump(void);
+
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
+void            log_sync(void);
+
+// futex.c
+void            futexinit(void);
+int             futex_wait(uint64, int);
+int             futex_wake(uint64, int);
+
+// mmap.c
+struct vma*     mmap_find(struct proc*, uint64);
+uint64          mmap(struct file*, uint64, int, int, uint);
+int             munmap(uint64, uint64);
+int             mmap_fork(struct proc*, struct proc*);
+void            mmap_free(struct proc*, pagetable_t);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
-int             piperead(struct pipe*, uint64, int);
-int             pipewrite(struct pipe*, uint64, int);
+int             piperead(struct pipe*, int, uint64, int);
+int             pipewrite(struct pipe*, int, uint64, int);
+int             pipe_wspan(struct pipe*, char**);
+void            pipe_wdone(struct pipe*, int);
+int             pipe_rspan(struct pipe*, char**);
+void            pipe_rdone(struct pipe*, int);
 
 // printf.c
 void            printf(char*, ...);
@@ -85,11 +155,18 @@ void            printfinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
-int             growproc(int);
+int             clone(uint64, uint64, uint64);
+int             join(int);
+int             spawn(char*, char**, int*);
+uint64          growproc(int);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
+struct proc*    findproc(int);
+struct proc*    slotproc(int);
+extern struct proc *procs[];
+extern int      nproc;
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
 struct proc*    myproc();
@@ -97,16 +174,71 @@ void            procinit(void);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            sleep(void*, struct spinlock*);
+void            sleepuntil(void*, struct spinlock*, uint);
+void            wakeproc(struct proc*, void*);
 void            userinit(void);
+void            kproc(char*, void (*)(void));
 int             wait(uint64);
 void            wakeup(void*);
-int             waitx(uint64, uint*, uint*);
+int             wakeupn(void*, int);
+int             waitx(uint64, uint64*, uint64*);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             proc_memstat(int, uint64);
+int             proc_snapshot(uint64, int);
 int             set_priority_i(int priority, int pid);
-void            update_time(void);
+int             set_tickets_i(int tickets, int pid);
+
+// sched.c
+extern int      sched_default;
+void            schedinit(void);
+void            setrunnable(struct proc*);
+int             sched_allowed(struct proc*, int);
+int             sched_place(struct proc*, int (*)(int));
+int             sched_setaffinity_i(int, int);
+int             sched_busiest(int, int (*)(int));
+int             sched_tick(struct proc*);
+void            sched_timer(struct proc*);
+uint64          sched_runtime(struct proc*);
+int             sched_yield_check(struct proc*);
+int             set_policy_i(int, int);
+void            sched_setclass(struct proc*, int);
+void            sched_exit(struct proc*);
+int             sched_stats(int, uint64);
+void            procq_push(struct procq*, struct proc*);
+struct proc*    procq_pop(struct procq*);
+struct proc*    procq_pop_cpu(struct procq*, int);
+int             procq_remove(struct procq*, struct proc*);
+void            procheap_init(struct procheap*, char*, int (*)(struct proc*, struct proc*));
+void            procheap_push(struct procheap*, struct proc*);
+struct proc*    procheap_pop(struct procheap*, int);
+int             procheap_remove(struct procheap*, struct proc*);
+void            procheap_fix(struct procheap*, struct proc*);
+struct proc*    procheap_pick(struct procheap*, int (*)(int), int);
+
+// edf.c
+int             edf_ready(void);
+int             edf_active(void);
+int             edf_setparam(int, int, int);
+
+// mlfq.c
+int             mlfq_setparam(uint64, uint64);
+extern uint     mlfq_epoch;
+
+// schedtrace.c
+extern int      schedtrace_on;
+void            schedtraceinit(void);
+int             schedtrace(int);
+void            schedtrace_log(int, struct proc*);
+int             schedtrace_read(uint64, int);
+#define SCHEDTRACE(type, p) do { if(schedtrace_on) schedtrace_log(type, p); } while(0)
+
+// trace.c
+void            traceinit(void);
+void            trace_record(struct proc*, int, int, uint64*, uint64);
+int             trace_read(uint64, int, int);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -118,6 +250,7 @@ void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+void            lockdump(void);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
@@ -141,25 +274,40 @@ int             argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
+int             sysprof_read(int, uint64, int);
 
 // trap.c
 extern uint     ticks;
+extern struct vdso *vdso;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            usertrapret(void);
+void            ipi(int);
+uint64          cycles2ns(uint64);
+int             clock_gettime(int, struct timespec*);
+void            tickupdate(void);
+void            twheel_add(struct proc*, void*, uint);
+void            twheel_del(struct proc*);
+uint64          twheel_due(int);
+void            timer_set(uint64);
+void            timer_kick(int);
 
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
 void            uartputc_sync(int);
+void            uartwrite(char*, int);
 int             uartgetc(void);
 
 // vm.c
 void            kvminit(void);
 void            kvminithart(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
+void            kvmmapstack(uint64, uint64);
+uint64          kvmunmapstack(int);
+void            kstack_sfence(struct proc*);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 void            uvminit(pagetable_t, uchar *, uint);
@@ -169,8 +317,19 @@ int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
+void            uvmstat(pagetable_t, struct memstat*);
+pte_t *         walk(pagetable_t, uint64, int);
+extern int      asidok;
+void            asid_invalidate(pagetable_t);
+uint64          asid_satp(struct proc*);
+void            tlb_shootdown(pagetable_t);
+void            tlb_ack(void);
 uint64          walkaddr(pagetable_t, uint64);
+uint64          uvmaddr(pagetable_t, uint64, int);
 int             copyout(pagetable_t, uint64, char *, uint64);
+int             cowfault(pagetable_t, uint64);
+int             vmfault(struct proc*, uint64, int);
+void            vmprefault(struct proc*, uint64, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 
@@ -183,6 +342,8 @@ void            plic_complete(int);
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_submit(struct buf **, int, int);
+void            virtio_disk_wait(struct buf *);
 void            virtio_disk_intr(void);
 
 // number of elements in fixed-size array
@@ -0,0 +1,254 @@
+// Earliest deadline first real-time class (SCHED_EDF).
+//
+// A process joins with sched_deadline(runtime, period,
+// deadline), all in ticks: every period it may run for
+// runtime ticks, which must be done deadline ticks after
+// the period starts. Admission control keeps the sum of
+// runtime/period over all EDF processes within EDF_MAX_BW
+// per online cpu. Runnable processes are in a heap by
+// absolute deadline; scheduler() asks this class first.
+//
+// The budget is charged in the tick op, from the timer path
+// of usertrap() and kerneltrap(), with the whole ticks of
+// run time used since it was last charged; timer interrupts
+// also come for other events. A process that uses it up
+// is throttled: it waits in a second heap, by release time,
+// until its next period begins and the budget is refilled.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "sched.h"
+#include "defs.h"
+
+#define EDF_BW_UNIT 1000            // dl_bw is in thousandths of a cpu
+#define EDF_MAX_BW  950             // leave 5% of every cpu to the rest
+#define EDF_MAX_PERIOD (1 << 20)    // ticks; keeps tick arithmetic far from wrapping
+
+static int
+edf_cmp(struct proc *p, struct proc *q)
+{
+  if(p->dl_abs != q->dl_abs)
+    return (int)(p->dl_abs - q->dl_abs) < 0 ? -1 : 1;
+  return p->pid < q->pid ? -1 : 1;
+}
+
+static int
+edf_release_cmp(struct proc *p, struct proc *q)
+{
+  if(p->dl_release != q->dl_release)
+    return (int)(p->dl_release - q->dl_release) < 0 ? -1 : 1;
+  return p->pid < q->pid ? -1 : 1;
+}
+
+struct procheap edf;                // RUNNABLE, by deadline
+struct procheap edf_throttled;      // RUNNABLE, out of budget
+
+struct spinlock edf_bwlock;
+int edf_bw;                         // admitted bandwidth, EDF_BW_UNIT
+
+static void
+edf_init(void)
+{
+  procheap_init(&edf, "edf", edf_cmp);
+  procheap_init(&edf_throttled, "edf_throttled", edf_release_cmp);
+  initlock(&edf_bwlock, "edf_bw");
+}
+
+// Start a new period at now with a full budget.
+static void
+edf_replenish(struct proc *p, uint now)
+{
+  p->dl_abs = now + p->dl_deadline;
+  p->dl_release = now + p->dl_period;
+  p->dl_budget = p->dl_runtime;
+  p->dl_charged = sched_runtime(p);
+  p->dl_throttled = 0;
+}
+
+// A process that wakes up keeps its deadline only if
+// running out its budget by then stays within its
+// bandwidth (the CBS wakeup rule); otherwise it gets a
+// new period, so sleeping can't be used to run past it.
+static void
+edf_enqueue(struct proc *p)
+{
+  if(p->dl_throttled){
+    if((int)(ticks - p->dl_release) < 0){
+      procheap_push(&edf_throttled, p);
+      return;
+    }
+    edf_replenish(p, p->dl_release);
+  }
+  if((int)(p->dl_abs - ticks) <= 0 ||
+     (uint64)p->dl_budget * p->dl_deadline > (uint64)p->dl_runtime * (p->dl_abs - ticks))
+    edf_replenish(p, ticks);
+  procheap_push(&edf, p);
+}
+
+static int
+edf_dequeue(struct proc *p)
+{
+  return procheap_remove(&edf, p) || procheap_remove(&edf_throttled, p);
+}
+
+// Move throttled processes whose new period has begun
+// back to the ready heap, then take the earliest deadline.
+static struct proc*
+edf_pick_next(int cpu)
+{
+  struct proc *p;
+
+  while((p = procheap_pop(&edf_throttled, -1)) != 0){
+    if((int)(ticks - p->dl_release) < 0){
+      procheap_push(&edf_throttled, p);
+      break;
+    }
+    edf_replenish(p, p->dl_release);
+    procheap_push(&edf, p);
+  }
+  return procheap_pop(&edf, cpu);
+}
+
+// True if an EDF process is waiting to run, or is due to
+// be released; every other class yields to it on the next
+// tick, see sched_tick().
+int
+edf_ready(void)
+{
+  int ready;
+
+  acquire(&edf.lock);
+  ready = edf.n > 0;
+  release(&edf.lock);
+  if(ready)
+    return 1;
+
+  acquire(&edf_throttled.lock);
+  ready = edf_throttled.n > 0 && (int)(ticks - edf_throttled.heap[0]->dl_release) >= 0;
+  release(&edf_throttled.lock);
+  return ready;
+}
+
+// True if any process holds EDF bandwidth. Its releases
+// are only noticed on ticks, so harts keep ticking while it
+// does; read without edf_bwlock.
+int
+edf_active(void)
+{
+  return edf_bw > 0;
+}
+
+static int
+edf_tick(struct proc *p)
+{
+  uint64 used = (sched_runtime(p) - p->dl_charged) / TICKCYCLES;
+  int preempt;
+
+  p->dl_budget -= used;
+  p->dl_charged += used * TICKCYCLES;
+  if(p->dl_budget <= 0){
+    p->dl_throttled = 1;
+    return 1;
+  }
+
+  acquire(&edf.lock);
+  preempt = edf.n > 0 && edf_cmp(edf.heap[0], p) < 0;
+  release(&edf.lock);
+  return preempt;
+}
+
+static int
+edf_yield_check(struct proc *cur, struct proc *p)
+{
+  return edf_cmp(p, cur) < 0;
+}
+
+static void
+edf_switched_to(struct proc *p)
+{
+  edf_replenish(p, ticks);
+}
+
+// Give back p's bandwidth when it leaves the class or exits.
+static void
+edf_switched_from(struct proc *p)
+{
+  acquire(&edf_bwlock);
+  edf_bw -= p->dl_bw;
+  release(&edf_bwlock);
+  p->dl_bw = 0;
+}
+
+// Admit the current process to the EDF class with the given
+// parameters, or change them if it is already in it.
+// A runtime of 0 moves it back to the default class.
+// Returns 0, or -1 if the parameters are bad or the
+// bandwidth is not available.
+int
+edf_setparam(int runtime, int period, int deadline)
+{
+  struct proc *p = myproc();
+  int bw, ncpu = 0, kick;
+
+  if(runtime == 0){
+    acquire(&p->lock);
+    if(p->policy == SCHED_EDF)
+      sched_setclass(p, sched_default);
+    release(&p->lock);
+    return 0;
+  }
+  if(runtime < 0 || deadline < runtime || period < deadline ||
+     period > EDF_MAX_PERIOD)
+    return -1;
+  bw = (uint64)runtime * EDF_BW_UNIT / period;
+  if(bw > EDF_MAX_BW)
+    return -1;
+  if(bw == 0)
+    bw = 1;
+
+  for(int i = 0; i < NCPU; i++)
+    if(cpus[i].online)
+      ncpu++;
+
+  acquire(&p->lock);
+  acquire(&edf_bwlock);
+  if(edf_bw - p->dl_bw + bw > ncpu * EDF_MAX_BW){
+    release(&edf_bwlock);
+    release(&p->lock);
+    return -1;
+  }
+  kick = edf_bw == 0;
+  edf_bw += bw - p->dl_bw;
+  release(&edf_bwlock);
+  // harts without a periodic tick start ticking again.
+  for(int i = 0; kick && i < NCPU; i++)
+    if(cpus[i].online)
+      timer_kick(i);
+
+  p->dl_bw = bw;
+  p->dl_runtime = runtime;
+  p->dl_period = period;
+  p->dl_deadline = deadline;
+  if(p->policy == SCHED_EDF)
+    edf_replenish(p, ticks);
+  else
+    sched_setclass(p, SCHED_EDF);
+  release(&p->lock);
+  return 0;
+}
+
+struct sched_class edf_class = {
+  .name = "edf",
+  .init = edf_init,
+  .enqueue = edf_enqueue,
+  .dequeue = edf_dequeue,
+  .pick_next = edf_pick_next,
+  .tick = edf_tick,
+  .yield_check = edf_yield_check,
+  .switched_to = edf_switched_to,
+  .switched_from = edf_switched_from,
+};
@@ -6,20 +6,39 @@
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
 
 static int loadseg(pde_t *pgdir, uint64 addr, struct inode *ip, uint offset, uint sz);
 
 int
 exec(char *path, char **argv)
+{
+  struct proc *p = myproc();
+
+  // the other threads would be left without a program.
+  if(p->group != p || p->nthread > 0)
+    return -1;
+  return execp(p, path, argv);
+}
+
+// Replace the user image of p with the program at path.
+// p is the caller, or a new process being built by spawn().
+// The program's segments are only reserved here; vmfault()
+// reads each page from the inode when it is first touched.
+// Returns argc, which the caller puts in p's a0.
+int
+execp(struct proc *p, char *path, char **argv)
 {
   char *s, *last;
-  int i, off;
+  int i, off, nseg = 0, eager = 0;
   uint64 argc, sz = 0, sp, ustack[MAXARG], stackbase;
   struct elfhdr elf;
-  struct inode *ip;
+  struct inode *ip, *exe = 0, *oldexe;
   struct proghdr ph;
+  struct execseg seg[NEXECSEG];
   pagetable_t pagetable = 0, oldpagetable;
-  struct proc *p = myproc();
 
   begin_op();
 
@@ -29,39 +48,57 @@ exec(char *path, char **argv)
   }
   ilock(ip);
 
-  // Check ELF header
-  if(readi(ip, 0, (uint64)&elf, 0, sizeof(elf)) != sizeof(elf))
-    goto bad;
-  if(elf.magic != ELF_MAGIC)
-    goto bad;
-
   if((pagetable = proc_pagetable(p)) == 0)
     goto bad;
 
-  // Load program into memory.
-  for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
-    if(readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
+  // A cached image needs no headers read.
+  if(execcache_get(ip, &elf.entry, &sz, seg, &nseg) == 0){
+    // Check ELF header
+    if(readi(ip, 0, (uint64)&elf, 0, sizeof(elf)) != sizeof(elf))
       goto bad;
-    if(ph.type != ELF_PROG_LOAD)
-      continue;
-    if(ph.memsz < ph.filesz)
-      goto bad;
-    if(ph.vaddr + ph.memsz < ph.vaddr)
-      goto bad;
-    uint64 sz1;
-    if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz)) == 0)
-      goto bad;
-    sz = sz1;
-    if((ph.vaddr % PGSIZE) != 0)
-      goto bad;
-    if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(elf.magic != ELF_MAGIC)
       goto bad;
+
+    // Load program into memory.
+    for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
+      if(readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
+        goto bad;
+      if(ph.type != ELF_PROG_LOAD)
+        continue;
+      if(ph.memsz < ph.filesz)
+        goto bad;
+      if(ph.vaddr + ph.memsz < ph.vaddr || ph.vaddr + ph.memsz > USERTOP)
+        goto bad;
+      if((ph.vaddr % PGSIZE) != 0)
+        goto bad;
+      if(ph.off + ph.filesz < ph.off || ph.off + ph.filesz > ip->size)
+        goto bad;
+      if(nseg < NEXECSEG){
+        seg[nseg].va = ph.vaddr;
+        seg[nseg].filesz = ph.filesz;
+        seg[nseg].off = ph.off;
+        nseg++;
+      } else {
+        // no slot left: load this one now.
+        if(uvmalloc(pagetable, ph.vaddr, ph.vaddr + ph.memsz) == 0)
+          goto bad;
+        if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
+          goto bad;
+        eager = 1;
+      }
+      if(ph.vaddr + ph.memsz > sz)
+        sz = ph.vaddr + ph.memsz;
+    }
+    if(!eager)
+      execcache_put(ip, elf.entry, sz, seg, nseg);
   }
-  iunlockput(ip);
+  // keep the reference: the pages are read from ip later.
+  exehold(ip);
+  iunlock(ip);
   end_op();
+  exe = ip;
   ip = 0;
 
-  p = myproc();
   uint64 oldsz = p->sz;
 
   // Allocate two pages at the next page boundary.
@@ -110,11 +147,24 @@ exec(char *path, char **argv)
     
   // Commit to the user image.
   oldpagetable = p->pagetable;
+  oldexe = p->exe;
+  acquire(&p->lock);          // for proc_memstat()
   p->pagetable = pagetable;
+  p->asidgen++;
   p->sz = sz;
+  release(&p->lock);
+  p->exe = exe;
+  memmove(p->seg, seg, nseg * sizeof(seg[0]));
+  p->nseg = nseg;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  mmap_free(p, oldpagetable);
   proc_freepagetable(oldpagetable, oldsz);
+  if(oldexe){
+    begin_op();
+    exeput(oldexe);
+    end_op();
+  }
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
@@ -125,9 +175,33 @@ exec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  if(exe){
+    begin_op();
+    exeput(exe);
+    end_op();
+  }
   return -1;
 }
 
+// ip is the program image of one more process, p->exe.
+// Its pages are read on demand, so writei() refuses to
+// change the file until every such process has exec()ed
+// another program or exited, lest one run a mix of pages
+// of the old and new versions.
+void
+exehold(struct inode *ip)
+{
+  __sync_add_and_fetch(&ip->nexec, 1);
+}
+
+// Drop p->exe, in a transaction.
+void
+exeput(struct inode *ip)
+{
+  __sync_sub_and_fetch(&ip->nexec, 1);
+  iput(ip);
+}
+
 // Load a program segment into pagetable at virtual address va.
 // va must be page-aligned
 // and the pages from va to va+sz must already be mapped.
@@ -152,3 +226,234 @@ loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset, uint sz
   
   return 0;
 }
+
+// Read the program page at va, in segment s of ip, into mem.
+// The part of the page past the segment's file data is left
+// as it is. Returns 0, or -1 if the file is too short.
+int
+execreadpage(struct inode *ip, struct execseg *s, uint64 va, char *mem)
+{
+  uint n;
+
+  n = s->va + s->filesz - va < PGSIZE ? s->va + s->filesz - va : PGSIZE;
+  ilock(ip);
+  if(readi(ip, 0, (uint64)mem, s->off + (va - s->va), n) != n){
+    iunlock(ip);
+    return -1;
+  }
+  iunlock(ip);
+  return 0;
+}
+
+// Exec image cache.
+//
+// Keeps the parsed layout of the last NEXECCACHE programs
+// exec()ed, so exec of one of them reads no headers, and
+// the pages of their segments read so far, which vmfault()
+// maps copy-on-write into every process running them
+// instead of reading its own copy. An image holds a
+// reference to its inode. It is dropped when the inode is
+// written, truncated or unlinked (ip->execcached says to
+// look), or to make room for another.
+
+#define NIMGPAGE (PGSIZE / sizeof(uint64))  // pages of an image that can be cached
+
+struct eimage {
+  struct inode *ip;             // referenced; 0 if the slot is free
+  uint gen;                     // tells a reused slot apart
+  uint64 entry;
+  uint64 sz;
+  struct execseg seg[NEXECSEG];
+  int nseg;
+  uint64 *pages;                // pages[va/PGSIZE], a page; 0 if not read yet
+  uint used;                    // ticks at the last exec, for replacement
+};
+
+struct {
+  struct spinlock lock;
+  struct eimage img[NEXECCACHE];
+  uint gen;
+  uint hits, misses;
+} ecache;
+
+void
+execcache_init(void)
+{
+  initlock(&ecache.lock, "ecache");
+}
+
+static struct eimage*
+eimage_find(struct inode *ip)
+{
+  for(struct eimage *e = ecache.img; e < &ecache.img[NEXECCACHE]; e++)
+    if(e->ip == ip)
+      return e;
+  return 0;
+}
+
+// Drop the image's pages and inode. Caller has taken e off
+// the table, and is in a transaction, for iput().
+static void
+eimage_free(struct inode *ip, uint64 *pages)
+{
+  for(int i = 0; i < NIMGPAGE; i++)
+    if(pages[i])
+      kfree((void*)pages[i]);
+  kfree(pages);
+  iput(ip);
+}
+
+// Fill in the layout of ip if it is cached. ip is locked.
+// Returns 1 if it was.
+int
+execcache_get(struct inode *ip, uint64 *entry, uint64 *sz, struct execseg *seg, int *nseg)
+{
+  struct eimage *e;
+
+  acquire(&ecache.lock);
+  if((e = eimage_find(ip)) == 0){
+    ecache.misses++;
+    release(&ecache.lock);
+    return 0;
+  }
+  ecache.hits++;
+  e->used = ticks;
+  *entry = e->entry;
+  *sz = e->sz;
+  memmove(seg, e->seg, e->nseg * sizeof(seg[0]));
+  *nseg = e->nseg;
+  release(&ecache.lock);
+  return 1;
+}
+
+// Cache the layout exec() just read from ip, replacing the
+// least recently used image. ip is locked, in a transaction.
+void
+execcache_put(struct inode *ip, uint64 entry, uint64 sz, struct execseg *seg, int nseg)
+{
+  struct eimage *e, *v;
+  struct inode *oldip = 0;
+  uint64 *pages, *oldpages = 0;
+
+  if((pages = kzalloc()) == 0)
+    return;
+  idup(ip);
+
+  acquire(&ecache.lock);
+  if(eimage_find(ip)){
+    release(&ecache.lock);          // another exec() was first
+    eimage_free(ip, pages);
+    return;
+  }
+  v = &ecache.img[0];
+  for(e = ecache.img; e < &ecache.img[NEXECCACHE]; e++){
+    if(e->ip == 0){
+      v = e;
+      break;
+    }
+    if(e->used < v->used)
+      v = e;
+  }
+  if(v->ip){
+    v->ip->execcached = 0;
+    oldip = v->ip;
+    oldpages = v->pages;
+  }
+  v->ip = ip;
+  v->gen = ++ecache.gen;
+  v->entry = entry;
+  v->sz = sz;
+  memmove(v->seg, seg, nseg * sizeof(seg[0]));
+  v->nseg = nseg;
+  v->pages = pages;
+  v->used = ticks;
+  ip->execcached = 1;
+  release(&ecache.lock);
+
+  if(oldip)
+    eimage_free(oldip, oldpages);
+}
+
+// ip's contents are changing; forget its image. ip is
+// locked, in a transaction.
+void
+execcache_drop(struct inode *ip)
+{
+  struct eimage *e;
+  uint64 *pages;
+
+  acquire(&ecache.lock);
+  if((e = eimage_find(ip)) == 0){
+    release(&ecache.lock);
+    return;
+  }
+  ip->execcached = 0;
+  pages = e->pages;
+  e->ip = 0;
+  release(&ecache.lock);
+  eimage_free(ip, pages);
+}
+
+// The page at va, in segment s of program ip, from the
+// image cache, reading it in if the image is cached but the
+// page is not. The caller gets a reference to it, and must
+// map it copy-on-write. Returns 0 if ip has no cached image.
+uint64
+execcache_page(struct inode *ip, struct execseg *s, uint64 va)
+{
+  struct eimage *e;
+  uint64 i = va / PGSIZE, pa;
+  uint gen;
+  char *mem;
+
+  if(i >= NIMGPAGE)
+    return 0;
+  acquire(&ecache.lock);
+  if((e = eimage_find(ip)) == 0){
+    release(&ecache.lock);
+    return 0;
+  }
+  if((pa = e->pages[i]) != 0){
+    kref((void*)pa);
+    release(&ecache.lock);
+    return pa;
+  }
+  gen = e->gen;
+  release(&ecache.lock);
+
+  if((mem = kzalloc()) == 0)
+    return 0;
+  if(execreadpage(ip, s, va, mem) < 0){
+    kfree(mem);
+    return 0;
+  }
+
+  // keep it, unless the image went or got it meanwhile.
+  acquire(&ecache.lock);
+  if((e = eimage_find(ip)) != 0 && e->gen == gen && e->pages[i] == 0){
+    e->pages[i] = (uint64)mem;
+    kref(mem);
+  }
+  release(&ecache.lock);
+  return (uint64)mem;
+}
+
+// Print the cache's images and hit rate, for ^P.
+void
+execcachedump(void)
+{
+  int n = 0, pages = 0;
+
+  acquire(&ecache.lock);
+  for(struct eimage *e = ecache.img; e < &ecache.img[NEXECCACHE]; e++){
+    if(e->ip == 0)
+      continue;
+    n++;
+    for(int i = 0; i < NIMGPAGE; i++)
+      if(e->pages[i])
+        pages++;
+  }
+  printf("ecache: %d images, %d pages, %d hits, %d misses\n",
+         n, pages, ecache.hits, ecache.misses);
+  release(&ecache.lock);
+}
@@ -0,0 +1,84 @@
+// First come first serve scheduling class (SCHED_FCFS).
+// Runs the RUNNABLE process that was created first and
+// never preempts it on a timer interrupt.
+//
+// Each hart has its own heap, ordered by creation time, so
+// "first" is per hart; procheap_pick() steals for idle
+// harts and evens the heaps out now and again.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+struct procheap fcfs[NCPU];
+
+// positive if q started before p.
+static int
+fcfs_cmp(struct proc *p, struct proc *q)
+{
+  if(p->start_time != q->start_time)
+    return p->start_time > q->start_time ? 1 : -1;
+  return p->pid > q->pid ? 1 : -1;
+}
+
+static void
+fcfs_init(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    procheap_init(&fcfs[i], "fcfs", fcfs_cmp);
+}
+
+static int
+fcfs_load(int cpu)
+{
+  return fcfs[cpu].n;
+}
+
+// Queue p on the hart it last ran on, or, if it has never
+// run, on the least loaded hart.
+static void
+fcfs_enqueue(struct proc *p)
+{
+  if(p->cpu < 0 || !sched_allowed(p, p->cpu))
+    p->cpu = sched_place(p, fcfs_load);
+  procheap_push(&fcfs[p->cpu], p);
+}
+
+static int
+fcfs_dequeue(struct proc *p)
+{
+  return procheap_remove(&fcfs[p->cpu], p);
+}
+
+static struct proc*
+fcfs_pick_next(int cpu)
+{
+  return procheap_pick(fcfs, fcfs_load, cpu);
+}
+
+static int
+fcfs_tick(struct proc *p)
+{
+  return 0;
+}
+
+// Never preempted by time, so no timer interrupts.
+static uint64
+fcfs_slice(struct proc *p)
+{
+  return 0;
+}
+
+struct sched_class fcfs_class = {
+  .name = "fcfs",
+  .init = fcfs_init,
+  .enqueue = fcfs_enqueue,
+  .dequeue = fcfs_dequeue,
+  .pick_next = fcfs_pick_next,
+  .tick = fcfs_tick,
+  .slice = fcfs_slice,
+};
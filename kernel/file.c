@@ -12,17 +12,29 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "slab.h"
+#include "uio.h"
+#include "fcntl.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// Most bytes one writei() may write in a transaction; see
+// filewrite1().
+#define MAXWRITE (((MAXOPBLOCKS-1-1-2) / 2) * BSIZE)
 
 struct devsw devsw[NDEV];
+
+// open files come from filecache; the lock protects ref.
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  struct kcache filecache;
 } ftable;
 
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  kcache_init(&ftable.filecache, "file", sizeof(struct file));
 }
 
 // Allocate a file structure.
@@ -31,16 +43,11 @@ filealloc(void)
 {
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
-  }
-  release(&ftable.lock);
-  return 0;
+  if((f = kcache_alloc(&ftable.filecache)) == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -69,9 +76,8 @@ fileclose(struct file *f)
     return;
   }
   ff = *f;
-  f->ref = 0;
-  f->type = FD_NONE;
   release(&ftable.lock);
+  kcache_free(&ftable.filecache, f);
 
   if(ff.type == FD_PIPE){
     pipeclose(ff.pipe, ff.writable);
@@ -101,10 +107,40 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
-// Read from file f.
-// addr is a user virtual address.
+// Set the offset of file f to off from the start, the
+// current offset or the end, by whence (SEEK_* in fcntl.h).
+// The offset may not go before the start or past the end,
+// since writei() can't leave holes. Returns the new offset,
+// or -1.
 int
-fileread(struct file *f, uint64 addr, int n)
+fileseek(struct file *f, int off, int whence)
+{
+  int base, r = -1;
+
+  if(f->type != FD_INODE)
+    return -1;
+  ilock(f->ip);
+  if(whence == SEEK_SET)
+    base = 0;
+  else if(whence == SEEK_CUR)
+    base = f->off;
+  else if(whence == SEEK_END)
+    base = f->ip->size;
+  else
+    goto out;
+  if(base + off < 0 || base + off > f->ip->size)
+    goto out;
+  f->off = base + off;
+  r = f->off;
+out:
+  iunlock(f->ip);
+  return r;
+}
+
+// Read from file f to addr, a user virtual address if
+// user_dst is set, else a kernel address.
+static int
+fileread1(struct file *f, int user_dst, uint64 addr, int n)
 {
   int r = 0;
 
@@ -112,14 +148,14 @@ fileread(struct file *f, uint64 addr, int n)
     return -1;
 
   if(f->type == FD_PIPE){
-    r = piperead(f->pipe, addr, n);
+    r = piperead(f->pipe, user_dst, addr, n);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].read)
       return -1;
-    r = devsw[f->major].read(1, addr, n);
+    r = devsw[f->major].read(user_dst, addr, n);
   } else if(f->type == FD_INODE){
     ilock(f->ip);
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
+    if((r = readi(f->ip, user_dst, addr, f->off, n)) > 0)
       f->off += r;
     iunlock(f->ip);
   } else {
@@ -129,10 +165,18 @@ fileread(struct file *f, uint64 addr, int n)
   return r;
 }
 
-// Write to file f.
+// Read from file f.
 // addr is a user virtual address.
 int
-filewrite(struct file *f, uint64 addr, int n)
+fileread(struct file *f, uint64 addr, int n)
+{
+  return fileread1(f, 1, addr, n);
+}
+
+// Write to file f from addr, a user virtual address if
+// user_src is set, else a kernel address.
+static int
+filewrite1(struct file *f, int user_src, uint64 addr, int n)
 {
   int r, ret = 0;
 
@@ -140,11 +184,11 @@ filewrite(struct file *f, uint64 addr, int n)
     return -1;
 
   if(f->type == FD_PIPE){
-    ret = pipewrite(f->pipe, addr, n);
+    ret = pipewrite(f->pipe, user_src, addr, n);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
       return -1;
-    ret = devsw[f->major].write(1, addr, n);
+    ret = devsw[f->major].write(user_src, addr, n);
   } else if(f->type == FD_INODE){
     // write a few blocks at a time to avoid exceeding
     // the maximum log transaction size, including
@@ -152,7 +196,7 @@ filewrite(struct file *f, uint64 addr, int n)
     // and 2 blocks of slop for non-aligned writes.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+    int max = MAXWRITE;
     int i = 0;
     while(i < n){
       int n1 = n - i;
@@ -161,7 +205,7 @@ filewrite(struct file *f, uint64 addr, int n)
 
       begin_op();
       ilock(f->ip);
-      if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
+      if ((r = writei(f->ip, user_src, addr + i, f->off, n1)) > 0)
         f->off += r;
       iunlock(f->ip);
       end_op();
@@ -180,3 +224,157 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+// Write to file f.
+// addr is a user virtual address.
+int
+filewrite(struct file *f, uint64 addr, int n)
+{
+  return filewrite1(f, 1, addr, n);
+}
+
+// Move up to n bytes from file in to file out, inside the
+// kernel. A file read into a pipe goes from the buffer cache
+// straight into the pipe's ring, and a pipe written to a
+// file from the ring into the buffer cache; anything else
+// through a kernel page. An inode is read until n bytes or
+// its end, a pipe or device only as far as one read gets.
+// Returns the number of bytes moved, or -1.
+int
+filesplice(struct file *in, struct file *out, int n)
+{
+  char *span, *buf;
+  int i = 0, m, r = 0;
+
+  if(in->readable == 0 || out->writable == 0 || n < 0)
+    return -1;
+
+  if(in->type == FD_INODE && out->type == FD_PIPE){
+    while(i < n){
+      if((m = pipe_wspan(out->pipe, &span)) < 0)
+        return i > 0 ? i : -1;
+      ilock(in->ip);
+      if((r = readi(in->ip, 0, (uint64)span, in->off, min(m, n - i))) > 0)
+        in->off += r;
+      iunlock(in->ip);
+      pipe_wdone(out->pipe, r > 0 ? r : 0);
+      if(r <= 0)
+        break;
+      i += r;
+    }
+    return i;
+  }
+
+  if(in->type == FD_PIPE && out->type == FD_INODE){
+    if((m = pipe_rspan(in->pipe, &span)) <= 0)
+      return m;
+    m = min(m, min(n, MAXWRITE));
+    begin_op();
+    ilock(out->ip);
+    if((r = writei(out->ip, 0, (uint64)span, out->off, m)) > 0)
+      out->off += r;
+    iunlock(out->ip);
+    end_op();
+    pipe_rdone(in->pipe, r > 0 ? r : 0);
+    return r == m ? m : -1;
+  }
+
+  if((buf = kalloc()) == 0)
+    return -1;
+  while(i < n){
+    if((r = fileread1(in, 0, (uint64)buf, min(PGSIZE, n - i))) <= 0)
+      break;
+    if(filewrite1(out, 0, (uint64)buf, r) != r){
+      r = -1;
+      break;
+    }
+    i += r;
+    if(in->type != FD_INODE)
+      break;
+  }
+  kfree(buf);
+  return r < 0 && i == 0 ? -1 : i;
+}
+
+// Read from file f into the n user buffers of iov in turn.
+// An inode is locked once for all of them. Stops at a
+// short read. Returns the bytes read, or -1.
+int
+filereadv(struct file *f, struct iovec *iov, int n)
+{
+  int i, r = 0, tot = 0;
+
+  if(f->readable == 0)
+    return -1;
+
+  if(f->type == FD_INODE){
+    ilock(f->ip);
+    for(i = 0; i < n; i++){
+      if((r = readi(f->ip, 1, iov[i].base, f->off, iov[i].len)) > 0){
+        f->off += r;
+        tot += r;
+      }
+      if(r != iov[i].len)
+        break;
+    }
+    iunlock(f->ip);
+  } else {
+    for(i = 0; i < n; i++){
+      if((r = fileread1(f, 1, iov[i].base, iov[i].len)) > 0)
+        tot += r;
+      if(r != iov[i].len)
+        break;
+    }
+  }
+  return r < 0 && tot == 0 ? -1 : tot;
+}
+
+// Write the n user buffers of iov to file f in turn. For an
+// inode, as many bytes as fit in one log transaction
+// (MAXWRITE, as for filewrite1()) are written under one
+// begin_op() and one ilock(), however many buffers they
+// come from. Returns the bytes written, or -1.
+int
+filewritev(struct file *f, struct iovec *iov, int n)
+{
+  int i, r, tot = 0;
+  uint64 done, left, m;
+
+  if(f->writable == 0)
+    return -1;
+
+  if(f->type != FD_INODE){
+    for(i = 0; i < n; i++){
+      if((r = filewrite1(f, 1, iov[i].base, iov[i].len)) != iov[i].len)
+        return tot > 0 ? tot : -1;
+      tot += r;
+    }
+    return tot;
+  }
+
+  i = 0;
+  done = 0;                         // of iov[i]
+  while(i < n){
+    begin_op();
+    ilock(f->ip);
+    for(left = MAXWRITE; i < n && left > 0; ){
+      m = min(iov[i].len - done, left);
+      if((r = writei(f->ip, 1, iov[i].base + done, f->off, m)) > 0)
+        f->off += r;
+      if(r != m){
+        // error from writei
+        iunlock(f->ip);
+        end_op();
+        return -1;
+      }
+      tot += m;
+      left -= m;
+      if((done += m) == iov[i].len){
+        i++;
+        done = 0;
+      }
+    }
+    iunlock(f->ip);
+    end_op();
+  }
+  return tot;
+}
@@ -18,15 +18,23 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *hnext; // itable bucket chain
+  struct inode *prev; // itable lru list, while ref is 0
+  struct inode *next;
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
+  uint ranext;        // block a sequential readi() starts in next
+  uint raend;         // readahead was started below this block
+  int execcached;     // may have an exec image cached; see exec.c
+  int nexec;          // processes running it, which keep it from being written
 
   short type;         // copy of disk inode
   short major;
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  struct extent ext[NEXTENT];
+  uint indirect;
 };
 
 // map major device number to device functions.
@@ -20,12 +20,15 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "slab.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 // there should be one superblock per disk device, but we run with
 // only one device
 struct superblock sb; 
 
+static void bsummary(int);
+
 // Read the super block.
 static void
 readsb(int dev, struct superblock *sb)
@@ -44,6 +47,7 @@ fsinit(int dev) {
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
   initlog(dev, &sb);
+  bsummary(dev);
 }
 
 // Zero a block.
@@ -59,30 +63,205 @@ bzero(int dev, int bno)
 }
 
 // Blocks.
+//
+// fsfree keeps how many blocks are free in each group of
+// BGROUP, so a search skips full groups, and a rotating hint
+// where the next search starts. A new extent is placed at
+// the start of a run of PREALLOC free blocks, and the rest
+// of the run is reserved for that inode in memory: other
+// inodes' searches pass over it while it is in the table,
+// and the hint moves past it. Nothing about reservations is
+// on disk; the table only forgets them.
+//
+// The bitmap itself is still only changed with its block
+// locked through bread().
+
+#define BGROUP   256                // blocks per group in nfree[]
+#define NBGROUP  ((FSSIZE + BGROUP - 1) / BGROUP)
+#define PREALLOC 8                  // blocks reserved for a new extent
+#define NRESV    16                 // reservations kept
+
+struct {
+  struct spinlock lock;
+  uint nfree[NBGROUP];
+  uint hint;
+  struct {
+    uint inum;                      // 0 if unused
+    uint start, end;                // blocks [start, end)
+  } resv[NRESV];
+  int next;                         // resv[] slot to reuse next
+} fsfree;
+
+// Count the free blocks of every group, once the log has
+// been recovered.
+static void
+bsummary(int dev)
+{
+  struct buf *bp = 0;
+
+  if(sb.size > FSSIZE)
+    panic("bsummary: fs too big");
+  initlock(&fsfree.lock, "fsfree");
+  for(uint b = 0; b < sb.size; b++){
+    if(bp == 0 || bp->blockno != BBLOCK(b, sb)){
+      if(bp)
+        brelse(bp);
+      bp = bread(dev, BBLOCK(b, sb));
+    }
+    if((bp->data[(b % BPB)/8] & (1 << (b % 8))) == 0)
+      fsfree.nfree[b / BGROUP]++;
+  }
+  brelse(bp);
+  fsfree.hint = sb.bmapstart;
+}
+
+// Is block b reserved for an inode other than inum?
+static int
+reserved(uint b, uint inum)
+{
+  int r = 0;
+
+  acquire(&fsfree.lock);
+  for(int i = 0; i < NRESV; i++)
+    if(fsfree.resv[i].inum && fsfree.resv[i].inum != inum &&
+       b >= fsfree.resv[i].start && b < fsfree.resv[i].end)
+      r = 1;
+  release(&fsfree.lock);
+  return r;
+}
+
+// Reserve [start, end) for inum, in place of its old
+// reservation or the oldest one.
+static void
+reserve(uint inum, uint start, uint end)
+{
+  int i;
 
-// Allocate a zeroed disk block.
+  acquire(&fsfree.lock);
+  for(i = 0; i < NRESV; i++)
+    if(fsfree.resv[i].inum == inum)
+      break;
+  if(i == NRESV){
+    i = fsfree.next;
+    fsfree.next = (fsfree.next + 1) % NRESV;
+  }
+  fsfree.resv[i].inum = inum;
+  fsfree.resv[i].start = start;
+  fsfree.resv[i].end = end;
+  release(&fsfree.lock);
+}
+
+// Drop inum's reservation; iput() calls this when the last
+// reference goes.
+static void
+bunreserve(uint inum)
+{
+  acquire(&fsfree.lock);
+  for(int i = 0; i < NRESV; i++)
+    if(fsfree.resv[i].inum == inum)
+      fsfree.resv[i].inum = 0;
+  release(&fsfree.lock);
+}
+
+// First block from from on, wrapping around, that starts a
+// run of len free blocks none of which is reserved for
+// another inode than inum (any inode, if inum is 0 and
+// strict is set; none, if strict is clear). Returns 0 if
+// there is none; block 0 is never free.
 static uint
-balloc(uint dev)
+bscan(int dev, uint from, int len, uint inum, int strict)
+{
+  struct buf *bp = 0;
+  uint b, start = 0;
+  int n = 0;
+
+  for(uint i = 0; i < sb.size; i++){
+    b = (from + i) % sb.size;
+    if(b == 0)
+      n = 0;                        // runs don't wrap
+    if(b % BGROUP == 0 && fsfree.nfree[b / BGROUP] == 0){
+      i += BGROUP - 1;              // a full group
+      n = 0;
+      continue;
+    }
+    if(bp == 0 || bp->blockno != BBLOCK(b, sb)){
+      if(bp)
+        brelse(bp);
+      bp = bread(dev, BBLOCK(b, sb));
+    }
+    if((bp->data[(b % BPB)/8] & (1 << (b % 8))) || (strict && reserved(b, inum))){
+      n = 0;
+      continue;
+    }
+    if(n++ == 0)
+      start = b;
+    if(n == len){
+      brelse(bp);
+      return start;
+    }
+  }
+  if(bp)
+    brelse(bp);
+  return 0;
+}
+
+// Mark block b in use and zero it, if it is free.
+static int
+btake(int dev, uint b)
 {
-  int b, bi, m;
   struct buf *bp;
+  int bi, m;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
-        brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
+  bp = bread(dev, BBLOCK(b, sb));
+  bi = b % BPB;
+  m = 1 << (bi % 8);
+  if(bp->data[bi/8] & m){
+    brelse(bp);
+    return 0;
+  }
+  bp->data[bi/8] |= m;  // Mark block in use.
+  log_write(bp);
+  brelse(bp);
+  acquire(&fsfree.lock);
+  fsfree.nfree[b / BGROUP]--;
+  release(&fsfree.lock);
+  bzero(dev, b);
+  return 1;
+}
+
+// Allocate a zeroed disk block for inode inum: goal, the
+// block after the end of the file, if it is free and not
+// reserved for another inode. Otherwise start a new run,
+// reserving the blocks after it for inum. An inum of 0 asks
+// for a single block that reserves nothing.
+static uint
+balloc(uint dev, uint goal, uint inum)
+{
+  uint b, from;
+
+  for(;;){
+    if(goal > 0 && goal < sb.size && !reserved(goal, inum) && btake(dev, goal))
+      return goal;
+    goal = 0;
+
+    from = fsfree.hint;
+    if(inum && (b = bscan(dev, from, PREALLOC, inum, 1)) != 0){
+      if(btake(dev, b)){
+        reserve(inum, b + 1, b + PREALLOC);
+        fsfree.hint = b + PREALLOC;
+        return b;
       }
+      continue;                     // lost a race for it; look again
+    }
+    if((b = bscan(dev, from, 1, inum, 1)) == 0 &&
+       (b = bscan(dev, from, 1, inum, 0)) == 0)
+      panic("balloc: out of blocks");
+    if(btake(dev, b)){
+      if(inum == 0)
+        fsfree.hint = b + 1;
+      return b;
     }
-    brelse(bp);
   }
-  panic("balloc: out of blocks");
 }
 
 // Free a disk block.
@@ -100,6 +279,9 @@ bfree(int dev, uint b)
   bp->data[bi/8] &= ~m;
   log_write(bp);
   brelse(bp);
+  acquire(&fsfree.lock);
+  fsfree.nfree[b / BGROUP]++;
+  release(&fsfree.lock);
 }
 
 // Inodes.
@@ -162,29 +344,102 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// The inode table is a hash of inode structures keyed by
+// (dev, inum), allocated from the inode slab cache. Its
+// bucket count is sized by iinit() for 1/ICACHEDIV of free
+// memory worth of inodes, at least NINODE; the table has
+// that many entries before it recycles unused ones, and
+// more if none is unused.
+//
+// A bucket's lock protects the allocation of the entries on
+// its chain. Since ip->ref indicates whether an entry is in
+// use, and ip->dev and ip->inum indicate which i-node an
+// entry holds, one must hold the lock of ip's bucket while
+// using any of those fields. An unused entry (ref 0) keeps
+// its inode, valid if it was, and is also on the lru list
+// from which iget() recycles. Lock order: bucket, then lru.
+// Only a recycling iget() holds two bucket locks, and evict
+// makes those take turns.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
-struct {
+struct ibucket {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *head;           // chain through hnext
+  uint hits, misses;
+};
+
+struct {
+  struct kcache inodecache;
+  int ninode;                   // entries allocated
+  int nmax;                     // recycle, rather than allocate, at this many
+
+  struct ibucket *bucket;       // nbucket of them, from kallocn()
+  uint nbucket;                 // a power of two
+
+  struct spinlock evict;
+  uint evictions;
+
+  // Unused entries, through prev/next.
+  // lru.next is most recent, lru.prev is least.
+  struct spinlock lrulock;
+  struct inode lru;
 } itable;
 
+static uint
+ihash(uint dev, uint inum)
+{
+  return (dev * 31 + inum) & (itable.nbucket - 1);
+}
+
+static struct ibucket*
+ibucket(struct inode *ip)
+{
+  return &itable.bucket[ihash(ip->dev, ip->inum)];
+}
+
+static void
+ilru_remove(struct inode *ip)
+{
+  ip->next->prev = ip->prev;
+  ip->prev->next = ip->next;
+}
+
+static void
+ilru_push(struct inode *ip)
+{
+  ip->next = itable.lru.next;
+  ip->prev = &itable.lru;
+  itable.lru.next->prev = ip;
+  itable.lru.next = ip;
+}
+
 void
 iinit()
 {
-  int i = 0;
-  
-  initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
+  int order;
+
+  itable.nmax = (uint64)kfreepages() * PGSIZE / ICACHEDIV / sizeof(struct inode);
+  if(itable.nmax < NINODE)
+    itable.nmax = NINODE;
+  for(itable.nbucket = 1; itable.nbucket * 2 < itable.nmax; itable.nbucket *= 2)
+    ;
+  for(order = 0; (PGSIZE << order) < itable.nbucket * sizeof(struct ibucket); order++)
+    ;
+  if(order > MAXORDER || (itable.bucket = kallocn(order)) == 0)
+    panic("iinit: buckets");
+  for(int i = 0; i < itable.nbucket; i++){
+    initlock(&itable.bucket[i].lock, "itable.bucket");
+    itable.bucket[i].head = 0;
+    itable.bucket[i].hits = itable.bucket[i].misses = 0;
   }
+  initlock(&itable.evict, "itable.evict");
+  initlock(&itable.lrulock, "itable.lru");
+  kcache_init(&itable.inodecache, "inode", sizeof(struct inode));
+  itable.lru.prev = &itable.lru;
+  itable.lru.next = &itable.lru;
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -231,43 +486,123 @@ iupdate(struct inode *ip)
   dip->minor = ip->minor;
   dip->nlink = ip->nlink;
   dip->size = ip->size;
-  memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
+  memmove(dip->ext, ip->ext, sizeof(ip->ext));
+  dip->indirect = ip->indirect;
   log_write(bp);
   brelse(bp);
 }
 
-// Find the inode with number inum on device dev
-// and return the in-memory copy. Does not lock
-// the inode and does not read it from disk.
+// The entry of inode (dev, inum) on bucket h, with a
+// reference taken, or 0. Caller holds the bucket lock.
 static struct inode*
-iget(uint dev, uint inum)
+ilookup(uint h, uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
+
+  for(ip = itable.bucket[h].head; ip; ip = ip->hnext){
+    if(ip->dev == dev && ip->inum == inum){
+      itable.bucket[h].hits++;
+      if(ip->ref++ == 0){
+        acquire(&itable.lrulock);
+        ilru_remove(ip);
+        release(&itable.lrulock);
+      }
+      return ip;
+    }
+  }
+  return 0;
+}
 
-  acquire(&itable.lock);
+// Take ip off the chain of bucket h. Caller holds its lock.
+static void
+iunhash(uint h, struct inode *ip)
+{
+  struct inode **pp;
 
-  // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
-      release(&itable.lock);
+  for(pp = &itable.bucket[h].head; *pp; pp = &(*pp)->hnext){
+    if(*pp == ip){
+      *pp = ip->hnext;
+      break;
+    }
+  }
+}
+
+// An entry for iget() to fill: a new one while the table is
+// below nmax or has no unused entry, else the least recently
+// used unused one, off its chain and the lru list. Caller
+// holds evict and the lock of bucket h.
+static struct inode*
+irecycle(uint h)
+{
+  struct inode *ip;
+  uint v;
+
+  for(;;){
+    acquire(&itable.lrulock);
+    ip = itable.lru.prev;
+    release(&itable.lrulock);
+    if(ip == &itable.lru || itable.ninode < itable.nmax){
+      if((ip = kcache_alloc(&itable.inodecache)) == 0)
+        panic("iget: no inodes");
+      initsleeplock(&ip->lock, "inode");
+      itable.ninode++;
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
+
+    // ip's ref is guarded by its own bucket's lock.
+    v = ihash(ip->dev, ip->inum);
+    if(v != h)
+      acquire(&itable.bucket[v].lock);
+    if(ip->ref == 0)
+      break;
+    if(v != h)
+      release(&itable.bucket[v].lock);  // just taken; try again
   }
+  iunhash(v, ip);
+  itable.evictions++;
+  if(v != h)
+    release(&itable.bucket[v].lock);
+  acquire(&itable.lrulock);
+  ilru_remove(ip);
+  release(&itable.lrulock);
+  return ip;
+}
 
-  // Recycle an inode entry.
-  if(empty == 0)
-    panic("iget: no inodes");
+// Find the inode with number inum on device dev
+// and return the in-memory copy. Does not lock
+// the inode and does not read it from disk.
+static struct inode*
+iget(uint dev, uint inum)
+{
+  struct inode *ip;
+  uint h = ihash(dev, inum);
 
-  ip = empty;
-  ip->dev = dev;
-  ip->inum = inum;
-  ip->ref = 1;
-  ip->valid = 0;
-  release(&itable.lock);
+  // Is the inode already in the table?
+  acquire(&itable.bucket[h].lock);
+  if((ip = ilookup(h, dev, inum)) != 0){
+    release(&itable.bucket[h].lock);
+    return ip;
+  }
+  release(&itable.bucket[h].lock);
+
+  // Recycle an inode entry. Look again once recycling is
+  // ours, another process may have got the inode meanwhile.
+  acquire(&itable.evict);
+  acquire(&itable.bucket[h].lock);
+  if((ip = ilookup(h, dev, inum)) == 0){
+    ip = irecycle(h);
+    itable.bucket[h].misses++;
+    ip->dev = dev;
+    ip->inum = inum;
+    ip->ref = 1;
+    ip->valid = 0;
+    ip->ranext = ip->raend = 0;
+    ip->execcached = 0;
+    ip->hnext = itable.bucket[h].head;
+    itable.bucket[h].head = ip;
+  }
+  release(&itable.bucket[h].lock);
+  release(&itable.evict);
 
   return ip;
 }
@@ -277,9 +612,11 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&itable.lock);
+  struct ibucket *bk = ibucket(ip);
+
+  acquire(&bk->lock);
   ip->ref++;
-  release(&itable.lock);
+  release(&bk->lock);
   return ip;
 }
 
@@ -304,7 +641,8 @@ ilock(struct inode *ip)
     ip->minor = dip->minor;
     ip->nlink = dip->nlink;
     ip->size = dip->size;
-    memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
+    memmove(ip->ext, dip->ext, sizeof(ip->ext));
+    ip->indirect = dip->indirect;
     brelse(bp);
     ip->valid = 1;
     if(ip->type == 0)
@@ -332,7 +670,9 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
-  acquire(&itable.lock);
+  struct ibucket *bk = ibucket(ip);
+
+  acquire(&bk->lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
@@ -341,8 +681,10 @@ iput(struct inode *ip)
     // so this acquiresleep() won't block (or deadlock).
     acquiresleep(&ip->lock);
 
-    release(&itable.lock);
+    release(&bk->lock);
 
+    if(ip->type == T_DIR)
+      dcache_purge(ip->dev, ip->inum);
     itrunc(ip);
     ip->type = 0;
     iupdate(ip);
@@ -350,11 +692,17 @@ iput(struct inode *ip)
 
     releasesleep(&ip->lock);
 
-    acquire(&itable.lock);
+    acquire(&bk->lock);
   }
 
+  if(ip->ref == 1){
+    bunreserve(ip->inum);
+    acquire(&itable.lrulock);
+    ilru_push(ip);
+    release(&itable.lrulock);
+  }
   ip->ref--;
-  release(&itable.lock);
+  release(&bk->lock);
 }
 
 // Common idiom: unlock, then put.
@@ -368,40 +716,94 @@ iunlockput(struct inode *ip)
 // Inode content
 //
 // The content (data) associated with each inode is stored
-// in blocks on the disk. The first NDIRECT block numbers
-// are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// in blocks on the disk, as extents: runs of consecutive
+// blocks, in file order. The first NEXTENT are in ip->ext[];
+// the next NINDEXT are in block ip->indirect. A file only
+// grows at its end, where bmap() extends the last extent if
+// the next disk block is free.
 
 // Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// If there is no such block, bmap allocates one; n must then
+// be the block just past the end. Returns 0 if the file has
+// no extent left for a new run.
 static uint
 bmap(struct inode *ip, uint bn)
 {
-  uint addr, *a;
+  struct extent *e, *last, *ie;
   struct buf *bp;
-
-  if(bn < NDIRECT){
-    if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
-    return addr;
+  uint base, addr;
+  int i, lastind;
+
+  base = 0;
+  last = 0;
+  for(i = 0; i < NEXTENT && ip->ext[i].len; i++){
+    e = &ip->ext[i];
+    if(bn < base + e->len)
+      return e->start + (bn - base);
+    base += e->len;
+    last = e;
   }
-  bn -= NDIRECT;
 
-  if(bn < NINDIRECT){
-    // Load indirect block, allocating if necessary.
-    if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
-    bp = bread(ip->dev, addr);
-    a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+  bp = 0;
+  ie = 0;
+  lastind = 0;
+  if(i == NEXTENT && ip->indirect){
+    bp = bread(ip->dev, ip->indirect);
+    ie = (struct extent*)bp->data;
+    for(i = 0; i < NINDEXT && ie[i].len; i++){
+      e = &ie[i];
+      if(bn < base + e->len){
+        addr = e->start + (bn - base);
+        brelse(bp);
+        return addr;
+      }
+      base += e->len;
+      last = e;
+      lastind = 1;
+    }
+  }
+  if(bn != base)
+    panic("bmap: out of range");
+
+  // Allocate the block after the last one if it's free.
+  addr = balloc(ip->dev, last ? last->start + last->len : 0, ip->inum);
+  if(last && addr == last->start + last->len){
+    last->len++;
+    if(lastind)
+      log_write(bp);
+  } else if(bp == 0 && i < NEXTENT){
+    ip->ext[i].start = addr;
+    ip->ext[i].len = 1;
+  } else {
+    if(bp == 0){
+      ip->indirect = balloc(ip->dev, 0, 0);
+      bp = bread(ip->dev, ip->indirect);
+      ie = (struct extent*)bp->data;
+      i = 0;
+    }
+    if(i == NINDEXT){
+      bfree(ip->dev, addr);
+      addr = 0;
+    } else {
+      ie[i].start = addr;
+      ie[i].len = 1;
       log_write(bp);
     }
-    brelse(bp);
-    return addr;
   }
+  if(bp)
+    brelse(bp);
+  return addr;
+}
 
-  panic("bmap: out of range");
+// Free the blocks of the n extents in e.
+static void
+efree(uint dev, struct extent *e, int n)
+{
+  for(int i = 0; i < n && e[i].len; i++){
+    for(uint b = 0; b < e[i].len; b++)
+      bfree(dev, e[i].start + b);
+    e[i].len = 0;
+  }
 }
 
 // Truncate inode (discard contents).
@@ -409,27 +811,18 @@ bmap(struct inode *ip, uint bn)
 void
 itrunc(struct inode *ip)
 {
-  int i, j;
   struct buf *bp;
-  uint *a;
 
-  for(i = 0; i < NDIRECT; i++){
-    if(ip->addrs[i]){
-      bfree(ip->dev, ip->addrs[i]);
-      ip->addrs[i] = 0;
-    }
-  }
+  if(ip->execcached)
+    execcache_drop(ip);
+  efree(ip->dev, ip->ext, NEXTENT);
 
-  if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
-    a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(ip->dev, a[j]);
-    }
+  if(ip->indirect){
+    bp = bread(ip->dev, ip->indirect);
+    efree(ip->dev, (struct extent*)bp->data, NINDEXT);
     brelse(bp);
-    bfree(ip->dev, ip->addrs[NDIRECT]);
-    ip->addrs[NDIRECT] = 0;
+    bfree(ip->dev, ip->indirect);
+    ip->indirect = 0;
   }
 
   ip->size = 0;
@@ -448,6 +841,33 @@ stati(struct inode *ip, struct stat *st)
   st->size = ip->size;
 }
 
+// readi() just read [start, end) of ip. If it went on from
+// where the previous read stopped, or starts the file, start
+// reading the next READAHEAD blocks into the buffer cache,
+// so that they are there by the time the reader gets to them.
+static void
+readahead(struct inode *ip, uint start, uint end)
+{
+  uint bn, next, last, blocks[READAHEAD];
+  int seq, n = 0;
+
+  seq = start/BSIZE == ip->ranext;
+  if(!seq)
+    ip->raend = 0;
+  ip->ranext = end/BSIZE;
+  if(!seq && start != 0)
+    return;
+
+  next = (end - 1)/BSIZE + 1;
+  last = (ip->size + BSIZE - 1)/BSIZE;
+  bn = next > ip->raend ? next : ip->raend;
+  for(; bn < next + READAHEAD && bn < last; bn++)
+    blocks[n++] = bmap(ip, bn);
+  breadahead(ip->dev, blocks, n);
+  if(bn > ip->raend)
+    ip->raend = bn;
+}
+
 // Read data from inode.
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
@@ -473,6 +893,8 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
     }
     brelse(bp);
   }
+  if(tot > 0 && tot != -1)
+    readahead(ip, off - tot, off);
   return tot;
 }
 
@@ -486,16 +908,22 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 int
 writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, addr;
   struct buf *bp;
 
   if(off > ip->size || off + n < off)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
+  if(ip->nexec > 0)    // a running program; see exehold()
+    return -1;
+  if(ip->execcached)
+    execcache_drop(ip);
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    if((addr = bmap(ip, off/BSIZE)) == 0)
+      break;
+    bp = bread(ip->dev, addr);
     m = min(n - tot, BSIZE - off%BSIZE);
     if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
       brelse(bp);
@@ -510,7 +938,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 
   // write the i-node back to disk even if the size didn't change
   // because the loop above might have called bmap() and added a new
-  // block to ip->addrs[].
+  // block to ip->ext[].
   iupdate(ip);
 
   return tot;
@@ -535,6 +963,14 @@ dirlookup(struct inode *dp, char *name, uint *poff)
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
+  if(dcache_lookup(dp, name, &inum, &off)){
+    if(inum == 0)
+      return 0;
+    if(poff)
+      *poff = off;
+    return iget(dp->dev, inum);
+  }
+
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
       panic("dirlookup read");
@@ -545,10 +981,12 @@ dirlookup(struct inode *dp, char *name, uint *poff)
       if(poff)
         *poff = off;
       inum = de.inum;
+      dcache_enter(dp, name, inum, off);
       return iget(dp->dev, inum);
     }
   }
 
+  dcache_enter(dp, name, 0, 0);
   return 0;
 }
 
@@ -578,6 +1016,7 @@ dirlink(struct inode *dp, char *name, uint inum)
   de.inum = inum;
   if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
     panic("dirlink");
+  dcache_enter(dp, name, inum, off);
 
   return 0;
 }
@@ -672,3 +1111,17 @@ nameiparent(char *path, char *name)
 {
   return namex(path, 1, name);
 }
+
+// Print the size and hit rate of the inode table, for ^P.
+void
+icachedump(void)
+{
+  uint hits = 0, misses = 0;
+
+  for(int i = 0; i < itable.nbucket; i++){
+    hits += itable.bucket[i].hits;
+    misses += itable.bucket[i].misses;
+  }
+  printf("itable: %d inodes, %d buckets, %d hits, %d misses, %d evictions\n",
+         itable.ninode, itable.nbucket, hits, misses, itable.evictions);
+}
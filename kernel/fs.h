@@ -24,9 +24,17 @@ struct superblock {
 
 #define FSMAGIC 0x10203040
 
-#define NDIRECT 12
-#define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+// A file's blocks are runs of consecutive disk blocks,
+// extents, in file order: NEXTENT in the inode, then up to
+// NINDEXT more in the block ip->indirect once those are used.
+struct extent {
+  uint start;           // first disk block
+  uint len;             // blocks; 0 for an unused slot
+};
+
+#define NEXTENT 6
+#define NINDEXT (BSIZE / sizeof(struct extent))
+#define MAXFILE 2048    // blocks; a fragmented file runs out of extents sooner
 
 // On-disk inode structure
 struct dinode {
@@ -35,7 +43,8 @@ struct dinode {
   short minor;          // Minor device number (T_DEVICE only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  struct extent ext[NEXTENT]; // Data blocks
+  uint indirect;        // Block of further extents
 };
 
 // Inodes per block.
@@ -0,0 +1,90 @@
+// Futexes: blocking on a word of user memory.
+//
+// futex_wait(addr, val) sleeps while the int at addr is val,
+// and futex_wake(addr, n) wakes up to n of the processes
+// sleeping on it. Both are keyed by the physical address of
+// the word, so threads of a process and processes sharing a
+// MAP_SHARED mapping meet on the same key; it is the channel
+// passed to sleep() and wakeup(). The bucket lock of the key
+// makes the check of the value and going to sleep atomic
+// with respect to futex_wake.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NFUTEX 31
+
+struct spinlock futexlocks[NFUTEX];
+
+void
+futexinit(void)
+{
+  for(int i = 0; i < NFUTEX; i++)
+    initlock(&futexlocks[i], "futex");
+}
+
+static struct spinlock*
+futexlock(uint64 key)
+{
+  return &futexlocks[(key >> 2) % NFUTEX];
+}
+
+// The key of the user word at addr: its physical address,
+// which is also its address in the kernel. The page is made
+// writable first, so a copy-on-write page is not keyed by
+// the copy that is about to be replaced. 0 if addr is bad.
+static uint64
+futexkey(uint64 addr)
+{
+  uint64 pa;
+
+  if(addr % sizeof(int))
+    return 0;
+  if((pa = uvmaddr(myproc()->pagetable, addr, 1)) == 0)
+    return 0;
+  return pa + (addr % PGSIZE);
+}
+
+// Sleep until woken by futex_wake, if the int at addr is
+// val. Returns 0 when woken, or -1 if the value differed,
+// addr is bad or the caller was killed.
+int
+futex_wait(uint64 addr, int val)
+{
+  struct spinlock *lk;
+  uint64 key;
+
+  if((key = futexkey(addr)) == 0)
+    return -1;
+  lk = futexlock(key);
+  acquire(lk);
+  if(*(volatile int*)key != val || myproc()->killed){
+    release(lk);
+    return -1;
+  }
+  sleep((void*)key, lk);
+  release(lk);
+  return 0;
+}
+
+// Wake up to n processes waiting on addr. Returns how many.
+int
+futex_wake(uint64 addr, int n)
+{
+  struct spinlock *lk;
+  uint64 key;
+  int woken;
+
+  if((key = futexkey(addr)) == 0)
+    return -1;
+  lk = futexlock(key);
+  acquire(lk);
+  woken = wakeupn((void*)key, n);
+  release(lk);
+  return woken;
+}
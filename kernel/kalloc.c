@@ -1,6 +1,7 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or with kallocn() 2^order contiguous ones.
 
 #include "types.h"
 #include "param.h"
@@ -16,17 +17,67 @@ extern char end[]; // first address after kernel.
 
 struct run {
   struct run *next;
+  struct run *prev;                 // kmem's lists only
 };
 
+#define NPAGE (((PHYSTOP) - KERNBASE) / PGSIZE)
+#define PA2IDX(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define IDX2PA(i) (KERNBASE + (uint64)(i) * PGSIZE)
+
+// Free pages are kept on per-cpu lists, so kalloc() and
+// kfree() normally touch only this cpu's list. A cpu refills
+// from the shared pool kmem, and gives pages back to it, in
+// batches of KBATCH; when the pool is empty too it steals
+// half of another cpu's list.
+//
+// kmem is a buddy allocator: free blocks of 2^k pages, k up
+// to MAXORDER, aligned to their size from KERNBASE, on one
+// list per order. A freed block is merged with its buddy
+// while that is free as well. freeorder[] marks the first
+// page of every block in kmem with k+1.
+#define KBATCH  32                  // pages moved to or from kmem at once
+#define KCPUMAX (4*KBATCH)          // most pages a cpu list keeps
+
+struct kcpu {
+  struct spinlock lock;             // others only take it to steal
+  struct run *freelist;
+  int n;
+};
+
+struct kcpu kcpus[NCPU];
+
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run *freelist[MAXORDER+1];
+  int nfree[MAXORDER+1];            // blocks on each list
 } kmem;
 
+char freeorder[NPAGE];
+
+// Pages known to be zero, for kzalloc(). Idle harts fill it
+// with kzero_fill(), up to KZEROMAX pages. On the list only
+// the next pointer is not zero.
+#define KZEROMAX 256
+
+struct {
+  struct spinlock lock;
+  struct run *freelist;
+  int n;
+} kzero;
+
+// References to every physical page: page table entries
+// sharing it copy-on-write, or 1 for any other owner.
+// Updated atomically, without kmem.lock.
+// A block from kallocn() is counted at its first page.
+int pageref[NPAGE];
+
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
+  initlock(&kzero.lock, "kzero");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&kcpus[i].lock, "kcpu");
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -35,31 +86,216 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    pageref[PA2IDX(p)] = 1;
     kfree(p);
+  }
 }
 
-// Free the page of physical memory pointed at by v,
-// which normally should have been returned by a
+// Unlink free block r of the given order from kmem.
+// Caller holds kmem.lock.
+static void
+bunlink(struct run *r, int order)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.freelist[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nfree[order]--;
+  freeorder[PA2IDX(r)] = 0;
+}
+
+// Give the block of 2^order pages at pa to kmem, merged with
+// its buddy as long as that is free too.
+// Caller holds kmem.lock.
+static void
+bfree(void *pa, int order)
+{
+  uint64 i = PA2IDX(pa), b;
+  struct run *r;
+
+  for(; order < MAXORDER; order++){
+    b = i ^ (1L << order);
+    if(b >= NPAGE || freeorder[b] != order + 1)
+      break;
+    bunlink((struct run*)IDX2PA(b), order);
+    if(b < i)
+      i = b;
+  }
+  r = (struct run*)IDX2PA(i);
+  r->prev = 0;
+  r->next = kmem.freelist[order];
+  if(r->next)
+    r->next->prev = r;
+  kmem.freelist[order] = r;
+  kmem.nfree[order]++;
+  freeorder[i] = order + 1;
+}
+
+// Take a block of 2^order pages from kmem, splitting the
+// smallest larger block there is if needed, or return 0.
+// Caller holds kmem.lock.
+static struct run*
+balloc(int order)
+{
+  struct run *r;
+  int k;
+
+  for(k = order; k <= MAXORDER && kmem.freelist[k] == 0; k++)
+    ;
+  if(k > MAXORDER)
+    return 0;
+  r = kmem.freelist[k];
+  bunlink(r, k);
+  // the upper halves go back, each a buddy of what is left.
+  while(k > order){
+    k--;
+    bfree((char*)r + (PGSIZE << k), k);
+  }
+  return r;
+}
+
+// Move up to n pages from the list at *from to the list at
+// *to. Returns how many were moved.
+static int
+kmove(struct run **from, struct run **to, int n)
+{
+  struct run *r;
+  int i;
+
+  for(i = 0; i < n && (r = *from) != 0; i++){
+    *from = r->next;
+    r->next = *to;
+    *to = r;
+  }
+  return i;
+}
+
+// Take a page from another cpu's list for cpu me, bringing
+// half of that list along. Only one kcpu lock is held at a
+// time, so two cpus stealing from each other can't deadlock.
+static struct run*
+ksteal(int me)
+{
+  struct run *got = 0, *r;
+  struct kcpu *k;
+  int n = 0;
+
+  for(int i = 1; i < NCPU && n == 0; i++){
+    k = &kcpus[(me + i) % NCPU];
+    acquire(&k->lock);
+    n = kmove(&k->freelist, &got, (k->n + 1) / 2);
+    k->n -= n;
+    release(&k->lock);
+  }
+  if(n == 0)
+    return 0;
+
+  r = got;
+  got = got->next;
+  k = &kcpus[me];
+  acquire(&k->lock);
+  k->n += kmove(&got, &k->freelist, n - 1);
+  release(&k->lock);
+  return r;
+}
+
+// Drop a reference to the page of physical memory pointed
+// at by v, which normally should have been returned by a
 // call to kalloc().  (The exception is when
 // initializing the allocator; see kinit above.)
+// The page is freed when the last reference goes.
 void
 kfree(void *pa)
 {
   struct run *r;
+  struct kcpu *k;
+  int n;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  if((n = __sync_sub_and_fetch(&pageref[PA2IDX(pa)], 1)) > 0)
+    return;
+  if(n < 0)
+    panic("kfree: ref");
+
+#ifdef KJUNK
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
+#endif
 
   r = (struct run*)pa;
 
-  acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  release(&kmem.lock);
+  push_off();
+  k = &kcpus[cpuid()];
+  acquire(&k->lock);
+  r->next = k->freelist;
+  k->freelist = r;
+  if(++k->n > KCPUMAX){
+    acquire(&kmem.lock);
+    for(n = 0; n < KBATCH; n++){
+      r = k->freelist;
+      k->freelist = r->next;
+      bfree(r, 0);
+    }
+    release(&kmem.lock);
+    k->n -= KBATCH;
+  }
+  release(&k->lock);
+  pop_off();
+}
+
+// Take a page off the free lists, not counting kzero.
+static struct run*
+kget(void)
+{
+  struct run *r;
+  struct kcpu *k;
+  int n;
+
+  push_off();
+  k = &kcpus[cpuid()];
+  acquire(&k->lock);
+  if(k->freelist == 0){
+    acquire(&kmem.lock);
+    for(n = 0; n < KBATCH && (r = balloc(0)) != 0; n++){
+      r->next = k->freelist;
+      k->freelist = r;
+    }
+    release(&kmem.lock);
+    k->n += n;
+  }
+  r = k->freelist;
+  if(r){
+    k->freelist = r->next;
+    k->n--;
+  }
+  release(&k->lock);
+  if(r == 0)
+    r = ksteal(cpuid());
+  pop_off();
+  return r;
+}
+
+// Take a page off kzero; all of it is zero.
+static struct run*
+kgetzero(void)
+{
+  struct run *r;
+
+  acquire(&kzero.lock);
+  r = kzero.freelist;
+  if(r){
+    kzero.freelist = r->next;
+    kzero.n--;
+  }
+  release(&kzero.lock);
+  if(r)
+    r->next = 0;
+  return r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -70,13 +306,184 @@ kalloc(void)
 {
   struct run *r;
 
+  if((r = kget()) == 0)
+    r = kgetzero();
+  if(r){
+    pageref[PA2IDX(r)] = 1;
+#ifdef KJUNK
+    memset((char*)r, 5, PGSIZE); // fill with junk
+#endif
+  }
+  return (void*)r;
+}
+
+// Allocate one page of physical memory filled with zeros,
+// from the pool idle harts zeroed in advance if it can.
+void *
+kzalloc(void)
+{
+  struct run *r;
+
+  if((r = kgetzero()) == 0){
+    if((r = kget()) == 0)
+      return 0;
+    memset((char*)r, 0, PGSIZE);
+  }
+  pageref[PA2IDX(r)] = 1;
+  return (void*)r;
+}
+
+// Zero one free page for kzalloc(), if the pool is not full.
+// Called by scheduler() while the hart has nothing to run.
+// Returns 1 if it zeroed a page.
+int
+kzero_fill(void)
+{
+  struct run *r;
+
+  if(kzero.n >= KZEROMAX || (r = kget()) == 0)
+    return 0;
+  memset((char*)r, 0, PGSIZE);
+  acquire(&kzero.lock);
+  r->next = kzero.freelist;
+  kzero.freelist = r;
+  kzero.n++;
+  release(&kzero.lock);
+  return 1;
+}
+
+// Give every page on the per-cpu lists and in kzero back to
+// kmem, so that they can merge into larger blocks.
+static void
+kdrain(void)
+{
+  struct run *r;
+  struct kcpu *k;
+
+  for(k = kcpus; k < &kcpus[NCPU]; k++){
+    acquire(&k->lock);
+    acquire(&kmem.lock);
+    while((r = k->freelist) != 0){
+      k->freelist = r->next;
+      bfree(r, 0);
+    }
+    k->n = 0;
+    release(&kmem.lock);
+    release(&k->lock);
+  }
+  while((r = kgetzero()) != 0){
+    acquire(&kmem.lock);
+    bfree(r, 0);
+    release(&kmem.lock);
+  }
+}
+
+// Allocate 2^order physically contiguous pages, aligned to
+// their size. Order 0 is kalloc(). Free with kfreen().
+// Returns 0 if there is no such block.
+void *
+kallocn(int order)
+{
+  struct run *r;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
+  if(order == 0)
+    return kalloc();
+
   acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  r = balloc(order);
   release(&kmem.lock);
-
-  if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
+  if(r == 0){
+    kdrain();
+    acquire(&kmem.lock);
+    r = balloc(order);
+    release(&kmem.lock);
+  }
+  if(r){
+    pageref[PA2IDX(r)] = 1;
+#ifdef KJUNK
+    memset((char*)r, 5, PGSIZE << order);
+#endif
+  }
   return (void*)r;
 }
+
+// Free a block from kallocn(order).
+void
+kfreen(void *pa, int order)
+{
+  int n;
+
+  if(order == 0){
+    kfree(pa);
+    return;
+  }
+  if(order < 0 || order > MAXORDER || PA2IDX(pa) % (1L << order) != 0 ||
+     (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kfreen");
+  if((n = __sync_sub_and_fetch(&pageref[PA2IDX(pa)], 1)) > 0)
+    return;
+  if(n < 0)
+    panic("kfreen: ref");
+#ifdef KJUNK
+  memset(pa, 1, PGSIZE << order);
+#endif
+  acquire(&kmem.lock);
+  bfree(pa, order);
+  release(&kmem.lock);
+}
+
+// Number of free pages, wherever they are kept.
+int
+kfreepages(void)
+{
+  int n = kzero.n;
+
+  for(int i = 0; i < NCPU; i++)
+    n += kcpus[i].n;
+  acquire(&kmem.lock);
+  for(int k = 0; k <= MAXORDER; k++)
+    n += kmem.nfree[k] << k;
+  release(&kmem.lock);
+  return n;
+}
+
+// Print the free blocks of every order, for ^P. "unusable"
+// is the part of the free memory in kmem, in percent, that
+// is in blocks too small for a request of that order.
+void
+kmemdump(void)
+{
+  int cpu = 0, below = 0, total = 0;
+
+  for(int i = 0; i < NCPU; i++)
+    cpu += kcpus[i].n;
+  acquire(&kmem.lock);
+  for(int k = 0; k <= MAXORDER; k++)
+    total += kmem.nfree[k] << k;
+  printf("free pages: %d buddy, %d per-cpu, %d zeroed\n", total, cpu, kzero.n);
+  for(int k = 0; k <= MAXORDER; k++){
+    printf("order %d: %d free, unusable %d%%\n", k, kmem.nfree[k],
+           total ? below * 100 / total : 0);
+    below += kmem.nfree[k] << k;
+  }
+  release(&kmem.lock);
+}
+
+// Add a reference to an allocated page, which is now
+// shared copy-on-write.
+void
+kref(void *pa)
+{
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kref");
+  __sync_fetch_and_add(&pageref[PA2IDX(pa)], 1);
+}
+
+// Number of references to an allocated page.
+int
+krefs(void *pa)
+{
+  return pageref[PA2IDX(pa)];
+}
@@ -19,7 +19,16 @@
 // its start and end. Usually begin_op() just increments
 // the count of in-progress FS system calls and returns.
 // But if it thinks the log is close to running out, it
-// sleeps until the last outstanding end_op() commits.
+// sleeps until the log has been committed.
+//
+// end_op() does not commit. The kernel process "commit"
+// (committer()) does, once no FS system call is active and
+// the oldest logged block has waited COMMITDELAY ticks, or
+// sooner if begin_op() needs the space or log_sync() was
+// called. A commit so takes in several rounds of system
+// calls, and system calls don't wait for the disk. A
+// system call that returned may be lost in a crash until
+// log_sync() returns (the sync() system call).
 //
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
@@ -30,6 +39,8 @@
 //   ...
 // Log appends are synchronous.
 
+#define LOGBATCH 10  // log blocks written with one bwritev()
+
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
 struct logheader {
@@ -43,6 +54,9 @@ struct log {
   int size;
   int outstanding; // how many FS sys calls are executing.
   int committing;  // in commit(), please wait.
+  int want;        // commit as soon as possible
+  uint since;      // ticks when the first block of lh was logged
+  uint ncommit;    // commits done
   int dev;
   struct logheader lh;
 };
@@ -50,6 +64,7 @@ struct log log;
 
 static void recover_from_log(void);
 static void commit();
+static void committer(void);
 
 void
 initlog(int dev, struct superblock *sb)
@@ -62,23 +77,32 @@ initlog(int dev, struct superblock *sb)
   log.size = sb->nlog;
   log.dev = dev;
   recover_from_log();
+  kproc("commit", committer);
 }
 
 // Copy committed blocks from log to their home location
+// LOGBATCH blocks at a time are written together, so the
+// disk driver can merge adjacent ones.
 static void
 install_trans(int recovering)
 {
-  int tail;
-
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    if(recovering == 0)
-      bunpin(dbuf);
-    brelse(lbuf);
-    brelse(dbuf);
+  struct buf *dbuf[LOGBATCH];
+  int tail, i, n;
+
+  for (tail = 0; tail < log.lh.n; tail += n) {
+    n = log.lh.n - tail < LOGBATCH ? log.lh.n - tail : LOGBATCH;
+    for (i = 0; i < n; i++) {
+      struct buf *lbuf = bread(log.dev, log.start+tail+i+1); // read log block
+      dbuf[i] = bread(log.dev, log.lh.block[tail+i]); // read dst
+      memmove(dbuf[i]->data, lbuf->data, BSIZE);  // copy block to dst
+      brelse(lbuf);
+    }
+    bwritev(dbuf, n);  // write dst to disk
+    for (i = 0; i < n; i++) {
+      if(recovering == 0)
+        bunpin(dbuf[i]);
+      brelse(dbuf[i]);
+    }
   }
 }
 
@@ -128,10 +152,13 @@ begin_op(void)
 {
   acquire(&log.lock);
   while(1){
-    if(log.committing){
+    if(log.committing || log.want){
+      // let the commit start, then wait for it.
       sleep(&log, &log.lock);
     } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
       // this op might exhaust log space; wait for commit.
+      log.want = 1;
+      wakeup(&log.want);
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
@@ -142,35 +169,78 @@ begin_op(void)
 }
 
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
+// the committer may go ahead once no operation is left.
 void
 end_op(void)
 {
-  int do_commit = 0;
-
   acquire(&log.lock);
   log.outstanding -= 1;
   if(log.committing)
     panic("log.committing");
-  if(log.outstanding == 0){
-    do_commit = 1;
-    log.committing = 1;
-  } else {
-    // begin_op() may be waiting for log space,
-    // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
-    wakeup(&log);
+  if(log.outstanding == 0)
+    wakeup(&log.want);
+
+  // begin_op() may be waiting for log space,
+  // and decrementing log.outstanding has decreased
+  // the amount of reserved space.
+  wakeup(&log);
+  release(&log.lock);
+}
+
+// Wait until every FS system call that has returned is on
+// disk.
+void
+log_sync(void)
+{
+  uint target;
+
+  acquire(&log.lock);
+  if(log.lh.n > 0 || log.committing){
+    // the blocks in lh go out with the commit after the
+    // ones done so far; if one is running, it has them.
+    target = log.ncommit + 1;
+    log.want = 1;
+    wakeup(&log.want);
+    while((int)(log.ncommit - target) < 0)
+      sleep(&log, &log.lock);
   }
   release(&log.lock);
+}
+
+// The body of the "commit" kernel process. Waits on
+// log.want, until the delay is over while it runs.
+static void
+committer(void)
+{
+  acquire(&log.lock);
+  for(;;){
+    if(log.lh.n == 0 && log.want){
+      // nothing to commit; let begin_op() go on.
+      log.want = 0;
+      wakeup(&log);
+    }
+    if(log.lh.n == 0 || log.outstanding > 0){
+      sleep(&log.want, &log.lock);
+      continue;
+    }
+    // ticks only moves when some hart looks at the time.
+    tickupdate();
+    if(!log.want && ticks - log.since < COMMITDELAY){
+      sleepuntil(&log.want, &log.lock, log.since + COMMITDELAY);
+      continue;
+    }
+    log.committing = 1;
+    release(&log.lock);
 
-  if(do_commit){
-    // call commit w/o holding locks, since not allowed
+    // commit w/o holding locks, since not allowed
     // to sleep with locks.
     commit();
+
     acquire(&log.lock);
     log.committing = 0;
+    log.want = 0;
+    log.ncommit++;
     wakeup(&log);
-    release(&log.lock);
   }
 }
 
@@ -178,15 +248,20 @@ end_op(void)
 static void
 write_log(void)
 {
-  int tail;
-
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
-    brelse(from);
-    brelse(to);
+  struct buf *to[LOGBATCH];
+  int tail, i, n;
+
+  for (tail = 0; tail < log.lh.n; tail += n) {
+    n = log.lh.n - tail < LOGBATCH ? log.lh.n - tail : LOGBATCH;
+    for (i = 0; i < n; i++) {
+      to[i] = bread(log.dev, log.start+tail+i+1); // log block
+      struct buf *from = bread(log.dev, log.lh.block[tail+i]); // cache block
+      memmove(to[i]->data, from->data, BSIZE);
+      brelse(from);
+    }
+    bwritev(to, n);  // write the log
+    for (i = 0; i < n; i++)
+      brelse(to[i]);
   }
 }
 
@@ -229,7 +304,10 @@ log_write(struct buf *b)
   log.lh.block[i] = b->blockno;
   if (i == log.lh.n) {  // Add new block to log?
     bpin(b);
-    log.lh.n++;
+    if(log.lh.n++ == 0){
+      tickupdate();
+      log.since = ticks;
+    }
   }
   release(&log.lock);
 }
@@ -20,13 +20,19 @@ main()
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
+    futexinit();     // futex buckets
+    traceinit();     // syscall trace rings
+    schedtraceinit(); // scheduling event rings
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
     iinit();         // inode table
+    dcache_init();   // directory entry cache
     fileinit();      // file table
+    pipeinit();      // pipe cache
+    execcache_init(); // exec image cache
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
@@ -27,6 +27,7 @@
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid))
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
 
@@ -62,6 +63,14 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   mmap() regions, from USERTOP down
+//   THREADTF(NTHREAD-1) ... THREADTF(1) (the trapframes of clone()d threads)
+//   VPROC (p->vproc, the process's struct vproc)
+//   VDSO (the struct vdso page, the same in every process)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define VDSO (TRAPFRAME - PGSIZE)
+#define VPROC (VDSO - PGSIZE)
+#define THREADTF(i) ((i) == 0 ? TRAPFRAME : VPROC - (i)*PGSIZE)
+#define USERTOP (VPROC - (NTHREAD-1)*PGSIZE)
@@ -0,0 +1,10 @@
+// Physical memory held by a process, read with memstat().
+// Needs kernel/types.h.
+struct memstat {
+  int pid;
+  uint64 sz;                   // heap top; virtual, may not be in memory
+  uint rss;                    // user pages in memory
+  uint shared;                 // of those, also mapped by someone else
+  uint ptpages;                // page-table pages, including the root
+  uint vmapages;               // pages of mmap() regions
+};
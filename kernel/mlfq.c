@@ -0,0 +1,327 @@
+// Multi-level feedback queue scheduling class (SCHED_MLFQ).
+//
+// Every hart owns NMLFQ FIFO queues guarded by a single
+// lock, so harts only touch each other's queues when one
+// of them runs out of work and steals. A process gets
+// time_added = ticks whenever it is appended, so each queue
+// is sorted by time_added, oldest at the head.
+//
+// How many of the queues are used, their slices, aging
+// thresholds and a periodic boost are set at run time with
+// mlfqparam(); see struct mlfqparam in sched.h.
+//
+// A level's slice is an allotment: the CPU time a process
+// may use at that level in all, however often it sleeps or
+// yields on the way, before it is demoted. It starts afresh
+// only on a move to another level, so sleeping just before
+// the slice ends no longer keeps a CPU-bound process in
+// queue 0. The boost then lifts everything back to queue 0
+// now and again, so demoted processes are not starved.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "schedtrace.h"
+#include "defs.h"
+#include "sched.h"
+
+struct mlfq {
+  struct spinlock lock;
+  struct procq level[NMLFQ];
+  int total;                        // queued processes, all levels
+  uint epoch;                       // last boost epoch applied here
+};
+
+struct mlfq mlfqs[NCPU];
+
+// Written whole under mlfqparamlock, read without it: a
+// reader racing with mlfqparam() may see a mix of old and
+// new values for one decision.
+struct spinlock mlfqparamlock;
+struct mlfqparam mlfqp = {
+  .nlevel = NMLFQ,
+  .slice = {MLFQSLICE, MLFQSLICE*2, MLFQSLICE*4, MLFQSLICE*8, MLFQSLICE*16},
+  .maxwait = {0, 10, 30, 100, 150},
+  .boost = MLFQBOOST,
+};
+
+// Boosts are numbered by mlfq_epoch, so a hart's queues,
+// or a process sleeping through one, can tell that a boost
+// has passed them by and catch up. Both are advanced under
+// mlfqparamlock.
+uint mlfq_epoch;
+uint mlfq_lastboost;                // ticks at the last boost
+
+static void
+mlfq_init(void)
+{
+  struct mlfq *q;
+
+  initlock(&mlfqparamlock, "mlfqparam");
+  for(q = mlfqs; q < &mlfqs[NCPU]; q++)
+    initlock(&q->lock, "mlfq");
+}
+
+// Copy out the MLFQ parameters to old, and then set them
+// from new, if they are not 0. Returns -1 on a bad address
+// or if new has nlevel out of 1..NMLFQ or a zero slice.
+int
+mlfq_setparam(uint64 new, uint64 old)
+{
+  struct proc *p = myproc();
+  struct mlfqparam np;
+
+  if(old && copyout(p->pagetable, old, (char*)&mlfqp, sizeof(mlfqp)) < 0)
+    return -1;
+  if(new == 0)
+    return 0;
+  if(copyin(p->pagetable, (char*)&np, new, sizeof(np)) < 0)
+    return -1;
+  if(np.nlevel < 1 || np.nlevel > NMLFQ)
+    return -1;
+  for(int i = 0; i < np.nlevel; i++)
+    if(np.slice[i] == 0)
+      return -1;
+  acquire(&mlfqparamlock);
+  mlfqp = np;
+  release(&mlfqparamlock);
+  return 0;
+}
+
+// Start a new boost epoch if mlfqp.boost ticks have
+// passed since the last one.
+static void
+mlfq_boost_check(void)
+{
+  if(mlfqp.boost == 0 || ticks - mlfq_lastboost < mlfqp.boost)
+    return;
+  acquire(&mlfqparamlock);
+  if(mlfqp.boost && ticks - mlfq_lastboost >= mlfqp.boost){
+    mlfq_lastboost = ticks;
+    mlfq_epoch++;
+  }
+  release(&mlfqparamlock);
+}
+
+// Move p to level lvl with a full allotment there.
+static void
+mlfq_setlevel(struct proc *p, int lvl)
+{
+  p->slice_start = sched_runtime(p);
+  if(p->priority_number != lvl){
+    p->priority_number = lvl;
+    SCHEDTRACE(SEV_PRIO, p);
+  }
+}
+
+// Apply the current boost epoch to p if it has missed it.
+static void
+mlfq_catchup(struct proc *p)
+{
+  if(p->mlfq_epoch == mlfq_epoch)
+    return;
+  p->mlfq_epoch = mlfq_epoch;
+  mlfq_setlevel(p, 0);
+}
+
+// Append p to the tail of its level in q.
+// q->lock must be held.
+static void
+mlfq_push(struct mlfq *q, struct proc *p)
+{
+  procq_push(&q->level[p->priority_number], p);
+  q->total++;
+}
+
+// Remove and return the first process of level lvl that
+// may run on hart cpu, or 0. q->lock must be held.
+static struct proc*
+mlfq_pop(struct mlfq *q, int lvl, int cpu)
+{
+  struct proc *p;
+
+  if((p = procq_pop_cpu(&q->level[lvl], cpu)) != 0)
+    q->total--;
+  return p;
+}
+
+static int
+mlfq_load(int cpu)
+{
+  return mlfqs[cpu].total;
+}
+
+// Queue a newly RUNNABLE process on the hart it last ran
+// on, or, if it has never run, on the least loaded hart.
+static void
+mlfq_enqueue(struct proc *p)
+{
+  struct mlfq *q;
+
+  if(p->cpu < 0 || !sched_allowed(p, p->cpu))
+    p->cpu = sched_place(p, mlfq_load);
+  q = &mlfqs[p->cpu];
+
+  acquire(&q->lock);
+  p->time_added = ticks;
+  mlfq_catchup(p);
+  // nlevel may have shrunk since p was demoted.
+  if(p->priority_number >= mlfqp.nlevel)
+    p->priority_number = mlfqp.nlevel - 1;
+  mlfq_push(q, p);
+  release(&q->lock);
+}
+
+static int
+mlfq_dequeue(struct proc *p)
+{
+  struct mlfq *q = &mlfqs[p->cpu];
+  int found;
+
+  acquire(&q->lock);
+  if((found = procq_remove(&q->level[p->priority_number], p)) != 0)
+    q->total--;
+  release(&q->lock);
+  return found;
+}
+
+// Promote processes that have waited in their queue
+// longer than the level allows, or all of them to queue 0
+// when q has not had the latest boost. q->lock must be held.
+// Queues are sorted by time_added, so only the processes
+// at the head can have waited too long; the pass stops at
+// the first one that has not. Queues beyond nlevel, left
+// over from a larger setting, drain upward the same way.
+void UpgradePolicy(struct mlfq *q)
+{
+  struct proc *p;
+  uint wait;
+  int boost = q->epoch != mlfq_epoch;
+
+  if(boost)
+    q->epoch = mlfq_epoch;
+  for(int lvl = 1; lvl < NMLFQ; lvl++)
+  {
+    wait = boost ? 0 : lvl < mlfqp.nlevel ? mlfqp.maxwait[lvl] : 0;
+    while((p = q->level[lvl].head) != 0 && (boost || ticks - p->time_added > wait))
+    {
+      procq_pop(&q->level[lvl]);
+      p->time_added = ticks;
+      // p may have caught up with the epoch on its own and
+      // been demoted since; boost it anyway, or it would go
+      // back on this level and the pass would never end.
+      if(boost){
+        p->mlfq_epoch = q->epoch;
+        mlfq_setlevel(p, 0);
+      } else
+        mlfq_setlevel(p, lvl - 1);
+      procq_push(&q->level[p->priority_number], p);
+    }
+  }
+}
+
+// Pop the head of the highest non-empty level of q that
+// may run on hart cpu, aging q's waiting processes first
+// if asked to.
+static struct proc*
+mlfq_take(struct mlfq *q, int age, int cpu)
+{
+  struct proc *p = 0;
+
+  acquire(&q->lock);
+  if(age)
+    UpgradePolicy(q);
+  for(int lvl = 0; lvl < NMLFQ && p == 0; lvl++)
+    p = mlfq_pop(q, lvl, cpu);
+  release(&q->lock);
+  return p;
+}
+
+// Heads of our own queues first; the last level is round
+// robin since expired processes go back to its tail.
+// Out of work, steal from the busiest hart.
+static struct proc*
+mlfq_pick_next(int cpu)
+{
+  struct proc *p;
+  int victim;
+
+  mlfq_boost_check();
+  if((p = mlfq_take(&mlfqs[cpu], 1, cpu)) != 0)
+    return p;
+  if((victim = sched_busiest(cpu, mlfq_load)) < 0)
+    return 0;
+  return mlfq_take(&mlfqs[victim], 0, cpu);
+}
+
+static void
+mlfq_dispatch(struct proc *p, int cpu)
+{
+  p->time_added = 0;  //not a time to acess set back when added to que.//sleep timer
+  p->No_times++;
+}
+
+// Length of the time slice of level lvl, in time CSR
+// cycles.
+static uint64
+mlfq_quantum(int lvl)
+{
+  if(lvl >= mlfqp.nlevel)
+    lvl = mlfqp.nlevel - 1;
+  return mlfqp.slice[lvl];
+}
+
+// p has used up its allotment: demote p and make it yield.
+// On the last level it starts a new one at the tail.
+static int
+mlfq_tick(struct proc *p)
+{
+  mlfq_catchup(p);
+  if(sched_runtime(p) - p->slice_start < mlfq_quantum(p->priority_number))
+    return 0;
+  if(p->priority_number < mlfqp.nlevel - 1)
+    mlfq_setlevel(p, p->priority_number + 1);
+  else
+    p->slice_start = sched_runtime(p);
+  return 1;
+}
+
+// The timer fires when the slice runs out, in cycles, so
+// slices need not be whole ticks.
+static uint64
+mlfq_slice(struct proc *p)
+{
+  uint64 used = sched_runtime(p) - p->slice_start;
+  uint64 q = mlfq_quantum(p->priority_number);
+
+  return used < q ? q - used : 1;
+}
+
+// A new process starts in queue 0. If it was queued on
+// our hart, the creator gives way to it unless it is in
+// queue 0 itself; what is left of its allotment carries
+// over.
+static int
+mlfq_yield_check(struct proc *cur, struct proc *p)
+{
+  if(p->cpu != cur->cpu)
+    return 0;
+  if(p->priority_number >= cur->priority_number)
+    return 0;
+  return 1;
+}
+
+struct sched_class mlfq_class = {
+  .name = "mlfq",
+  .init = mlfq_init,
+  .enqueue = mlfq_enqueue,
+  .dequeue = mlfq_dequeue,
+  .pick_next = mlfq_pick_next,
+  .dispatch = mlfq_dispatch,
+  .tick = mlfq_tick,
+  .slice = mlfq_slice,
+  .yield_check = mlfq_yield_check,
+};
@@ -0,0 +1,8 @@
+// mmap() protection and flags.
+#define PROT_READ   0x1
+#define PROT_WRITE  0x2
+#define PROT_EXEC   0x4
+
+#define MAP_SHARED  0x01            // one set of pages, also across fork
+#define MAP_PRIVATE 0x02            // copy-on-write across fork
+#define MAP_ANON    0x20            // zero pages, no file
@@ -0,0 +1,194 @@
+// Memory mappings made with mmap(), to share pages between
+// processes without copying them.
+//
+// A mapping is a struct vma in the process. Mappings are
+// placed from p->mmapbase down, below USERTOP and above
+// the heap, and their pages are allocated, and read from the
+// file, when the mapping is made. fork() gives the child the
+// same physical pages of MAP_SHARED mappings, counted with
+// kref(), and copy-on-write ones of MAP_PRIVATE mappings.
+// File mappings are copies: MAP_SHARED ones are read-only
+// and nothing is written back. The mappings of a thread are
+// its group leader's, changed under its glock.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "mman.h"
+#include "defs.h"
+
+// The mapping of p that contains va, or 0.
+struct vma*
+mmap_find(struct proc *p, uint64 va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->len && va >= v->addr && va < v->addr + v->len)
+      return v;
+  return 0;
+}
+
+// Lowest mapping of p, or USERTOP if it has none.
+static uint64
+mmap_lowest(struct proc *p)
+{
+  uint64 low = USERTOP;
+
+  for(struct vma *v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->len && v->addr < low)
+      low = v->addr;
+  return low;
+}
+
+// Map len bytes of f from offset off, or zero pages if f is
+// 0, into the current process. Returns the address, or -1.
+uint64
+mmap(struct file *f, uint64 len, int prot, int flags, uint off)
+{
+  struct proc *p = myproc()->group;
+  struct vma *v;
+  uint64 a, va;
+  char *mem;
+  int perm;
+
+  if(len == 0 || len > MAXVA || (off % PGSIZE) != 0)
+    return -1;
+  if(((flags & MAP_SHARED) != 0) == ((flags & MAP_PRIVATE) != 0))
+    return -1;
+  if(f && (f->type != FD_INODE || !f->readable ||
+           ((flags & MAP_SHARED) && (prot & PROT_WRITE))))
+    return -1;
+  len = PGROUNDUP(len);
+
+  // claim the slot and the addresses, then read the pages
+  // without the lock. vmfault() leaves the range alone.
+  acquire(&p->glock);
+  if(len > p->mmapbase || p->mmapbase - len < PGROUNDUP(p->sz)){
+    release(&p->glock);
+    return -1;
+  }
+  for(v = p->vma; v < &p->vma[NVMA] && v->len; v++)
+    ;
+  if(v == &p->vma[NVMA]){
+    release(&p->glock);
+    return -1;
+  }
+  va = p->mmapbase - len;
+  v->addr = va;
+  v->len = len;
+  v->prot = prot;
+  v->flags = flags;
+  p->mmapbase = va;
+  release(&p->glock);
+
+  // risc-v has no write-only pages.
+  perm = PTE_U | PTE_R;
+  if(prot & PROT_WRITE)
+    perm |= PTE_W;
+  if(prot & PROT_EXEC)
+    perm |= PTE_X;
+
+  for(a = 0; a < len; a += PGSIZE){
+    if((mem = kzalloc()) == 0)
+      goto bad;
+    if(f){
+      // past the end of the file the page stays zero.
+      ilock(f->ip);
+      readi(f->ip, 0, (uint64)mem, off + a, PGSIZE);
+      iunlock(f->ip);
+    }
+    acquire(&p->glock);
+    if(mappages(p->pagetable, va + a, PGSIZE, (uint64)mem, perm) != 0){
+      release(&p->glock);
+      kfree(mem);
+      goto bad;
+    }
+    release(&p->glock);
+  }
+  return va;
+
+ bad:
+  acquire(&p->glock);
+  uvmunmap(p->pagetable, va, a / PGSIZE, 1);
+  v->len = 0;
+  p->mmapbase = mmap_lowest(p);
+  release(&p->glock);
+  return -1;
+}
+
+// Unmap [addr, addr+len) of the current process. It must
+// be all of a mapping, or its start or its end.
+int
+munmap(uint64 addr, uint64 len)
+{
+  struct proc *p = myproc()->group;
+  struct vma *v;
+
+  if((addr % PGSIZE) != 0 || len == 0)
+    return -1;
+  len = PGROUNDUP(len);
+  acquire(&p->glock);
+  if((v = mmap_find(p, addr)) == 0 || addr + len > v->addr + v->len ||
+     (addr != v->addr && addr + len != v->addr + v->len)){
+    release(&p->glock);
+    return -1;
+  }
+
+  uvmunmap(p->pagetable, addr, len / PGSIZE, 1);
+  if(addr == v->addr)
+    v->addr += len;
+  v->len -= len;
+  p->mmapbase = mmap_lowest(p);
+  release(&p->glock);
+  return 0;
+}
+
+// Give np the mappings of p, as fork() does. On failure
+// the caller frees np's mappings with mmap_free().
+int
+mmap_fork(struct proc *p, struct proc *np)
+{
+  struct vma *v;
+  uint64 a, pa;
+  pte_t *pte;
+
+  memmove(np->vma, p->vma, sizeof(p->vma));
+  np->mmapbase = p->mmapbase;
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    for(a = v->addr; a < v->addr + v->len; a += PGSIZE){
+      if((pte = walk(p->pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+        panic("mmap_fork");
+      if((v->flags & MAP_PRIVATE) && (*pte & PTE_W))
+        *pte = (*pte & ~PTE_W) | PTE_COW;
+      pa = PTE2PA(*pte);
+      if(mappages(np->pagetable, a, PGSIZE, pa, PTE_FLAGS(*pte)) != 0)
+        return -1;
+      kref((void*)pa);
+    }
+  }
+  asid_invalidate(p->pagetable);
+  tlb_shootdown(p->pagetable);
+  return 0;
+}
+
+// Unmap all of p's mappings from pagetable, which is p's
+// or, in exec(), the one it is leaving.
+void
+mmap_free(struct proc *p, pagetable_t pagetable)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->len)
+      uvmunmap(pagetable, v->addr, v->len / PGSIZE, 1);
+    v->len = 0;
+  }
+  p->mmapbase = USERTOP;
+}
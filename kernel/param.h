@@ -1,13 +1,35 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC      2048  // maximum number of processes, made on demand
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NTHREAD      16  // threads per process, the first one included
+#define NINODE       50  // smallest number of cached i-nodes
+#define ICACHEDIV   256  // inode table is sized for 1/ICACHEDIV of free memory
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
+#define NEXECSEG      4  // program segments loaded on demand
+#define NEXECCACHE    8  // program images exec() keeps, with their pages
+#define NVMA         16  // mmap regions per process
+#define PIPEORDER     2  // pipe ring buffer is 2^PIPEORDER pages
+#define MAXORDER     10  // largest kallocn() block is 2^MAXORDER pages
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define LOGSIZE      (MAXOPBLOCKS*8)  // max data blocks in on-disk log
+#define COMMITDELAY  10  // ticks a finished transaction may wait to be committed
+#define NBUFMIN      (LOGSIZE+MAXOPBLOCKS*3)  // smallest disk block cache
+#define BCACHEDIV    16  // block cache gets 1/BCACHEDIV of free memory, unless make NBUF=n
+#define READAHEAD     8  // blocks readi() reads ahead of a sequential reader
+#ifndef FSSIZE
+#define FSSIZE       4000  // size of file system in blocks; make FSSIZE=n
+#endif
 #define MAXPATH      128   // maximum file path name
+#define NMLFQ          5   // number of MLFQ priority queues
+#define TICKCYCLES 1000000 // time CSR cycles per clock tick; about 1/10th second in qemu
+#define TIMEBASE  10000000 // time CSR cycles per second in qemu virt
+#ifndef MLFQSLICE
+#define MLFQSLICE TICKCYCLES // MLFQ queue 0 slice in cycles, doubling per queue; make MLFQSLICE=n
+#endif
+#define MLFQBOOST    100   // ticks between MLFQ boosts to queue 0, by default
+#define BALANCETICKS   4   // ticks between load balancing passes of FCFS and PBS
+#define NLATBUCKET    32   // log2 buckets of the run queue latency histogram
+#define NSYSCALL      64   // size of per-syscall tables; syscall numbers are below it
+#define MAXTICKETS 10000   // most stride tickets one process can hold
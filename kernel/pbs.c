@@ -0,0 +1,165 @@
+// Priority based scheduling class (SCHED_PBS).
+// Non-preemptive: runs the RUNNABLE process with the best
+// (lowest) dynamic priority, ties broken by how often each
+// process has been scheduled and then by creation time.
+//
+// Each hart has its own heap, so the priority order is per
+// hart; procheap_pick() steals for idle harts and evens the
+// heaps out now and again.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+int PSBPriority(struct proc* p)
+{
+  //caliculating nicess
+  int niceness = -1;
+  if(p->sleeping_time == -1 && p->running_time == -1) //default
+    niceness = 5;
+  else if(p->running_time + p->sleeping_time == 0)    //no history yet
+    niceness = 5;
+  else
+    niceness = (int)(p->sleeping_time*10)/(p->running_time + p->sleeping_time); 
+  
+  //caliculating priority using niceness and static priority.
+  int Value = p->Static_priority - niceness + 5;
+
+  // a waiter for a sleeplock p holds lends its priority.
+  if(p->pi_prio < Value)
+    Value = p->pi_prio;
+
+  if(Value > 100)
+    return 100;
+  if(Value < 0)
+    return 0;
+    
+  return Value;
+}
+
+// positive if q > p.
+// uses the cached dynamic priority, see pbs_enqueue().
+int PcbCompare(struct proc *p, struct proc *q)
+{
+  int p_priority = p->dynamic_priority, q_priority = q->dynamic_priority;
+
+  if(p_priority < q_priority)  //p is more important
+    return -1;
+  if(p_priority > q_priority)  //q is more important
+    return 1;
+
+  //p_priority = q_priority.  process with less number of times scheduled
+  if(p->Times_scheduled > q->Times_scheduled) //q is run less number of times
+    return 1;
+  if(q->Times_scheduled > p->Times_scheduled) //p is run less number of times.
+    return -1;
+
+  //Times schecduled are equal. Started early given priority.
+  if(p->start_time < q->start_time)  //p started before
+    return -1;
+  if(q->start_time < p->start_time) //q started before
+    return 1;
+  
+  //All values are tied. (same time multiprocessor) //extrememly rare.
+  return -1;
+}
+
+// RUNNABLE processes of each hart ordered by PcbCompare(),
+// so its most important process is always at the top.
+// A process's sort keys only change while it is out of
+// the heap, except through set_priority_i(), which
+// re-sifts it in pbs_prio_changed().
+struct procheap pbs[NCPU];
+
+static void
+pbs_init(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    procheap_init(&pbs[i], "pbs", PcbCompare);
+}
+
+static int
+pbs_load(int cpu)
+{
+  return pbs[cpu].n;
+}
+
+// Sleep and run times only change between runs, so
+// this is where the dynamic priority is brought up
+// to date. p goes back to the hart it last ran on, or, if
+// it has never run, to the least loaded hart.
+static void
+pbs_enqueue(struct proc *p)
+{
+  p->dynamic_priority = PSBPriority(p);
+  if(p->cpu < 0 || !sched_allowed(p, p->cpu))
+    p->cpu = sched_place(p, pbs_load);
+  procheap_push(&pbs[p->cpu], p);
+}
+
+static int
+pbs_dequeue(struct proc *p)
+{
+  return procheap_remove(&pbs[p->cpu], p);
+}
+
+static struct proc*
+pbs_pick_next(int cpu)
+{
+  return procheap_pick(pbs, pbs_load, cpu);
+}
+
+static void
+pbs_dispatch(struct proc *p, int cpu)
+{
+  p->Times_scheduled++;
+  p->sleeping_time = 0;
+  p->running_time = ticks;
+}
+
+static int
+pbs_tick(struct proc *p)
+{
+  return 0;
+}
+
+// Never preempted by time, so no timer interrupts.
+static uint64
+pbs_slice(struct proc *p)
+{
+  return 0;
+}
+
+// Yielding only helps if p is queued on our hart.
+static int
+pbs_yield_check(struct proc *cur, struct proc *p)
+{
+  if(p->cpu != cur->cpu)
+    return 0;
+  return PcbCompare(cur, p) > 0;
+}
+
+static void
+pbs_prio_changed(struct proc *p)
+{
+  p->dynamic_priority = PSBPriority(p);
+  if(p->cpu >= 0)
+    procheap_fix(&pbs[p->cpu], p);
+}
+
+struct sched_class pbs_class = {
+  .name = "pbs",
+  .init = pbs_init,
+  .enqueue = pbs_enqueue,
+  .dequeue = pbs_dequeue,
+  .pick_next = pbs_pick_next,
+  .dispatch = pbs_dispatch,
+  .tick = pbs_tick,
+  .slice = pbs_slice,
+  .yield_check = pbs_yield_check,
+  .prio_changed = pbs_prio_changed,
+};
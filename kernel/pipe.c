@@ -7,18 +7,43 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "slab.h"
 
-#define PIPESIZE 512
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// The ring is 2^PIPEORDER pages from kallocn(). Reads and
+// writes move contiguous spans of it with one copyin() or
+// copyout() each. A writer wakes the reader only when the
+// ring is full or its write is done, a reader the writer
+// only when its read is done.
+//
+// splice() moves file data straight between the ring and
+// the buffer cache. It claims a span of the ring with
+// pipe_wspan() or pipe_rspan(), fills or drains it without
+// the pipe lock, and finishes with pipe_wdone() or
+// pipe_rdone(). While a span is claimed, wbusy or rbusy
+// keeps other writers or readers out.
+#define PIPESIZE (PGSIZE << PIPEORDER)
 
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *data;     // PIPESIZE bytes
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  int wbusy;      // a writer's span is claimed
+  int rbusy;      // a reader's span is claimed
 };
 
+struct kcache pipecache;
+
+void
+pipeinit(void)
+{
+  kcache_init(&pipecache, "pipe", sizeof(struct pipe));
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -28,12 +53,18 @@ pipealloc(struct file **f0, struct file **f1)
   *f0 = *f1 = 0;
   if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
     goto bad;
-  if((pi = (struct pipe*)kalloc()) == 0)
+  if((pi = kcache_alloc(&pipecache)) == 0)
+    goto bad;
+  if((pi->data = kallocn(PIPEORDER)) == 0){
+    kcache_free(&pipecache, pi);
+    pi = 0;
     goto bad;
+  }
   pi->readopen = 1;
   pi->writeopen = 1;
   pi->nwrite = 0;
   pi->nread = 0;
+  pi->wbusy = pi->rbusy = 0;
   initlock(&pi->lock, "pipe");
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
@@ -46,8 +77,10 @@ pipealloc(struct file **f0, struct file **f1)
   return 0;
 
  bad:
-  if(pi)
-    kfree((char*)pi);
+  if(pi){
+    kfreen(pi->data, PIPEORDER);
+    kcache_free(&pipecache, pi);
+  }
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -68,13 +101,16 @@ pipeclose(struct pipe *pi, int writable)
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
-    kfree((char*)pi);
+    kfreen(pi->data, PIPEORDER);
+    kcache_free(&pipecache, pi);
   } else
     release(&pi->lock);
 }
 
+// Write n bytes from addr, a user virtual address if
+// user_src is set, else a kernel address.
 int
-pipewrite(struct pipe *pi, uint64 addr, int n)
+pipewrite(struct pipe *pi, int user_src, uint64 addr, int n)
 {
   int i = 0;
   struct proc *pr = myproc();
@@ -85,15 +121,19 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       release(&pi->lock);
       return -1;
     }
-    if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
+    if(pi->wbusy){
+      sleep(&pi->nwrite, &pi->lock);
+    } else if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
       wakeup(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
     } else {
-      char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+      // as much as fits before the ring's end or the reader.
+      uint off = pi->nwrite % PIPESIZE;
+      int m = min(n - i, min(PIPESIZE - off, pi->nread + PIPESIZE - pi->nwrite));
+      if(either_copyin(&pi->data[off], user_src, addr + i, m) == -1)
         break;
-      pi->data[pi->nwrite++ % PIPESIZE] = ch;
-      i++;
+      pi->nwrite += m;
+      i += m;
     }
   }
   wakeup(&pi->nread);
@@ -102,29 +142,117 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
   return i;
 }
 
+// Read up to n bytes to addr, a user virtual address if
+// user_dst is set, else a kernel address.
 int
-piperead(struct pipe *pi, uint64 addr, int n)
+piperead(struct pipe *pi, int user_dst, uint64 addr, int n)
 {
-  int i;
+  int i, m;
+  uint off;
   struct proc *pr = myproc();
-  char ch;
 
   acquire(&pi->lock);
-  while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
+  while(pi->rbusy || (pi->nread == pi->nwrite && pi->writeopen)){  //DOC: pipe-empty
     if(pr->killed){
       release(&pi->lock);
       return -1;
     }
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
-      break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+  for(i = 0; i < n && pi->nread != pi->nwrite; i += m){  //DOC: piperead-copy
+    // as much as is there before the ring's end.
+    off = pi->nread % PIPESIZE;
+    m = min(n - i, min(PIPESIZE - off, pi->nwrite - pi->nread));
+    if(either_copyout(user_dst, addr + i, &pi->data[off], m) == -1)
       break;
+    pi->nread += m;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
   release(&pi->lock);
   return i;
 }
+
+// Claim the free span of the ring after the data, up to its
+// end, waiting for one if the ring is full. Sets *dst to it
+// and returns its length, or -1 if the read end is closed.
+// The caller fills it and calls pipe_wdone().
+int
+pipe_wspan(struct pipe *pi, char **dst)
+{
+  struct proc *pr = myproc();
+  uint off;
+  int m;
+
+  acquire(&pi->lock);
+  for(;;){
+    if(pi->readopen == 0 || pr->killed){
+      release(&pi->lock);
+      return -1;
+    }
+    if(!pi->wbusy && pi->nwrite != pi->nread + PIPESIZE)
+      break;
+    wakeup(&pi->nread);
+    sleep(&pi->nwrite, &pi->lock);
+  }
+  pi->wbusy = 1;
+  off = pi->nwrite % PIPESIZE;
+  *dst = &pi->data[off];
+  m = min(PIPESIZE - off, pi->nread + PIPESIZE - pi->nwrite);
+  release(&pi->lock);
+  return m;
+}
+
+// The first m bytes of the span from pipe_wspan() are data.
+void
+pipe_wdone(struct pipe *pi, int m)
+{
+  acquire(&pi->lock);
+  pi->nwrite += m;
+  pi->wbusy = 0;
+  wakeup(&pi->nread);
+  wakeup(&pi->nwrite);
+  release(&pi->lock);
+}
+
+// Claim the span of data at the head of the ring, up to its
+// end, waiting for some. Sets *src to it and returns its
+// length, 0 at end of file, or -1 if killed. The caller
+// drains it and calls pipe_rdone().
+int
+pipe_rspan(struct pipe *pi, char **src)
+{
+  struct proc *pr = myproc();
+  uint off;
+  int m;
+
+  acquire(&pi->lock);
+  while(pi->rbusy || (pi->nread == pi->nwrite && pi->writeopen)){
+    if(pr->killed){
+      release(&pi->lock);
+      return -1;
+    }
+    sleep(&pi->nread, &pi->lock);
+  }
+  if(pi->nread == pi->nwrite){
+    release(&pi->lock);
+    return 0;
+  }
+  pi->rbusy = 1;
+  off = pi->nread % PIPESIZE;
+  *src = &pi->data[off];
+  m = min(PIPESIZE - off, pi->nwrite - pi->nread);
+  release(&pi->lock);
+  return m;
+}
+
+// The first m bytes of the span from pipe_rspan() were read.
+void
+pipe_rdone(struct pipe *pi, int m)
+{
+  acquire(&pi->lock);
+  pi->nread += m;
+  pi->rbusy = 0;
+  wakeup(&pi->nwrite);
+  wakeup(&pi->nread);
+  release(&pi->lock);
+}
@@ -16,13 +16,55 @@
 #include "proc.h"
 
 volatile int panicked = 0;
+volatile int panicking = 0;   // panic() is printing; see uartwrite()
 
 // lock to avoid interleaving concurrent printf's.
+// a printf formats into buf and hands it to the uart's
+// interrupt-driven output buffer when buf fills and at the
+// end, instead of waiting on the uart for every character.
+#define PRBUF 128
+struct prbuf {
+  char buf[PRBUF];
+  int n;
+};
+
 static struct {
   struct spinlock lock;
   int locking;
+  struct prbuf b;
 } pr;
 
+// without the lock, as after panic(), harts print at the
+// same time, so each formats into its own buffer.
+static struct prbuf prcpu[NCPU];
+
+static struct prbuf*
+prbuf(void)
+{
+  return pr.locking ? &pr.b : &prcpu[cpuid()];
+}
+
+static void
+flush(void)
+{
+  struct prbuf *b = prbuf();
+
+  consputs(b->buf, b->n);
+  b->n = 0;
+}
+
+static void
+putc(int c)
+{
+  struct prbuf *b = prbuf();
+
+  if(b->n >= PRBUF){
+    consputs(b->buf, b->n);
+    b->n = 0;
+  }
+  b->buf[b->n++] = c;
+}
+
 static char digits[] = "0123456789abcdef";
 
 static void
@@ -46,17 +88,17 @@ printint(int xx, int base, int sign)
     buf[i++] = '-';
 
   while(--i >= 0)
-    consputc(buf[i]);
+    putc(buf[i]);
 }
 
 static void
 printptr(uint64 x)
 {
   int i;
-  consputc('0');
-  consputc('x');
+  putc('0');
+  putc('x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    consputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
+    putc(digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
 // Print to the console. only understands %d, %x, %p, %s.
@@ -77,7 +119,7 @@ printf(char *fmt, ...)
   va_start(ap, fmt);
   for(i = 0; (c = fmt[i] & 0xff) != 0; i++){
     if(c != '%'){
-      consputc(c);
+      putc(c);
       continue;
     }
     c = fmt[++i] & 0xff;
@@ -97,19 +139,21 @@ printf(char *fmt, ...)
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";
       for(; *s; s++)
-        consputc(*s);
+        putc(*s);
       break;
     case '%':
-      consputc('%');
+      putc('%');
       break;
     default:
       // Print unknown % sequence to draw attention.
-      consputc('%');
-      consputc(c);
+      putc('%');
+      putc(c);
       break;
     }
   }
 
+  flush();
+
   if(locking)
     release(&pr.lock);
 }
@@ -118,6 +162,8 @@ void
 panic(char *s)
 {
   pr.locking = 0;
+  panicking = 1;
+  prcpu[cpuid()].n = 0;
   printf("panic: ");
   printf(s);
   printf("\n");
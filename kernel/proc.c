@@ -4,11 +4,32 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
+#include "memstat.h"
+#include "procsnap.h"
+#include "vdso.h"
+#include "schedtrace.h"
+#include "slab.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// Processes are made from proccache on demand, up to NPROC
+// of them, and given back with their kernel stacks when they
+// are reaped. procs[0..nproc-1] lists them by slot, which
+// also numbers the kernel stack and the ASID; an empty slot
+// is 0 and waits on freeslots, and allocproc() reuses one
+// before it grows nproc. A process found through procs[] or
+// findproc() is only held with interrupts off, so that
+// procfree() can wait out every hart that may still hold it;
+// see proc_quiesce().
+struct kcache proccache;
+struct proc *procs[NPROC];
+int nproc;
+int freeslots[NPROC];
+int nfreeslot;
+uint slotgen[NPROC];            // asidgen of the slot's last process
+struct spinlock freeproc_lock;  // protects freeslots, slotgen and nproc
 
 struct proc *initproc;
 
@@ -17,43 +38,60 @@ struct spinlock pid_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void procfree(struct proc *p);
+static void dropthread(struct proc *t);
+static void setparent(struct proc *np, struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
+// Processes in sleep(), hashed by wait channel, so that
+// wakeup() only looks at the processes that may be waiting
+// on its channel. Linked through p->wq_next.
+#define NWAITQ 61
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;
+} waitqs[NWAITQ];
+
+// Live processes hashed by pid, for findproc(). A process
+// is in its bucket, linked through p->pid_next, from
+// allocproc() until freeproc().
+#define NPIDHASH 61
+struct pidhash {
+  struct spinlock lock;
+  struct proc *head;
+} pidhash[NPIDHASH];
+
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
 // memory model when using p->parent.
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
+// Make the page-table pages for the kernel stack of every
+// process slot, high in memory, each followed by an invalid
+// guard page. The stacks themselves are mapped by newproc()
+// as processes are made.
 void
 proc_mapstacks(pagetable_t kpgtbl) {
-  struct proc *p;
-  
-  for(p = proc; p < &proc[NPROC]; p++) {
-    char *pa = kalloc();
-    if(pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int) (p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
-  }
+  for(int i = 0; i < NPROC; i++)
+    if(walk(kpgtbl, KSTACK(i), 1) == 0)
+      panic("proc_mapstacks");
 }
 
 // initialize the proc table at boot time.
 void
 procinit(void)
 {
-  struct proc *p;
-  
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
-      initlock(&p->lock, "proc");
-      p->kstack = KSTACK((int) (p - proc));
-  }
+  initlock(&freeproc_lock, "freeproc");
+  kcache_init(&proccache, "proc", sizeof(struct proc));
+  for(int i = 0; i < NPIDHASH; i++)
+    initlock(&pidhash[i].lock, "pidhash");
+  for(int i = 0; i < NWAITQ; i++)
+      initlock(&waitqs[i].lock, "waitq");
+  schedinit();
 }
 
 // Must be called with interrupts disabled,
@@ -97,42 +135,174 @@ allocpid() {
   return pid;
 }
 
-// Look in the process table for an UNUSED proc.
-// If found, initialize state required to run in the kernel,
-// and return with p->lock held.
-// If there are no free procs, or a memory allocation fails, return 0.
-static struct proc*
-allocproc(void)
+static void
+pidhash_insert(struct proc *p)
+{
+  struct pidhash *h = &pidhash[p->pid % NPIDHASH];
+
+  acquire(&h->lock);
+  p->pid_next = h->head;
+  h->head = p;
+  release(&h->lock);
+}
+
+static void
+pidhash_remove(struct proc *p)
+{
+  struct pidhash *h = &pidhash[p->pid % NPIDHASH];
+  struct proc **pp;
+
+  acquire(&h->lock);
+  for(pp = &h->head; *pp; pp = &(*pp)->pid_next){
+    if(*pp == p){
+      *pp = p->pid_next;
+      break;
+    }
+  }
+  release(&h->lock);
+  p->pid_next = 0;
+}
+
+// Return the process with pid pid, with p->lock held, or
+// 0 if there is none. The bucket lock is dropped before
+// p->lock is taken, so p may have been reaped in between;
+// its pid is checked again under p->lock. Interrupts stay
+// off meanwhile, so procfree() does not free it under us.
+struct proc*
+findproc(int pid)
+{
+  struct pidhash *h;
+  struct proc *p;
+
+  if(pid <= 0)
+    return 0;
+  h = &pidhash[pid % NPIDHASH];
+  push_off();
+  acquire(&h->lock);
+  for(p = h->head; p && p->pid != pid; p = p->pid_next)
+    ;
+  release(&h->lock);
+  if(p == 0){
+    pop_off();
+    return 0;
+  }
+  acquire(&p->lock);
+  pop_off();
+  if(p->pid != pid || p->state == UNUSED){
+    release(&p->lock);
+    return 0;
+  }
+  return p;
+}
+
+// Return the process in slot slot with p->lock held, or 0
+// if the slot is empty or UNUSED. For the scans of procs[].
+struct proc*
+slotproc(int slot)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  push_off();
+  if((p = procs[slot]) != 0){
     acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
+    if(p->state == UNUSED){
       release(&p->lock);
+      p = 0;
     }
   }
-  return 0;
+  pop_off();
+  return p;
+}
+
+// Make the struct proc for slot, UNUSED, with its kernel
+// stack. Returns 0 if memory runs out.
+// freeproc_lock must be held.
+static struct proc*
+newproc(int slot)
+{
+  struct proc *p;
+  char *stack;
+
+  if((p = kcache_alloc(&proccache)) == 0)
+    return 0;
+  if((stack = kalloc()) == 0){
+    kcache_free(&proccache, p);
+    return 0;
+  }
+  memset(p, 0, sizeof(*p));
+  initlock(&p->lock, "proc");
+  initlock(&p->glock, "group");
+  p->state = UNUSED;
+  p->slot = slot;
+  p->kstack = KSTACK(slot);
+  // allocproc() makes it a new address space for the ASID.
+  p->asidgen = slotgen[slot];
+  kvmmapstack(p->kstack, (uint64)stack);
+  // the scans read procs[] without the lock.
+  __sync_synchronize();
+  procs[slot] = p;
+  return p;
+}
 
-found:
+// Make a proc in a free slot, or in a new one.
+// If found, initialize state required to run in the kernel,
+// and return with p->lock held.
+// If there are no free slots, or a memory allocation fails, return 0.
+static struct proc*
+allocproc(void)
+{
+  struct proc *p = 0;
+  int slot = -1;
+
+  acquire(&freeproc_lock);
+  if(nfreeslot > 0)
+    slot = freeslots[--nfreeslot];
+  else if(nproc < NPROC)
+    slot = nproc++;
+  if(slot >= 0 && (p = newproc(slot)) == 0)
+    freeslots[nfreeslot++] = slot;
+  release(&freeproc_lock);
+  if(p == 0)
+    return 0;
+  acquire(&p->lock);
   p->pid = allocpid();
+  pidhash_insert(p);
   p->state = USED;
   p->Trace = 0;
+  memset(p->sccount, 0, sizeof(p->sccount));
+  memset(p->sccycles, 0, sizeof(p->sccycles));
+  p->mmapbase = USERTOP;
+  p->asidgen++;               // a new address space for the ASID
+  p->group = p;
+  p->tgid = p->pid;
+  p->tslot = 0;
+  p->tslots = 1;
+  p->nthread = 0;
+  p->ofile = p->ofiles;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
     freeproc(p);
     release(&p->lock);
+    procfree(p);
     return 0;
   }
 
+  // Allocate the page of it user space can read.
+  if((p->vproc = (struct vproc *)kzalloc()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    procfree(p);
+    return 0;
+  }
+  p->vproc->pid = p->pid;
+
   // An empty user page table.
   p->pagetable = proc_pagetable(p);
   if(p->pagetable == 0){
     freeproc(p);
     release(&p->lock);
+    procfree(p);
     return 0;
   }
 
@@ -144,32 +314,67 @@ found:
   p->rtime = 0;
   p->etime = 0;
   p->ctime = ticks;
-
-
-  #ifdef FCFS
+  p->rcycles = 0;
+  p->run_start = 0;
+  p->runnable_since = 0;
+  p->waitcycles = 0;
+  p->nruns = 0;
+  p->nvcsw = 0;
+  p->nivcsw = 0;
+  memset(p->lat, 0, sizeof(p->lat));
+  p->ccycles = r_time();
+  p->ecycles = 0;
+
+
+  p->policy = sched_default;
+  p->affinity = (1 << NCPU) - 1;
+  p->cpu = -1;
+  p->rq_next = 0;
+  p->heap_index = -1;
   p->start_time = ticks;
-  #endif
 
-  #ifdef PBS
   p->Static_priority = 60;
   p->Times_scheduled = 0;
-  p->start_time = ticks;
   p->running_time = -1;
   p->sleeping_time = -1;
-  #endif
+  p->dynamic_priority = 60;
+  p->pi_prio = PI_NONE;
+  p->pi_locks = 0;
 
-  #ifdef MLFQ
   p->priority_number = 0;
   p->time_added = ticks;
-  p->no_of_ticks = 0;
+  p->slice_start = 0;
+  p->mlfq_epoch = mlfq_epoch;
   p->No_times = 0;
-  #endif
+
+  p->vruntime = 0;
+  p->cfs_charged = 0;
+  p->cfs_weight = 1024;
+  p->cfs_left = 0;
+  p->cfs_right = 0;
+  p->cfs_height = 0;
+
+  p->dl_runtime = 0;
+  p->dl_period = 0;
+  p->dl_deadline = 0;
+  p->dl_bw = 0;
+  p->dl_budget = 0;
+  p->dl_charged = 0;
+  p->dl_abs = 0;
+  p->dl_release = 0;
+  p->dl_throttled = 0;
+
+  p->tickets = 100;
+  p->stride = 0;
+  p->pass = 0;
+  p->stride_charged = 0;
 
   return p;
 }
 
-// free a proc structure and the data hanging from it,
-// including user pages.
+// free the data hanging from a proc structure, including
+// user pages, and make it UNUSED. procfree() frees the rest
+// once p->lock is released.
 // p->lock must be held.
 static void
 freeproc(struct proc *p)
@@ -177,12 +382,22 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->pagetable)
+  if(p->vproc)
+    kfree((void*)p->vproc);
+  p->vproc = 0;
+  if(p->pagetable){
+    mmap_free(p, p->pagetable);
     proc_freepagetable(p->pagetable, p->sz);
+  }
   p->pagetable = 0;
   p->sz = 0;
+  pidhash_remove(p);
   p->pid = 0;
   p->parent = 0;
+  p->children = 0;
+  p->sibling = 0;
+  p->zombies = 0;
+  p->zombie_next = 0;
   p->name[0] = 0;
   p->chan = 0;
   p->killed = 0;
@@ -190,6 +405,55 @@ freeproc(struct proc *p)
   p->state = UNUSED;
 }
 
+// Wait until no other hart can still hold a process just
+// taken out of procs[] and pidhash: each has since been
+// through scheduler(), or is idle or in user space, since
+// one is only held with interrupts off. Yields meanwhile,
+// so that harts waiting here for each other get through.
+static void
+proc_quiesce(void)
+{
+  uint seen[NCPU];
+  struct cpu *c;
+  int me;
+
+  __sync_synchronize();
+  for(int i = 0; i < NCPU; i++)
+    seen[i] = __atomic_load_n(&cpus[i].qs, __ATOMIC_RELAXED);
+  for(int i = 0; i < NCPU; i++){
+    c = &cpus[i];
+    for(;;){
+      push_off();
+      me = cpuid();
+      pop_off();
+      if(i == me || !c->online || __atomic_load_n(&c->idle, __ATOMIC_RELAXED) ||
+         __atomic_load_n(&c->upt, __ATOMIC_RELAXED) ||
+         __atomic_load_n(&c->qs, __ATOMIC_RELAXED) != seen[i])
+        break;
+      yield();
+    }
+  }
+  __sync_synchronize();
+}
+
+// Give back p, which freeproc() made UNUSED, with its kernel
+// stack and slot. Called without locks held, since it may
+// have to wait for other harts.
+static void
+procfree(struct proc *p)
+{
+  int slot = p->slot;
+
+  procs[slot] = 0;
+  proc_quiesce();
+  kfree((void*)kvmunmapstack(slot));
+  acquire(&freeproc_lock);
+  slotgen[slot] = p->asidgen;
+  freeslots[nfreeslot++] = slot;
+  release(&freeproc_lock);
+  kcache_release(&proccache, p);
+}
+
 // Create a user page table for a given process,
 // with no user memory, but with trampoline pages.
 pagetable_t
@@ -220,6 +484,17 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the vdso and vproc pages below it, read-only, for
+  // uptime() and getpid() in user space.
+  if(mappages(pagetable, VDSO, PGSIZE, (uint64)vdso, PTE_R | PTE_U) < 0 ||
+     mappages(pagetable, VPROC, PGSIZE, (uint64)(p->vproc), PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, VDSO, 1, 0);   // uvmunmap skips it if unmapped
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -230,6 +505,8 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, VDSO, 1, 0);
+  uvmunmap(pagetable, VPROC, 1, 0);
   uvmfree(pagetable, sz);
 }
 
@@ -266,29 +543,63 @@ userinit(void)
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
+
+  release(&p->lock);
+}
+
+// A kernel process starts here, still holding p->lock
+// from scheduler().
+static void
+kprocret(void)
+{
+  struct proc *p = myproc();
+
+  release(&p->lock);
+  p->kfn();
+  panic("kproc returned");
+}
+
+// Start a process that runs fn in the kernel and never
+// returns to user space, such as the log committer.
+void
+kproc(char *name, void (*fn)(void))
+{
+  struct proc *p;
 
+  if((p = allocproc()) == 0)
+    panic("kproc");
+  p->context.ra = (uint64)kprocret;
+  p->kfn = fn;
+  safestrcpy(p->name, name, sizeof(p->name));
+  setrunnable(p);
   release(&p->lock);
 }
 
 // Grow or shrink user memory by n bytes.
-// Return 0 on success, -1 on failure.
-int
+// Return the old size, or -1 on failure.
+uint64
 growproc(int n)
 {
-  uint sz;
-  struct proc *p = myproc();
+  uint64 sz, oldsz;
+  struct proc *p = myproc()->group;
 
-  sz = p->sz;
+  acquire(&p->glock);
+  sz = oldsz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+    // only reserve the address space; vmfault() allocates
+    // each page when it is first touched.
+    if(sz + n > p->mmapbase){
+      release(&p->glock);
       return -1;
     }
+    sz += n;
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
   p->sz = sz;
-  return 0;
+  release(&p->glock);
+  return oldsz;
 }
 
 // Create a new process, copying the parent.
@@ -296,9 +607,10 @@ growproc(int n)
 int
 fork(void)
 {
-  int i, pid;
+  int i, pid, bad;
   struct proc *np;
   struct proc *p = myproc();
+  struct proc *g = p->group;   // has the memory, if p is a thread
 
   // Allocate process.
   if((np = allocproc()) == 0){
@@ -306,13 +618,21 @@ fork(void)
   }
 
   // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  acquire(&g->glock);
+  bad = uvmcopy(g->pagetable, np->pagetable, g->sz) < 0 || mmap_fork(g, np) < 0;
+  release(&g->glock);
+  if(bad){
     freeproc(np);
     release(&np->lock);
+    procfree(np);
     return -1;
   }
-  np->sz = p->sz;
+  np->sz = g->sz;
   np->Trace = p->Trace;
+  // a real-time budget is not inherited.
+  np->policy = p->policy == SCHED_EDF ? sched_default : p->policy;
+  np->affinity = p->affinity;
+  np->tickets = p->tickets;
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -320,11 +640,21 @@ fork(void)
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
-  // increment reference counts on open file descriptors.
+  // increment reference counts on open file descriptors,
+  // which a sibling thread may be closing.
+  acquire(&g->glock);
   for(i = 0; i < NOFILE; i++)
     if(p->ofile[i])
       np->ofile[i] = filedup(p->ofile[i]);
+  release(&g->glock);
   np->cwd = idup(p->cwd);
+  // pages the parent never touched are loaded by the child.
+  if(g->exe){
+    np->exe = idup(g->exe);
+    exehold(np->exe);
+  }
+  memmove(np->seg, g->seg, sizeof(g->seg));
+  np->nseg = g->nseg;
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
@@ -333,36 +663,259 @@ fork(void)
   release(&np->lock);
 
   acquire(&wait_lock);
-  np->parent = p;
+  setparent(np, p);
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  setrunnable(np);
   release(&np->lock);
 
-  #ifdef MLFQ
-  if(p->priority_number != 0) //premeption part of the MLFQ
-  {
-    p->no_of_ticks = 0;
+  if(sched_yield_check(np)) // the new process may preempt us (MLFQ)
     yield();
+
+  return pid;
+}
+
+// Create a new process running the program at path, without
+// copying the caller's memory first as fork() and exec()
+// would. The child gets the caller's open files, or, if
+// fdmap is not 0, only fdmap[0..2] of them as its fds 0..2
+// (-1 leaves one closed). Returns the child's pid, or -1.
+int
+spawn(char *path, char **argv, int *fdmap)
+{
+  int i, argc, pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if((np = allocproc()) == 0)
+    return -1;
+  np->Trace = p->Trace;
+  np->policy = p->policy == SCHED_EDF ? sched_default : p->policy;
+  np->affinity = p->affinity;
+  np->tickets = p->tickets;
+  memset(np->trapframe, 0, sizeof(*np->trapframe));
+  // np is not RUNNABLE, so nothing else touches it while
+  // loading sleeps on the disk.
+  release(&np->lock);
+
+  acquire(&p->group->glock);
+  if(fdmap){
+    for(i = 0; i < 3; i++)
+      if(fdmap[i] >= 0 && fdmap[i] < NOFILE && p->ofile[fdmap[i]])
+        np->ofile[i] = filedup(p->ofile[fdmap[i]]);
+  } else {
+    for(i = 0; i < NOFILE; i++)
+      if(p->ofile[i])
+        np->ofile[i] = filedup(p->ofile[i]);
   }
-  #endif
+  release(&p->group->glock);
+  np->cwd = idup(p->cwd);
+
+  if((argc = execp(np, path, argv)) < 0){
+    for(i = 0; i < NOFILE; i++){
+      if(np->ofile[i]){
+        fileclose(np->ofile[i]);
+        np->ofile[i] = 0;
+      }
+    }
+    begin_op();
+    iput(np->cwd);
+    end_op();
+    np->cwd = 0;
+    acquire(&np->lock);
+    freeproc(np);
+    release(&np->lock);
+    procfree(np);
+    return -1;
+  }
+  np->trapframe->a0 = argc;
+
+  pid = np->pid;
+
+  acquire(&wait_lock);
+  setparent(np, p);
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  setrunnable(np);
+  release(&np->lock);
+
+  if(sched_yield_check(np))
+    yield();
 
   return pid;
 }
 
-// Pass p's abandoned children to init.
-// Caller must hold wait_lock.
+// Create a thread in the caller's process: a new proc with
+// its own trapframe and kernel stack, running in the page
+// table of the caller's group with its open files. It starts
+// at fn(arg) on the stack stack, and ends with exit(); fn
+// must not return. Returns the thread's id, which is a pid,
+// or -1.
+int
+clone(uint64 fn, uint64 arg, uint64 stack)
+{
+  int slot, tid;
+  struct proc *np;
+  struct proc *p = myproc();
+  struct proc *g = p->group;
+
+  if((np = allocproc()) == 0)
+    return -1;
+  // np is not RUNNABLE, so nothing else touches it.
+  release(&np->lock);
+  proc_freepagetable(np->pagetable, 0);
+  np->pagetable = 0;
+  kfree((void*)np->vproc);     // it reads g's
+  np->vproc = 0;
+
+  acquire(&g->glock);
+  for(slot = 1; slot < NTHREAD && (g->tslots & (1 << slot)); slot++)
+    ;
+  if(slot == NTHREAD ||
+     mappages(g->pagetable, THREADTF(slot), PGSIZE, (uint64)np->trapframe, PTE_R | PTE_W) != 0){
+    release(&g->glock);
+    acquire(&np->lock);
+    freeproc(np);
+    release(&np->lock);
+    procfree(np);
+    return -1;
+  }
+  g->tslots |= 1 << slot;
+  release(&g->glock);
+
+  np->group = g;
+  np->tgid = g->pid;
+  np->tslot = slot;
+  np->pagetable = g->pagetable;
+  np->ofile = g->ofiles;
+  np->Trace = p->Trace;
+  np->policy = p->policy == SCHED_EDF ? sched_default : p->policy;
+  np->affinity = p->affinity;
+  np->tickets = p->tickets;
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+
+  // the leader's exit() kills the threads it knows of with
+  // wait_lock held, then waits for them; don't add one after.
+  acquire(&wait_lock);
+  if(p->killed){
+    release(&wait_lock);
+    dropthread(np);
+    acquire(&np->lock);
+    freeproc(np);
+    release(&np->lock);
+    procfree(np);
+    return -1;
+  }
+  setparent(np, p);
+  g->nthread++;
+  release(&wait_lock);
+
+  np->cwd = idup(p->cwd);
+  tid = np->pid;
+
+  acquire(&np->lock);
+  setrunnable(np);
+  release(&np->lock);
+
+  if(sched_yield_check(np))
+    yield();
+
+  return tid;
+}
+
+// Take the thread t out of its group's page table.
+static void
+dropthread(struct proc *t)
+{
+  struct proc *g = t->group;
+
+  acquire(&g->glock);
+  uvmunmap(g->pagetable, THREADTF(t->tslot), 1, 0);
+  g->tslots &= ~(1 << t->tslot);
+  g->asidgen++;                // the slot's TLB entries are stale
+  release(&g->glock);
+  t->pagetable = 0;
+}
+
+// Kill the threads of the group leader p and wait until they
+// have all exited, since they use its memory and files.
+static void
+killthreads(struct proc *p)
+{
+  struct proc *t;
+
+  acquire(&wait_lock);
+  if(p->nthread > 0){
+    for(int i = 0; i < nproc; i++){
+      t = procs[i];
+      if(t && t != p && t->group == p){
+        acquire(&t->lock);
+        t->killed = 1;
+        if(t->state == SLEEPING)
+          setrunnable(t);
+        release(&t->lock);
+      }
+    }
+  }
+  while(p->nthread > 0)
+    sleep(&p->nthread, &wait_lock);
+  release(&wait_lock);
+}
+
+// Make p the parent of np. Caller must hold wait_lock.
+static void
+setparent(struct proc *np, struct proc *p)
+{
+  np->parent = p;
+  np->sibling = p->children;
+  p->children = np;
+}
+
+// Take the ZOMBIE np off its parent's lists, before it is
+// freed. Caller must hold wait_lock.
+static void
+unlinkchild(struct proc *np)
+{
+  struct proc *p = np->parent, **pp;
+
+  for(pp = &p->children; *pp != np; pp = &(*pp)->sibling)
+    ;
+  *pp = np->sibling;
+  for(pp = &p->zombies; *pp != np; pp = &(*pp)->zombie_next)
+    ;
+  *pp = np->zombie_next;
+  np->sibling = 0;
+  np->zombie_next = 0;
+}
+
+// Pass p's abandoned children to init, or, for the
+// threads a thread made, to its group leader, which may
+// join() them. Its zombies go with them, so they don't
+// have to be looked for. Caller must hold wait_lock.
 void
 reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
+  while((pp = p->children) != 0){
+    p->children = pp->sibling;
+    if(p->group != p && pp->group == p->group)
+      setparent(pp, p->group);
+    else
+      setparent(pp, initproc);
+  }
+  while((pp = p->zombies) != 0){
+    p->zombies = pp->zombie_next;
+    pp->zombie_next = pp->parent->zombies;
+    pp->parent->zombies = pp;
+    wakeup(pp->parent);
   }
 }
 
@@ -373,29 +926,45 @@ void
 exit(int status)
 {
   struct proc *p = myproc();
+  struct proc *g = p->group;
 
   if(p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
+  // the files of a thread are its group's; see clone().
+  if(g == p){
+    killthreads(p);
+
+    // Close all open files.
+    for(int fd = 0; fd < NOFILE; fd++){
+      if(p->ofile[fd]){
+        struct file *f = p->ofile[fd];
+        fileclose(f);
+        p->ofile[fd] = 0;
+      }
     }
+  } else {
+    dropthread(p);
   }
 
   begin_op();
   iput(p->cwd);
+  if(p->exe)
+    exeput(p->exe);
   end_op();
   p->cwd = 0;
+  p->exe = 0;
+  p->nseg = 0;
 
   acquire(&wait_lock);
 
   // Give any children to init.
   reparent(p);
 
+  // the leader might be waiting in killthreads().
+  if(g != p && --g->nthread == 0)
+    wakeup(&g->nthread);
+
   // Parent might be sleeping in wait().
   wakeup(p->parent);
   
@@ -403,7 +972,11 @@ exit(int status)
 
   p->xstate = status;
   p->state = ZOMBIE;
+  sched_exit(p);
   p->etime = ticks;
+  p->ecycles = r_time();
+  p->zombie_next = p->parent->zombies;
+  p->parent->zombies = p;
 
   release(&wait_lock);
 
@@ -417,90 +990,57 @@ exit(int status)
 int
 wait(uint64 addr)
 {
-  struct proc *np;
-  int havekids, pid;
-  struct proc *p = myproc();
-
-  acquire(&wait_lock);
-
-  for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
-          release(&np->lock);
-          release(&wait_lock);
-          return pid;
-        }
-        release(&np->lock);
-      }
-    }
-
-    // No point waiting if we don't have any children.
-    if(!havekids || p->killed){
-      release(&wait_lock);
-      return -1;
-    }
-    
-    // Wait for a child to exit.
-    sleep(p, &wait_lock);  //DOC: wait-sleep
-  }
+  return waitx(addr, 0, 0);
 }
 
+// wait() that also returns the run and wait time of the
+// child, in time CSR cycles, if rcycles and wcycles are
+// not 0. Exited children are on p->zombies, so this only
+// looks at those, and at p->children to see whether there
+// is any to wait for.
 int
-waitx(uint64 addr, uint* rtime, uint* wtime)
+waitx(uint64 addr, uint64 *rcycles, uint64 *wcycles)
 {
   struct proc *np;
-  int havekids, pid;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          *rtime = np->rtime;
-          *wtime = np->etime - np->ctime - np->rtime;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
-          release(&np->lock);
-          release(&wait_lock);
-          return pid;
-        }
+    // threads are collected by join().
+    for(np = p->zombies; np && np->group == p->group; np = np->zombie_next)
+      ;
+    if(np){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+      pid = np->pid;
+      if(rcycles)
+        *rcycles = np->rcycles;
+      if(wcycles){
+        if(np->ecycles - np->ccycles > np->rcycles)
+          *wcycles = np->ecycles - np->ccycles - np->rcycles;
+        else
+          *wcycles = 0;
+      }
+      if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                              sizeof(np->xstate)) < 0) {
         release(&np->lock);
+        release(&wait_lock);
+        return -1;
       }
+      unlinkchild(np);
+      freeproc(np);
+      release(&np->lock);
+      release(&wait_lock);
+      procfree(np);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || p->killed){
+    for(np = p->children; np && np->group == p->group; np = np->sibling)
+      ;
+    if(np == 0 || p->killed){
       release(&wait_lock);
       return -1;
     }
@@ -510,290 +1050,50 @@ waitx(uint64 addr, uint* rtime, uint* wtime)
   }
 }
 
-void
-update_time()
+// Is np a thread of p's that join(tid) is after?
+static int
+joinable(struct proc *np, struct proc *p, int tid)
 {
-  struct proc* p;
-  for (p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if (p->state == RUNNING) {
-      p->rtime++;
-    }
-    release(&p->lock); 
-  }
+  return np->group == p->group && (tid == 0 || np->pid == tid);
 }
 
-// Per-CPU process scheduler.
-// Each CPU calls scheduler() after setting itself up.
-// Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
-//  - swtch to start running that process.
-//  - eventually that process transfers control
-//    via swtch back to the scheduler.
-#ifdef DEFAULT
-void
-scheduler(void)
-{
-  struct proc *p;
-  struct cpu *c = mycpu();
-  
-  c->proc = 0;
-  for(;;){
-    // Avoid deadlock by ensuring that devices can interrupt.
-    intr_on();
-
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
-    }
-  }
-}
-#endif
-
-
-#ifdef FCFS
-void
-scheduler(void)
-{
-  struct proc *p, *ToBeScheduled = 0;
-  struct cpu *c = mycpu();
-
-  while(1)
-  {
-    c->proc = 0;
-    // Avoid deadlock by ensuring that devices can interrupt.  
-    intr_on();
-
-    int First_start = -1;
-    for(p = proc; p < &proc[NPROC]; p++)
-    {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE)
-      {
-        if(First_start == -1)                           //Intiallizng with first runnable process. 
-        {
-          First_start = p->start_time;
-          ToBeScheduled = p;
-          continue;
-        }
-        
-        if(p->start_time < First_start)                //found a process which was started earilier.  
-        {
-          release(&ToBeScheduled->lock);
-          First_start = p->start_time;
-          ToBeScheduled = p;
-          continue;
-        }
-      }
-      release(&p->lock);
-    }
-
-    if(First_start == -1)
-      continue;
-      
-
-    ToBeScheduled->state = RUNNING;
-    c->proc = ToBeScheduled;
-    swtch(&c->context, &ToBeScheduled->context);
-    release(&ToBeScheduled->lock);
-  }
-  
-}
-#endif
-
-
-#ifdef PBS
-int PSBPriority(struct proc* p)
-{
-  //caliculating nicess
-  int niceness = -1;
-  if(p->sleeping_time == -1 && p->running_time == -1) //default
-    niceness = 5;
-  else
-    niceness = (int)(p->sleeping_time*10)/(p->running_time + p->sleeping_time); 
-  
-  //caliculating priority using niceness and static priority.
-  int Value = p->Static_priority - niceness + 5;
-
-  if(Value > 100)
-    return 100;
-  if(Value < 0)
-    return 0;
-    
-  return Value;
-}
-
-// positive if q > p.
-int PcbCompare(struct proc *p, struct proc *q)
-{
-  int p_priority = PSBPriority(p), q_priority = PSBPriority(q);
-
-  if(p_priority < q_priority)  //p is more important
-    return -1;
-  if(p_priority > q_priority)  //q is more important
-    return 1;
-
-  //p_priority = q_priority.  process with less number of times scheduled
-  if(p->Times_scheduled > q->Times_scheduled) //q is run less number of times
-    return 1;
-  if(q->Times_scheduled > p->Times_scheduled) //p is run less number of times.
-    return -1;
-
-  //Times schecduled are equal. Started early given priority.
-  if(p->start_time < q->start_time)  //p started before
-    return -1;
-  if(q->start_time < p->start_time) //q started before
-    return 1;
-  
-  //All values are tied. (same time multiprocessor) //extrememly rare.
-  return -1;
-}
-
-void
-scheduler(void)
+// Wait for thread tid of the caller's, or for any if tid is
+// 0, to exit, and free it. A thread belongs to the thread that
+// clone()d it, or to the group leader once that one exits.
+// Returns its tid, or -1 if there is no such thread.
+int
+join(int tid)
 {
-  struct proc *p, *ToBeScheduled = 0;
-  struct cpu *c = mycpu();
-  int intialized;
-  
-  while(1)
-  {
-    c->proc = 0;
-    // Avoid deadlock by ensuring that devices can interrupt.  
-    intr_on();
-
-    intialized = -1;
-    for(p = proc; p < &proc[NPROC]; p++)
-    {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE)
-      {
-        if(intialized == -1)                              //Intiallizng with first runnable process. 
-        {
-          ToBeScheduled = p;
-          intialized = 0;
-          continue;
-        } 
-        
-        if(PcbCompare(ToBeScheduled, p) > 0) 
-        {               //found a process which was found with higher priority
-          release(&ToBeScheduled->lock);
-          ToBeScheduled = p;
-          continue;
-        }
-      }
-      release(&p->lock);
-    }
-
-    if(intialized == -1)
-      continue;
-
-    ToBeScheduled->state = RUNNING;
-    ToBeScheduled->Times_scheduled++;
-    ToBeScheduled->sleeping_time = 0;
-    ToBeScheduled->running_time = ticks;
-    c->proc = ToBeScheduled;
-    swtch(&c->context, &ToBeScheduled->context);
-    release(&ToBeScheduled->lock);
-  }
-  
-}
-#endif
+  struct proc *np;
+  struct proc *p = myproc();
 
-#ifdef MLFQ
-void UpgradePolicy()
-{
-  static const int Max_wait[5] = {0, 10, 30, 100, 150};
-  struct proc *p;
+  acquire(&wait_lock);
 
-  for(p = proc; p < &proc[NPROC]; p++)
-  {
-    if(p->state == RUNNABLE && p->priority_number != 0)
-    {
-      if(ticks - p->time_added > Max_wait[p->priority_number])
-      {
-        p->time_added = ticks;
-        p->priority_number--;
-      }
+  for(;;){
+    for(np = p->zombies; np && !joinable(np, p, tid); np = np->zombie_next)
+      ;
+    if(np){
+      // make sure the thread isn't still in exit() or swtch().
+      acquire(&np->lock);
+      tid = np->pid;
+      unlinkchild(np);
+      freeproc(np);
+      release(&np->lock);
+      release(&wait_lock);
+      procfree(np);
+      return tid;
     }
-  }
-}
 
-void
-scheduler(void)
-{
-  struct proc *p, *toSchedule;
-  struct cpu *c = mycpu();
-  int rr_s = 0;
-  uint minimum_time;
-
-  //the below for loop is run when a scheduler is called. 
-  //locks are not used single processor system no need
-  for(;;)
-  {
-    intr_on();
-    c->proc = 0;
-    UpgradePolicy();
-
-    for(int i = 0; i < 4; i++) //for i = 0,1,2,3
-    {
-      minimum_time = 0;
-      for(p = proc; p < &proc[NPROC]; p++)
-      {
-        if(p->state == RUNNABLE && p->priority_number == i)
-        {
-          if(minimum_time == 0)
-          {
-            minimum_time = p->time_added;
-            toSchedule = p;
-            continue;
-          }
-          
-          if(p->time_added < minimum_time)
-          {
-            minimum_time = p->time_added;
-            toSchedule = p;
-          }
-        }
-      }
-      if(minimum_time != 0) goto Schedu;
-    }
-  
-    while(1) //roundroubin
-    {
-      if(proc[rr_s].state == RUNNABLE)
-      {
-        toSchedule = &proc[rr_s];
-        rr_s = (rr_s + 1) % NPROC;
-        goto Schedu;
-      }
-      rr_s = (rr_s + 1) % NPROC;
+    for(np = p->children; np && !joinable(np, p, tid); np = np->sibling)
+      ;
+    if(np == 0 || p->killed){
+      release(&wait_lock);
+      return -1;
     }
 
-    //switching part. The process to schedule is in "toSchedule"
-    Schedu:
-    acquire(&toSchedule->lock);
-    c->proc = toSchedule;
-    toSchedule->state = RUNNING;
-    toSchedule->time_added = 0;  //not a time to acess set back when added to que.//sleep timer
-    toSchedule->No_times++;
-    swtch(&c->context, &toSchedule->context);
-    release(&toSchedule->lock);
+    sleep(p, &wait_lock);
   }
 }
-#endif
 
 // Switch to scheduler.  Must hold only p->lock
 // and have changed proc->state. Saves and restores
@@ -828,7 +1128,8 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  p->nivcsw++;
+  setrunnable(p);
   sched();
   release(&p->lock);
 }
@@ -854,12 +1155,46 @@ forkret(void)
   usertrapret();
 }
 
-// Atomically release lock and sleep on chan.
-// Reacquires lock when awakened.
-void
-sleep(void *chan, struct spinlock *lk)
+static struct waitq*
+chanq(void *chan)
+{
+  return &waitqs[((uint64)chan >> 3) % NWAITQ];
+}
+
+// Unlink p from wait queue q. q->lock must be held.
+static void
+waitq_remove(struct waitq *q, struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &q->head; *pp; pp = &(*pp)->wq_next){
+    if(*pp == p){
+      *pp = p->wq_next;
+      break;
+    }
+  }
+  p->wq_next = 0;
+  p->waitq = 0;
+}
+
+// sleep() and sleepuntil(): if timed, p also goes on its
+// hart's timer wheel for tick t.
+static void
+sleep1(void *chan, struct spinlock *lk, int timed, uint t)
 {
   struct proc *p = myproc();
+  struct waitq *q = chanq(chan);
+
+  // Join chan's wait queue while still holding lk.
+  // wakeup(chan) is called with lk held, so it can't
+  // look at the queue before p is on it.
+  // wakeup() locks the queue and then p->lock, so
+  // don't hold p->lock here.
+  acquire(&q->lock);
+  p->wq_next = q->head;
+  q->head = p;
+  p->waitq = q;
+  release(&q->lock);
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
@@ -874,48 +1209,118 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->nvcsw++;
+  SCHEDTRACE(SEV_SLEEP, p);
 
-  #ifdef PBS
+  // inputs to PSBPriority().
   p->running_time = ticks - p->running_time;
   p->sleeping_time = ticks;
-  #endif
+
+  // the wheel wakes p with wakeproc(), which takes p->lock,
+  // so it can't find p before p is asleep.
+  if(timed)
+    twheel_add(p, chan, t);
 
   sched();
 
   // Tidy up.
+  if(timed)
+    twheel_del(p);
   p->chan = 0;
+  release(&p->lock);
+
+  // wakeup() takes p off the queue, but kill() does not.
+  acquire(&q->lock);
+  if(p->waitq == q)
+    waitq_remove(q, p);
+  release(&q->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
+// Atomically release lock and sleep on chan.
+// Reacquires lock when awakened.
+void
+sleep(void *chan, struct spinlock *lk)
+{
+  sleep1(chan, lk, 0, 0);
+}
+
+// Like sleep(), but p is also woken at tick t, once, by its
+// hart's timer wheel. A chan of 0 waits for t alone. Returns
+// at once if t has come.
+void
+sleepuntil(void *chan, struct spinlock *lk, uint t)
+{
+  struct proc *p = myproc();
+
+  if((int)(t - ticks) <= 0)
+    return;
+  sleep1(chan ? chan : &p->tw_tick, lk, 1, t);
+}
+
+// Wake p if it still sleeps on chan: wakeup() of one known
+// process, for the timer wheel. Must be called without any
+// p->lock.
+void
+wakeproc(struct proc *p, void *chan)
+{
+  struct waitq *q = chanq(chan);
+
+  acquire(&q->lock);
+  acquire(&p->lock);
+  if(p->state == SLEEPING && p->chan == chan){
+    waitq_remove(q, p);
+    p->sleeping_time = ticks - p->sleeping_time;
+    setrunnable(p);
+  }
+  release(&p->lock);
+  release(&q->lock);
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void
 wakeup(void *chan)
 {
-  struct proc *p;
+  wakeupn(chan, -1);
+}
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc())
+// Wake up at most n of the processes sleeping on chan, all
+// of them if n is negative. Returns how many were woken.
+// Must be called without any p->lock.
+int
+wakeupn(void *chan, int n)
+{
+  struct waitq *q = chanq(chan);
+  struct proc *p, **pp;
+  struct proc *me = myproc();
+  int woken = 0;
+
+  acquire(&q->lock);
+  for(pp = &q->head; (p = *pp) != 0 && woken != n; ){
+    if(p != me)
     {
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) 
       {
-        p->state = RUNNABLE;
-        #ifdef PBS
-        p->sleeping_time = ticks - p->sleeping_time;
-        #endif
+        *pp = p->wq_next;
+        p->wq_next = 0;
+        p->waitq = 0;
 
-        #ifdef MLFQ
-        p->time_added = ticks;
-        p->no_of_ticks = 0;
-        #endif
+        p->sleeping_time = ticks - p->sleeping_time;
+        setrunnable(p);
+        release(&p->lock);
+        woken++;
+        continue;
       }
       release(&p->lock);
     }
+    pp = &p->wq_next;
   }
+  release(&q->lock);
+  return woken;
 }
 
 // Kill the process with the given pid.
@@ -926,20 +1331,15 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    setrunnable(p);
   }
-  return -1;
+  release(&p->lock);
+  return 0;
 }
 
 // Copy to either a user address, or kernel address,
@@ -972,6 +1372,96 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
   }
 }
 
+// Fill in st for p. The caller holds p->lock, which keeps exec()
+// and freeproc() from freeing the page table under the walk;
+// procdump() doesn't, and relies on uvmstat() staying in RAM.
+static void
+memstat_of(struct proc *p, struct memstat *st)
+{
+  st->pid = p->pid;
+  st->sz = p->sz;
+  st->vmapages = 0;
+  for(struct vma *v = p->vma; v < &p->vma[NVMA]; v++)
+    st->vmapages += v->len / PGSIZE;
+  if(p->pagetable)
+    uvmstat(p->pagetable, st);
+  else
+    st->rss = st->shared = st->ptpages = 0;
+}
+
+// Copy out the memory use of process pid, or of the caller
+// if pid is 0, to user address addr.
+int
+proc_memstat(int pid, uint64 addr)
+{
+  struct proc *p;
+  struct memstat st;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  memstat_of(p, &st);
+  release(&p->lock);
+  return copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st));
+}
+
+// Fill in s for p. The caller holds p->lock, so every entry
+// is taken at one instant of its process.
+static void
+procsnap_of(struct proc *p, struct procsnap *s)
+{
+  struct memstat st;
+
+  s->version = PROCSNAP_VERSION;
+  s->pid = p->pid;
+  s->tgid = p->tgid;
+  s->state = p->state;
+  s->policy = p->policy;
+  s->cpu = p->cpu;
+  s->priority = p->dynamic_priority;
+  s->static_priority = p->Static_priority;
+  s->queue = p->priority_number;
+  s->nscheduled = p->policy == SCHED_MLFQ ? p->No_times : p->Times_scheduled;
+  s->rtime = p->rtime;
+  s->wtime = (p->etime ? p->etime : ticks) - p->ctime - p->rtime;
+  s->time = r_time();
+  s->rcycles = sched_runtime(p);
+  s->waitcycles = p->waitcycles;
+  if(p->state == RUNNABLE)
+    s->waitcycles += s->time - p->runnable_since;
+  s->nruns = p->nruns;
+  s->nvcsw = p->nvcsw;
+  s->nivcsw = p->nivcsw;
+  memstat_of(p, &st);
+  s->sz = st.sz;
+  s->rss = st.rss;
+  safestrcpy(s->name, p->name, sizeof(s->name));
+}
+
+// Copy out a struct procsnap for each of up to n live
+// processes to the array at user address addr. Returns how
+// many, or -1.
+int
+proc_snapshot(uint64 addr, int n)
+{
+  struct proc *p;
+  struct procsnap s;
+  int i = 0;
+
+  for(int slot = 0; slot < nproc && i < n; slot++){
+    if((p = slotproc(slot)) == 0)
+      continue;
+    procsnap_of(p, &s);
+    release(&p->lock);
+    if(copyout(myproc()->pagetable, addr + i*sizeof(s), (char*)&s, sizeof(s)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
@@ -986,12 +1476,14 @@ procdump(void)
   [ZOMBIE]    "zombie"
   };
   struct proc *p;
+  struct memstat st;
   char *state;
 
   printf("\n");
-  for(p = proc; p < &proc[NPROC]; p++)
+  for(int i = 0; i < nproc; i++)
   {
-    if(p->state == UNUSED)
+    p = procs[i];
+    if(p == 0 || p->state == UNUSED)
       continue;
 
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
@@ -999,70 +1491,109 @@ procdump(void)
     else
       state = "???";
 
-    #ifdef DEFAULT
-    printf("%d %s %s", p->pid, state, p->name);
-    #endif
-
-    #ifdef FCFS
-    printf("%d %s %s", p->pid, state, p->name);
-    #endif
-
-    #ifdef PBS
     uint waittime;
     if(p->etime == 0)
       waittime = ticks - p->ctime - p->rtime;
     else
       waittime = p->etime - p->ctime - p->rtime;
-    printf("%d %d %s %d %d %d", p->pid, PSBPriority(p), state, p->rtime, waittime, p->Times_scheduled);
-    #endif
 
-    #ifdef MLFQ
-    uint waittime;
-    if(p->etime == 0)
-      waittime = ticks - p->ctime - p->rtime;
-    else
-      waittime = p->etime - p->ctime - p->rtime;
-    printf("%d %d %s %d %d %d", p->pid, p->priority_number, state, p->rtime, waittime, p->No_times);
-    #endif
+    switch(p->policy){
+    case SCHED_PBS:
+      printf("%d %d %s %d %d %d", p->pid, p->dynamic_priority, state, p->rtime, waittime, p->Times_scheduled);
+      break;
+    case SCHED_MLFQ:
+      printf("%d %d %s %d %d %d", p->pid, p->priority_number, state, p->rtime, waittime, p->No_times);
+      break;
+    case SCHED_CFS:
+      printf("%d %d %s %d %d %d", p->pid, p->cfs_weight, state, p->rtime, waittime, (int)(p->vruntime / TICKCYCLES));
+      break;
+    case SCHED_EDF:
+      printf("%d %d %s %d %d %d", p->pid, p->dl_budget, state, p->rtime, waittime, p->dl_abs);
+      break;
+    case SCHED_STRIDE:
+      printf("%d %d %s %d %d %d", p->pid, p->tickets, state, p->rtime, waittime, (int)p->pass);
+      break;
+    default:
+      printf("%d %s %s", p->pid, state, p->name);
+      break;
+    }
 
+    // pages: in memory, of those shared, page tables.
+    memstat_of(p, &st);
+    printf(" rss %d shared %d pt %d", st.rss, st.shared, st.ptpages);
     printf("\n");
   }
 }
 
+// Set the static priority of process pid. Returns the old
+// one, 1 for a bad priority or 2 if there is no such
+// process. A RUNNABLE process is re-sifted in its run queue
+// at once; a RUNNING one, which used to be skipped, gets its
+// new dynamic priority when it next becomes RUNNABLE, and,
+// if it is the caller and got worse, yields straight away so
+// that a better process on this hart may run.
 int set_priority_i(int priority, int pid)
 {
-  #ifndef PBS
-  return 10; //not defined
-  #endif
-
-  #ifdef PBS
   if(priority < 0 || priority > 100)             //invalid values for static priority
     return 1;
-  
-  struct proc* pid_process;
-  int Ppid = -1, old_priority;
-  for(pid_process = proc; pid_process < &proc[NPROC]; pid_process++)
-  {
-    acquire(&pid_process->lock);
-    if( (pid_process->state == RUNNABLE || pid_process->state == SLEEPING) && pid_process->pid == pid)          //even sleeping take to be care *****
-    {
-      Ppid = pid_process->pid;
-      break;
-    }
+
+  struct proc* pid_process, *me = myproc();
+  int old_priority, runnable, demoted;
+
+  if((pid_process = findproc(pid)) == 0)
+    return 2;
+  if(pid_process->state == ZOMBIE){
     release(&pid_process->lock);
-  }
-  if(Ppid == -1)
     return 2;
+  }
 
   old_priority = pid_process->Static_priority;
   pid_process->Static_priority = priority;
-  pid_process->running_time = -1;
-  pid_process->sleeping_time = -1;
+  // a running process is in the middle of timing its run;
+  // it keeps its history.
+  if(pid_process->state != RUNNING){
+    pid_process->running_time = -1;
+    pid_process->sleeping_time = -1;
+  }
+  SCHEDTRACE(SEV_PRIO, pid_process);
+  if(sched_classes[pid_process->policy]->prio_changed)
+    sched_classes[pid_process->policy]->prio_changed(pid_process);
+  runnable = pid_process->state == RUNNABLE;
+  demoted = pid_process == me && priority > old_priority;
   release(&pid_process->lock);
 
-  if(priority > old_priority)
+  if((runnable && sched_yield_check(pid_process)) || demoted)
     yield();
   return old_priority;
-  #endif
+}
+
+// Give process pid tickets shares of the cpu (stride class),
+// the proportional-share counterpart of set_priority.
+// Returns the old number of tickets, or -1.
+int
+set_tickets_i(int tickets, int pid)
+{
+  struct proc *p;
+  int old, runnable;
+
+  if(tickets < 1 || tickets > MAXTICKETS)
+    return -1;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  if(p->state == ZOMBIE){
+    release(&p->lock);
+    return -1;
+  }
 
-}
\ No newline at end of file
+  old = p->tickets;
+  p->tickets = tickets;
+  if(sched_classes[p->policy]->prio_changed)
+    sched_classes[p->policy]->prio_changed(p);
+  runnable = p->state == RUNNABLE;
+  release(&p->lock);
+
+  if(runnable && sched_yield_check(p))
+    yield();
+  return old;
+}
@@ -24,6 +24,14 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int online;                 // Has this hart entered scheduler()?
+  int idle;                   // Is this hart waiting in wfi for work?
+  uint asidgen[NPROC+1];      // proc asidgen last flushed here, by ASID
+  pagetable_t upt;            // user page table this hart is in user mode on, or 0
+  uint tlbreq;                // TLB flushes other harts asked of this one
+  uint tlback;                // tlbreq when this hart last flushed for them
+  uint kstackgen[NPROC];      // kstackgen[] last flushed here, by slot
+  uint qs;                    // times through scheduler(), for proc_quiesce()
 };
 
 extern struct cpu cpus[NCPU];
@@ -78,11 +86,30 @@ struct trapframe {
   /* 264 */ uint64 t4;
   /* 272 */ uint64 t5;
   /* 280 */ uint64 t6;
+  /* 288 */ uint64 tlbflush;      // flush the TLB on entry: no ASIDs
 };
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A loadable segment of the program image, read in from
+// p->exe a page at a time on first touch (see vmfault).
+struct execseg {
+  uint64 va;                   // page aligned
+  uint64 filesz;               // bytes from the file; the rest is zero
+  uint off;                    // file offset of va
+};
+
+// A region mapped with mmap(), see mmap.c.
+struct vma {
+  uint64 addr;                 // page aligned
+  uint64 len;                  // bytes, a page multiple; 0 if unused
+  int prot;                    // PROT_ bits
+  int flags;                   // MAP_ bits
+};
+
 // Per-process state
+#define PI_NONE 101            // pi_prio: worse than any PBS priority
+
 struct proc {
   struct spinlock lock;
 
@@ -93,39 +120,199 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
-  // wait_lock must be held when using this:
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // its children, linked through sibling
+  struct proc *sibling;        // next child of parent
+  struct proc *zombies;        // its ZOMBIE children, linked through zombie_next
+  struct proc *zombie_next;    // next ZOMBIE child of parent
+  int nthread;                 // group leader: clone()d threads not yet exited
+
+  // the lock of the wait queue must be held for these, see sleep():
+  struct waitq *waitq;         // Wait queue p is on, or 0
+  struct proc *wq_next;        // Next process on that wait queue
+
+  // the lock of its hart's timer wheel must be held for these, see twheel_add():
+  struct twheel *tw_wheel;     // Timer wheel p waits on in sleepuntil(), or 0
+  struct proc *tw_next;        // Next process in that wheel slot
+  uint tw_tick;                // tick p wakes at
+  void *tw_chan;               // what p sleeps on until then
+
+  // the lock of its pid hash bucket must be held for this, see findproc():
+  struct proc *pid_next;       // Next process in that bucket
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
+  int slot;                    // Index in procs[], for kstack and the ASID
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  struct vproc *vproc;         // page mapped read-only at VPROC
   struct context context;      // swtch() here to run process
-  struct file *ofile[NOFILE];  // Open files
+  struct file **ofile;         // Open files, group->ofiles
+  struct file *ofiles[NOFILE];
   struct inode *cwd;           // Current directory
+  struct inode *exe;           // Program image, for demand paging
+  struct execseg seg[NEXECSEG];
+  int nseg;
+  struct vma vma[NVMA];        // mmap() regions
+  uint64 mmapbase;             // lowest mapped address, USERTOP if none
+  uint asidgen;                // changes with the page table, see asid_satp
   char name[16];               // Process name (debugging)
+
+  // threads, see clone(). A thread has its own trapframe and
+  // kernel stack; the page table, sz, mappings, program image
+  // and open files are those of its group leader.
+  struct proc *group;          // thread group leader, p itself if not a thread
+  int tgid;                    // group->pid, kept after the leader is reaped
+  int tslot;                   // trapframe mapped at THREADTF(tslot)
+  struct spinlock glock;       // leader: page table and ofile changes
+  uint tslots;                 // leader, glock: THREADTF slots in use
+  void (*kfn)(void);           // body of a kernel process, see kproc()
   int Trace;                   // Which all syscalls to trace.
+  uint sccount[NSYSCALL];      // syscalls made, by number
+  uint64 sccycles[NSYSCALL];   // time CSR cycles spent in them
   uint rtime;                   // How long the process ran for
   uint ctime;                   // When was the process created 
   uint etime;                   // When did the process exited
+  uint64 rcycles;              // time CSR cycles spent RUNNING, see scheduler()
+  uint64 run_start;            // time CSR when it last started running
+  uint64 runnable_since;       // time CSR when it last became RUNNABLE
+  int woken;                   // it was SLEEPING or new then, not preempted
+  uint64 waitcycles;           // time CSR cycles spent RUNNABLE
+  uint nruns;                  // times dispatched by scheduler()
+  uint nvcsw;                  // switches in sleep()
+  uint nivcsw;                 // switches in yield()
+  uint lat[NLATBUCKET];        // RUNNABLE to RUNNING waits, log2 cycles
+  uint64 ccycles;              // time CSR when created
+  uint64 ecycles;              // time CSR when exited
+
 
-  #ifdef FCFS
-  uint start_time;
-  #endif
+  // scheduling, see sched.c. p->lock must be held for policy.
+  int policy;                  // Scheduling class, SCHED_* in sched.h
+  int affinity;                // harts it may run on, bit i is hart i
+  int cpu;                     // Hart it last ran or is queued on, -1 if new
+  struct proc *rq_next;        // Next process in a run queue
+  int heap_index;              // Slot in a run-queue heap, -1 if not in one
+  uint start_time;             // FCFS, PBS: when the process was created
 
-  #ifdef PBS
+  // PBS
   int Static_priority;
   int Times_scheduled;
-  uint start_time;
   int running_time;
   int sleeping_time;
-  #endif
+  int dynamic_priority;        // PSBPriority(), cached when its inputs change
+  int pi_prio;                 // lent by sleeplock waiters, PI_NONE if none
+  int pi_locks;                // sleeplocks held that lent it
 
-  #ifdef MLFQ
+  // MLFQ. while the process is queued, the owning mlfq lock
+  // protects priority_number and time_added.
   int priority_number;
   uint time_added;
-  int no_of_ticks;
+  uint64 slice_start;          // sched_runtime() when its allotment at this level began
+  uint mlfq_epoch;             // last boost epoch it has seen
   int No_times;
-  #endif
+
+  // CFS. the tree links are protected by the cfs lock.
+  uint64 vruntime;             // Run time in cycles, scaled by 1024/cfs_weight
+  uint64 cfs_charged;          // Part of sched_runtime() already in vruntime
+  int cfs_weight;              // From Static_priority
+  struct proc *cfs_left;       // Tree of RUNNABLE processes by vruntime
+  struct proc *cfs_right;
+  int cfs_height;
+
+  // EDF, all in ticks. see edf.c.
+  int dl_runtime;              // budget per period
+  int dl_period;
+  int dl_deadline;             // relative to the start of a period
+  int dl_bw;                   // admitted share of a cpu
+  int dl_budget;               // left in this period
+  uint64 dl_charged;           // Part of sched_runtime() already taken from dl_budget
+  uint dl_abs;                 // absolute deadline of this period
+  uint dl_release;             // start of the next period
+  int dl_throttled;            // out of budget until dl_release
+
+  // Stride. tickets is set with set_tickets().
+  int tickets;                 // share of the cpu, relative to others
+  uint64 stride;               // cached STRIDE1/tickets, see stride.c
+  uint64 pass;
+  uint64 stride_charged;       // Part of sched_runtime() already in pass
+};
+
+// A first-in first-out run queue linked through p->rq_next.
+// The user of a procq provides the locking.
+struct procq {
+  struct proc *head;
+  struct proc *tail;
 };
+
+// A binary min-heap of processes. cmp(a, b) > 0 when b
+// should run before a. Each process is in at most one heap,
+// at slot p->heap_index. Operations take h->lock.
+struct procheap {
+  struct spinlock lock;
+  struct proc *heap[NPROC];
+  int n;
+  int (*cmp)(struct proc *, struct proc *);
+  uint balanced;               // ticks at the last procheap_pick() balance
+};
+
+// A scheduling class. Every process belongs to one
+// (p->policy); scheduler() asks the classes for work in
+// a fixed order, see sched.c. Optional ops may be 0.
+struct sched_class {
+  char *name;
+  void (*init)(void);
+
+  // p became RUNNABLE: put it on a run queue.
+  // p->lock is held.
+  void (*enqueue)(struct proc *p);
+
+  // take p off its run queue. p->lock is held.
+  // returns 0 if p was not queued because a hart has
+  // already picked it and is about to run it.
+  int (*dequeue)(struct proc *p);
+
+  // remove and return a process for hart cpu, or 0.
+  // the caller locks it and checks it is RUNNABLE.
+  struct proc* (*pick_next)(int cpu);
+
+  // optional: p is about to run on hart cpu.
+  // p->lock is held.
+  void (*dispatch)(struct proc *p, int cpu);
+
+  // a timer interrupt arrived while p was running.
+  // returns non-zero if p should yield the cpu.
+  int (*tick)(struct proc *p);
+
+  // optional: time CSR cycles from now until the class
+  // wants the next tick for p, running here; 0 for never.
+  // without it, a tick every TICKCYCLES. see sched_timer().
+  uint64 (*slice)(struct proc *p);
+
+  // optional: p, in the same class as the running process
+  // cur, was created or had its priority changed.
+  // returns non-zero if cur should yield to it.
+  int (*yield_check)(struct proc *cur, struct proc *p);
+
+  // optional: p->Static_priority or p->tickets changed.
+  // p->lock is held.
+  void (*prio_changed)(struct proc *p);
+
+  // optional: set_policy moved p into this class. called
+  // before enqueue if p is RUNNABLE. p->lock is held.
+  void (*switched_to)(struct proc *p);
+
+  // optional: p leaves this class through set_policy, or
+  // exits. p->lock is held.
+  void (*switched_from)(struct proc *p);
+};
+
+extern struct sched_class rr_class;
+extern struct sched_class fcfs_class;
+extern struct sched_class pbs_class;
+extern struct sched_class mlfq_class;
+extern struct sched_class cfs_class;
+extern struct sched_class edf_class;
+extern struct sched_class stride_class;
+extern struct sched_class *sched_classes[];
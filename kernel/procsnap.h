@@ -0,0 +1,37 @@
+// One process of a process table snapshot, read with
+// procsnap(). A program checks version before using the
+// entries; any change to the layout changes the version.
+// Times are in time CSR cycles unless noted.
+// Needs kernel/types.h.
+#define PROCSNAP_VERSION 1
+
+// state
+#define PS_USED      1
+#define PS_SLEEPING  2
+#define PS_RUNNABLE  3
+#define PS_RUNNING   4
+#define PS_ZOMBIE    5
+
+struct procsnap {
+  int version;                 // PROCSNAP_VERSION
+  int pid;
+  int tgid;                    // pid of its thread group leader
+  int state;                   // PS_*
+  int policy;                  // SCHED_* in kernel/sched.h
+  int cpu;                     // hart it last ran on, -1 if new
+  int priority;                // PBS dynamic priority
+  int static_priority;
+  int queue;                   // MLFQ queue
+  int nscheduled;              // PBS Times_scheduled, MLFQ No_times
+  uint rtime;                  // ticks RUNNING
+  uint wtime;                  // ticks alive and not RUNNING
+  uint64 time;                 // time CSR when this entry was taken
+  uint64 rcycles;              // total time RUNNING
+  uint64 waitcycles;           // total time RUNNABLE
+  uint nruns;                  // times dispatched
+  uint nvcsw;                  // voluntary switches (sleep)
+  uint nivcsw;                 // involuntary switches
+  uint64 sz;                   // heap top
+  uint rss;                    // user pages in memory
+  char name[16];
+};
@@ -0,0 +1,42 @@
+// Syscall submission ring, for ring_enter().
+// Needs kernel/types.h.
+//
+// A process puts a struct ring on a page of its own memory.
+// It fills sq[sqtail % NRING] and advances sqtail; the
+// kernel takes entries from sqhead, runs them in order, and
+// for each fills cq[cqtail % NRING] and advances cqtail.
+// The process reads completions from cqhead. Each index is
+// only advanced by one side, so neither takes a lock.
+
+#define NRING 64                // entries in each ring; struct ring fits a page
+
+// ops
+#define RING_NOP   0
+#define RING_READ  1            // fd, addr, len
+#define RING_WRITE 2            // fd, addr, len
+#define RING_OPEN  3            // path at addr, omode in len
+#define RING_CLOSE 4            // fd
+
+struct sqe {
+  int op;
+  int fd;
+  uint64 addr;
+  int len;
+  int pad;
+  uint64 data;                  // copied to the completion
+};
+
+struct cqe {
+  uint64 data;                  // from the sqe
+  int res;                      // what the syscall would return
+  int pad;
+};
+
+struct ring {
+  volatile uint sqhead;         // advanced by the kernel
+  volatile uint sqtail;         // advanced by the process
+  volatile uint cqhead;         // advanced by the process
+  volatile uint cqtail;         // advanced by the kernel
+  struct sqe sq[NRING];
+  struct cqe cq[NRING];
+};
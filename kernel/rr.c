@@ -0,0 +1,107 @@
+// Round robin scheduling class (SCHED_DEFAULT).
+// Every timer interrupt preempts the running process.
+//
+// Each hart has its own FIFO of RUNNABLE processes. A
+// process goes back to the hart it last ran on, so harts
+// normally only take their own lock; a hart whose queue
+// is empty steals the oldest process of the busiest one.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+struct rrq {
+  struct spinlock lock;
+  struct procq q;
+  int len;
+};
+
+struct rrq rrqs[NCPU];
+
+static void
+rr_init(void)
+{
+  struct rrq *rq;
+
+  for(rq = rrqs; rq < &rrqs[NCPU]; rq++)
+    initlock(&rq->lock, "rr");
+}
+
+static int
+rr_load(int cpu)
+{
+  return rrqs[cpu].len;
+}
+
+static void
+rr_enqueue(struct proc *p)
+{
+  struct rrq *rq;
+
+  if(p->cpu < 0 || !sched_allowed(p, p->cpu))
+    p->cpu = sched_place(p, rr_load);
+  rq = &rrqs[p->cpu];
+
+  acquire(&rq->lock);
+  procq_push(&rq->q, p);
+  rq->len++;
+  release(&rq->lock);
+}
+
+static int
+rr_dequeue(struct proc *p)
+{
+  struct rrq *rq = &rrqs[p->cpu];
+  int found;
+
+  acquire(&rq->lock);
+  if((found = procq_remove(&rq->q, p)) != 0)
+    rq->len--;
+  release(&rq->lock);
+  return found;
+}
+
+// Pop the oldest process in rq that may run on hart cpu.
+static struct proc*
+rr_pop(struct rrq *rq, int cpu)
+{
+  struct proc *p;
+
+  acquire(&rq->lock);
+  if((p = procq_pop_cpu(&rq->q, cpu)) != 0)
+    rq->len--;
+  release(&rq->lock);
+  return p;
+}
+
+static struct proc*
+rr_pick_next(int cpu)
+{
+  struct proc *p;
+  int victim;
+
+  if(rrqs[cpu].len > 0 && (p = rr_pop(&rrqs[cpu], cpu)) != 0)
+    return p;
+  if((victim = sched_busiest(cpu, rr_load)) < 0)
+    return 0;
+  return rr_pop(&rrqs[victim], cpu);
+}
+
+static int
+rr_tick(struct proc *p)
+{
+  return 1;
+}
+
+struct sched_class rr_class = {
+  .name = "default",
+  .init = rr_init,
+  .enqueue = rr_enqueue,
+  .dequeue = rr_dequeue,
+  .pick_next = rr_pick_next,
+  .tick = rr_tick,
+};
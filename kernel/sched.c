@@ -0,0 +1,749 @@
+// Scheduling classes.
+//
+// Every process belongs to one scheduling class, p->policy.
+// The classes (rr.c, fcfs.c, pbs.c, mlfq.c, cfs.c, edf.c,
+// stride.c) keep their own
+// run queues; this file hands RUNNABLE processes to them and
+// runs the per-CPU scheduler loop on top of them.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "sched.h"
+#include "schedtrace.h"
+#include "defs.h"
+
+struct sched_class *sched_classes[] = {
+[SCHED_DEFAULT] &rr_class,
+[SCHED_FCFS]    &fcfs_class,
+[SCHED_PBS]     &pbs_class,
+[SCHED_MLFQ]    &mlfq_class,
+[SCHED_CFS]     &cfs_class,
+[SCHED_EDF]     &edf_class,
+[SCHED_STRIDE]  &stride_class,
+};
+
+// The order in which scheduler() asks the classes for
+// work: real-time first, interactive classes before
+// batch ones.
+static struct sched_class *pick_order[] = {
+  &edf_class,
+  &mlfq_class,
+  &pbs_class,
+  &cfs_class,
+  &stride_class,
+  &rr_class,
+  &fcfs_class,
+};
+
+// Class of new processes that have no parent to inherit
+// one from, chosen at build time with SCHEDULER=.
+#if defined(FCFS)
+int sched_default = SCHED_FCFS;
+#elif defined(PBS)
+int sched_default = SCHED_PBS;
+#elif defined(MLFQ)
+int sched_default = SCHED_MLFQ;
+#elif defined(CFS)
+int sched_default = SCHED_CFS;
+#elif defined(STRIDE)
+int sched_default = SCHED_STRIDE;
+#else
+int sched_default = SCHED_DEFAULT;
+#endif
+
+void
+schedinit(void)
+{
+  for(int i = 0; i < NSCHED; i++)
+    if(sched_classes[i]->init)
+      sched_classes[i]->init();
+}
+
+void
+procq_push(struct procq *q, struct proc *p)
+{
+  p->rq_next = 0;
+  if(q->tail)
+    q->tail->rq_next = p;
+  else
+    q->head = p;
+  q->tail = p;
+}
+
+// Remove and return the head of q, or 0 if q is empty.
+struct proc*
+procq_pop(struct procq *q)
+{
+  struct proc *p;
+
+  if((p = q->head) == 0)
+    return 0;
+  if((q->head = p->rq_next) == 0)
+    q->tail = 0;
+  p->rq_next = 0;
+  return p;
+}
+
+// Remove and return the first process in q that may run
+// on hart cpu, or 0.
+struct proc*
+procq_pop_cpu(struct procq *q, int cpu)
+{
+  struct proc *p;
+
+  if((p = q->head) != 0 && sched_allowed(p, cpu))
+    return procq_pop(q);
+  for(; p; p = p->rq_next){
+    if(sched_allowed(p, cpu)){
+      procq_remove(q, p);
+      return p;
+    }
+  }
+  return 0;
+}
+
+// Unlink p from anywhere in q.
+// Returns 0 if p was not in q.
+int
+procq_remove(struct procq *q, struct proc *p)
+{
+  struct proc **pp, *prev = 0;
+
+  for(pp = &q->head; *pp; pp = &(*pp)->rq_next){
+    if(*pp == p){
+      *pp = p->rq_next;
+      if(q->tail == p)
+        q->tail = prev;
+      p->rq_next = 0;
+      return 1;
+    }
+    prev = *pp;
+  }
+  return 0;
+}
+
+void
+procheap_init(struct procheap *h, char *name, int (*cmp)(struct proc *, struct proc *))
+{
+  initlock(&h->lock, name);
+  h->n = 0;
+  h->cmp = cmp;
+  h->balanced = 0;
+}
+
+static void
+procheap_swap(struct procheap *h, int i, int j)
+{
+  struct proc *t = h->heap[i];
+
+  h->heap[i] = h->heap[j];
+  h->heap[j] = t;
+  h->heap[i]->heap_index = i;
+  h->heap[j]->heap_index = j;
+}
+
+// h->lock must be held.
+static void
+procheap_siftup(struct procheap *h, int i)
+{
+  while(i > 0 && h->cmp(h->heap[(i-1)/2], h->heap[i]) > 0){
+    procheap_swap(h, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+}
+
+// h->lock must be held.
+static void
+procheap_siftdown(struct procheap *h, int i)
+{
+  int c;
+
+  for(;;){
+    c = 2*i + 1;
+    if(c >= h->n)
+      break;
+    if(c+1 < h->n && h->cmp(h->heap[c], h->heap[c+1]) > 0)
+      c++;
+    if(h->cmp(h->heap[i], h->heap[c]) <= 0)
+      break;
+    procheap_swap(h, i, c);
+    i = c;
+  }
+}
+
+// Take the element at slot i out of h.
+// h->lock must be held.
+static void
+procheap_delete(struct procheap *h, int i)
+{
+  struct proc *p = h->heap[i];
+
+  h->n--;
+  if(i != h->n){
+    procheap_swap(h, i, h->n);
+    procheap_siftup(h, i);
+    procheap_siftdown(h, i);
+  }
+  p->heap_index = -1;
+}
+
+void
+procheap_push(struct procheap *h, struct proc *p)
+{
+  acquire(&h->lock);
+  p->heap_index = h->n;
+  h->heap[h->n++] = p;
+  procheap_siftup(h, p->heap_index);
+  release(&h->lock);
+}
+
+// Remove and return the process that should run first on
+// hart cpu, or 0. Usually that is the top; if the top may
+// not run there, look through the whole heap for the best
+// one that may. cpu -1 means any hart.
+struct proc*
+procheap_pop(struct procheap *h, int cpu)
+{
+  struct proc *p = 0;
+  int i, best = -1;
+
+  acquire(&h->lock);
+  if(h->n > 0 && (cpu < 0 || sched_allowed(h->heap[0], cpu))){
+    best = 0;
+  } else {
+    for(i = 1; i < h->n; i++)
+      if(sched_allowed(h->heap[i], cpu) &&
+         (best < 0 || h->cmp(h->heap[best], h->heap[i]) > 0))
+        best = i;
+  }
+  if(best >= 0){
+    p = h->heap[best];
+    procheap_delete(h, best);
+  }
+  release(&h->lock);
+  return p;
+}
+
+// Remove and return the coldest process in h that may run
+// on hart cpu, or 0: the one whose last run started longest
+// ago, or that has never run, so its cache is least likely
+// to still be warm where it is. The top is left alone; it
+// is about to run there anyway.
+static struct proc*
+procheap_pop_cold(struct procheap *h, int cpu)
+{
+  struct proc *p = 0;
+  int i, best = -1;
+
+  acquire(&h->lock);
+  for(i = 1; i < h->n; i++)
+    if(sched_allowed(h->heap[i], cpu) &&
+       (best < 0 || h->heap[i]->run_start < h->heap[best]->run_start))
+      best = i;
+  if(best >= 0){
+    p = h->heap[best];
+    procheap_delete(h, best);
+  }
+  release(&h->lock);
+  return p;
+}
+
+// Returns 0 if p was not in h.
+int
+procheap_remove(struct procheap *h, struct proc *p)
+{
+  int found = 0;
+
+  acquire(&h->lock);
+  if(p->heap_index >= 0 && p->heap_index < h->n && h->heap[p->heap_index] == p){
+    procheap_delete(h, p->heap_index);
+    found = 1;
+  }
+  release(&h->lock);
+  return found;
+}
+
+// Restore the heap order after p's sort keys changed.
+void
+procheap_fix(struct procheap *h, struct proc *p)
+{
+  acquire(&h->lock);
+  if(p->heap_index >= 0 && p->heap_index < h->n && h->heap[p->heap_index] == p){
+    procheap_siftup(h, p->heap_index);
+    procheap_siftdown(h, p->heap_index);
+  }
+  release(&h->lock);
+}
+
+// pick_next for a class with one heap per hart, hs[NCPU],
+// whose sizes load() returns: the best process on our own
+// heap. A hart whose heap is empty takes the best one of
+// the busiest hart. Every BALANCETICKS ticks a hart also
+// compares its heap with the busiest one and, if that is at
+// least two longer, moves the coldest process from it to
+// its own, so queues stay even while every hart is busy.
+// The moved process is queued again through its class,
+// under its lock, in case it changed class in between.
+struct proc*
+procheap_pick(struct procheap *hs, int (*load)(int), int cpu)
+{
+  struct procheap *h = &hs[cpu];
+  struct proc *p;
+  int victim;
+
+  if(ticks - h->balanced >= BALANCETICKS){
+    h->balanced = ticks;
+    if((victim = sched_busiest(cpu, load)) >= 0 && load(victim) >= load(cpu) + 2 &&
+       (p = procheap_pop_cold(&hs[victim], cpu)) != 0){
+      acquire(&p->lock);
+      p->cpu = cpu;
+      sched_classes[p->policy]->enqueue(p);
+      release(&p->lock);
+    }
+  }
+  if((p = procheap_pop(h, cpu)) != 0)
+    return p;
+  if((victim = sched_busiest(cpu, load)) < 0)
+    return 0;
+  return procheap_pop(&hs[victim], cpu);
+}
+
+// May p run on hart cpu?
+int
+sched_allowed(struct proc *p, int cpu)
+{
+  return (p->affinity >> cpu) & 1;
+}
+
+// Choose a hart for a process that has never run, or whose
+// last hart it may no longer run on: the online hart in its
+// affinity mask with the smallest load(), counting a running
+// process as one more. Loads are read without locks; the
+// result is only a hint.
+int
+sched_place(struct proc *p, int (*load)(int))
+{
+  int i, l, best = -1, bestload = -1;
+
+  for(i = 0; i < NCPU; i++){
+    if(!cpus[i].online || !sched_allowed(p, i))
+      continue;
+    l = load(i) + (cpus[i].proc != 0);
+    if(bestload < 0 || l < bestload){
+      best = i;
+      bestload = l;
+    }
+  }
+  if(best < 0){
+    // only harts that have not started yet are allowed;
+    // queue it on the first of them.
+    for(best = 0; best < NCPU - 1 && !sched_allowed(p, best); best++)
+      ;
+  }
+  return best;
+}
+
+// The hart other than cpu with the largest non-zero
+// load(), for cpu to steal from, or -1. Like
+// sched_place(), only a hint.
+int
+sched_busiest(int cpu, int (*load)(int))
+{
+  int i, l, victim = -1, most = 0;
+
+  for(i = 0; i < NCPU; i++){
+    if(i != cpu && (l = load(i)) > most){
+      most = l;
+      victim = i;
+    }
+  }
+  return victim;
+}
+
+// Wake an idle hart to run p: the one p last ran on, or was
+// queued on, if it is idle, so p finds its cache and TLB
+// warm; otherwise any idle hart p may run on, which can
+// steal it or take it from a shared queue.
+static void
+sched_kick(struct proc *p)
+{
+  int i;
+
+  // pairs with the barrier in scheduler() between setting
+  // c->idle and looking for work once more.
+  __sync_synchronize();
+
+  if(p->cpu >= 0 && cpus[p->cpu].idle){
+    ipi(p->cpu);
+    return;
+  }
+  for(i = 0; i < NCPU; i++){
+    if(cpus[i].online && cpus[i].idle && sched_allowed(p, i)){
+      ipi(i);
+      return;
+    }
+  }
+}
+
+// Mark p RUNNABLE and hand it to its scheduling class.
+// p->lock must be held.
+void
+setrunnable(struct proc *p)
+{
+  SCHEDTRACE(p->state == RUNNING ? SEV_PREEMPT : p->state == SLEEPING ? SEV_WAKEUP : SEV_NEW, p);
+  p->woken = p->state != RUNNING;
+  p->state = RUNNABLE;
+  p->runnable_since = r_time();
+  sched_classes[p->policy]->enqueue(p);
+
+  // a process that yields goes back on this busy hart's
+  // queue; don't wake another hart to steal it.
+  if(p != myproc())
+    sched_kick(p);
+}
+
+// Ask the classes, in order, for a process for hart id.
+static struct proc*
+sched_pick(int id)
+{
+  struct proc *p = 0;
+  int i;
+
+  for(i = 0; i < NELEM(pick_order) && p == 0; i++)
+    p = pick_order[i]->pick_next(id);
+  return p;
+}
+
+// Charge a RUNNABLE to RUNNING wait of t cycles to p.
+static void
+sched_latency(struct proc *p, uint64 t)
+{
+  int b = 0;
+
+  while(b < NLATBUCKET - 1 && (t >> (b + 1)) != 0)
+    b++;
+  p->lat[b]++;
+  p->waitcycles += t;
+  p->nruns++;
+}
+
+// Per-CPU process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - ask the scheduling classes for a process to run.
+//  - swtch to start running that process.
+//  - eventually that process transfers control
+//    via swtch back to the scheduler.
+void
+scheduler(void)
+{
+  struct proc *p;
+  struct sched_class *sc;
+  struct cpu *c = mycpu();
+  int id = cpuid();
+
+  c->proc = 0;
+  c->online = 1;
+  for(;;){
+    // this hart holds no process it found in procs[].
+    __sync_add_and_fetch(&c->qs, 1);
+
+    // Avoid deadlock by ensuring that devices can interrupt.
+    intr_on();
+    tickupdate();
+
+    if((p = sched_pick(id)) == 0){
+      // nothing to do: zero a page for kzalloc(), then look
+      // again, until the pool is full.
+      if(kzero_fill())
+        continue;
+
+      // still nothing. announce that this hart is idle, then
+      // look once more, so that a concurrent setrunnable()
+      // either is seen here or sees c->idle and sends an IPI.
+      // wfi with interrupts off, so that the IPI can't be
+      // taken and lost between the check and the wfi; wfi
+      // still returns once it is pending.
+      intr_off();
+      c->idle = 1;
+      __sync_synchronize();
+      if((p = sched_pick(id)) == 0){
+        sched_timer(0);
+        wfi();
+      }
+      c->idle = 0;
+      if(p == 0)
+        continue;
+    }
+
+    // p has left its run queue while still RUNNABLE, so no
+    // other hart can pick it. its lock is free as soon as
+    // the hart that queued it has switched away from it.
+    acquire(&p->lock);
+    if(p->state == RUNNABLE){
+      p->cpu = id;
+      sc = sched_classes[p->policy];
+      if(sc->dispatch)
+        sc->dispatch(p, id);
+      SCHEDTRACE(SEV_PICK, p);
+
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      p->state = RUNNING;
+      c->proc = p;
+      p->run_start = r_time();
+      sched_latency(p, p->run_start - p->runnable_since);
+      sched_timer(p);
+      kstack_sfence(p);
+      swtch(&c->context, &p->context);
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      // Charge it for the interval it ran; the clock interrupt
+      // does no per-process accounting.
+      p->rcycles += r_time() - p->run_start;
+      p->rtime = p->rcycles / TICKCYCLES;
+      c->proc = 0;
+    }
+    release(&p->lock);
+  }
+}
+
+// Cycles p has spent running, including the current
+// interval if p is running, here or on another hart. The
+// scheduler charges that interval under p->lock once p has
+// stopped, so the caller holds p->lock or is p.
+uint64
+sched_runtime(struct proc *p)
+{
+  uint64 t = p->rcycles;
+
+  if(p == myproc() || p->state == RUNNING)
+    t += r_time() - p->run_start;
+  return t;
+}
+
+// Called from the timer interrupt with p running.
+// Returns non-zero if p should give up the CPU.
+// Every class makes way for real-time work, and a process
+// whose affinity no longer includes this hart moves.
+int
+sched_tick(struct proc *p)
+{
+  if(!sched_allowed(p, cpuid()))
+    return 1;
+  if(p->policy != SCHED_EDF && edf_ready())
+    return 1;
+  return sched_classes[p->policy]->tick(p);
+}
+
+// Arm this hart's timer for its next scheduling event: the
+// end of the slice of p, the process about to run or
+// running here, and the wakeup of tick sleepers if this
+// hart keeps it. A class without a slice op wants a tick
+// every TICKCYCLES; one whose slice is 0, like FCFS, and an
+// idle hart take no timer interrupts at all, unless EDF
+// work is admitted and needs ticks to be released.
+void
+sched_timer(struct proc *p)
+{
+  struct sched_class *sc;
+  uint64 now, s = 0, next = ~0ULL, due;
+
+  push_off();
+  now = r_time();
+  if(p){
+    sc = sched_classes[p->policy];
+    s = sc->slice ? sc->slice(p) : TICKCYCLES;
+  }
+  if(edf_active() && (s == 0 || s > TICKCYCLES))
+    s = TICKCYCLES;
+  if(s)
+    next = now + s;
+  if((due = twheel_due(cpuid())) < next)
+    next = due;
+  timer_set(next);
+  pop_off();
+}
+
+static int
+pick_rank(struct sched_class *sc)
+{
+  int i;
+
+  for(i = 0; i < NELEM(pick_order); i++)
+    if(pick_order[i] == sc)
+      break;
+  return i;
+}
+
+// p has just been created, or has had its priority
+// changed, while the current process runs. Returns
+// non-zero if the current process should yield to it.
+int
+sched_yield_check(struct proc *p)
+{
+  struct proc *cur = myproc();
+  struct sched_class *sc, *cursc;
+
+  if(cur == 0 || cur == p)
+    return 0;
+  sc = sched_classes[p->policy];
+  cursc = sched_classes[cur->policy];
+  if(sc != cursc)
+    return pick_rank(sc) < pick_rank(cursc);
+  if(sc->yield_check)
+    return sc->yield_check(cur, p);
+  return 0;
+}
+
+// Move p to scheduling class policy.
+// p->lock must be held.
+void
+sched_setclass(struct proc *p, int policy)
+{
+  struct sched_class *sc = sched_classes[policy];
+
+  if(p->policy == policy)
+    return;
+  if(sched_classes[p->policy]->switched_from)
+    sched_classes[p->policy]->switched_from(p);
+
+  // leave a RUNNABLE process alone if a hart has already
+  // taken it off its queue; it is about to run, and joins
+  // the new class next time it becomes RUNNABLE.
+  if(p->state == RUNNABLE && sched_classes[p->policy]->dequeue(p)){
+    p->policy = policy;
+    if(sc->switched_to)
+      sc->switched_to(p);
+    sc->enqueue(p);
+  } else {
+    p->policy = policy;
+    if(sc->switched_to)
+      sc->switched_to(p);
+  }
+}
+
+// p is exiting. p->lock must be held.
+void
+sched_exit(struct proc *p)
+{
+  SCHEDTRACE(SEV_EXIT, p);
+  if(sched_classes[p->policy]->switched_from)
+    sched_classes[p->policy]->switched_from(p);
+}
+
+// Copy out the scheduling statistics of process pid, or
+// of the caller if pid is 0, to user address addr.
+int
+sched_stats(int pid, uint64 addr)
+{
+  struct proc *p;
+  struct schedstat st;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  st.pid = p->pid;
+  st.policy = p->policy;
+  st.rcycles = sched_runtime(p);
+  st.waitcycles = p->waitcycles;
+  if(p->state == RUNNABLE)
+    st.waitcycles += r_time() - p->runnable_since;
+  st.nruns = p->nruns;
+  st.nvcsw = p->nvcsw;
+  st.nivcsw = p->nivcsw;
+  memmove(st.lat, p->lat, sizeof(st.lat));
+  release(&p->lock);
+  return copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st));
+}
+
+// Set the affinity mask of process pid, or of the caller if
+// pid is 0, to mask (bit i is hart i). mask 0 only reads it.
+// Returns the old mask, or -1 if there is no such process
+// or mask has no hart that is running.
+int
+sched_setaffinity_i(int pid, int mask)
+{
+  struct proc *p, *me = myproc();
+  int i, old = -1, move = 0;
+
+  mask &= (1 << NCPU) - 1;
+  if(mask){
+    for(i = 0; i < NCPU; i++)
+      if(((mask >> i) & 1) && cpus[i].online)
+        break;
+    if(i == NCPU)
+      return -1;
+  }
+  if(pid == 0)
+    pid = me->pid;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  if(p->state != ZOMBIE){
+    old = p->affinity;
+    if(mask){
+      p->affinity = mask;
+      // requeue a process waiting on a per-cpu queue of a
+      // hart it may no longer use; enqueue places it anew.
+      if(p->state == RUNNABLE && p->cpu >= 0 && !sched_allowed(p, p->cpu) &&
+         sched_classes[p->policy]->dequeue(p))
+        sched_classes[p->policy]->enqueue(p);
+      move = p == me && !sched_allowed(p, cpuid());
+      // one running on a hart it may no longer use moves on
+      // that hart's next tick; it may not be ticking.
+      if(p->state == RUNNING && p != me && !sched_allowed(p, p->cpu))
+        timer_kick(p->cpu);
+    }
+  }
+  release(&p->lock);
+  if(move)
+    yield();
+  return old;
+}
+
+// Set the scheduling class of process pid, or of every
+// process and all future ones if pid is 0. pid 0 leaves
+// kernel processes, exited ones and EDF reservations alone.
+// Returns the previous policy, or -1. Only
+// sched_deadline() admits processes to SCHED_EDF.
+int
+set_policy_i(int policy, int pid)
+{
+  struct proc *p;
+  int old = -1;
+
+  if(policy < 0 || policy >= NSCHED || policy == SCHED_EDF)
+    return -1;
+
+  if(pid == 0){
+    old = sched_default;
+    sched_default = policy;
+    for(int i = 0; i < nproc; i++){
+      if((p = slotproc(i)) == 0)
+        continue;
+      if(p->state != UNUSED && p->state != ZOMBIE && p->kfn == 0 &&
+         p->policy != SCHED_EDF)
+        sched_setclass(p, policy);
+      release(&p->lock);
+    }
+    return old;
+  }
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  if(p->state != ZOMBIE){
+    old = p->policy;
+    sched_setclass(p, policy);
+  }
+  release(&p->lock);
+  return old;
+}
@@ -0,0 +1,39 @@
+// Scheduling policies, for set_policy().
+#define SCHED_DEFAULT 0  // round robin
+#define SCHED_FCFS    1  // first come first serve
+#define SCHED_PBS     2  // priority based
+#define SCHED_MLFQ    3  // multi-level feedback queue
+#define SCHED_CFS     4  // completely fair, by weighted run time
+#define SCHED_EDF     5  // earliest deadline first, see sched_deadline()
+#define SCHED_STRIDE  6  // proportional share, see set_tickets()
+#define NSCHED        7
+
+// Scheduling statistics of a live process, for schedstat().
+// Times are in time CSR cycles. lat[i] counts the waits
+// from RUNNABLE to RUNNING of 2^i to 2^(i+1)-1 cycles; the
+// last bucket also holds everything longer.
+// Needs kernel/types.h and kernel/param.h.
+struct schedstat {
+  int pid;
+  int policy;
+  uint64 rcycles;              // total time RUNNING
+  uint64 waitcycles;           // total time RUNNABLE
+  uint nruns;                  // times dispatched
+  uint nvcsw;                  // voluntary switches (sleep)
+  uint nivcsw;                 // involuntary switches (preempted, yield)
+  uint lat[NLATBUCKET];
+};
+
+// MLFQ tunables, for mlfqparam(). Only queues 0..nlevel-1
+// are used; slices are time CSR cycles of run time a
+// process may use at a level, across sleeps, before it is
+// demoted. The aging thresholds (maxwait[0] is unused) and
+// the boost period, which moves every process to queue 0,
+// are in ticks. boost 0 means no periodic boost.
+// Needs kernel/types.h and kernel/param.h.
+struct mlfqparam {
+  int nlevel;                  // 1..NMLFQ
+  uint64 slice[NMLFQ];
+  uint maxwait[NMLFQ];
+  uint boost;
+};
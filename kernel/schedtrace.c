@@ -0,0 +1,123 @@
+// Scheduling event rings.
+//
+// While schedtrace(1) has it on, the scheduler appends a
+// compact record for every pick, preemption, sleep, wakeup,
+// priority change and exit to the ring of the hart it runs
+// on. Like the syscall trace rings in trace.c, each ring has
+// a single writer, its hart with interrupts off, so writers
+// take no lock; a full ring drops the record and counts it.
+// schedtrace_read() drains the rings into user memory.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "schedtrace.h"
+#include "defs.h"
+
+#define NSCHEDEV 1024               // records per cpu, power of 2
+
+struct schedring {
+  volatile uint head;               // next slot to write, writer only
+  volatile uint tail;               // next slot to read, readers only
+  uint dropped;                     // records lost to a full ring
+  struct schedev ev[NSCHEDEV];
+};
+
+struct schedring schedrings[NCPU];
+
+int schedtrace_on;
+
+// serializes readers; writers never take it.
+struct spinlock schedtracelock;
+
+void
+schedtraceinit(void)
+{
+  initlock(&schedtracelock, "schedtrace");
+}
+
+// Turn logging on or off; returns whether it was on.
+int
+schedtrace(int on)
+{
+  int old = schedtrace_on;
+
+  schedtrace_on = on != 0;
+  return old;
+}
+
+// Log event type for p. Cheap when logging is off; callers
+// test schedtrace_on first through the SCHEDTRACE macro in
+// defs.h. p->lock is usually held, so this takes no locks.
+void
+schedtrace_log(int type, struct proc *p)
+{
+  struct schedring *r;
+  struct schedev *e;
+
+  push_off();
+  r = &schedrings[cpuid()];
+  if(r->head - r->tail >= NSCHEDEV){
+    __sync_fetch_and_add(&r->dropped, 1);
+    pop_off();
+    return;
+  }
+  e = &r->ev[r->head % NSCHEDEV];
+  e->time = r_time();
+  e->tick = ticks;
+  e->pid = p->pid;
+  e->type = type;
+  e->cpu = cpuid();
+  e->policy = p->policy;
+  e->queue = p->priority_number;
+  e->prio = p->Static_priority;
+  // the record must be complete before a reader sees it.
+  __sync_synchronize();
+  r->head++;
+  pop_off();
+}
+
+// Copy up to n records, from all harts, to user address
+// addr. A ring that dropped records first yields a record
+// with pid -1 and the count in tick. Returns the number of
+// records.
+int
+schedtrace_read(uint64 addr, int n)
+{
+  struct proc *me = myproc();
+  struct schedring *r;
+  struct schedev lost;
+  uint h, t;
+  int got = 0;
+
+  acquire(&schedtracelock);
+  for(r = schedrings; r < &schedrings[NCPU] && got < n; r++){
+    if(r->dropped){
+      memset(&lost, 0, sizeof(lost));
+      lost.pid = -1;
+      lost.cpu = r - schedrings;
+      lost.tick = __sync_lock_test_and_set(&r->dropped, 0);
+      if(copyout(me->pagetable, addr + got*sizeof(lost), (char*)&lost, sizeof(lost)) < 0)
+        break;
+      got++;
+    }
+    h = r->head;
+    // read the records only after seeing head.
+    __sync_synchronize();
+    for(t = r->tail; t != h && got < n; t++, got++){
+      if(copyout(me->pagetable, addr + got*sizeof(struct schedev),
+                 (char*)&r->ev[t % NSCHEDEV], sizeof(struct schedev)) < 0)
+        break;
+    }
+    // done with the slots before the writer may reuse them.
+    __sync_synchronize();
+    r->tail = t;
+    if(t != h)
+      break;
+  }
+  release(&schedtracelock);
+  return got;
+}
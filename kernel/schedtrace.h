@@ -0,0 +1,23 @@
+// Scheduling event records, read with schedtrace_read().
+// user/schedlog.c prints them, mkfs/schedsim.c replays them.
+// Needs kernel/types.h.
+
+#define SEV_NEW     1  // p became RUNNABLE for the first time
+#define SEV_PICK    2  // a hart dispatched p
+#define SEV_PREEMPT 3  // p went from RUNNING back to RUNNABLE
+#define SEV_SLEEP   4  // p blocked
+#define SEV_WAKEUP  5  // p went from SLEEPING to RUNNABLE
+#define SEV_PRIO    6  // p's static priority or MLFQ queue changed
+#define SEV_EXIT    7  // p exited
+#define NSEV        8
+
+struct schedev {
+  uint64 time;                 // time CSR
+  uint tick;
+  int pid;                     // -1: lost records, count in tick
+  uchar type;                  // SEV_*
+  uchar cpu;                   // hart that logged it
+  uchar policy;                // SCHED_* in sched.h
+  uchar queue;                 // MLFQ queue
+  short prio;                  // PBS static priority
+};
@@ -0,0 +1,207 @@
+// Slab allocator for small kernel objects.
+//
+// A kcache hands out objects of one size. They are carved
+// out of slabs of 2^order pages from kallocn(), with a
+// struct slab at the start of each; slabs are aligned to
+// their size, so an object's slab is found by rounding its
+// address down. Slabs with free objects are on the cache's
+// partial list; a slab that becomes empty goes back to
+// kalloc unless it is the only partial one.
+//
+// Every cpu has a magazine of up to KMAG free objects in
+// front of the slabs. kcache_alloc() and kcache_free() only
+// take the cache lock to move KMAG/2 objects between the
+// magazine and the slabs.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "slab.h"
+#include "defs.h"
+
+struct slab {
+  struct slab *next, *prev;         // on the partial list
+  struct kcache *cache;
+  void *free;                       // free objects, linked by first word
+  int inuse;
+};
+
+// every cache, for kcachedump(). only added to while
+// booting, before other harts start.
+struct kcache *kcaches;
+
+// Set up cache c for objects of size bytes; slabs are the
+// smallest blocks that hold at least 8 of them.
+// Only called while booting.
+void
+kcache_init(struct kcache *c, char *name, uint size)
+{
+  initlock(&c->lock, name);
+  c->name = name;
+  c->size = (size + 7) & ~7;
+  for(c->order = 0; c->order < MAXORDER; c->order++)
+    if(((PGSIZE << c->order) - sizeof(struct slab)) / c->size >= 8)
+      break;
+  c->perslab = ((PGSIZE << c->order) - sizeof(struct slab)) / c->size;
+  if(c->perslab == 0)
+    panic("kcache_init: size");
+  c->partial = 0;
+  c->nslab = 0;
+  c->inuse = 0;
+  for(int i = 0; i < NCPU; i++)
+    c->mag[i].n = 0;
+  c->next = kcaches;
+  kcaches = c;
+}
+
+static void
+slab_link(struct kcache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(s->next)
+    s->next->prev = s;
+  c->partial = s;
+}
+
+static void
+slab_unlink(struct kcache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// A new slab with all objects free, on the partial list.
+// Caller holds c->lock.
+static struct slab*
+slab_grow(struct kcache *c)
+{
+  struct slab *s;
+  char *o;
+
+  if((s = kallocn(c->order)) == 0)
+    return 0;
+  s->cache = c;
+  s->inuse = 0;
+  s->free = 0;
+  o = (char*)s + ((sizeof(struct slab) + 7) & ~7);
+  for(int i = 0; i < c->perslab && o + c->size <= (char*)s + (PGSIZE << c->order); i++, o += c->size){
+    *(void**)o = s->free;
+    s->free = o;
+  }
+  slab_link(c, s);
+  c->nslab++;
+  return s;
+}
+
+// Take an object out of the slabs. Caller holds c->lock.
+static void*
+slab_get(struct kcache *c)
+{
+  struct slab *s;
+  void *o;
+
+  if((s = c->partial) == 0 && (s = slab_grow(c)) == 0)
+    return 0;
+  o = s->free;
+  s->free = *(void**)o;
+  s->inuse++;
+  c->inuse++;
+  if(s->free == 0)
+    slab_unlink(c, s);
+  return o;
+}
+
+// Put an object back into its slab. Caller holds c->lock.
+static void
+slab_put(struct kcache *c, void *o)
+{
+  struct slab *s = (struct slab*)((uint64)o & ~((uint64)(PGSIZE << c->order) - 1));
+
+  if(s->cache != c)
+    panic("kcache_free: wrong cache");
+  if(s->free == 0)
+    slab_link(c, s);
+  *(void**)o = s->free;
+  s->free = o;
+  s->inuse--;
+  c->inuse--;
+  if(s->inuse == 0 && (s->prev || s->next)){
+    slab_unlink(c, s);
+    c->nslab--;
+    kfreen(s, c->order);
+  }
+}
+
+// Allocate an object from c, or return 0. Its contents are
+// whatever the last user left.
+void*
+kcache_alloc(struct kcache *c)
+{
+  struct kmag *m;
+  void *o = 0;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&c->lock);
+    while(m->n < KMAG/2 && (o = slab_get(c)) != 0)
+      m->obj[m->n++] = o;
+    release(&c->lock);
+  }
+  if(m->n > 0)
+    o = m->obj[--m->n];
+  pop_off();
+  return o;
+}
+
+// Return object o to c.
+void
+kcache_free(struct kcache *c, void *o)
+{
+  struct kmag *m;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == KMAG){
+    acquire(&c->lock);
+    while(m->n > KMAG/2)
+      slab_put(c, m->obj[--m->n]);
+    release(&c->lock);
+  }
+  m->obj[m->n++] = o;
+  pop_off();
+}
+
+// Return object o to its slab past the magazine, so that a
+// slab it empties goes back to kalloc at once. For big
+// objects that are freed in bursts, like struct proc.
+void
+kcache_release(struct kcache *c, void *o)
+{
+  acquire(&c->lock);
+  slab_put(c, o);
+  release(&c->lock);
+}
+
+// Print every cache's usage, for ^P.
+void
+kcachedump(void)
+{
+  struct kcache *c;
+  int cached;
+
+  for(c = kcaches; c; c = c->next){
+    cached = 0;
+    for(int i = 0; i < NCPU; i++)
+      cached += c->mag[i].n;
+    printf("cache %s: size %d, %d slabs of %d pages, %d in use\n",
+           c->name, c->size, c->nslab, 1 << c->order, c->inuse - cached);
+  }
+}
@@ -0,0 +1,23 @@
+// Object caches on top of kallocn(), see slab.c.
+// Needs spinlock.h and param.h.
+
+#define KMAG 16                     // objects in a per-cpu magazine
+
+// A cpu's stack of free objects, used with interrupts off.
+struct kmag {
+  int n;
+  void *obj[KMAG];
+};
+
+struct kcache {
+  struct spinlock lock;             // protects the slab lists
+  char *name;
+  uint size;                        // object size, 8-byte aligned
+  int order;                        // slabs are 2^order pages
+  int perslab;                      // objects in a slab
+  struct slab *partial;             // slabs with free objects
+  int nslab;                        // slabs allocated
+  int inuse;                        // objects not in a slab free list
+  struct kcache *next;              // on the list for kcachedump()
+  struct kmag mag[NCPU];
+};
@@ -1,4 +1,15 @@
 // Sleeping locks
+//
+// Under PBS a sleeplock lends the priority of a PBS process
+// waiting for it to the holder (p->pi_prio, which
+// PSBPriority() honours), so a low priority holder is not
+// starved by processes of medium priority while a high
+// priority one waits. The holder keeps the best priority
+// lent until it has released every lock that lent one
+// (p->pi_locks). Inheritance is not passed on to a holder
+// the holder itself waits for. The holder is looked up by
+// lk->pid, since it may have exited and been reaped while an
+// I/O it started still holds the lock.
 
 #include "types.h"
 #include "riscv.h"
@@ -7,6 +18,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 #include "sleeplock.h"
 
 void
@@ -16,24 +28,77 @@ initsleeplock(struct sleeplock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+  lk->boost = PI_NONE;
+}
+
+// Lend waiter w's priority to the holder of lk.
+// lk->lk must be held.
+static void
+lend(struct sleeplock *lk, struct proc *w)
+{
+  struct proc *h;
+  int prio;
+
+  if(lk->pid == w->pid || w->policy != SCHED_PBS)
+    return;
+  prio = w->pi_prio < w->dynamic_priority ? w->pi_prio : w->dynamic_priority;
+  if(prio >= lk->boost)
+    return;
+
+  if((h = findproc(lk->pid)) == 0)
+    return;
+  if(lk->boost == PI_NONE)
+    h->pi_locks++;
+  lk->boost = prio;
+  if(prio < h->pi_prio){
+    h->pi_prio = prio;
+    if(h->policy == SCHED_PBS)
+      sched_classes[SCHED_PBS]->prio_changed(h);
+  }
+  release(&h->lock);
+}
+
+// lk, which lent a priority, is being released.
+// lk->lk must be held.
+static void
+unlend(struct sleeplock *lk)
+{
+  struct proc *h;
+
+  if((h = findproc(lk->pid)) != 0){
+    if(h->pi_locks > 0 && --h->pi_locks == 0){
+      h->pi_prio = PI_NONE;
+      if(h->policy == SCHED_PBS)
+        sched_classes[SCHED_PBS]->prio_changed(h);
+    }
+    release(&h->lock);
+  }
+  lk->boost = PI_NONE;
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  struct proc *p = myproc();
+
   acquire(&lk->lk);
   while (lk->locked) {
+    lend(lk, p);
     sleep(lk, &lk->lk);
   }
   lk->locked = 1;
-  lk->pid = myproc()->pid;
+  lk->pid = p->pid;
   release(&lk->lk);
 }
 
+// May be called by another process than the holder, or
+// from an interrupt (bdone()).
 void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+  if(lk->boost != PI_NONE)
+    unlend(lk);
   lk->locked = 0;
   lk->pid = 0;
   wakeup(lk);
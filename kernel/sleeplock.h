@@ -6,5 +6,8 @@ struct sleeplock {
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+
+  // Priority inheritance, under PBS: see sleeplock.c.
+  int boost;         // Best priority lent to holder, PI_NONE if none
 };
 
@@ -8,11 +8,51 @@
 #include "proc.h"
 #include "defs.h"
 
+#define NLOCKCLASS 64
+
+// Locks are counted by name, so the hundreds of "proc" or
+// "sleep lock" locks show up as one line. Each cpu counts in
+// its own row, with interrupts off, so acquire() adds no
+// shared writes. Class 0 takes the names that don't fit.
+static char *classnames[NLOCKCLASS] = { "other" };
+static int nclass = 1;
+static uint classlock;
+struct lockstat lockstats[NCPU][NLOCKCLASS];
+
+// The statistics class of locks called name.
+static int
+lockclass(char *name)
+{
+  int c;
+
+  push_off();
+  while(__sync_lock_test_and_set(&classlock, 1) != 0)
+    ;
+  for(c = 1; c < nclass; c++)
+    if(classnames[c] == name || strncmp(classnames[c], name, 32) == 0)
+      break;
+  if(c == nclass){
+    if(nclass < NLOCKCLASS)
+      classnames[nclass++] = name;
+    else
+      c = 0;
+  }
+  __sync_lock_release(&classlock);
+  pop_off();
+  return c;
+}
+
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
+#ifdef TASLOCK
   lk->locked = 0;
+#else
+  lk->next = 0;
+  lk->owner = 0;
+#endif
+  lk->class = lockclass(name);
   lk->cpu = 0;
 }
 
@@ -21,16 +61,39 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  struct lockstat *st;
+  uint64 start;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
+  st = &lockstats[cpuid()][lk->class];
 
+#ifdef TASLOCK
   // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  if(__sync_lock_test_and_set(&lk->locked, 1) != 0){
+    start = r_time();
+    while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+      ;
+    st->ncontended++;
+    st->spincycles += r_time() - start;
+  }
+#else
+  // Take a ticket with one amoadd.w, then wait with plain
+  // loads, which leave the line shared until release()
+  // stores to it, instead of every waiter writing it.
+  uint t = __sync_fetch_and_add(&lk->next, 1);
+  if(__atomic_load_n(&lk->owner, __ATOMIC_RELAXED) != t){
+    start = r_time();
+    while(__atomic_load_n(&lk->owner, __ATOMIC_RELAXED) != t)
+      ;
+    st->ncontended++;
+    st->spincycles += r_time() - start;
+  }
+#endif
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +103,7 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+  st->nacquire++;
 }
 
 // Release the lock.
@@ -59,6 +123,7 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
+#ifdef TASLOCK
   // Release the lock, equivalent to lk->locked = 0.
   // This code doesn't use a C assignment, since the C standard
   // implies that an assignment might be implemented with
@@ -67,6 +132,11 @@ release(struct spinlock *lk)
   //   s1 = &lk->locked
   //   amoswap.w zero, zero, (s1)
   __sync_lock_release(&lk->locked);
+#else
+  // Serve the next ticket. Only the holder writes owner, so
+  // this needs no atomic read-modify-write, just one store.
+  __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
+#endif
 
   pop_off();
 }
@@ -77,10 +147,46 @@ int
 holding(struct spinlock *lk)
 {
   int r;
+#ifdef TASLOCK
   r = (lk->locked && lk->cpu == mycpu());
+#else
+  r = (lk->owner != lk->next && lk->cpu == mycpu());
+#endif
   return r;
 }
 
+// Print the lock classes that were contended, most spun
+// first, for ^P.
+void
+lockdump(void)
+{
+  static struct lockstat sum[NLOCKCLASS];   // off the stack: ^P runs in an interrupt
+  static int order[NLOCKCLASS];
+  int n = 0, i, j, c;
+
+  memset(sum, 0, sizeof(sum));
+  for(i = 0; i < NCPU; i++){
+    for(c = 0; c < nclass; c++){
+      sum[c].nacquire += lockstats[i][c].nacquire;
+      sum[c].ncontended += lockstats[i][c].ncontended;
+      sum[c].spincycles += lockstats[i][c].spincycles;
+    }
+  }
+  for(c = 0; c < nclass; c++){
+    if(sum[c].ncontended == 0)
+      continue;
+    for(j = n++; j > 0 && sum[order[j-1]].spincycles < sum[c].spincycles; j--)
+      order[j] = order[j-1];
+    order[j] = c;
+  }
+  printf("locks: %d classes, %d contended\n", nclass, n);
+  for(i = 0; i < n; i++){
+    c = order[i];
+    printf("  %s: %d acquires, %d contended, %d kcycles spun\n", classnames[c],
+           (int)sum[c].nacquire, (int)sum[c].ncontended, (int)(sum[c].spincycles / 1000));
+  }
+}
+
 // push_off/pop_off are like intr_off()/intr_on() except that they are matched:
 // it takes two pop_off()s to undo two push_off()s.  Also, if interrupts
 // are initially off, then push_off, pop_off leaves them off.
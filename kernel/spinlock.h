@@ -1,9 +1,24 @@
-// Mutual exclusion lock.
+// Mutual exclusion lock. A ticket lock: a cpu takes the next
+// ticket and spins until owner reaches it, so waiters get
+// the lock in the order they came. Built with TASLOCK, the
+// old test-and-set lock on locked instead.
 struct spinlock {
+#ifdef TASLOCK
   uint locked;       // Is the lock held?
+#else
+  uint next;         // Next ticket to hand out
+  uint owner;        // Ticket being served; held if != next
+#endif
+  int class;         // Statistics slot, by name; see initlock()
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
 };
 
+// Lock statistics of one class of locks on one cpu.
+struct lockstat {
+  uint64 nacquire;   // acquire() calls
+  uint64 ncontended; // that found the lock held
+  uint64 spincycles; // time CSR cycles they spun
+};
@@ -0,0 +1,158 @@
+// Stride scheduling class (SCHED_STRIDE).
+//
+// Proportional share: a process holds tickets (set_tickets)
+// and gets the cpu in proportion to them. Its stride is
+// STRIDE1/tickets, and its pass grows by the stride for
+// every tick's worth of cycles it runs. The RUNNABLE
+// process with the smallest pass runs next, from a heap.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define STRIDE1 (1 << 20)
+
+struct procheap stride;
+
+// pass of the process dispatched last; never decreases.
+// a process joining or waking starts no lower, so it can't
+// claim the cpu for the time it was away. Harts pick at the
+// same time, so it is read and raised under stride.lock.
+uint64 global_pass;
+
+static uint64
+stride_global_pass(void)
+{
+  uint64 pass;
+
+  acquire(&stride.lock);
+  pass = global_pass;
+  release(&stride.lock);
+  return pass;
+}
+
+// positive if q has the smaller pass.
+static int
+stride_cmp(struct proc *p, struct proc *q)
+{
+  if(p->pass != q->pass)
+    return p->pass > q->pass ? 1 : -1;
+  return p->pid > q->pid ? 1 : -1;
+}
+
+static void
+stride_init(void)
+{
+  procheap_init(&stride, "stride", stride_cmp);
+}
+
+// p->stride caches STRIDE1/p->tickets; 0 until first used.
+static uint64
+stride_of(struct proc *p)
+{
+  if(p->stride == 0)
+    p->stride = STRIDE1 / p->tickets;
+  return p->stride;
+}
+
+// Add the run time not yet charged to p's pass.
+static void
+stride_charge(struct proc *p)
+{
+  uint64 now = sched_runtime(p);
+
+  p->pass += (now - p->stride_charged) * stride_of(p) / TICKCYCLES;
+  p->stride_charged = now;
+}
+
+// A preempted process keeps its pass, and with it the credit
+// it earned while global_pass moved on under other harts.
+static void
+stride_enqueue(struct proc *p)
+{
+  uint64 pass;
+
+  stride_charge(p);
+  if(p->woken && p->pass < (pass = stride_global_pass()))
+    p->pass = pass;
+  procheap_push(&stride, p);
+}
+
+static int
+stride_dequeue(struct proc *p)
+{
+  return procheap_remove(&stride, p);
+}
+
+static struct proc*
+stride_pick_next(int cpu)
+{
+  struct proc *p;
+
+  if((p = procheap_pop(&stride, cpu)) != 0){
+    acquire(&stride.lock);
+    if(p->pass > global_pass)
+      global_pass = p->pass;
+    release(&stride.lock);
+  }
+  return p;
+}
+
+// p's pass including the run time not yet charged.
+static uint64
+stride_curpass(struct proc *p)
+{
+  return p->pass + (sched_runtime(p) - p->stride_charged) * stride_of(p) / TICKCYCLES;
+}
+
+// Yield once a waiting process has a smaller pass.
+static int
+stride_tick(struct proc *p)
+{
+  int preempt;
+
+  acquire(&stride.lock);
+  preempt = stride.n > 0 && stride.heap[0]->pass < stride_curpass(p);
+  release(&stride.lock);
+  return preempt;
+}
+
+static int
+stride_yield_check(struct proc *cur, struct proc *p)
+{
+  return p->pass < stride_curpass(cur);
+}
+
+// The new stride only applies to future run time; a queued
+// process keeps its pass and so its place in the heap.
+static void
+stride_prio_changed(struct proc *p)
+{
+  if(p->heap_index < 0)
+    stride_charge(p);
+  p->stride = STRIDE1 / p->tickets;
+}
+
+static void
+stride_switched_to(struct proc *p)
+{
+  p->stride = STRIDE1 / p->tickets;
+  p->stride_charged = sched_runtime(p);
+  p->pass = stride_global_pass();
+}
+
+struct sched_class stride_class = {
+  .name = "stride",
+  .init = stride_init,
+  .enqueue = stride_enqueue,
+  .dequeue = stride_dequeue,
+  .pick_next = stride_pick_next,
+  .tick = stride_tick,
+  .yield_check = stride_yield_check,
+  .prio_changed = stride_prio_changed,
+  .switched_to = stride_switched_to,
+};
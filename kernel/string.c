@@ -4,8 +4,15 @@ void*
 memset(void *dst, int c, uint n)
 {
   char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
+  uint64 w = (uchar)c * 0x0101010101010101UL;
+  int i = 0;
+
+  // 8 bytes at a time from the first aligned one.
+  for(; i < n && ((uint64)(cdst + i) & 7); i++)
+    cdst[i] = c;
+  for(; i + 8 <= n; i += 8)
+    *(uint64*)(cdst + i) = w;
+  for(; i < n; i++){
     cdst[i] = c;
   }
   return dst;
@@ -38,14 +45,33 @@ memmove(void *dst, const void *src, uint n)
   
   s = src;
   d = dst;
+  // if s and d are equally misaligned, move 8 bytes at a
+  // time once they are aligned; copyin/copyout and whole
+  // pages go this way.
   if(s < d && s + n > d){
     s += n;
     d += n;
+    if((((uint64)s ^ (uint64)d) & 7) == 0){
+      for(; n > 0 && ((uint64)d & 7); n--)
+        *--d = *--s;
+      for(; n >= 8; n -= 8){
+        d -= 8;
+        s -= 8;
+        *(uint64*)d = *(const uint64*)s;
+      }
+    }
     while(n-- > 0)
       *--d = *--s;
-  } else
+  } else {
+    if((((uint64)s ^ (uint64)d) & 7) == 0){
+      for(; n > 0 && ((uint64)d & 7); n--)
+        *d++ = *s++;
+      for(; n >= 8; n -= 8, d += 8, s += 8)
+        *(uint64*)d = *(const uint64*)s;
+    }
     while(n-- > 0)
       *d++ = *s++;
+  }
 
   return dst;
 }
@@ -5,13 +5,15 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "syscall.h"
+#include "trace.h"
+#include "sysprof.h"
 #include "defs.h"
 
 // Fetch the uint64 at addr from the current process.
 int
 fetchaddr(uint64 addr, uint64 *ip)
 {
-  struct proc *p = myproc();
+  struct proc *p = myproc()->group;   // a thread's memory is its group's
   if(addr >= p->sz || addr+sizeof(uint64) > p->sz)
     return -1;
   if(copyin(p->pagetable, (char *)ip, addr, sizeof(*ip)) != 0)
@@ -107,6 +109,34 @@ extern uint64 sys_uptime(void);
 extern uint64 sys_trace(void);
 extern uint64 sys_set_priority(void);
 extern uint64 sys_waitx(void);
+extern uint64 sys_set_policy(void);
+extern uint64 sys_sched_deadline(void);
+extern uint64 sys_schedstat(void);
+extern uint64 sys_traceread(void);
+extern uint64 sys_sysprof(void);
+extern uint64 sys_sched_setaffinity(void);
+extern uint64 sys_set_tickets(void);
+extern uint64 sys_spawn(void);
+extern uint64 sys_mmap(void);
+extern uint64 sys_munmap(void);
+extern uint64 sys_memstat(void);
+extern uint64 sys_sync(void);
+extern uint64 sys_splice(void);
+extern uint64 sys_readv(void);
+extern uint64 sys_writev(void);
+extern uint64 sys_ring_enter(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_procsnap(void);
+extern uint64 sys_waitx_ns(void);
+extern uint64 sys_clock_gettime(void);
+extern uint64 sys_mlfqparam(void);
+extern uint64 sys_lseek(void);
+extern uint64 sys_sched_yield(void);
+extern uint64 sys_schedtrace(void);
+extern uint64 sys_schedtrace_read(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -132,34 +162,138 @@ static uint64 (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_trace]   sys_trace,
 [SYS_set_priority] sys_set_priority,
-[SYS_waitx]   sys_waitx
+[SYS_waitx]   sys_waitx,
+[SYS_set_policy] sys_set_policy,
+[SYS_sched_deadline] sys_sched_deadline,
+[SYS_schedstat] sys_schedstat,
+[SYS_traceread] sys_traceread,
+[SYS_sysprof] sys_sysprof,
+[SYS_sched_setaffinity] sys_sched_setaffinity,
+[SYS_set_tickets] sys_set_tickets,
+[SYS_spawn]   sys_spawn,
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
+[SYS_memstat] sys_memstat,
+[SYS_sync]    sys_sync,
+[SYS_splice]  sys_splice,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_ring_enter] sys_ring_enter,
+[SYS_clone]   sys_clone,
+[SYS_join]    sys_join,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_procsnap] sys_procsnap,
+[SYS_waitx_ns] sys_waitx_ns,
+[SYS_clock_gettime] sys_clock_gettime,
+[SYS_mlfqparam] sys_mlfqparam,
+[SYS_lseek]   sys_lseek,
+[SYS_sched_yield] sys_sched_yield,
+[SYS_schedtrace] sys_schedtrace,
+[SYS_schedtrace_read] sys_schedtrace_read,
 };
 
+// Syscall count and time, per cpu, so updating them takes
+// no lock. sysprof() adds them up.
+struct sysprof sysprofs[NCPU][NSYSCALL];
+
+
+// Charge a call to syscall num of t cycles by p.
+static void
+sysprof_charge(struct proc *p, int num, uint64 t)
+{
+  struct sysprof *s;
+
+  push_off();
+  s = &sysprofs[cpuid()][num];
+  s->count++;
+  s->cycles += t;
+  if(t > s->max)
+    s->max = t;
+  pop_off();
+
+  p->sccount[num]++;
+  p->sccycles[num] += t;
+}
+
+// Copy the profile of syscalls 0..n-1 to user address addr:
+// summed over all cpus if pid is -1, otherwise of process
+// pid, or of the caller if pid is 0.
+// Returns the number of entries copied, or -1.
+int
+sysprof_read(int pid, uint64 addr, int n)
+{
+  struct proc *me = myproc(), *p;
+  struct sysprof s;
+  int i, c;
+
+  if(n > NSYSCALL)
+    n = NSYSCALL;
+  if(pid == 0)
+    pid = me->pid;
+
+  if(pid == -1){
+    for(i = 0; i < n; i++){
+      memset(&s, 0, sizeof(s));
+      for(c = 0; c < NCPU; c++){
+        s.count += sysprofs[c][i].count;
+        s.cycles += sysprofs[c][i].cycles;
+        if(sysprofs[c][i].max > s.max)
+          s.max = sysprofs[c][i].max;
+      }
+      if(copyout(me->pagetable, addr + i*sizeof(s), (char*)&s, sizeof(s)) < 0)
+        return -1;
+    }
+    return n;
+  }
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  // p->lock is held, so p can't be freed; p updates its own
+  // counters without it, which at worst makes them a call stale.
+  for(i = 0; i < n; i++){
+    s.count = p->sccount[i];
+    s.cycles = p->sccycles[i];
+    s.max = 0;
+    if(copyout(me->pagetable, addr + i*sizeof(s), (char*)&s, sizeof(s)) < 0){
+      release(&p->lock);
+      return -1;
+    }
+  }
+  release(&p->lock);
+  return n;
+}
+
 void
 syscall(void)
 {
-  static char SystemcallNames[25][50] = {
-  {" "}, {"fork"}, {"exit"}, {"wait"}, {"pipe"}, {"read"}, {"kill"}, {"exec"}, {"fstat"}, {"chdir"}, {"dup"}, {"getpid"}, {"sbrk"}, {"sleep"}, {"uptime"}, {"open"}, {"write"}, {"mknod"}, {"unlink"}, {"link"}, {"mkdir"}, {"close"}, {"trace"}, {"set_priority"}, {"waitx"}};
-  
-  static int SystemcallArgs[25] = {
-  0, 0, 1, 1, 1, 3, 1, 2, 2, 1, 1, 0, 1, 2, 0, 2, 3, 3, 1, 2, 1, 1, 1, 2, 3};
+  static int SystemcallArgs[] = {
+  0, 0, 1, 1, 1, 3, 1, 2, 2, 1, 1, 0, 1, 2, 0, 2, 3, 3, 1, 2, 1, 1, 1, 2, 3,
+  [SYS_set_policy] 2, [SYS_sched_deadline] 3, [SYS_schedstat] 2, [SYS_traceread] 3, [SYS_sysprof] 3,
+  [SYS_sched_setaffinity] 2, [SYS_set_tickets] 2,
+  [SYS_spawn] 3, [SYS_mmap] 6, [SYS_munmap] 2, [SYS_memstat] 2, [SYS_sync] 0, [SYS_splice] 3, [SYS_readv] 3, [SYS_writev] 3, [SYS_ring_enter] 2, [SYS_clone] 3, [SYS_join] 1, [SYS_futex_wait] 2, [SYS_futex_wake] 2, [SYS_procsnap] 2, [SYS_waitx_ns] 3, [SYS_clock_gettime] 2, [SYS_mlfqparam] 2, [SYS_lseek] 3, [SYS_sched_yield] 0, [SYS_schedtrace] 1, [SYS_schedtrace_read] 2};
   
 
-  int num, arg1;
+  int num, traced;
+  uint64 args[TRACE_NARG], start;
   struct proc *p = myproc();
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) 
   {
-    arg1 = argraw(0);
-    p->trapframe->a0 = syscalls[num]();
-    if((p->Trace & (1 << num)) != 0)
+    // the return value overwrites a0, so save the
+    // arguments of a traced call first.
+    // the trace mask only has room for the first 32 calls.
+    if((traced = num < 32 && (p->Trace & (1U << num)) != 0))
     {
-      printf("%d: syscall %s (%d", p->pid, SystemcallNames[num], arg1);
-      for(int i = 1; i < SystemcallArgs[num]; i++)
-        printf(" %d",argraw(i));
-      printf(") -> %d\n", p->trapframe->a0);
+      for(int i = 0; i < TRACE_NARG; i++)
+        args[i] = argraw(i);
     }
+    start = r_time();
+    p->trapframe->a0 = syscalls[num]();
+    sysprof_charge(p, num, r_time() - start);
+    if(traced)
+      trace_record(p, num, SystemcallArgs[num], args, p->trapframe->a0);
   }
   else
   {
@@ -22,4 +22,32 @@
 #define SYS_close  21
 #define SYS_trace  22
 #define SYS_set_priority 23
-#define SYS_waitx  24
\ No newline at end of file
+#define SYS_waitx  24
+#define SYS_set_policy 25
+#define SYS_sched_deadline 26
+#define SYS_schedstat 27
+#define SYS_traceread 28
+#define SYS_sysprof 29
+#define SYS_sched_setaffinity 30
+#define SYS_set_tickets 31
+#define SYS_spawn 32
+#define SYS_mmap 33
+#define SYS_munmap 34
+#define SYS_memstat 35
+#define SYS_sync 36
+#define SYS_splice 37
+#define SYS_readv 38
+#define SYS_writev 39
+#define SYS_ring_enter 40
+#define SYS_clone 41
+#define SYS_join 42
+#define SYS_futex_wait 43
+#define SYS_futex_wake 44
+#define SYS_procsnap 45
+#define SYS_waitx_ns 46
+#define SYS_clock_gettime 47
+#define SYS_mlfqparam 48
+#define SYS_lseek 49
+#define SYS_sched_yield 50
+#define SYS_schedtrace 51
+#define SYS_schedtrace_read 52
@@ -15,54 +15,167 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "mman.h"
+#include "uio.h"
+#include "ring.h"
+
+static struct file* fdfile(int, int*);
+static void fdput(struct file*, int);
 
 // Fetch the nth word-sized system call argument as a file descriptor
-// and return both the descriptor and the corresponding struct file.
+// and return the corresponding struct file, as fdfile() does. The
+// caller drops it with fdput(f, *ref).
 static int
-argfd(int n, int *pfd, struct file **pf)
+argfd(int n, int *ref, struct file **pf)
 {
   int fd;
   struct file *f;
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if((f = fdfile(fd, ref)) == 0)
     return -1;
-  if(pfd)
-    *pfd = fd;
-  if(pf)
-    *pf = f;
+  *pf = f;
   return 0;
 }
 
 // Allocate a file descriptor for the given file.
 // Takes over file reference from caller on success.
+// The threads of a process share its descriptors, so
+// they are taken and released under the group's glock.
 static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *p = myproc();
+  struct proc *p = myproc()->group;
 
+  acquire(&p->glock);
   for(fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd] == 0){
       p->ofile[fd] = f;
+      release(&p->glock);
       return fd;
     }
   }
+  release(&p->glock);
   return -1;
 }
 
+// Take the file of descriptor fd out of the table, to be
+// closed by the caller, or return 0 if fd isn't open.
+static struct file*
+fdtake(int fd)
+{
+  struct proc *p = myproc()->group;
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&p->glock);
+  f = p->ofile[fd];
+  p->ofile[fd] = 0;
+  release(&p->glock);
+  return f;
+}
+
+// Wait until every file system change so far is on disk.
+uint64
+sys_sync(void)
+{
+  log_sync();
+  return 0;
+}
+
+// Copy in the iovcnt buffers of a readv() or writev() to
+// iov, and fault in those of them matching exec segments.
+static int
+argiov(int n, struct iovec *iov, int *iovcnt)
+{
+  uint64 a, tot = 0;
+
+  if(argaddr(n, &a) < 0 || argint(n + 1, iovcnt) < 0)
+    return -1;
+  if(*iovcnt < 0 || *iovcnt > IOV_MAX)
+    return -1;
+  if(copyin(myproc()->pagetable, (char*)iov, a, *iovcnt * sizeof(*iov)) < 0)
+    return -1;
+  for(int i = 0; i < *iovcnt; i++){
+    if((tot += iov[i].len) > 0x7fffffff)  // the result is an int
+      return -1;
+    vmprefault(myproc(), iov[i].base, iov[i].len);
+  }
+  return 0;
+}
+
+uint64
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int n, ref;
+
+  if(argfd(0, &ref, &f) < 0)
+    return -1;
+  if(argiov(1, iov, &n) < 0){
+    fdput(f, ref);
+    return -1;
+  }
+  n = filereadv(f, iov, n);
+  fdput(f, ref);
+  return n;
+}
+
+uint64
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int n, ref;
+
+  if(argfd(0, &ref, &f) < 0)
+    return -1;
+  if(argiov(1, iov, &n) < 0){
+    fdput(f, ref);
+    return -1;
+  }
+  n = filewritev(f, iov, n);
+  fdput(f, ref);
+  return n;
+}
+
+// Move up to n bytes from fd in to fd out in the kernel.
+uint64
+sys_splice(void)
+{
+  struct file *in, *out;
+  int n, inref, outref, r = -1;
+
+  if(argfd(0, &inref, &in) < 0)
+    return -1;
+  if(argfd(1, &outref, &out) == 0){
+    if(argint(2, &n) == 0)
+      r = filesplice(in, out, n);
+    fdput(out, outref);
+  }
+  fdput(in, inref);
+  return r;
+}
+
 uint64
 sys_dup(void)
 {
   struct file *f;
-  int fd;
+  int fd, ref;
 
-  if(argfd(0, 0, &f) < 0)
+  // fdalloc() takes over a reference.
+  if(argfd(0, &ref, &f) < 0)
     return -1;
-  if((fd=fdalloc(f)) < 0)
+  if(!ref)
+    filedup(f);
+  if((fd=fdalloc(f)) < 0){
+    fileclose(f);
     return -1;
-  filedup(f);
+  }
   return fd;
 }
 
@@ -70,25 +183,65 @@ uint64
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, ref;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, &ref, &f) < 0)
     return -1;
-  return fileread(f, p, n);
+  vmprefault(myproc(), p, n);
+  n = fileread(f, p, n);
+  fdput(f, ref);
+  return n;
 }
 
 uint64
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, ref;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, &ref, &f) < 0)
     return -1;
+  vmprefault(myproc(), p, n);
 
-  return filewrite(f, p, n);
+  n = filewrite(f, p, n);
+  fdput(f, ref);
+  return n;
+}
+
+// The open file of descriptor fd, or 0. If the process has
+// threads, a sibling's close() could free the file meanwhile,
+// so this takes a new reference under glock and sets *ref.
+// Without threads only the caller can close fd, and it
+// borrows the table's reference. Drop it with fdput().
+static struct file*
+fdfile(int fd, int *ref)
+{
+  struct proc *p = myproc()->group;
+  struct file *f;
+
+  *ref = 0;
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  // only the caller could clone() a first thread.
+  if(p->nthread == 0)
+    return p->ofile[fd];
+  acquire(&p->glock);
+  if((f = p->ofile[fd]) != 0){
+    filedup(f);
+    *ref = 1;
+  }
+  release(&p->glock);
+  return f;
+}
+
+// Drop the file fdfile() returned.
+static void
+fdput(struct file *f, int ref)
+{
+  if(ref)
+    fileclose(f);
 }
 
 uint64
@@ -97,22 +250,38 @@ sys_close(void)
   int fd;
   struct file *f;
 
-  if(argfd(0, &fd, &f) < 0)
+  if(argint(0, &fd) < 0 || (f = fdtake(fd)) == 0)
     return -1;
-  myproc()->ofile[fd] = 0;
   fileclose(f);
   return 0;
 }
 
+uint64
+sys_lseek(void)
+{
+  struct file *f;
+  int off, whence, ref;
+
+  if(argint(1, &off) < 0 || argint(2, &whence) < 0 || argfd(0, &ref, &f) < 0)
+    return -1;
+  off = fileseek(f, off, whence);
+  fdput(f, ref);
+  return off;
+}
+
 uint64
 sys_fstat(void)
 {
   struct file *f;
   uint64 st; // user pointer to struct stat
 
-  if(argfd(0, 0, &f) < 0 || argaddr(1, &st) < 0)
+  int r, ref;
+
+  if(argaddr(1, &st) < 0 || argfd(0, &ref, &f) < 0)
     return -1;
-  return filestat(f, st);
+  r = filestat(f, st);
+  fdput(f, ref);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -218,6 +387,7 @@ sys_unlink(void)
   memset(&de, 0, sizeof(de));
   if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
     panic("unlink: writei");
+  dcache_enter(dp, name, 0, 0);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -226,6 +396,8 @@ sys_unlink(void)
 
   ip->nlink--;
   iupdate(ip);
+  if(ip->nlink == 0 && ip->execcached)
+    execcache_drop(ip);   // its reference would keep ip alive
   iunlockput(ip);
 
   end_op();
@@ -283,17 +455,14 @@ create(char *path, short type, short major, short minor)
   return ip;
 }
 
-uint64
-sys_open(void)
+// Open path with omode, for open() and the ring.
+// Returns the new fd, or -1.
+static int
+fileopen(char *path, int omode)
 {
-  char path[MAXPATH];
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
-  int n;
-
-  if((n = argstr(0, path, MAXPATH)) < 0 || argint(1, &omode) < 0)
-    return -1;
 
   begin_op();
 
@@ -322,6 +491,13 @@ sys_open(void)
     return -1;
   }
 
+  // a running program's pages are still read from it.
+  if((omode & O_TRUNC) && ip->type == T_FILE && ip->nexec > 0){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+
   if((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0){
     if(f)
       fileclose(f);
@@ -351,6 +527,17 @@ sys_open(void)
   return fd;
 }
 
+uint64
+sys_open(void)
+{
+  char path[MAXPATH];
+  int omode;
+
+  if(argstr(0, path, MAXPATH) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return fileopen(path, omode);
+}
+
 uint64
 sys_mkdir(void)
 {
@@ -412,19 +599,24 @@ sys_chdir(void)
   return 0;
 }
 
-uint64
-sys_exec(void)
+static void
+freeargv(char **argv)
+{
+  for(int i = 0; i < MAXARG && argv[i] != 0; i++)
+    kfree(argv[i]);
+}
+
+// Copy the user argv array at uargv into argv[MAXARG],
+// a page per string. Frees what it copied on failure.
+static int
+fetchargv(uint64 uargv, char **argv)
 {
-  char path[MAXPATH], *argv[MAXARG];
   int i;
-  uint64 uargv, uarg;
+  uint64 uarg;
 
-  if(argstr(0, path, MAXPATH) < 0 || argaddr(1, &uargv) < 0){
-    return -1;
-  }
-  memset(argv, 0, sizeof(argv));
+  memset(argv, 0, MAXARG*sizeof(char*));
   for(i=0;; i++){
-    if(i >= NELEM(argv)){
+    if(i >= MAXARG){
       goto bad;
     }
     if(fetchaddr(uargv+sizeof(uint64)*i, (uint64*)&uarg) < 0){
@@ -440,18 +632,50 @@ sys_exec(void)
     if(fetchstr(uarg, argv[i], PGSIZE) < 0)
       goto bad;
   }
+  return 0;
 
-  int ret = exec(path, argv);
+ bad:
+  freeargv(argv);
+  return -1;
+}
 
-  for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
-    kfree(argv[i]);
+uint64
+sys_exec(void)
+{
+  char path[MAXPATH], *argv[MAXARG];
+  uint64 uargv;
+
+  if(argstr(0, path, MAXPATH) < 0 || argaddr(1, &uargv) < 0){
+    return -1;
+  }
+  if(fetchargv(uargv, argv) < 0)
+    return -1;
 
+  int ret = exec(path, argv);
+
+  freeargv(argv);
   return ret;
+}
 
- bad:
-  for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
-    kfree(argv[i]);
-  return -1;
+uint64
+sys_spawn(void)
+{
+  char path[MAXPATH], *argv[MAXARG];
+  int fdmap[3];
+  uint64 uargv, ufdmap;
+
+  if(argstr(0, path, MAXPATH) < 0 || argaddr(1, &uargv) < 0 || argaddr(2, &ufdmap) < 0){
+    return -1;
+  }
+  if(ufdmap && copyin(myproc()->pagetable, (char*)fdmap, ufdmap, sizeof(fdmap)) < 0)
+    return -1;
+  if(fetchargv(uargv, argv) < 0)
+    return -1;
+
+  int ret = spawn(path, argv, ufdmap ? fdmap : 0);
+
+  freeargv(argv);
+  return ret;
 }
 
 uint64
@@ -469,18 +693,117 @@ sys_pipe(void)
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
     if(fd0 >= 0)
-      p->ofile[fd0] = 0;
+      fdtake(fd0);
     fileclose(rf);
     fileclose(wf);
     return -1;
   }
   if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
      copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
+    fdtake(fd0);
+    fdtake(fd1);
     fileclose(rf);
     fileclose(wf);
     return -1;
   }
   return 0;
 }
+
+uint64
+sys_mmap(void)
+{
+  uint64 addr, len;
+  int prot, flags, off, ref = 0;
+  struct file *f = 0;
+
+  // addr is only a hint, and not used.
+  if(argaddr(0, &addr) < 0 || argaddr(1, &len) < 0 || argint(2, &prot) < 0 ||
+     argint(3, &flags) < 0 || argint(5, &off) < 0)
+    return -1;
+  if((flags & MAP_ANON) == 0 && argfd(4, &ref, &f) < 0)
+    return -1;
+  // mmap() reads the pages in, and doesn't keep f.
+  addr = mmap(f, len, prot, flags, off);
+  if(f)
+    fdput(f, ref);
+  return addr;
+}
+
+// Run one submission of a ring; returns what the syscall
+// would have.
+static int
+ring_op(struct sqe *e)
+{
+  char path[MAXPATH];
+  struct file *f;
+  int r, ref;
+
+  switch(e->op){
+  case RING_NOP:
+    return 0;
+  case RING_READ:
+  case RING_WRITE:
+    if(e->len < 0 || (f = fdfile(e->fd, &ref)) == 0)
+      return -1;
+    vmprefault(myproc(), e->addr, e->len);
+    if(e->op == RING_READ)
+      r = fileread(f, e->addr, e->len);
+    else
+      r = filewrite(f, e->addr, e->len);
+    fdput(f, ref);
+    return r;
+  case RING_OPEN:
+    if(fetchstr(e->addr, path, MAXPATH) < 0)
+      return -1;
+    return fileopen(path, e->len);
+  case RING_CLOSE:
+    if((f = fdtake(e->fd)) == 0)
+      return -1;
+    fileclose(f);
+    return 0;
+  }
+  return -1;
+}
+
+// Run up to n submissions from the ring at user address
+// addr, in order, with one trap. Stops early when the
+// submission ring is empty or the completion ring full.
+// The kernel works on the ring through its own mapping of
+// the page, looked up again after each op: an op may sleep,
+// and meanwhile a sibling thread may unmap the page or a
+// fork() make it copy-on-write. Returns the number run, or
+// -1 if the ring can't be reached.
+uint64
+sys_ring_enter(void)
+{
+  uint64 addr;
+  pagetable_t pt = myproc()->pagetable;
+  struct ring *r;
+  struct sqe e;
+  struct cqe *c;
+  int n, done, res;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  if(addr % PGSIZE != 0)
+    return -1;
+
+  for(done = 0; done < n; done++){
+    if((r = (struct ring*)uvmaddr(pt, addr, 1)) == 0)
+      return -1;
+    if(r->sqhead == r->sqtail || r->cqtail - r->cqhead == NRING)
+      break;
+    __sync_synchronize();           // read the entry after sqtail
+    e = r->sq[r->sqhead % NRING];
+    r->sqhead++;
+    res = ring_op(&e);
+    if((r = (struct ring*)uvmaddr(pt, addr, 1)) == 0)
+      return -1;
+    c = &r->cq[r->cqtail % NRING];
+    c->data = e.data;
+    c->res = res;
+    __sync_synchronize();           // fill the entry before cqtail
+    r->cqtail++;
+  }
+  return done;
+}
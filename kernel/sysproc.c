@@ -6,6 +6,10 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "trace.h"
+#include "sysprof.h"
+#include "clock.h"
+#include "schedtrace.h"
 
 uint64
 sys_exit(void)
@@ -20,7 +24,15 @@ sys_exit(void)
 uint64
 sys_getpid(void)
 {
-  return myproc()->pid;
+  return myproc()->group->pid;
+}
+
+// Give up the cpu to any other RUNNABLE process.
+uint64
+sys_sched_yield(void)
+{
+  yield();
+  return 0;
 }
 
 uint64
@@ -35,21 +47,92 @@ sys_wait(void)
   uint64 p;
   if(argaddr(0, &p) < 0)
     return -1;
+  vmprefault(myproc(), p, sizeof(int));
   return wait(p);
 }
 
 uint64
 sys_sbrk(void)
 {
-  int addr;
   int n;
 
   if(argint(0, &n) < 0)
     return -1;
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
+  return growproc(n);
+}
+
+uint64
+sys_clone(void)
+{
+  uint64 fn, arg, stack;
+
+  if(argaddr(0, &fn) < 0 || argaddr(1, &arg) < 0 || argaddr(2, &stack) < 0)
+    return -1;
+  return clone(fn, arg, stack);
+}
+
+uint64
+sys_futex_wait(void)
+{
+  uint64 addr;
+  int val;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &val) < 0)
+    return -1;
+  return futex_wait(addr, val);
+}
+
+uint64
+sys_futex_wake(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return futex_wake(addr, n);
+}
+
+uint64
+sys_join(void)
+{
+  int tid;
+
+  if(argint(0, &tid) < 0)
+    return -1;
+  return join(tid);
+}
+
+uint64
+sys_munmap(void)
+{
+  uint64 addr, len;
+
+  if(argaddr(0, &addr) < 0 || argaddr(1, &len) < 0)
     return -1;
-  return addr;
+  return munmap(addr, len);
+}
+
+uint64
+sys_memstat(void)
+{
+  int pid;
+  uint64 addr;
+
+  if(argint(0, &pid) < 0 || argaddr(1, &addr) < 0)
+    return -1;
+  return proc_memstat(pid, addr);
+}
+
+uint64
+sys_procsnap(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return proc_snapshot(addr, n);
 }
 
 uint64
@@ -58,8 +141,11 @@ sys_sleep(void)
   int n;
   uint ticks0;
 
-  if(argint(0, &n) < 0)
+  if(argint(0, &n) < 0 || n < 0)
     return -1;
+  // without a periodic tick, ticks may be well behind the
+  // time; count n from now, as sys_uptime() does.
+  tickupdate();
   acquire(&tickslock);
   ticks0 = ticks;
   while(ticks - ticks0 < n){
@@ -67,7 +153,7 @@ sys_sleep(void)
       release(&tickslock);
       return -1;
     }
-    sleep(&ticks, &tickslock);
+    sleepuntil(0, &tickslock, ticks0 + n);
   }
   release(&tickslock);
   return 0;
@@ -90,6 +176,7 @@ sys_uptime(void)
 {
   uint xticks;
 
+  tickupdate();
   acquire(&tickslock);
   xticks = ticks;
   release(&tickslock);
@@ -113,10 +200,22 @@ sys_set_priority(void)
   return set_priority_i(Priority, pid);
 }
 
+uint64
+sys_set_tickets(void)
+{
+  int tickets, pid;
+  if(argint(0, &tickets) < 0)
+    return -1;
+  if(argint(1, &pid) < 0)
+    return -1;
+  return set_tickets_i(tickets, pid);
+}
+
 uint64
 sys_waitx(void)
 {
   uint64 addr, addr1, addr2;
+  uint64 rc, wc;
   uint wtime, rtime;
   if(argaddr(0, &addr) < 0)
     return -1;
@@ -124,11 +223,162 @@ sys_waitx(void)
     return -1;
   if(argaddr(2, &addr2) < 0)
     return -1;
-  int ret = waitx(addr, &wtime, &rtime);
+  vmprefault(myproc(), addr, sizeof(int));
+  int ret = waitx(addr, &rc, &wc);
+  // in ticks, but from cycle counts rather than from the
+  // tick at which each interval began.
+  rtime = rc / TICKCYCLES;
+  wtime = wc / TICKCYCLES;
   struct proc* p = myproc();
   if (copyout(p->pagetable, addr1,(char*)&wtime, sizeof(int)) < 0)
     return -1;
   if (copyout(p->pagetable, addr2,(char*)&rtime, sizeof(int)) < 0)
     return -1;
   return ret;
-}
\ No newline at end of file
+}
+
+// waitx() with the times in nanoseconds.
+uint64
+sys_waitx_ns(void)
+{
+  uint64 addr, addr1, addr2;
+  uint64 rc, wc;
+  int ret;
+  struct proc *p = myproc();
+
+  if(argaddr(0, &addr) < 0 || argaddr(1, &addr1) < 0 || argaddr(2, &addr2) < 0)
+    return -1;
+  vmprefault(p, addr, sizeof(int));
+  if((ret = waitx(addr, &rc, &wc)) < 0)
+    return -1;
+  wc = cycles2ns(wc);
+  rc = cycles2ns(rc);
+  if(copyout(p->pagetable, addr1, (char*)&wc, sizeof(wc)) < 0 ||
+     copyout(p->pagetable, addr2, (char*)&rc, sizeof(rc)) < 0)
+    return -1;
+  return ret;
+}
+
+uint64
+sys_clock_gettime(void)
+{
+  int clk;
+  uint64 addr;
+  struct timespec ts;
+
+  if(argint(0, &clk) < 0 || argaddr(1, &addr) < 0)
+    return -1;
+  if(clock_gettime(clk, &ts) < 0)
+    return -1;
+  return copyout(myproc()->pagetable, addr, (char*)&ts, sizeof(ts));
+}
+
+uint64
+sys_set_policy(void)
+{
+  int policy, pid;
+  if(argint(0, &policy) < 0)
+    return -1;
+  if(argint(1, &pid) < 0)
+    return -1;
+  return set_policy_i(policy, pid);
+}
+
+uint64
+sys_sched_deadline(void)
+{
+  int runtime, period, deadline;
+  if(argint(0, &runtime) < 0)
+    return -1;
+  if(argint(1, &period) < 0)
+    return -1;
+  if(argint(2, &deadline) < 0)
+    return -1;
+  return edf_setparam(runtime, period, deadline);
+}
+
+uint64
+sys_schedstat(void)
+{
+  int pid;
+  uint64 addr;
+  if(argint(0, &pid) < 0)
+    return -1;
+  if(argaddr(1, &addr) < 0)
+    return -1;
+  return sched_stats(pid, addr);
+}
+
+uint64
+sys_traceread(void)
+{
+  uint64 addr;
+  int n, pid;
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  if(argint(1, &n) < 0)
+    return -1;
+  if(argint(2, &pid) < 0)
+    return -1;
+  vmprefault(myproc(), addr, (uint64)n * sizeof(struct tracerec));
+  return trace_read(addr, n, pid);
+}
+
+uint64
+sys_sysprof(void)
+{
+  int pid, n;
+  uint64 addr;
+  if(argint(0, &pid) < 0)
+    return -1;
+  if(argaddr(1, &addr) < 0)
+    return -1;
+  if(argint(2, &n) < 0)
+    return -1;
+  vmprefault(myproc(), addr, (uint64)n * sizeof(struct sysprof));
+  return sysprof_read(pid, addr, n);
+}
+
+uint64
+sys_sched_setaffinity(void)
+{
+  int pid, mask;
+  if(argint(0, &pid) < 0)
+    return -1;
+  if(argint(1, &mask) < 0)
+    return -1;
+  return sched_setaffinity_i(pid, mask);
+}
+
+uint64
+sys_schedtrace(void)
+{
+  int on;
+  if(argint(0, &on) < 0)
+    return -1;
+  return schedtrace(on);
+}
+
+uint64
+sys_schedtrace_read(void)
+{
+  uint64 addr;
+  int n;
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  if(argint(1, &n) < 0)
+    return -1;
+  vmprefault(myproc(), addr, (uint64)n * sizeof(struct schedev));
+  return schedtrace_read(addr, n);
+}
+
+uint64
+sys_mlfqparam(void)
+{
+  uint64 new, old;
+  if(argaddr(0, &new) < 0)
+    return -1;
+  if(argaddr(1, &old) < 0)
+    return -1;
+  return mlfq_setparam(new, old);
+}
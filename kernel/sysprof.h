@@ -0,0 +1,7 @@
+// Per-syscall profile, read with sysprof().
+// Needs kernel/types.h.
+struct sysprof {
+  uint64 count;                // calls that returned
+  uint64 cycles;               // total time CSR cycles in the call
+  uint64 max;                  // longest call; 0 in per-process tables
+};
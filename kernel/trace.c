@@ -0,0 +1,129 @@
+// Syscall trace rings.
+//
+// syscall() appends a fixed-size binary record for every
+// traced call to the ring of the cpu it runs on, instead of
+// printing it. Each ring has a single writer, its own cpu
+// with interrupts off, so writers take no lock; a full ring
+// drops the record and counts it. traceread() drains the
+// rings into user memory; user/strace.c formats them.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "trace.h"
+#include "defs.h"
+
+#define NTRACE 128                  // records per cpu, power of 2
+
+struct tracering {
+  volatile uint head;               // next slot to write, writer only
+  volatile uint tail;               // next slot to read, readers only
+  uint dropped;                     // records lost to a full ring
+  struct tracerec rec[NTRACE];
+};
+
+struct tracering tracerings[NCPU];
+
+// serializes readers; writers never take it.
+struct spinlock tracelock;
+
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// Record a traced syscall of p on this cpu.
+void
+trace_record(struct proc *p, int num, int nargs, uint64 *args, uint64 ret)
+{
+  struct tracering *r;
+  struct tracerec *e;
+
+  push_off();
+  r = &tracerings[cpuid()];
+  if(r->head - r->tail >= NTRACE){
+    __sync_fetch_and_add(&r->dropped, 1);
+    pop_off();
+    return;
+  }
+  e = &r->rec[r->head % NTRACE];
+  e->pid = p->pid;
+  e->num = num;
+  e->nargs = nargs;
+  e->time = r_time();
+  e->ret = ret;
+  for(int i = 0; i < TRACE_NARG; i++)
+    e->arg[i] = args[i];
+  // the record must be complete before a reader sees it.
+  __sync_synchronize();
+  r->head++;
+  pop_off();
+}
+
+// Is a process pid still running?
+static int
+tracee_alive(int pid)
+{
+  struct proc *p;
+  int alive;
+
+  if((p = findproc(pid)) == 0)
+    return 0;
+  alive = p->state != ZOMBIE;
+  release(&p->lock);
+  return alive;
+}
+
+// Copy up to n records, from all cpus, to user address addr.
+// A ring that dropped records first yields a record with
+// pid -1 and the count in ret. Returns the number of records,
+// or -1 once the rings are empty and pid (if not 0) has
+// exited, so a tracer knows it has seen everything.
+int
+trace_read(uint64 addr, int n, int pid)
+{
+  struct proc *me = myproc();
+  struct tracering *r;
+  struct tracerec lost;
+  uint h, t;
+  int got = 0, alive;
+
+  // look before draining: records pid wrote before it
+  // exited are then sure to be drained below.
+  alive = pid == 0 || tracee_alive(pid);
+
+  acquire(&tracelock);
+  for(r = tracerings; r < &tracerings[NCPU] && got < n; r++){
+    if(r->dropped){
+      memset(&lost, 0, sizeof(lost));
+      lost.pid = -1;
+      lost.ret = __sync_lock_test_and_set(&r->dropped, 0);
+      if(copyout(me->pagetable, addr + got*sizeof(lost), (char*)&lost, sizeof(lost)) < 0)
+        break;
+      got++;
+    }
+    h = r->head;
+    // read the records only after seeing head.
+    __sync_synchronize();
+    for(t = r->tail; t != h && got < n; t++, got++){
+      if(copyout(me->pagetable, addr + got*sizeof(struct tracerec),
+                 (char*)&r->rec[t % NTRACE], sizeof(struct tracerec)) < 0)
+        break;
+    }
+    // done with the slots before the writer may reuse them.
+    __sync_synchronize();
+    r->tail = t;
+    if(t != h)
+      break;
+  }
+  release(&tracelock);
+
+  if(got == 0 && !alive)
+    return -1;
+  return got;
+}
@@ -0,0 +1,12 @@
+// Syscall trace records, read with traceread().
+// Needs kernel/types.h.
+#define TRACE_NARG 6
+
+struct tracerec {
+  int pid;                     // -1: lost records, count in ret
+  short num;                   // syscall number
+  short nargs;
+  uint64 time;                 // time CSR after the call returned
+  uint64 ret;
+  uint64 arg[TRACE_NARG];      // arguments as passed in a0..a5
+};
@@ -5,9 +5,30 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "vdso.h"
+#include "clock.h"
 
 struct spinlock tickslock;
 uint ticks;
+uint64 tickbase;            // time CSR at boot; ticks count from it
+
+// A timer wheel per hart for sleepuntil(): a process waiting
+// for tick t is in slot t % NWHEEL of the wheel of the hart it
+// slept on, until that hart's tickupdate() reaches t and wakes
+// it. Only that hart runs its wheel, and arms its timer for
+// the earliest deadline on it (twheel_due()).
+#define NWHEEL 64
+#define NBATCH 16           // processes woken per hold of the wheel lock
+
+struct twheel {
+  struct spinlock lock;
+  struct proc *slot[NWHEEL];
+  int n;                    // processes on the wheel
+  uint done;                // ticks up to this one have been run
+  uint next;                // earliest deadline, if n > 0
+} wheels[NCPU];
+
+struct vdso *vdso;          // mapped at VDSO in every process
 
 extern char trampoline[], uservec[], userret[];
 
@@ -16,10 +37,21 @@ void kernelvec();
 
 extern int devintr();
 
+// start.c; timervec sets [6] when the timer fires.
+extern uint64 timer_scratch[NCPU][7];
+
 void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&wheels[i].lock, "twheel");
+  if((vdso = kzalloc()) == 0)
+    panic("trapinit: vdso");
+  tickbase = r_time();
+  vdso->tickbase = tickbase;
+  vdso->tickcycles = TICKCYCLES;
+  vdso->timebase = TIMEBASE;
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -36,10 +68,6 @@ trapinithart(void)
 void
 usertrap(void)
 {
-  #ifdef MLFQ
-  static const int NoTicks[5] = {1, 2, 4, 8, 16};
-  #endif
-  
   int which_dev = 0;
 
   if((r_sstatus() & SSTATUS_SPP) != 0)
@@ -48,6 +76,11 @@ usertrap(void)
   // send interrupts and exceptions to kerneltrap(),
   // since we're now in the kernel.
   w_stvec((uint64)kernelvec);
+  // no longer in user space, for tlb_shootdown() and
+  // proc_quiesce(); the fence orders it before anything the
+  // kernel reads here.
+  __atomic_store_n(&mycpu()->upt, 0, __ATOMIC_RELAXED);
+  __sync_synchronize();
 
   struct proc *p = myproc();
   
@@ -71,6 +104,19 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
+  } else if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15){
+    // page fault on a lazy, copy-on-write or not yet loaded
+    // page. loading one reads the disk and sleeps, so read
+    // the csrs before interrupts go back on.
+    uint64 cause = r_scause();
+    uint64 va = r_stval();
+
+    intr_on();
+    if(vmfault(p, va, cause == 15) < 0){
+      printf("usertrap(): unexpected scause %p pid=%d\n", cause, p->pid);
+      printf("            sepc=%p stval=%p\n", p->trapframe->epc, va);
+      p->killed = 1;
+    }
   } else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
@@ -80,28 +126,14 @@ usertrap(void)
   if(p->killed)
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  #ifdef DEFAULT
-  if(which_dev == 2)
-    yield();
-  #endif
-
-  #ifdef MLFQ
-  if(which_dev == 2)
-  {
-    p->no_of_ticks++;
-    if(p->no_of_ticks >= NoTicks[p->priority_number])
-    {
-      p->no_of_ticks = 0;
-      
-      if(p->priority_number != 4)
-        p->priority_number++;
-
-      p->time_added = ticks;
+  // give up the CPU if this is a timer interrupt
+  // and p's scheduling class wants to preempt it.
+  if(which_dev == 2){
+    if(sched_tick(p))
       yield();
-    }
+    else
+      sched_timer(p);
   }
-  #endif
 
   usertrapret();
 }
@@ -141,14 +173,20 @@ usertrapret(void)
   // set S Exception Program Counter to the saved user pc.
   w_sepc(p->trapframe->epc);
 
-  // tell trampoline.S the user page table to switch to.
-  uint64 satp = MAKE_SATP(p->pagetable);
+  // tell trampoline.S the user page table to switch to, and
+  // whether it has to flush the TLB. upt is set first, so a
+  // tlb_shootdown() of the page table either sees this hart
+  // or bumped the asidgen that asid_satp() looks at.
+  __atomic_store_n(&mycpu()->upt, p->group->pagetable, __ATOMIC_RELAXED);
+  __sync_synchronize();
+  uint64 satp = asid_satp(p);
+  p->trapframe->tlbflush = !asidok;
 
   // jump to trampoline.S at the top of memory, which 
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 fn = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64,uint64))fn)(TRAPFRAME, satp);
+  ((void (*)(uint64,uint64,uint64))fn)(THREADTF(p->tslot), satp, !asidok);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -156,10 +194,6 @@ usertrapret(void)
 void 
 kerneltrap()
 {
-  #ifdef MLFQ
-  static const int NoTicks[5] = {1, 2, 4, 8, 16};
-  #endif
-
   int which_dev = 0;
   uint64 sepc = r_sepc();
   uint64 sstatus = r_sstatus();
@@ -176,43 +210,228 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-  #ifdef DEFAULT
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
-    yield();
-  #endif    
-
-  #ifdef MLFQ
-  struct proc* p = myproc();
-  if(which_dev == 2 && p != 0 && p->state == RUNNING)
-  {
-    p->no_of_ticks++;
-    if(p->no_of_ticks >= NoTicks[p->priority_number])
-    {
-      p->no_of_ticks = 0;
-      
-      if(p->priority_number != 4)
-        p->priority_number++;
-
-      p->time_added = ticks;
+  // give up the CPU if this is a timer interrupt
+  // and the process's scheduling class wants to preempt it.
+  struct proc *p = myproc();
+  if(which_dev == 2 && p != 0 && p->state == RUNNING){
+    if(sched_tick(p))
       yield();
-    } 
+    else
+      sched_timer(p);
   }
-  #endif
+
   // the yield() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
   w_sepc(sepc);
   w_sstatus(sstatus);
 }
 
+// Nanoseconds in c time CSR cycles, without overflowing
+// for long uptimes.
+uint64
+cycles2ns(uint64 c)
+{
+  return c / TIMEBASE * 1000000000 + c % TIMEBASE * 1000000000 / TIMEBASE;
+}
+
+// Read clock clk (CLOCK_* in clock.h) into ts. The time CSR
+// counts at TIMEBASE on every hart from the same CLINT mtime,
+// so CLOCK_MONOTONIC doesn't go back when a process moves.
+// Returns 0, or -1 if clk is unknown.
+int
+clock_gettime(int clk, struct timespec *ts)
+{
+  uint64 c;
+
+  switch(clk){
+  case CLOCK_MONOTONIC:
+    c = r_time();
+    break;
+  case CLOCK_PROCESS_CPUTIME_ID:
+    c = sched_runtime(myproc());
+    break;
+  default:
+    return -1;
+  }
+  ts->sec = c / TIMEBASE;
+  ts->nsec = c % TIMEBASE * 1000000000 / TIMEBASE;
+  return 0;
+}
+
+// Set w->next to the earliest deadline on w. Looks one turn
+// of the wheel ahead, and only past that at every process.
+// Caller holds w->lock.
+static void
+twheel_next(struct twheel *w)
+{
+  struct proc *p;
+  uint t;
+
+  if(w->n == 0)
+    return;
+  for(t = w->done + 1; t != w->done + 1 + NWHEEL; t++)
+    for(p = w->slot[t % NWHEEL]; p; p = p->tw_next)
+      if(p->tw_tick == t){
+        w->next = t;
+        return;
+      }
+  w->next = w->done + ~0U;
+  for(int i = 0; i < NWHEEL; i++)
+    for(p = w->slot[i]; p; p = p->tw_next)
+      if(p->tw_tick - w->done < w->next - w->done)
+        w->next = p->tw_tick;
+}
+
+// Wake the processes on w whose deadlines are at or before
+// tick now, taking them off the wheel in batches so the wheel
+// lock is not held across wakeproc().
+static void
+twheel_run(struct twheel *w, uint now)
+{
+  struct proc *batch[NBATCH], *p, **pp;
+  void *chan[NBATCH];
+  uint t, end;
+  int n;
+
+  if((int)(now - w->done) <= 0)
+    return;
+  do {
+    n = 0;
+    acquire(&w->lock);
+    end = (int)(now - w->done) > NWHEEL ? w->done + NWHEEL : now;
+    for(t = w->done + 1; w->n > 0 && (int)(end - t) >= 0; t++){
+      for(pp = &w->slot[t % NWHEEL]; (p = *pp) != 0 && n < NBATCH; ){
+        if((int)(now - p->tw_tick) >= 0){
+          *pp = p->tw_next;
+          p->tw_next = 0;
+          p->tw_wheel = 0;
+          w->n--;
+          chan[n] = p->tw_chan;
+          batch[n++] = p;
+        } else
+          pp = &p->tw_next;
+      }
+      if(n == NBATCH)
+        break;
+    }
+    // a full batch may have left some of slot t behind.
+    w->done = n == NBATCH ? t - 1 : now;
+    if(w->n > 0 && (int)(w->next - w->done) <= 0)
+      twheel_next(w);
+    release(&w->lock);
+
+    for(int i = 0; i < n; i++)
+      wakeproc(batch[i], chan[i]);
+  } while(n == NBATCH);
+}
+
+// Bring ticks up to the time CSR. There is no periodic
+// tick: harts take timer interrupts only for their next
+// scheduling event (see sched_timer()), so ticks is derived
+// from the time, here, whenever a timer fires or a hart
+// schedules. Then runs this hart's timer wheel up to it.
+void
+tickupdate(void)
+{
+  uint t = (r_time() - tickbase) / TICKCYCLES;
+
+  if(t != ticks){
+    acquire(&tickslock);
+    if((int)(t - ticks) > 0){
+      ticks = t;
+      vdso->ticks = t;
+    }
+    release(&tickslock);
+  }
+  push_off();
+  twheel_run(&wheels[cpuid()], t);
+  pop_off();
+}
+
+// Put p, about to sleep on chan until tick t, on this hart's
+// timer wheel. The hart arms its timer for t when it next
+// schedules, which p's sleep is about to make it do. Caller
+// holds p->lock.
+void
+twheel_add(struct proc *p, void *chan, uint t)
+{
+  struct twheel *w = &wheels[cpuid()];
+
+  acquire(&w->lock);
+  // already run past t; the next tick will do.
+  if((int)(t - w->done) <= 0)
+    t = w->done + 1;
+  p->tw_tick = t;
+  p->tw_chan = chan;
+  p->tw_wheel = w;
+  p->tw_next = w->slot[t % NWHEEL];
+  w->slot[t % NWHEEL] = p;
+  if(w->n++ == 0 || (int)(t - w->next) < 0)
+    w->next = t;
+  release(&w->lock);
+}
+
+// Take p off its timer wheel, if it is still on one because
+// something other than the wheel woke it. Caller holds
+// p->lock.
+void
+twheel_del(struct proc *p)
+{
+  struct twheel *w = p->tw_wheel;
+  struct proc **pp;
+
+  if(w == 0)
+    return;
+  acquire(&w->lock);
+  if(p->tw_wheel == w){
+    for(pp = &w->slot[p->tw_tick % NWHEEL]; *pp; pp = &(*pp)->tw_next){
+      if(*pp == p){
+        *pp = p->tw_next;
+        break;
+      }
+    }
+    p->tw_next = 0;
+    p->tw_wheel = 0;
+    w->n--;
+  }
+  release(&w->lock);
+}
+
+// The time CSR value at which hart must run its timer wheel,
+// or ~0 if there is nobody on it. Read without the wheel
+// lock; only hart adds to its wheel, and a stale deadline
+// left by twheel_del() costs one early timer.
+uint64
+twheel_due(int hart)
+{
+  struct twheel *w = &wheels[hart];
+
+  if(w->n == 0)
+    return ~0ULL;
+  return tickbase + (uint64)w->next * TICKCYCLES;
+}
+
+// Make this hart's timer fire at time when, or never for ~0.
+// S-mode may write mtimecmp; timervec disarms it on firing.
+void
+timer_set(uint64 when)
+{
+  *(uint64*)CLINT_MTIMECMP(cpuid()) = when;
+}
+
+// Make hart take a timer interrupt now, so it rechecks what
+// it runs (sched_tick()) and rearms its timer. A hint: the
+// hart may be rearming itself at the same moment.
+void
+timer_kick(int hart)
+{
+  *(uint64*)CLINT_MTIMECMP(hart) = 0;
+}
+
 void
 clockintr()
 {
-  acquire(&tickslock);
-  ticks++;
-  update_time();
-  wakeup(&ticks);
-  release(&tickslock);
+  tickupdate();
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -249,19 +468,32 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000001L){
     // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // or from an IPI, forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
+    // the SSIP bit in sip, before looking at what raised
+    // it, so that a timer interrupt arriving meanwhile
+    // raises it again.
     w_sip(r_sip() & ~2);
+    tlb_ack();
+
+    if(__sync_lock_test_and_set(&timer_scratch[cpuid()][6], 0) == 0){
+      // an IPI; it only had to get the hart out of wfi.
+      return 1;
+    }
 
+    clockintr();
     return 2;
   } else {
     return 0;
   }
 }
 
+// Raise a software interrupt on another hart,
+// to wake it from wfi in scheduler().
+void
+ipi(int hart)
+{
+  __sync_synchronize();
+  *(uint32*)CLINT_MSIP(hart) = 1;
+}
@@ -38,14 +38,16 @@
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
 
-// the transmit output buffer.
+// the transmit output buffer, shared by write() and
+// kernel printf; the interrupt handler drains it.
 struct spinlock uart_tx_lock;
-#define UART_TX_BUF_SIZE 32
+#define UART_TX_BUF_SIZE 4096
 char uart_tx_buf[UART_TX_BUF_SIZE];
 uint64 uart_tx_w; // write next to uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE]
 uint64 uart_tx_r; // read next from uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]
 
 extern volatile int panicked; // from printf.c
+extern volatile int panicking; // from printf.c
 
 void uartstart();
 
@@ -108,10 +110,43 @@ uartputc(int c)
   }
 }
 
+// add n characters to the output buffer for kernel printf
+// and to echo characters. it doesn't sleep, so it can be
+// called with locks held and from interrupts: if the buffer
+// is full it spins sending characters to make room. while
+// panic() prints, it sends what's buffered and then the
+// characters synchronously, taking no lock.
+void
+uartwrite(char *s, int n)
+{
+  if(panicking){
+    push_off();
+    while(uart_tx_w != uart_tx_r)
+      uartputc_sync(uart_tx_buf[uart_tx_r++ % UART_TX_BUF_SIZE]);
+    for(int i = 0; i < n; i++)
+      uartputc_sync(s[i]);
+    pop_off();
+    return;
+  }
+
+  acquire(&uart_tx_lock);
+  if(panicked){
+    for(;;)
+      ;
+  }
+  for(int i = 0; i < n; i++){
+    while(uart_tx_w == uart_tx_r + UART_TX_BUF_SIZE)
+      uartstart();
+    uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = s[i];
+    uart_tx_w += 1;
+  }
+  uartstart();
+  release(&uart_tx_lock);
+}
+
 // alternate version of uartputc() that doesn't 
-// use interrupts, for use by kernel printf() and
-// to echo characters. it spins waiting for the uart's
-// output register to be empty.
+// use interrupts, for use by panic(). it spins waiting
+// for the uart's output register to be empty.
 void
 uartputc_sync(int c)
 {
@@ -0,0 +1,8 @@
+// One buffer of a readv() or writev().
+// Needs kernel/types.h.
+struct iovec {
+  uint64 base;                 // user virtual address
+  uint64 len;                  // bytes
+};
+
+#define IOV_MAX 16             // most buffers per call
@@ -0,0 +1,16 @@
+// Pages the kernel maps read-only into every process, so
+// that uptime() and getpid() in ulib.c need no trap.
+// Needs kernel/types.h.
+
+// At VDSO, the same page in every process.
+struct vdso {
+  volatile uint ticks;          // ticks as last brought up to date
+  uint tickcycles;              // time CSR cycles per tick
+  uint64 timebase;              // time CSR cycles per second
+  uint64 tickbase;              // time CSR at tick 0
+};
+
+// At VPROC, a page of the process's own.
+struct vproc {
+  int pid;
+};
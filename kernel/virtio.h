@@ -44,8 +44,12 @@
 #define VIRTIO_RING_F_EVENT_IDX     29
 
 // this many virtio descriptors.
-// must be a power of two.
-#define NUM 8
+// must be a power of two, and NUM descriptors plus the avail
+// ring must fit in the first page of disk.pages.
+#define NUM 64
+
+// most blocks merged into one request.
+#define MAXMERGE 16
 
 // a single descriptor, from the spec.
 struct virtq_desc {
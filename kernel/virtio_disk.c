@@ -55,16 +55,24 @@ static struct disk {
 
   // our own book-keeping.
   char free[NUM];  // is a descriptor free?
+  int nfree;       // how many are
   uint16 used_idx; // we've looked this far in used[2..NUM].
 
   // track info about in-flight operations,
   // for use when completion interrupt arrives.
   // indexed by first descriptor index of chain.
+  // b is the first of the bufs of the request, linked
+  // through qnext.
   struct {
     struct buf *b;
     char status;
   } info[NUM];
 
+  // bufs waiting for descriptors, through qnext, by block
+  // number, so that runs of adjacent blocks can be sent as
+  // one request.
+  struct buf *queue;
+
   // disk command headers.
   // one-for-one with descriptors, for convenience.
   struct virtio_blk_req ops[NUM];
@@ -136,6 +144,8 @@ virtio_disk_init(void)
   // all NUM descriptors start out unused.
   for(int i = 0; i < NUM; i++)
     disk.free[i] = 1;
+  disk.nfree = NUM;
+  disk.queue = 0;
 
   // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
 }
@@ -147,6 +157,7 @@ alloc_desc()
   for(int i = 0; i < NUM; i++){
     if(disk.free[i]){
       disk.free[i] = 0;
+      disk.nfree--;
       return i;
     }
   }
@@ -166,7 +177,7 @@ free_desc(int i)
   disk.desc[i].flags = 0;
   disk.desc[i].next = 0;
   disk.free[i] = 1;
-  wakeup(&disk.free[0]);
+  disk.nfree++;
 }
 
 // free a chain of descriptors.
@@ -184,101 +195,140 @@ free_chain(int i)
   }
 }
 
-// allocate three descriptors (they need not be contiguous).
-// disk transfers always use three descriptors.
-static int
-alloc3_desc(int *idx)
-{
-  for(int i = 0; i < 3; i++){
-    idx[i] = alloc_desc();
-    if(idx[i] < 0){
-      for(int j = 0; j < i; j++)
-        free_desc(idx[j]);
-      return -1;
-    }
-  }
-  return 0;
-}
-
-void
-virtio_disk_rw(struct buf *b, int write)
+// Send the n bufs at the head of the queue, which are for
+// adjacent blocks in the same direction, to the device as
+// one request. The spec's Section 5.2 says that legacy block
+// operations use a descriptor for type/reserved/sector, the
+// data, then one for a 1-byte status result; the data can
+// take several descriptors, one per buf here. Caller holds
+// vdisk_lock and has checked that n+2 descriptors are free.
+static void
+send(int n)
 {
-  uint64 sector = b->blockno * (BSIZE / 512);
-
-  acquire(&disk.vdisk_lock);
-
-  // the spec's Section 5.2 says that legacy block operations use
-  // three descriptors: one for type/reserved/sector, one for the
-  // data, one for a 1-byte status result.
+  struct buf *b = disk.queue, *last;
+  int write = b->qwrite;
+  int head, d, prev;
 
-  // allocate the three descriptors.
-  int idx[3];
-  while(1){
-    if(alloc3_desc(idx) == 0) {
-      break;
-    }
-    sleep(&disk.free[0], &disk.vdisk_lock);
-  }
-
-  // format the three descriptors.
+  // format the descriptors.
   // qemu's virtio-blk.c reads them.
 
-  struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
+  head = alloc_desc();
+  struct virtio_blk_req *buf0 = &disk.ops[head];
 
   if(write)
     buf0->type = VIRTIO_BLK_T_OUT; // write the disk
   else
     buf0->type = VIRTIO_BLK_T_IN; // read the disk
   buf0->reserved = 0;
-  buf0->sector = sector;
-
-  disk.desc[idx[0]].addr = (uint64) buf0;
-  disk.desc[idx[0]].len = sizeof(struct virtio_blk_req);
-  disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
-  disk.desc[idx[0]].next = idx[1];
-
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
+  buf0->sector = b->blockno * (BSIZE / 512);
+
+  disk.desc[head].addr = (uint64) buf0;
+  disk.desc[head].len = sizeof(struct virtio_blk_req);
+  disk.desc[head].flags = VRING_DESC_F_NEXT;
+
+  prev = head;
+  for(last = b; ; last = last->qnext){
+    d = alloc_desc();
+    disk.desc[prev].next = d;
+    disk.desc[d].addr = (uint64) last->data;
+    disk.desc[d].len = BSIZE;
+    if(write)
+      disk.desc[d].flags = 0; // device reads b->data
+    else
+      disk.desc[d].flags = VRING_DESC_F_WRITE; // device writes b->data
+    disk.desc[d].flags |= VRING_DESC_F_NEXT;
+    prev = d;
+    if(--n == 0)
+      break;
+  }
+  disk.queue = last->qnext;
+  last->qnext = 0;
 
-  disk.info[idx[0]].status = 0xff; // device writes 0 on success
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
+  d = alloc_desc();
+  disk.desc[prev].next = d;
+  disk.info[head].status = 0xff; // device writes 0 on success
+  disk.desc[d].addr = (uint64) &disk.info[head].status;
+  disk.desc[d].len = 1;
+  disk.desc[d].flags = VRING_DESC_F_WRITE; // device writes the status
+  disk.desc[d].next = 0;
 
-  // record struct buf for virtio_disk_intr().
-  b->disk = 1;
-  disk.info[idx[0]].b = b;
+  // record the bufs for virtio_disk_intr().
+  disk.info[head].b = b;
 
   // tell the device the first index in our chain of descriptors.
-  disk.avail->ring[disk.avail->idx % NUM] = idx[0];
+  disk.avail->ring[disk.avail->idx % NUM] = head;
 
   __sync_synchronize();
 
   // tell the device another avail ring entry is available.
   disk.avail->idx += 1; // not % NUM ...
+}
+
+// Send as much of the queue as there are descriptors for,
+// merging runs of adjacent blocks. Caller holds vdisk_lock.
+static void
+dispatch(void)
+{
+  struct buf *b;
+  int n, sent = 0;
+
+  while(disk.queue){
+    n = 1;
+    for(b = disk.queue; b->qnext && n < MAXMERGE; b = b->qnext, n++)
+      if(b->qnext->blockno != b->blockno + 1 || b->qnext->qwrite != b->qwrite)
+        break;
+    if(disk.nfree < n + 2)
+      break;
+    send(n);
+    sent = 1;
+  }
 
   __sync_synchronize();
 
-  *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+  if(sent)
+    *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+}
 
-  // Wait for virtio_disk_intr() to say request has finished.
-  while(b->disk == 1) {
-    sleep(b, &disk.vdisk_lock);
-  }
+// Queue the transfer of the n locked bufs in bs, all reads
+// or all writes, and start what the device can take now.
+// Does not wait: virtio_disk_intr() clears b->disk when a
+// buf is done, and hands bufs with b->async to bdone().
+void
+virtio_disk_submit(struct buf **bs, int n, int write)
+{
+  struct buf **pp;
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+  acquire(&disk.vdisk_lock);
+  for(int i = 0; i < n; i++){
+    struct buf *b = bs[i];
+    b->disk = 1;
+    b->qwrite = write;
+    for(pp = &disk.queue; *pp && (*pp)->blockno < b->blockno; pp = &(*pp)->qnext)
+      ;
+    b->qnext = *pp;
+    *pp = b;
+  }
+  dispatch();
+  release(&disk.vdisk_lock);
+}
 
+// Wait for the transfer of b to finish.
+void
+virtio_disk_wait(struct buf *b)
+{
+  acquire(&disk.vdisk_lock);
+  while(b->disk == 1)
+    sleep(b, &disk.vdisk_lock);
   release(&disk.vdisk_lock);
 }
 
+void
+virtio_disk_rw(struct buf *b, int write)
+{
+  virtio_disk_submit(&b, 1, write);
+  virtio_disk_wait(b);
+}
+
 void
 virtio_disk_intr()
 {
@@ -295,7 +345,8 @@ virtio_disk_intr()
   __sync_synchronize();
 
   // the device increments disk.used->idx when it
-  // adds an entry to the used ring.
+  // adds an entry to the used ring. finish every request
+  // there, then refill the freed descriptors from the queue.
 
   while(disk.used_idx != disk.used->idx){
     __sync_synchronize();
@@ -304,12 +355,25 @@ virtio_disk_intr()
     if(disk.info[id].status != 0)
       panic("virtio_disk_intr status");
 
-    struct buf *b = disk.info[id].b;
-    b->disk = 0;   // disk is done with buf
-    wakeup(b);
+    struct buf *b = disk.info[id].b, *next;
+    disk.info[id].b = 0;
+    free_chain(id);
+    for(; b; b = next){
+      next = b->qnext;
+      b->qnext = 0;
+      b->disk = 0;   // disk is done with buf
+      if(b->async){
+        // a readahead; no one waits for it.
+        b->async = 0;
+        bdone(b);
+      } else {
+        wakeup(b);
+      }
+    }
 
     disk.used_idx += 1;
   }
+  dispatch();
 
   release(&disk.vdisk_lock);
 }
@@ -3,6 +3,9 @@
 #include "memlayout.h"
 #include "elf.h"
 #include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "memstat.h"
 #include "defs.h"
 #include "fs.h"
 
@@ -11,18 +14,23 @@
  */
 pagetable_t kernel_pagetable;
 
+// satp holds an ASID for every process slot. Process slot i
+// uses ASID i+1, the kernel 0.
+int asidok;
+
 extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+static pte_t *walklevel(pagetable_t, uint64, int, int);
+
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
 {
   pagetable_t kpgtbl;
 
-  kpgtbl = (pagetable_t) kalloc();
-  memset(kpgtbl, 0, PGSIZE);
+  kpgtbl = (pagetable_t) kzalloc();
 
   // uart registers
   kvmmap(kpgtbl, UART0, UART0, PGSIZE, PTE_R | PTE_W);
@@ -30,6 +38,9 @@ kvmmake(void)
   // virtio mmio disk interface
   kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
 
+  // CLINT, for ipi() to raise software interrupts on other harts.
+  kvmmap(kpgtbl, CLINT, CLINT, 0x10000, PTE_R | PTE_W);
+
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x400000, PTE_R | PTE_W);
 
@@ -37,6 +48,7 @@ kvmmake(void)
   kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
 
   // map kernel data and the physical RAM we'll make use of.
+  // past the first 2MB boundary this is all megapages.
   kvmmap(kpgtbl, (uint64)etext, (uint64)etext, PHYSTOP-(uint64)etext, PTE_R | PTE_W);
 
   // map the trampoline for trap entry/exit to
@@ -61,8 +73,153 @@ kvminit(void)
 void
 kvminithart()
 {
+  uint64 bits;
+
+  // the ASID bits a hart doesn't implement read back as 0.
+  w_satp(MAKE_SATP(kernel_pagetable) | SATP_ASID_MASK);
+  bits = (r_satp() & SATP_ASID_MASK) >> SATP_ASID_SHIFT;
   w_satp(MAKE_SATP(kernel_pagetable));
   sfence_vma();
+  if(cpuid() == 0)
+    asidok = bits >= NPROC;
+  else if(bits < NPROC)
+    asidok = 0;
+}
+
+// pagetable changed. If it is the current process's, its
+// TLB entries must be flushed on every hart before it next
+// runs there; see asid_satp(). Any other table is a new one
+// being filled in, for fork(), spawn() or exec(), or one
+// being freed, and was never installed in satp under its
+// ASID since.
+void
+asid_invalidate(pagetable_t pagetable)
+{
+  struct proc *p = myproc();
+
+  if(p && p->group->pagetable == pagetable)
+    p->group->asidgen++;
+}
+
+// Make every other hart in user mode on pagetable flush its
+// TLB, and wait until it has, so that pages just unmapped
+// from pagetable can be freed: a sibling thread could still
+// reach them through stale entries. Harts in the kernel flush
+// in asid_satp() before they go back, since the caller has
+// already called asid_invalidate().
+void
+tlb_shootdown(pagetable_t pagetable)
+{
+  struct cpu *c;
+  uint want[NCPU];
+  int me, any = 0;
+
+  push_off();
+  me = cpuid();
+  __sync_synchronize();
+  for(int i = 0; i < NCPU; i++){
+    c = &cpus[i];
+    want[i] = 0;
+    if(i == me || __atomic_load_n(&c->upt, __ATOMIC_RELAXED) != pagetable)
+      continue;
+    want[i] = __sync_add_and_fetch(&c->tlbreq, 1);
+    ipi(i);
+    any = 1;
+  }
+  for(int i = 0; any && i < NCPU; i++){
+    c = &cpus[i];
+    // done once it flushed, or left user mode.
+    while(want[i] && (int)(__atomic_load_n(&c->tlback, __ATOMIC_ACQUIRE) - want[i]) < 0 &&
+          __atomic_load_n(&c->upt, __ATOMIC_RELAXED) == pagetable)
+      ;
+  }
+  pop_off();
+}
+
+// Flush this hart's TLB if another hart asked for it with
+// tlb_shootdown(). Called for every software interrupt.
+void
+tlb_ack(void)
+{
+  struct cpu *c = mycpu();
+  uint req = __atomic_load_n(&c->tlbreq, __ATOMIC_ACQUIRE);
+
+  if(req != c->tlback){
+    sfence_vma();
+    __atomic_store_n(&c->tlback, req, __ATOMIC_RELEASE);
+  }
+}
+
+// The satp value for p's page table and ASID. If this hart
+// may still have stale entries for the ASID, since p's page
+// table changed or another process used the slot, flush them
+// first. The threads of a group share its leader's ASID.
+uint64
+asid_satp(struct proc *p)
+{
+  struct cpu *c = mycpu();
+  uint64 asid;
+
+  if(!asidok)
+    return MAKE_SATP(p->pagetable);
+  p = p->group;
+  asid = p->slot + 1;
+  if(c->asidgen[asid] != p->asidgen){
+    sfence_vma_asid(asid);
+    c->asidgen[asid] = p->asidgen;
+  }
+  return MAKE_SATP(p->pagetable) | (asid << SATP_ASID_SHIFT);
+}
+
+// Times the kernel stack of each process slot was unmapped.
+uint kstackgen[NPROC];
+
+// Map the kernel stack page pa at va in the kernel page
+// table, which is in use by every hart. proc_mapstacks()
+// made its page-table pages at boot, so this only fills in
+// a leaf PTE. An earlier process in the slot may have had
+// va; a hart that ran it may still cache the old page until
+// kstack_sfence().
+void
+kvmmapstack(uint64 va, uint64 pa)
+{
+  pte_t *pte;
+
+  if((pte = walk(kernel_pagetable, va, 0)) == 0 || (*pte & PTE_V))
+    panic("kvmmapstack");
+  *pte = PA2PTE(pa) | PTE_R | PTE_W | PTE_V;
+  sfence_vma();
+}
+
+// Unmap the kernel stack of process slot slot and return
+// its page, once the process that had it is gone.
+uint64
+kvmunmapstack(int slot)
+{
+  pte_t *pte;
+  uint64 pa;
+
+  if((pte = walk(kernel_pagetable, KSTACK(slot), 0)) == 0 || (*pte & PTE_V) == 0)
+    panic("kvmunmapstack");
+  pa = PTE2PA(*pte);
+  *pte = 0;
+  __sync_add_and_fetch(&kstackgen[slot], 1);
+  return pa;
+}
+
+// Flush this hart's translation of p's kernel stack if the
+// slot's stack was unmapped since it last did, before p
+// runs here. Called by scheduler().
+void
+kstack_sfence(struct proc *p)
+{
+  struct cpu *c = mycpu();
+  uint gen = __atomic_load_n(&kstackgen[p->slot], __ATOMIC_ACQUIRE);
+
+  if(c->kstackgen[p->slot] != gen){
+    sfence_vma_va(p->kstack);
+    c->kstackgen[p->slot] = gen;
+  }
 }
 
 // Return the address of the PTE in page table pagetable
@@ -77,24 +234,36 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
+//
+// A leaf PTE above level 0 maps a 2MB megapage (level 1) or
+// a 1GB gigapage (level 2); only the kernel page table has
+// them (see kvmmap), and walk() returns them as they are.
 pte_t *
 walk(pagetable_t pagetable, uint64 va, int alloc)
+{
+  return walklevel(pagetable, va, alloc, 0);
+}
+
+// walk() down to the PTE at level leaf.
+static pte_t *
+walklevel(pagetable_t pagetable, uint64 va, int alloc, int leaf)
 {
   if(va >= MAXVA)
     panic("walk");
 
-  for(int level = 2; level > 0; level--) {
+  for(int level = 2; level > leaf; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
     if(*pte & PTE_V) {
+      if(*pte & (PTE_R | PTE_W | PTE_X))
+        return pte;
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+      if(!alloc || (pagetable = (pde_t*)kzalloc()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
-  return &pagetable[PX(0, va)];
+  return &pagetable[PX(leaf, va)];
 }
 
 // Look up a virtual address, return the physical address,
@@ -120,14 +289,32 @@ walkaddr(pagetable_t pagetable, uint64 va)
   return pa;
 }
 
-// add a mapping to the kernel page table.
+// add a mapping to the kernel page table, using the largest
+// leaves (1GB, 2MB or 4KB) that the alignment of va and pa
+// and the size allow, to need fewer PTEs and TLB entries.
+// va and pa must be page-aligned.
 // only used when booting.
 // does not flush TLB or enable paging.
 void
 kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 {
-  if(mappages(kpgtbl, va, sz, pa, perm) != 0)
-    panic("kvmmap");
+  uint64 end = PGROUNDUP(va + sz), size;
+  pte_t *pte;
+  int level;
+
+  for(; va < end; va += size, pa += size){
+    for(level = 2; level > 0; level--){
+      size = 1L << PXSHIFT(level);
+      if(va % size == 0 && pa % size == 0 && end - va >= size)
+        break;
+    }
+    size = 1L << PXSHIFT(level);
+    if((pte = walklevel(kpgtbl, va, 1, level)) == 0)
+      panic("kvmmap");
+    if(*pte & PTE_V)
+      panic("kvmmap: remap");
+    *pte = PA2PTE(pa) | perm | PTE_V;
+  }
 }
 
 // Create PTEs for virtual addresses starting at va that refer to
@@ -156,34 +343,50 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
     a += PGSIZE;
     pa += PGSIZE;
   }
+  asid_invalidate(pagetable);
   return 0;
 }
 
 // Remove npages of mappings starting from va. va must be
-// page-aligned. The mappings must exist.
-// Optionally free the physical memory.
+// page-aligned. Pages that were never touched (see vmfault)
+// are skipped. Optionally free the physical memory.
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-  uint64 a;
+  uint64 a, pa[32];
   pte_t *pte;
+  int n = 0;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
+  // the pages are freed in batches, each once no hart's TLB
+  // maps them any more.
   for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
-    if((pte = walk(pagetable, a, 0)) == 0)
-      panic("uvmunmap: walk");
+    if((pte = walk(pagetable, a, 0)) == 0){
+      // no page-table page: a lazily grown heap can be
+      // mostly holes, so skip the rest of its 2MB.
+      a |= (1L << PXSHIFT(1)) - PGSIZE;
+      continue;
+    }
     if((*pte & PTE_V) == 0)
-      panic("uvmunmap: not mapped");
+      continue;
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
-    if(do_free){
-      uint64 pa = PTE2PA(*pte);
-      kfree((void*)pa);
-    }
+    if(do_free)
+      pa[n++] = PTE2PA(*pte);
     *pte = 0;
+    if(n == NELEM(pa)){
+      asid_invalidate(pagetable);
+      tlb_shootdown(pagetable);
+      while(n > 0)
+        kfree((void*)pa[--n]);
+    }
   }
+  asid_invalidate(pagetable);
+  tlb_shootdown(pagetable);
+  while(n > 0)
+    kfree((void*)pa[--n]);
 }
 
 // create an empty user page table.
@@ -192,10 +395,9 @@ pagetable_t
 uvmcreate()
 {
   pagetable_t pagetable;
-  pagetable = (pagetable_t) kalloc();
+  pagetable = (pagetable_t) kzalloc();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
   return pagetable;
 }
 
@@ -209,8 +411,7 @@ uvminit(pagetable_t pagetable, uchar *src, uint sz)
 
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
-  mem = kalloc();
-  memset(mem, 0, PGSIZE);
+  mem = kzalloc();
   mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_X|PTE_U);
   memmove(mem, src, sz);
 }
@@ -228,12 +429,11 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 
   oldsz = PGROUNDUP(oldsz);
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = kzalloc();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
@@ -291,35 +491,38 @@ uvmfree(pagetable_t pagetable, uint64 sz)
   freewalk(pagetable);
 }
 
-// Given a parent process's page table, copy
-// its memory into a child's page table.
-// Copies both the page table and the
-// physical memory.
+// Given a parent process's page table, share
+// its memory with a child's page table.
+// Writable pages become read-only and copy-on-write
+// in both; cowfault() copies one when it is written.
 // returns 0 on success, -1 on failure.
-// frees any allocated pages on failure.
+// drops the references it took on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 {
   pte_t *pte;
   uint64 pa, i;
   uint flags;
-  char *mem;
 
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walk(old, i, 0)) == 0)
-      panic("uvmcopy: pte should exist");
+    if((pte = walk(old, i, 0)) == 0){
+      i |= (1L << PXSHIFT(1)) - PGSIZE;   // nothing in this 2MB
+      continue;
+    }
     if((*pte & PTE_V) == 0)
-      panic("uvmcopy: page not present");
+      continue;   // not touched yet; the child faults it in too
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE2PA(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto err;
-    memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
-      kfree(mem);
+    if(mappages(new, i, PGSIZE, pa, flags) != 0)
       goto err;
-    }
+    kref((void*)pa);
   }
+  // the caller's old writable mappings may still be in
+  // the TLB, here and on harts running its other threads.
+  asid_invalidate(old);
+  tlb_shootdown(old);
   return 0;
 
  err:
@@ -327,6 +530,233 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   return -1;
 }
 
+// Give pagetable its own writable copy of the copy-on-write
+// page at va, after a store to it faulted. If no one else
+// shares the page any more, just make it writable again.
+// Returns 0, or -1 if va is not a copy-on-write user page
+// or there is no memory for the copy.
+int
+cowfault(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  uint flags;
+  char *mem;
+
+  if(va >= MAXVA)
+    return -1;
+  va = PGROUNDDOWN(va);
+  if((pte = walk(pagetable, va, 0)) == 0)
+    return -1;
+  if((*pte & (PTE_V | PTE_U | PTE_COW)) != (PTE_V | PTE_U | PTE_COW))
+    return -1;
+  pa = PTE2PA(*pte);
+  flags = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+
+  if(krefs((void*)pa) == 1){
+    *pte = PA2PTE(pa) | flags;
+  } else {
+    if((mem = kalloc()) == 0)
+      return -1;
+    memmove(mem, (char*)pa, PGSIZE);
+    *pte = PA2PTE(mem) | flags;
+    asid_invalidate(pagetable);
+    tlb_shootdown(pagetable);
+    kfree((void*)pa);
+  }
+  asid_invalidate(pagetable);
+  return 0;
+}
+
+// The segment of p's program image with file data at
+// page va, or 0.
+static struct execseg*
+execseg(struct proc *p, uint64 va)
+{
+  struct execseg *s;
+
+  for(s = p->seg; s < &p->seg[p->nseg]; s++)
+    if(va >= s->va && va < s->va + s->filesz)
+      return s;
+  return 0;
+}
+
+// Map page pa at va in p's page table with perm, unless
+// another thread of p got there first. Called with the page
+// already read, since that sleeps; p->glock keeps the check
+// and the mapping together. Drops pa if it isn't used.
+static int
+vmfault_map(struct proc *p, uint64 va, uint64 pa, int perm)
+{
+  pte_t *pte;
+  int r = 0;
+
+  acquire(&p->glock);
+  if((pte = walk(p->pagetable, va, 0)) != 0 && (*pte & PTE_V))
+    kfree((void*)pa);
+  else if(mappages(p->pagetable, va, PGSIZE, pa, perm) != 0){
+    kfree((void*)pa);
+    r = -1;
+  }
+  release(&p->glock);
+  return r;
+}
+
+// Handle a page fault at va in p's address space: a store to
+// a copy-on-write page, or the first touch of a page below
+// p->sz that exec() or growproc() only reserved. Program
+// pages are read from p->exe, which sleeps. write is set for
+// a store. A thread's faults are its group's. Returns 0 if
+// p can go on, -1 if the access is bad.
+int
+vmfault(struct proc *p, uint64 va, int write)
+{
+  pte_t *pte;
+  struct execseg *s;
+  char *mem;
+  uint64 pa;
+  int r, perm;
+
+  p = p->group;
+  if(va >= p->sz && mmap_find(p, va) == 0)
+    return -1;
+  va = PGROUNDDOWN(va);
+  acquire(&p->glock);
+  if((pte = walk(p->pagetable, va, 0)) != 0 && (*pte & PTE_V)){
+    perm = (write ? PTE_W : PTE_R | PTE_X) | PTE_U;
+    if((*pte & PTE_U) == 0)
+      r = -1;     // e.g. exec()'s stack guard page
+    else if(write && (*pte & PTE_COW))
+      r = cowfault(p->pagetable, va);
+    else if((*pte & perm) == perm)
+      r = 0;      // another thread faulted it in
+    else
+      r = -1;
+    release(&p->glock);
+    return r;
+  }
+  release(&p->glock);
+  if(va >= p->sz)
+    return -1;    // mmap() maps all pages up front
+
+  // a page of a cached program image is shared.
+  if((s = execseg(p, va)) != 0 && (pa = execcache_page(p->exe, s, va)) != 0)
+    return vmfault_map(p, va, pa, PTE_X|PTE_R|PTE_U|PTE_COW);
+
+  if((mem = kzalloc()) == 0)
+    return -1;
+  if(s != 0 && execreadpage(p->exe, s, va, mem) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return vmfault_map(p, va, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U);
+}
+
+// Load the pages of p's program image in [va, va+len) that
+// are not in memory yet. copyin/copyout would fault them in,
+// but can't sleep under the spinlocks some callers hold
+// (pipes, console, wait), or read p->exe while holding an
+// inode lock (readi); those system calls call this first.
+void
+vmprefault(struct proc *p, uint64 va, uint64 len)
+{
+  struct execseg *s;
+  uint64 a, end;
+  pte_t *pte;
+
+  p = p->group;
+  if(va + len < va)
+    return;
+  for(s = p->seg; s < &p->seg[p->nseg]; s++){
+    a = va > s->va ? PGROUNDDOWN(va) : s->va;
+    end = va + len < s->va + s->filesz ? va + len : s->va + s->filesz;
+    for(; a < end; a += PGSIZE){
+      pte = walk(p->pagetable, a, 0);
+      if(pte == 0 || (*pte & PTE_V) == 0)
+        vmfault(p, a, 0);
+    }
+  }
+}
+
+// Physical address of user page va for copyin/copyout,
+// first faulting it in as usertrap() would if the current
+// process touched it, and for a write breaking copy-on-write.
+// Returns 0 if it can't be accessed. Walks the page table
+// once unless it has to fault.
+uint64
+uvmaddr(pagetable_t pagetable, uint64 va, int write)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+
+  if(va >= MAXVA)
+    return 0;
+  pte = walk(pagetable, va, 0);
+  if(pte == 0 || (*pte & PTE_V) == 0){
+    if(p == 0 || p->pagetable != pagetable || vmfault(p, va, write) < 0)
+      return 0;
+    // the page may have come in as a shared, copy-on-write
+    // page of the program image; check it like any other.
+    if((pte = walk(pagetable, va, 0)) == 0 || (*pte & PTE_V) == 0)
+      return 0;
+  }
+  if(write && (*pte & PTE_COW)){
+    // vmfault() does it under the lock of the current
+    // process's thread group.
+    if(p != 0 && p->pagetable == pagetable){
+      if(vmfault(p, va, write) < 0)
+        return 0;
+    } else if(cowfault(pagetable, va) < 0)
+      return 0;
+  } else if(write && (*pte & PTE_W) == 0){
+    return 0;
+  }
+  if((*pte & PTE_U) == 0)
+    return 0;
+  return PTE2PA(*pte);
+}
+
+// Add the pages below page-table page pt, at level, to st.
+// Only descends into pages of RAM, so ^P can't be sent
+// astray by a page table exec() or exit() is freeing.
+static void
+uvmcount(pagetable_t pt, int level, struct memstat *st)
+{
+  uint64 pa;
+
+  st->ptpages++;
+  for(int i = 0; i < 512; i++){
+    pte_t pte = pt[i];
+    if((pte & PTE_V) == 0)
+      continue;
+    pa = PTE2PA(pte);
+    if(pa < KERNBASE || pa >= PHYSTOP)
+      continue;
+    if(pte & (PTE_R|PTE_W|PTE_X)){
+      if(pte & PTE_U){
+        st->rss++;
+        if(krefs((void*)pa) > 1)
+          st->shared++;
+      }
+    } else if(level > 0){
+      uvmcount((pagetable_t)pa, level - 1, st);
+    }
+  }
+}
+
+// Fill in the memory use of pagetable: user pages in memory,
+// those shared with another page table (copy-on-write or
+// MAP_SHARED), and page-table pages. The counts come from
+// the page table itself rather than from counters, because
+// sharing ends without the process doing anything, when the
+// other side exits or writes a copy-on-write page.
+void
+uvmstat(pagetable_t pagetable, struct memstat *st)
+{
+  st->rss = st->shared = st->ptpages = 0;
+  uvmcount(pagetable, 2, st);
+}
+
 // mark a PTE invalid for user access.
 // used by exec for the user stack guard page.
 void
@@ -338,6 +768,7 @@ uvmclear(pagetable_t pagetable, uint64 va)
   if(pte == 0)
     panic("uvmclear");
   *pte &= ~PTE_U;
+  asid_invalidate(pagetable);
 }
 
 // Copy from kernel to user.
@@ -350,7 +781,7 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmaddr(pagetable, va0, 1);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (dstva - va0);
@@ -375,7 +806,7 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmaddr(pagetable, va0, 0);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -402,7 +833,7 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmaddr(pagetable, va0, 0);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -411,6 +842,18 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 
     char *p = (char *) (pa0 + (srcva - va0));
     while(n > 0){
+      // 8 bytes at a time while none of them is a '\0'.
+      if(((uint64)p & 7) == 0 && n >= 8){
+        uint64 w = *(uint64*)p;
+        if(((w - 0x0101010101010101UL) & ~w & 0x8080808080808080UL) == 0){
+          memmove(dst, p, 8);
+          n -= 8;
+          max -= 8;
+          p += 8;
+          dst += 8;
+          continue;
+        }
+      }
       if(*p == '\0'){
         *dst = '\0';
         got_null = 1;
@@ -4,12 +4,15 @@
 #include <string.h>
 #include <fcntl.h>
 #include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define stat xv6_stat  // avoid clash with host struct stat
 #include "kernel/types.h"
 #include "kernel/fs.h"
 #include "kernel/stat.h"
 #include "kernel/param.h"
+#undef stat
 
 #ifndef static_assert
 #define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
@@ -19,16 +22,24 @@
 
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
-
-int nbitmap = FSSIZE/(BSIZE*8) + 1;
-int ninodeblocks = NINODES / IPB + 1;
+//
+// The image is built in memory, in a shared mapping of the
+// output file, which starts out as all zeroes; wsect() and
+// rsect() only copy. Each input file is read straight into
+// a run of blocks allocated for it in one go, so it is one
+// extent.
+
+uint fssize = FSSIZE;   // blocks, -s
+uint ninodes = NINODES; // -i
+int nbitmap;
+int ninodeblocks;
 int nlog = LOGSIZE;
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;  // Number of data blocks
 
 int fsfd;
+char *img;    // the image, fssize blocks
 struct superblock sb;
-char zeroes[BSIZE];
 uint freeinode = 1;
 uint freeblock;
 
@@ -40,6 +51,8 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+void icopy(uint inum, int fd, char *name);
+uint emap(struct dinode *din, uint fbn);
 void die(const char *);
 
 // convert to intel byte order
@@ -65,10 +78,17 @@ xint(uint x)
   return y;
 }
 
+void
+usage(void)
+{
+  fprintf(stderr, "Usage: mkfs [-s blocks] [-i inodes] fs.img files...\n");
+  exit(1);
+}
+
 int
 main(int argc, char *argv[])
 {
-  int i, cc, fd;
+  int i, fd, a;
   uint rootino, inum, off;
   struct dirent de;
   char buf[BSIZE];
@@ -77,39 +97,55 @@ main(int argc, char *argv[])
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
-  if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
-    exit(1);
+  for(a = 1; a < argc && argv[a][0] == '-'; a += 2){
+    if(argv[a][2] != 0 || a + 1 >= argc)
+      usage();
+    if(argv[a][1] == 's')
+      fssize = atoi(argv[a+1]);
+    else if(argv[a][1] == 'i')
+      ninodes = atoi(argv[a+1]);
+    else
+      usage();
   }
+  if(a >= argc || ninodes < 2)
+    usage();
 
   assert((BSIZE % sizeof(struct dinode)) == 0);
   assert((BSIZE % sizeof(struct dirent)) == 0);
 
-  fsfd = open(argv[1], O_RDWR|O_CREAT|O_TRUNC, 0666);
-  if(fsfd < 0)
-    die(argv[1]);
-
+  nbitmap = fssize/(BSIZE*8) + 1;
+  ninodeblocks = ninodes / IPB + 1;
   // 1 fs block = 1 disk sector
   nmeta = 2 + nlog + ninodeblocks + nbitmap;
-  nblocks = FSSIZE - nmeta;
+  if(fssize <= nmeta){
+    fprintf(stderr, "mkfs: %u blocks is too small\n", fssize);
+    exit(1);
+  }
+  nblocks = fssize - nmeta;
+
+  fsfd = open(argv[a], O_RDWR|O_CREAT|O_TRUNC, 0666);
+  if(fsfd < 0)
+    die(argv[a]);
+  if(ftruncate(fsfd, (off_t)fssize * BSIZE) < 0)
+    die("ftruncate");
+  img = mmap(0, (size_t)fssize * BSIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fsfd, 0);
+  if(img == MAP_FAILED)
+    die("mmap");
 
   sb.magic = FSMAGIC;
-  sb.size = xint(FSSIZE);
+  sb.size = xint(fssize);
   sb.nblocks = xint(nblocks);
-  sb.ninodes = xint(NINODES);
+  sb.ninodes = xint(ninodes);
   sb.nlog = xint(nlog);
   sb.logstart = xint(2);
   sb.inodestart = xint(2+nlog);
   sb.bmapstart = xint(2+nlog+ninodeblocks);
 
   printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
-         nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
+         nmeta, nlog, ninodeblocks, nbitmap, nblocks, fssize);
 
   freeblock = nmeta;     // the first free block that we can allocate
 
-  for(i = 0; i < FSSIZE; i++)
-    wsect(i, zeroes);
-
   memset(buf, 0, sizeof(buf));
   memmove(buf, &sb, sizeof(sb));
   wsect(1, buf);
@@ -127,7 +163,7 @@ main(int argc, char *argv[])
   strcpy(de.name, "..");
   iappend(rootino, &de, sizeof(de));
 
-  for(i = 2; i < argc; i++){
+  for(i = a + 1; i < argc; i++){
     // get rid of "user/"
     char *shortname;
     if(strncmp(argv[i], "user/", 5) == 0)
@@ -154,9 +190,7 @@ main(int argc, char *argv[])
     strncpy(de.name, shortname, DIRSIZ);
     iappend(rootino, &de, sizeof(de));
 
-    while((cc = read(fd, buf, sizeof(buf))) > 0)
-      iappend(inum, buf, cc);
-
+    icopy(inum, fd, argv[i]);
     close(fd);
   }
 
@@ -169,16 +203,17 @@ main(int argc, char *argv[])
 
   balloc(freeblock);
 
+  if(munmap(img, (size_t)fssize * BSIZE) < 0)
+    die("munmap");
+  close(fsfd);
   exit(0);
 }
 
 void
 wsect(uint sec, void *buf)
 {
-  if(lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE)
-    die("lseek");
-  if(write(fsfd, buf, BSIZE) != BSIZE)
-    die("write");
+  assert(sec < fssize);
+  memmove(img + (size_t)sec * BSIZE, buf, BSIZE);
 }
 
 void
@@ -211,10 +246,8 @@ rinode(uint inum, struct dinode *ip)
 void
 rsect(uint sec, void *buf)
 {
-  if(lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE)
-    die("lseek");
-  if(read(fsfd, buf, BSIZE) != BSIZE)
-    die("read");
+  assert(sec < fssize);
+  memmove(buf, img + (size_t)sec * BSIZE, BSIZE);
 }
 
 uint
@@ -223,6 +256,11 @@ ialloc(ushort type)
   uint inum = freeinode++;
   struct dinode din;
 
+  if(inum >= ninodes){
+    fprintf(stderr, "mkfs: out of inodes\n");
+    exit(1);
+  }
+
   bzero(&din, sizeof(din));
   din.type = xshort(type);
   din.nlink = xshort(1);
@@ -231,24 +269,90 @@ ialloc(ushort type)
   return inum;
 }
 
+// Mark blocks 0..used-1 allocated. The bitmap blocks are
+// consecutive, so bit i is bit i of the whole run.
 void
 balloc(int used)
 {
-  uchar buf[BSIZE];
+  uchar *bitmap = (uchar*)img + (size_t)xint(sb.bmapstart) * BSIZE;
   int i;
 
   printf("balloc: first %d blocks have been allocated\n", used);
-  assert(used < BSIZE*8);
-  bzero(buf, BSIZE);
-  for(i = 0; i < used; i++){
-    buf[i/8] = buf[i/8] | (0x1 << (i%8));
+  assert(used <= fssize);
+  memset(bitmap, 0xff, used / 8);
+  for(i = used / 8 * 8; i < used; i++)
+    bitmap[i/8] |= 0x1 << (i%8);
+  printf("balloc: write bitmap blocks at sector %d\n", xint(sb.bmapstart));
+}
+
+// Take n consecutive blocks.
+uint
+bspan(uint n)
+{
+  uint b = freeblock;
+
+  if(freeblock + n > fssize){
+    fprintf(stderr, "mkfs: out of blocks\n");
+    exit(1);
   }
-  printf("balloc: write bitmap block at sector %d\n", sb.bmapstart);
-  wsect(sb.bmapstart, buf);
+  freeblock += n;
+  return b;
 }
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// Disk block of block fbn of din, allocating it if fbn is
+// just past the end. Files are written one after another
+// here, so each usually is a single extent.
+uint
+emap(struct dinode *din, uint fbn)
+{
+  struct extent ind[NINDEXT], *e, *last = 0;
+  uint base = 0, x;
+  int i, inind = 0;
+
+  for(i = 0; i < NEXTENT && xint(din->ext[i].len); i++){
+    e = &din->ext[i];
+    if(fbn < base + xint(e->len))
+      return xint(e->start) + fbn - base;
+    base += xint(e->len);
+    last = e;
+  }
+  if(i == NEXTENT && xint(din->indirect)){
+    rsect(xint(din->indirect), (char*)ind);
+    for(i = 0; i < NINDEXT && xint(ind[i].len); i++){
+      e = &ind[i];
+      if(fbn < base + xint(e->len))
+        return xint(e->start) + fbn - base;
+      base += xint(e->len);
+      last = e;
+      inind = 1;
+    }
+  }
+  assert(fbn == base);
+
+  x = bspan(1);
+  if(last && xint(last->start) + xint(last->len) == x){
+    last->len = xint(xint(last->len) + 1);
+    if(inind)
+      wsect(xint(din->indirect), (char*)ind);
+  } else if(!inind && i < NEXTENT){
+    din->ext[i].start = xint(x);
+    din->ext[i].len = xint(1);
+  } else {
+    if(xint(din->indirect) == 0){
+      din->indirect = xint(bspan(1));
+      bzero(ind, sizeof(ind));
+      i = 0;
+    }
+    assert(i < NINDEXT);
+    ind[i].start = xint(x);
+    ind[i].len = xint(1);
+    wsect(xint(din->indirect), (char*)ind);
+  }
+  return x;
+}
+
 void
 iappend(uint inum, void *xp, int n)
 {
@@ -256,7 +360,6 @@ iappend(uint inum, void *xp, int n)
   uint fbn, off, n1;
   struct dinode din;
   char buf[BSIZE];
-  uint indirect[NINDIRECT];
   uint x;
 
   rinode(inum, &din);
@@ -265,22 +368,7 @@ iappend(uint inum, void *xp, int n)
   while(n > 0){
     fbn = off / BSIZE;
     assert(fbn < MAXFILE);
-    if(fbn < NDIRECT){
-      if(xint(din.addrs[fbn]) == 0){
-        din.addrs[fbn] = xint(freeblock++);
-      }
-      x = xint(din.addrs[fbn]);
-    } else {
-      if(xint(din.addrs[NDIRECT]) == 0){
-        din.addrs[NDIRECT] = xint(freeblock++);
-      }
-      rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      if(indirect[fbn - NDIRECT] == 0){
-        indirect[fbn - NDIRECT] = xint(freeblock++);
-        wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-      }
-      x = xint(indirect[fbn-NDIRECT]);
-    }
+    x = emap(&din, fbn);
     n1 = min(n, (fbn + 1) * BSIZE - off);
     rsect(x, buf);
     bcopy(p, buf + off - (fbn * BSIZE), n1);
@@ -293,6 +381,37 @@ iappend(uint inum, void *xp, int n)
   winode(inum, &din);
 }
 
+// Fill the new, empty file inum with the contents of fd:
+// read it straight into one run of blocks, its one extent.
+void
+icopy(uint inum, int fd, char *name)
+{
+  struct stat st;
+  struct dinode din;
+  uint n, x;
+  ssize_t cc;
+  size_t off;
+
+  if(fstat(fd, &st) < 0)
+    die(name);
+  n = (st.st_size + BSIZE - 1) / BSIZE;
+  if(n > MAXFILE){
+    fprintf(stderr, "mkfs: %s is too big\n", name);
+    exit(1);
+  }
+  rinode(inum, &din);
+  if(n > 0){
+    x = bspan(n);
+    for(off = 0; off < st.st_size; off += cc)
+      if((cc = read(fd, img + (size_t)x * BSIZE + off, st.st_size - off)) <= 0)
+        die(name);
+    din.ext[0].start = xint(x);
+    din.ext[0].len = xint(n);
+  }
+  din.size = xint(st.st_size);
+  winode(inum, &din);
+}
+
 void
 die(const char *s)
 {
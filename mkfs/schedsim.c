@@ -0,0 +1,496 @@
+// schedsim: replay a scheduling trace through models of the
+// scheduling policies, on the host.
+//
+//   schedsim [-c harts] [-q cycles] < console.log
+//
+// Reads the "sev ..." lines user/schedlog prints, rebuilds
+// each process as its arrival, static priority and a list
+// of cpu bursts separated by sleeps, prints what the traced
+// kernel achieved, and then what RR, FCFS, PBS and MLFQ
+// would have achieved on harts (by default as many as the
+// trace used) with a tick of cycles (TICKCYCLES).
+//
+// The replay is open loop: a process sleeps for as long as
+// it did in the trace, whatever the others do, so waits on
+// each other (pipes, wait()) are not modelled. The models
+// use one global queue rather than per-hart queues.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/schedtrace.h"
+
+#define MAXEV   (1 << 20)
+#define MAXJOB  1024
+#define INF     (~0ULL)
+
+enum { RR, FCFS, PBS, MLFQ, NMODEL };
+static char *models[NMODEL] = {"rr", "fcfs", "pbs", "mlfq"};
+
+// MLFQ defaults, as in kernel/mlfq.c. A job's slice at a
+// level is an allotment kept across its sleeps.
+static const uint64 mlfq_ticks[NMLFQ] = {1, 2, 4, 8, 16};
+static const uint64 mlfq_maxwait[NMLFQ] = {0, 10, 30, 100, 150};
+
+struct ev {
+  uint64 time;
+  int pid, type, cpu, prio;
+  int seq;                          // input order, for a stable sort
+};
+
+struct job {
+  int pid;
+  int prio;                         // PBS static priority
+  uint64 arrive;
+  int nburst, cap;
+  uint64 *burst;                    // cpu cycles of each burst
+  uint64 *sleep;                    // cycles asleep after burst i
+
+  // as traced
+  uint64 rdone, rfirst, rwait;
+
+  // model state
+  int state, b, level, nsched, started;
+  uint64 left, ready_at, since, sliceused, seq;
+  uint64 first, done, wait;
+  uint64 runacc;                    // cycles run in this burst
+  uint64 lastrun, lastsleep;        // PBS niceness inputs
+};
+
+enum { FUTURE, READY, RUNNING, ASLEEP, DONE };
+
+static struct ev evs[MAXEV];
+static int nev;
+static struct job jobs[MAXJOB];
+static int njob;
+static int ncpu = 0;
+static uint64 quantum = TICKCYCLES;
+
+static int
+evcmp(const void *a, const void *b)
+{
+  const struct ev *x = a, *y = b;
+
+  if(x->time != y->time)
+    return x->time < y->time ? -1 : 1;
+  return x->seq - y->seq;
+}
+
+static int
+evtype(char *s)
+{
+  static char *names[NSEV] = {
+    [SEV_NEW] "new", [SEV_PICK] "pick", [SEV_PREEMPT] "preempt",
+    [SEV_SLEEP] "sleep", [SEV_WAKEUP] "wakeup", [SEV_PRIO] "prio",
+    [SEV_EXIT] "exit",
+  };
+
+  for(int i = 1; i < NSEV; i++)
+    if(strcmp(s, names[i]) == 0)
+      return i;
+  return 0;
+}
+
+static void
+readtrace(FILE *f)
+{
+  char line[512], name[32], *s;
+  unsigned long long t;
+  int tick, cpu, pid, policy, queue, prio, maxcpu = -1;
+  long lost = 0;
+
+  while(fgets(line, sizeof(line), f)){
+    if((s = strstr(line, "sev lost=")) != 0){
+      lost += atol(s + 9);
+      continue;
+    }
+    if((s = strstr(line, "sev time=")) == 0)
+      continue;
+    if(sscanf(s, "sev time=%llu tick=%d cpu=%d pid=%d ev=%31s policy=%d queue=%d prio=%d",
+              &t, &tick, &cpu, &pid, name, &policy, &queue, &prio) != 8)
+      continue;
+    if(nev == MAXEV){
+      fprintf(stderr, "schedsim: more than %d events, rest ignored\n", MAXEV);
+      break;
+    }
+    evs[nev] = (struct ev){t, pid, evtype(name), cpu, prio, nev};
+    nev++;
+    if(cpu > maxcpu)
+      maxcpu = cpu;
+  }
+  if(lost)
+    fprintf(stderr, "schedsim: the trace lost %ld events\n", lost);
+  qsort(evs, nev, sizeof(evs[0]), evcmp);
+  if(ncpu == 0)
+    ncpu = maxcpu + 1 > 0 ? maxcpu + 1 : 1;
+}
+
+static struct job*
+jobof(int pid)
+{
+  for(int i = 0; i < njob; i++)
+    if(jobs[i].pid == pid)
+      return &jobs[i];
+  if(njob == MAXJOB)
+    return 0;
+  memset(&jobs[njob], 0, sizeof(jobs[0]));
+  jobs[njob].pid = pid;
+  jobs[njob].prio = 60;
+  jobs[njob].rfirst = INF;
+  return &jobs[njob++];
+}
+
+// Append a burst of c cycles to j, with no sleep after it yet.
+static void
+addburst(struct job *j, uint64 c)
+{
+  if(j->nburst == j->cap){
+    j->cap = j->cap ? 2 * j->cap : 16;
+    j->burst = realloc(j->burst, j->cap * sizeof(uint64));
+    j->sleep = realloc(j->sleep, j->cap * sizeof(uint64));
+    if(j->burst == 0 || j->sleep == 0){
+      fprintf(stderr, "schedsim: out of memory\n");
+      exit(1);
+    }
+  }
+  j->sleep[j->nburst] = 0;
+  j->burst[j->nburst++] = c;
+}
+
+// Cut each process's events into bursts and sleeps, and
+// measure the traced run on the way.
+static void
+buildjobs(void)
+{
+  static uint64 runstart[MAXJOB], sleepstart[MAXJOB], readysince[MAXJOB], cur[MAXJOB];
+  static char seen[MAXJOB], running[MAXJOB], picked[MAXJOB], exited[MAXJOB];
+  struct job *j;
+  struct ev *e;
+  int k;
+
+  for(int i = 0; i < nev; i++){
+    e = &evs[i];
+    if((j = jobof(e->pid)) == 0)
+      continue;
+    k = j - jobs;
+    if(exited[k])
+      continue;
+    if(!seen[k]){
+      seen[k] = 1;
+      j->arrive = e->time;
+      readysince[k] = e->time;
+    }
+    switch(e->type){
+    case SEV_NEW:
+    case SEV_PRIO:
+      if(!picked[k])
+        j->prio = e->prio;
+      break;
+    case SEV_PICK:
+      j->rwait += e->time - readysince[k];
+      if(j->rfirst == INF)
+        j->rfirst = e->time;
+      picked[k] = running[k] = 1;
+      runstart[k] = e->time;
+      break;
+    case SEV_PREEMPT:
+    case SEV_SLEEP:
+    case SEV_EXIT:
+      if(running[k]){
+        cur[k] += e->time - runstart[k];
+        running[k] = 0;
+      }
+      readysince[k] = e->time;
+      if(e->type == SEV_SLEEP){
+        addburst(j, cur[k]);
+        cur[k] = 0;
+        sleepstart[k] = e->time;
+      } else if(e->type == SEV_EXIT){
+        addburst(j, cur[k]);
+        j->rdone = e->time;
+        exited[k] = 1;
+      }
+      break;
+    case SEV_WAKEUP:
+      if(j->nburst > 0)
+        j->sleep[j->nburst - 1] = e->time - sleepstart[k];
+      readysince[k] = e->time;
+      break;
+    }
+  }
+  // processes still alive at the end of the trace exit there.
+  for(k = 0; k < njob; k++){
+    if(exited[k])
+      continue;
+    if(running[k])
+      cur[k] += evs[nev-1].time - runstart[k];
+    addburst(&jobs[k], cur[k]);
+    jobs[k].rdone = evs[nev-1].time;
+  }
+}
+
+// PSBPriority() of kernel/pbs.c, from the last run and sleep.
+static int
+pbsprio(struct job *j)
+{
+  int nice = 5, v;
+
+  if(j->lastrun + j->lastsleep > 0)
+    nice = j->lastsleep * 10 / (j->lastrun + j->lastsleep);
+  v = j->prio - nice + 5;
+  return v < 0 ? 0 : v > 100 ? 100 : v;
+}
+
+// Negative if a should run before b under model m.
+static int
+before(int m, struct job *a, struct job *b)
+{
+  int pa, pb;
+
+  switch(m){
+  case FCFS:
+    if(a->arrive != b->arrive)
+      return a->arrive < b->arrive ? -1 : 1;
+    return a->pid - b->pid;
+  case PBS:
+    pa = pbsprio(a);
+    pb = pbsprio(b);
+    if(pa != pb)
+      return pa - pb;
+    if(a->nsched != b->nsched)
+      return a->nsched - b->nsched;
+    if(a->arrive != b->arrive)
+      return a->arrive < b->arrive ? -1 : 1;
+    return a->pid - b->pid;
+  case MLFQ:
+    if(a->level != b->level)
+      return a->level - b->level;
+    break;
+  }
+  return a->seq < b->seq ? -1 : 1;
+}
+
+static uint64
+slice(int m, struct job *j)
+{
+  if(m == RR)
+    return quantum;
+  if(m == MLFQ)
+    return mlfq_ticks[j->level] * quantum;
+  return INF;
+}
+
+static uint64 seqno;
+
+static void
+makeready(struct job *j, uint64 now)
+{
+  j->state = READY;
+  j->since = now;
+  j->seq = seqno++;
+}
+
+struct result {
+  double turnaround, wait, response;
+  uint64 maxturn, makespan;
+  long nsched;
+};
+
+static void
+report(char *name, struct result *r)
+{
+  printf("model=%s harts=%d jobs=%d avg_turnaround=%.2f avg_wait=%.2f avg_response=%.2f "
+         "max_turnaround=%.2f makespan=%.2f switches=%ld\n",
+         name, ncpu, njob, r->turnaround / njob / quantum, r->wait / njob / quantum,
+         r->response / njob / quantum, (double)r->maxturn / quantum,
+         (double)r->makespan / quantum, r->nsched);
+}
+
+static void
+simulate(int m)
+{
+  struct job *run[NCPU], *j, *best;
+  struct result r = {0};
+  uint64 now = evs[0].time, next, t, dt, start = now, lastboost = now;
+  int ndone = 0;
+
+  if(ncpu > NCPU)
+    ncpu = NCPU;
+  for(int c = 0; c < ncpu; c++)
+    run[c] = 0;
+  for(j = jobs; j < &jobs[njob]; j++){
+    j->state = FUTURE;
+    j->ready_at = j->arrive;
+    j->b = j->level = j->nsched = j->started = 0;
+    j->left = j->burst[0];
+    j->sliceused = j->wait = j->runacc = j->lastrun = j->lastsleep = 0;
+  }
+
+  while(ndone < njob){
+    // MLFQ boost: every job back to queue 0.
+    if(m == MLFQ && MLFQBOOST && now - lastboost >= MLFQBOOST * quantum){
+      lastboost = now;
+      for(j = jobs; j < &jobs[njob]; j++){
+        j->level = 0;
+        j->sliceused = 0;
+        if(j->state == READY)
+          makeready(j, now);
+      }
+    }
+    for(j = jobs; j < &jobs[njob]; j++){
+      if((j->state == FUTURE || j->state == ASLEEP) && j->ready_at <= now){
+        if(j->state == ASLEEP && m != MLFQ)
+          j->sliceused = 0;
+        makeready(j, now);
+      }
+      // MLFQ aging; ticks - time_added > Max_wait.
+      if(m == MLFQ && j->state == READY && j->level > 0 &&
+         now - j->since > mlfq_maxwait[j->level] * quantum){
+        j->level--;
+        j->sliceused = 0;
+        makeready(j, now);
+      }
+    }
+
+    for(int c = 0; c < ncpu; c++){
+      if(run[c])
+        continue;
+      best = 0;
+      for(j = jobs; j < &jobs[njob]; j++)
+        if(j->state == READY && (best == 0 || before(m, j, best) < 0))
+          best = j;
+      if(best == 0)
+        break;
+      best->state = RUNNING;
+      best->wait += now - best->since;
+      best->nsched++;
+      r.nsched++;
+      if(!best->started){
+        best->started = 1;
+        best->first = now;
+      }
+      run[c] = best;
+    }
+
+    next = INF;
+    for(int c = 0; c < ncpu; c++){
+      if((j = run[c]) == 0)
+        continue;
+      t = slice(m, j);
+      t = t == INF ? j->left : t - j->sliceused < j->left ? t - j->sliceused : j->left;
+      if(now + t < next)
+        next = now + t;
+    }
+    for(j = jobs; j < &jobs[njob]; j++){
+      if((j->state == FUTURE || j->state == ASLEEP) && j->ready_at < next)
+        next = j->ready_at;
+      if(m == MLFQ && j->state == READY && j->level > 0 &&
+         j->since + mlfq_maxwait[j->level] * quantum + 1 < next)
+        next = j->since + mlfq_maxwait[j->level] * quantum + 1;
+    }
+    if(m == MLFQ && MLFQBOOST && next != INF && lastboost + MLFQBOOST * quantum < next)
+      next = lastboost + MLFQBOOST * quantum;
+    if(next == INF)
+      break;
+    if(next < now)
+      next = now;
+    dt = next - now;
+    now = next;
+
+    for(int c = 0; c < ncpu; c++){
+      if((j = run[c]) == 0)
+        continue;
+      j->left -= dt;
+      j->sliceused += dt;
+      j->runacc += dt;
+      if(j->left == 0){
+        run[c] = 0;
+        if(m != MLFQ)
+          j->sliceused = 0;
+        j->lastrun = j->runacc;
+        j->runacc = 0;
+        if(++j->b >= j->nburst){
+          j->state = DONE;
+          j->done = now;
+          ndone++;
+          continue;
+        }
+        j->state = ASLEEP;
+        j->lastsleep = j->sleep[j->b - 1];
+        j->ready_at = now + j->lastsleep;
+        j->left = j->burst[j->b];
+      } else if(j->sliceused >= slice(m, j)){
+        run[c] = 0;
+        j->sliceused = 0;
+        if(m == MLFQ && j->level < NMLFQ - 1)
+          j->level++;
+        makeready(j, now);
+      }
+    }
+  }
+
+  for(j = jobs; j < &jobs[njob]; j++){
+    r.turnaround += j->done - j->arrive;
+    r.wait += j->wait;
+    r.response += j->first - j->arrive;
+    if(j->done - j->arrive > r.maxturn)
+      r.maxturn = j->done - j->arrive;
+    if(j->done - start > r.makespan)
+      r.makespan = j->done - start;
+  }
+  report(models[m], &r);
+}
+
+static void
+traced(void)
+{
+  struct result r = {0};
+  struct job *j;
+  uint64 start = evs[0].time;
+
+  for(j = jobs; j < &jobs[njob]; j++){
+    r.turnaround += j->rdone - j->arrive;
+    r.wait += j->rwait;
+    r.response += (j->rfirst == INF ? j->rdone : j->rfirst) - j->arrive;
+    if(j->rdone - j->arrive > r.maxturn)
+      r.maxturn = j->rdone - j->arrive;
+    if(j->rdone - start > r.makespan)
+      r.makespan = j->rdone - start;
+  }
+  for(int i = 0; i < nev; i++)
+    r.nsched += evs[i].type == SEV_PICK;
+  report("traced", &r);
+}
+
+int
+main(int argc, char *argv[])
+{
+  for(int i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+      ncpu = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+      quantum = strtoull(argv[++i], 0, 10);
+    else {
+      fprintf(stderr, "usage: schedsim [-c harts] [-q cycles] < trace\n");
+      exit(1);
+    }
+  }
+  if(quantum == 0)
+    quantum = TICKCYCLES;
+
+  readtrace(stdin);
+  if(nev == 0){
+    fprintf(stderr, "schedsim: no sev records\n");
+    exit(1);
+  }
+  buildjobs();
+  printf("config events=%d jobs=%d harts=%d tick=%llu (times in ticks)\n",
+         nev, njob, ncpu, (unsigned long long)quantum);
+  traced();
+  for(int m = 0; m < NMODEL; m++)
+    simulate(m);
+  return 0;
+}
@@ -4,11 +4,17 @@
 
 char buf[512];
 
+// Copy fd to the output inside the kernel with splice();
+// fall back to read and write if it fails.
 void
 cat(int fd)
 {
   int n;
 
+  while((n = splice(fd, 1, 4096)) > 0)
+    ;
+  if(n == 0)
+    return;
   while((n = read(fd, buf, sizeof(buf))) > 0) {
     if (write(1, buf, n) != n) {
       fprintf(2, "cat: write error\n");
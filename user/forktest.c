@@ -3,9 +3,10 @@
 
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/param.h"
 #include "user/user.h"
 
-#define N  1000
+#define N  (NPROC + 10)
 
 void
 print(const char *s)
@@ -0,0 +1,267 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+// fsbench [-s kb,kb,...] [-b bs] [-n files] [-d depth] [-l lookups]
+//
+// File system benchmark, in a directory fsb it makes and
+// removes again:
+//   seq    write then read a file of each size (64, 256 and
+//          1024 KB by default) in bs byte requests (4096);
+//          the write includes the sync() that commits it.
+//   rand   the same number of bs requests at random aligned
+//          offsets in the file, with lseek().
+//   meta   create, mkdir and unlink rates over files (100)
+//          entries of one directory.
+//   lookup open() and close() of a file depth levels down,
+//          for each depth from 1 to depth (8), lookups times
+//          (100), so the cost per path component shows.
+// Times are from the time CSR. One record per line, fields
+// as key=value; bandwidth is KB/s, rates are ops/s.
+
+#define MAXBS   8192
+#define MAXSIZE 16
+
+int sizes[MAXSIZE] = {64, 256, 1024}, nsize = 3;
+int bs = 4096;
+int nfiles = 100;
+int maxdepth = 8;
+int nlookup = 100;
+
+char buf[MAXBS];
+uint rnd = 1;
+
+static uint
+rand(void)
+{
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 17;
+  rnd ^= rnd << 5;
+  return rnd;
+}
+
+static void
+die(char *what)
+{
+  fprintf(2, "fsbench: %s failed\n", what);
+  exit(1);
+}
+
+static uint64
+us(uint64 cycles)
+{
+  return cycles * 1000000 / TIMEBASE;
+}
+
+// n things in cycles, per second.
+static uint64
+rate(uint64 n, uint64 cycles)
+{
+  return cycles ? n * TIMEBASE / cycles : 0;
+}
+
+static void
+seq(int kb)
+{
+  int fd, n = kb * 1024 / bs;
+  uint64 t;
+
+  if((fd = open("file", O_CREATE | O_TRUNC | O_RDWR)) < 0)
+    die("create");
+  t = rdtime();
+  for(int i = 0; i < n; i++)
+    if(write(fd, buf, bs) != bs)
+      die("write");
+  sync();
+  t = rdtime() - t;
+  printf("seq op=write size=%d bs=%d us=%l kbps=%l\n", kb, bs, us(t), rate(kb, t));
+
+  if(lseek(fd, 0, SEEK_SET) != 0)
+    die("lseek");
+  t = rdtime();
+  for(int i = 0; i < n; i++)
+    if(read(fd, buf, bs) != bs)
+      die("read");
+  t = rdtime() - t;
+  printf("seq op=read size=%d bs=%d us=%l kbps=%l\n", kb, bs, us(t), rate(kb, t));
+  close(fd);
+}
+
+// The file from seq() is still there, kb long.
+static void
+randio(int kb)
+{
+  int fd, n = kb * 1024 / bs;
+  uint64 t;
+
+  if((fd = open("file", O_RDWR)) < 0)
+    die("open");
+  t = rdtime();
+  for(int i = 0; i < n; i++){
+    if(lseek(fd, rand() % n * bs, SEEK_SET) < 0 || write(fd, buf, bs) != bs)
+      die("write");
+  }
+  sync();
+  t = rdtime() - t;
+  printf("rand op=write size=%d bs=%d us=%l kbps=%l\n", kb, bs, us(t), rate(kb, t));
+
+  t = rdtime();
+  for(int i = 0; i < n; i++){
+    if(lseek(fd, rand() % n * bs, SEEK_SET) < 0 || read(fd, buf, bs) != bs)
+      die("read");
+  }
+  t = rdtime() - t;
+  printf("rand op=read size=%d bs=%d us=%l kbps=%l\n", kb, bs, us(t), rate(kb, t));
+  close(fd);
+  unlink("file");
+}
+
+static void
+name(char *s, char c, int i)
+{
+  s[0] = c;
+  s[1] = '0' + i / 100 % 10;
+  s[2] = '0' + i / 10 % 10;
+  s[3] = '0' + i % 10;
+  s[4] = 0;
+}
+
+static void
+meta(void)
+{
+  char s[8];
+  uint64 t;
+  int fd;
+
+  t = rdtime();
+  for(int i = 0; i < nfiles; i++){
+    name(s, 'f', i);
+    if((fd = open(s, O_CREATE | O_RDWR)) < 0)
+      die("create");
+    close(fd);
+  }
+  t = rdtime() - t;
+  printf("meta op=create n=%d us=%l ops=%l\n", nfiles, us(t), rate(nfiles, t));
+
+  t = rdtime();
+  for(int i = 0; i < nfiles; i++){
+    name(s, 'd', i);
+    if(mkdir(s) < 0)
+      die("mkdir");
+  }
+  t = rdtime() - t;
+  printf("meta op=mkdir n=%d us=%l ops=%l\n", nfiles, us(t), rate(nfiles, t));
+
+  t = rdtime();
+  for(int i = 0; i < nfiles; i++){
+    name(s, 'f', i);
+    if(unlink(s) < 0)
+      die("unlink");
+    name(s, 'd', i);
+    if(unlink(s) < 0)
+      die("unlink");
+  }
+  t = rdtime() - t;
+  printf("meta op=unlink n=%d us=%l ops=%l\n", 2 * nfiles, us(t), rate(2 * nfiles, t));
+}
+
+// open file at the bottom of a chain of depth directories
+// d/d/.../file, one level deeper each round.
+static void
+lookup(void)
+{
+  char path[MAXPATH];
+  int len = 0, fd;
+  uint64 t;
+
+  for(int depth = 1; depth <= maxdepth && len + 7 < MAXPATH; depth++){
+    memmove(path + len, "d", 2);
+    if(mkdir(path) < 0)
+      die("mkdir");
+    len += 1;
+    memmove(path + len, "/file", 6);
+    if((fd = open(path, O_CREATE | O_RDWR)) < 0)
+      die("create");
+    close(fd);
+
+    t = rdtime();
+    for(int i = 0; i < nlookup; i++){
+      if((fd = open(path, O_RDONLY)) < 0)
+        die("open");
+      close(fd);
+    }
+    t = rdtime() - t;
+    printf("lookup depth=%d n=%d us=%l ns_per_open=%l\n", depth, nlookup, us(t),
+           t * (1000000000 / TIMEBASE) / nlookup);
+
+    unlink(path);
+    path[len++] = '/';
+    path[len] = 0;
+  }
+
+  // remove the chain from the bottom up.
+  while(len > 0){
+    path[--len] = 0;
+    if(len > 0 && path[len - 1] == 'd' && unlink(path) < 0)
+      die("unlink");
+    while(len > 0 && path[len - 1] != '/')
+      len--;
+  }
+}
+
+static void
+usage(void)
+{
+  fprintf(2, "usage: fsbench [-s kb,kb,...] [-b bs] [-n files] [-d depth] [-l lookups]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  for(int i = 1; i < argc; i++){
+    if(argv[i][0] != '-' || argv[i][2] != 0 || i + 1 >= argc)
+      usage();
+    switch(argv[i][1]){
+    case 's':
+      nsize = 0;
+      for(char *s = argv[++i]; *s && nsize < MAXSIZE; ){
+        sizes[nsize++] = atoi(s);
+        while(*s && *s != ',')
+          s++;
+        if(*s == ',')
+          s++;
+      }
+      break;
+    case 'b': bs = atoi(argv[++i]); break;
+    case 'n': nfiles = atoi(argv[++i]); break;
+    case 'd': maxdepth = atoi(argv[++i]); break;
+    case 'l': nlookup = atoi(argv[++i]); break;
+    default: usage();
+    }
+  }
+  if(bs < 1 || bs > MAXBS || nfiles < 1 || nfiles > 999 || nlookup < 1)
+    usage();
+
+  for(int i = 0; i < bs; i++)
+    buf[i] = i;
+  if(mkdir("fsb") < 0 || chdir("fsb") < 0)
+    die("mkdir fsb");
+  printf("config sizes=%d bs=%d files=%d depth=%d lookups=%d\n",
+         nsize, bs, nfiles, maxdepth, nlookup);
+
+  for(int i = 0; i < nsize; i++){
+    if(sizes[i] * 1024 / bs < 1)
+      continue;
+    seq(sizes[i]);
+    randio(sizes[i]);
+  }
+  meta();
+  lookup();
+
+  if(chdir("..") < 0 || unlink("fsb") < 0)
+    die("rmdir fsb");
+  exit(0);
+}
@@ -0,0 +1,209 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+// ipcbench [-n iters] [-m megabytes]
+//
+// Basic costs, timed with the time CSR:
+//   syscall  a null system call (trap_getpid, which traps,
+//            unlike the vDSO getpid)
+//   yield    a context switch: two processes sched_yield()
+//            to each other
+//   pingpong a one byte round trip over two pipes, through
+//            sleep(), wakeup(), sched() and swtch()
+//   pipe     bandwidth of one writer and one reader for
+//            writes of 64 bytes to 4 KB
+// The two-process tests run once with both processes pinned
+// to hart 0 and, if there is more than one hart, once on
+// harts 0 and 1. Compare kernels built with different CPUS=
+// by running it under each. One record per line, fields as
+// key=value.
+
+int iters = 2000;
+int megabytes = 4;
+int ncpu;
+
+char buf[4096];
+
+static void
+die(char *what)
+{
+  fprintf(2, "ipcbench: %s failed\n", what);
+  exit(1);
+}
+
+static uint64
+ns(uint64 cycles)
+{
+  return cycles * (1000000000 / TIMEBASE);
+}
+
+// The online harts: sched_setaffinity() refuses a mask of
+// only harts that are not running.
+static int
+countcpus(void)
+{
+  int n = 0, old = sched_setaffinity(0, 0);
+
+  for(int i = 0; i < NCPU; i++)
+    if(sched_setaffinity(0, 1 << i) >= 0)
+      n++;
+  sched_setaffinity(0, old);
+  return n;
+}
+
+static void
+nullsyscall(void)
+{
+  uint64 t = rdtime();
+
+  for(int i = 0; i < iters; i++)
+    trap_getpid();
+  t = rdtime() - t;
+  printf("syscall n=%d ns=%l\n", iters, ns(t) / iters);
+}
+
+// Fork a child on hart cpu running fn(arg); the caller is
+// moved to hart 0. The caller wait()s for it.
+static void
+spawnon(int cpu, void (*fn)(int*), int *arg)
+{
+  int pid;
+
+  sched_setaffinity(0, 1);
+  if((pid = fork()) < 0)
+    die("fork");
+  if(pid == 0){
+    sched_setaffinity(0, 1 << cpu);
+    fn(arg);
+    exit(0);
+  }
+}
+
+static void
+yielder(int *unused)
+{
+  for(int i = 0; i < iters; i++)
+    sched_yield();
+}
+
+// Both on one hart, so each yield switches to the other.
+static void
+yieldtest(void)
+{
+  uint64 t;
+
+  spawnon(0, yielder, 0);
+  t = rdtime();
+  yielder(0);
+  t = rdtime() - t;
+  wait(0);
+  printf("yield harts=1 n=%d ns_per_switch=%l\n", iters, ns(t) / (2 * iters));
+}
+
+static void
+ponger(int *fds)
+{
+  char c;
+
+  for(int i = 0; i < iters; i++){
+    if(read(fds[0], &c, 1) != 1)
+      die("read");
+    if(write(fds[3], &c, 1) != 1)
+      die("write");
+  }
+}
+
+// fds[0..1] is parent to child, fds[2..3] child to parent.
+static void
+pingpong(int cpu)
+{
+  int fds[4];
+  char c = 'x';
+  uint64 t;
+
+  if(pipe(fds) < 0 || pipe(fds + 2) < 0)
+    die("pipe");
+  spawnon(cpu, ponger, fds);
+  t = rdtime();
+  for(int i = 0; i < iters; i++){
+    if(write(fds[1], &c, 1) != 1)
+      die("write");
+    if(read(fds[2], &c, 1) != 1)
+      die("read");
+  }
+  t = rdtime() - t;
+  wait(0);
+  for(int i = 0; i < 4; i++)
+    close(fds[i]);
+  printf("pingpong harts=%d n=%d ns_per_roundtrip=%l\n", cpu + 1, iters, ns(t) / iters);
+}
+
+static void
+drain(int *fds)
+{
+  close(fds[1]);
+  while(read(fds[0], buf, sizeof(buf)) > 0)
+    ;
+}
+
+static void
+bandwidth(int cpu, int size)
+{
+  int fds[2];
+  uint64 t, total = (uint64)megabytes << 20;
+
+  if(pipe(fds) < 0)
+    die("pipe");
+  spawnon(cpu, drain, fds);
+  close(fds[0]);
+  t = rdtime();
+  for(uint64 done = 0; done < total; done += size)
+    if(write(fds[1], buf, size) != size)
+      die("write");
+  close(fds[1]);
+  wait(0);
+  t = rdtime() - t;
+  printf("pipe harts=%d size=%d kb=%d kbps=%l\n", cpu + 1, size, megabytes << 10,
+         t ? (total >> 10) * TIMEBASE / t : 0);
+}
+
+static void
+usage(void)
+{
+  fprintf(2, "usage: ipcbench [-n iters] [-m megabytes]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int old;
+
+  for(int i = 1; i < argc; i++){
+    if(argv[i][0] != '-' || argv[i][2] != 0 || i + 1 >= argc)
+      usage();
+    switch(argv[i][1]){
+    case 'n': iters = atoi(argv[++i]); break;
+    case 'm': megabytes = atoi(argv[++i]); break;
+    default: usage();
+    }
+  }
+  if(iters < 1 || megabytes < 1)
+    usage();
+
+  old = sched_setaffinity(0, 0);
+  ncpu = countcpus();
+  printf("config harts=%d iters=%d megabytes=%d\n", ncpu, iters, megabytes);
+
+  nullsyscall();
+  yieldtest();
+  for(int cpu = 0; cpu < 2 && cpu < ncpu; cpu++){
+    pingpong(cpu);
+    for(int size = 64; size <= sizeof(buf); size *= 4)
+      bandwidth(cpu, size);
+  }
+  sched_setaffinity(0, old);
+  exit(0);
+}
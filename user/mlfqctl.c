@@ -0,0 +1,69 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// mlfqctl [-l levels] [-s s0,s1,...] [-w w1,w2,...] [-b ticks]
+// prints the MLFQ parameters, after setting the ones given:
+// the number of queues used, the slice of each queue in time
+// CSR cycles, how many ticks a process waits in queue 1, 2,
+// ... before it is promoted, and the period in ticks of the
+// boost of every process to queue 0 (0 for none).
+
+static void
+usage(void)
+{
+  fprintf(2, "usage: mlfqctl [-l levels] [-s s0,s1,...] [-w w1,w2,...] [-b ticks]\n");
+  exit(1);
+}
+
+// Parse the comma separated list s into v[first..NMLFQ-1].
+static void
+list(char *s, uint64 *v64, uint *v, int first)
+{
+  for(int i = first; *s && i < NMLFQ; i++){
+    if(v64)
+      v64[i] = atoi(s);
+    else
+      v[i] = atoi(s);
+    while(*s && *s != ',')
+      s++;
+    if(*s == ',')
+      s++;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct mlfqparam mp;
+  int set = 0;
+
+  if(mlfqparam(0, &mp) < 0){
+    fprintf(2, "mlfqctl: mlfqparam failed\n");
+    exit(1);
+  }
+  for(int i = 1; i < argc; i++){
+    if(argv[i][0] != '-' || argv[i][2] != 0 || i + 1 >= argc)
+      usage();
+    switch(argv[i][1]){
+    case 'l': mp.nlevel = atoi(argv[++i]); break;
+    case 's': list(argv[++i], mp.slice, 0, 0); break;
+    case 'w': list(argv[++i], 0, mp.maxwait, 1); break;
+    case 'b': mp.boost = atoi(argv[++i]); break;
+    default: usage();
+    }
+    set = 1;
+  }
+  if(set && mlfqparam(&mp, 0) < 0){
+    fprintf(2, "mlfqctl: bad parameters\n");
+    exit(1);
+  }
+
+  printf("levels=%d boost=%d\n", mp.nlevel, mp.boost);
+  for(int i = 0; i < mp.nlevel; i++)
+    printf("queue=%d slice=%d slice_us=%d maxwait=%d\n", i, (int)mp.slice[i],
+           (int)(mp.slice[i] * 1000000 / TIMEBASE), i ? mp.maxwait[i] : 0);
+  exit(0);
+}
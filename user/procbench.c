@@ -0,0 +1,230 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+// procbench [-n samples]
+//
+// Process lifecycle latencies, timed with the time CSR, each
+// as min/median/p99 over samples (100) runs:
+//   fork   fork() in the parent, for parents with 0, 1, 4
+//          and 16 MB of touched heap
+//   exec   fork, exec and exit of a small (echo) and a large
+//          (usertests) binary, less a plain fork and exit
+//   sbrk   growing the heap by one page and touching it, and
+//          shrinking it by one page
+//   reap   wait() and waitx() for a child that has already
+//          exited, and from the child's last instruction to
+//          the return of wait()
+// One record per line, fields as key=value, times in ns.
+
+#define MAXSAMPLES 1000
+
+int nsamples = 100;
+uint64 v[MAXSAMPLES], done[MAXSAMPLES];
+
+static void
+die(char *what)
+{
+  fprintf(2, "procbench: %s failed\n", what);
+  exit(1);
+}
+
+static uint64
+ns(uint64 cycles)
+{
+  return cycles * (1000000000 / TIMEBASE);
+}
+
+static void
+sort(uint64 *a, int n)
+{
+  for(int i = 1; i < n; i++){
+    uint64 x = a[i];
+    int j;
+    for(j = i; j > 0 && a[j-1] > x; j--)
+      a[j] = a[j-1];
+    a[j] = x;
+  }
+}
+
+// Print min, median and nearest-rank p99 of v[0..n-1], in ns.
+static uint64
+report(char *test, char *what, int n)
+{
+  sort(v, n);
+  printf("%s %s n=%d min=%l median=%l p99=%l\n", test, what, n,
+         ns(v[0]), ns(v[n/2]), ns(v[(n*99 + 99)/100 - 1]));
+  return v[n/2];
+}
+
+static void
+forks(void)
+{
+  static int mb[] = {0, 1, 4, 16};
+  char *heap, what[16];
+  uint64 t;
+  int pid, have = 0;
+
+  for(int m = 0; m < sizeof(mb)/sizeof(mb[0]); m++){
+    // grow the heap to mb[m] MB and touch every page.
+    if((heap = sbrk((mb[m] - have) << 20)) == (char*)-1)
+      die("sbrk");
+    for(char *a = heap; a < heap + ((mb[m] - have) << 20); a += PGSIZE)
+      *a = 1;
+    have = mb[m];
+
+    for(int i = 0; i < nsamples; i++){
+      t = rdtime();
+      if((pid = fork()) < 0)
+        die("fork");
+      if(pid == 0)
+        exit(0);
+      v[i] = rdtime() - t;
+      wait(0);
+    }
+    strcpy(what, "parent_mb=");
+    what[10] = '0' + mb[m] / 10;
+    what[11] = '0' + mb[m] % 10;
+    what[12] = 0;
+    report("fork", what, nsamples);
+  }
+  sbrk(-(have << 20));
+}
+
+// fork, exec argv with no output, exit and wait; argv 0
+// only forks and exits.
+static void
+spawnexit(char **argv)
+{
+  int pid;
+
+  if((pid = fork()) < 0)
+    die("fork");
+  if(pid == 0){
+    if(argv){
+      close(1);
+      close(2);
+      exec(argv[0], argv);
+    }
+    exit(0);
+  }
+  wait(0);
+}
+
+static void
+execs(void)
+{
+  char *small[] = {"echo", "x", 0};
+  char *large[] = {"usertests", "-x", 0};
+  uint64 base, t;
+
+  for(int i = 0; i < nsamples; i++){
+    t = rdtime();
+    spawnexit(0);
+    v[i] = rdtime() - t;
+  }
+  base = report("exec", "binary=none", nsamples);
+
+  for(int i = 0; i < nsamples; i++){
+    t = rdtime();
+    spawnexit(small);
+    t = rdtime() - t;
+    v[i] = t > base ? t - base : 0;
+  }
+  report("exec", "binary=echo", nsamples);
+
+  for(int i = 0; i < nsamples; i++){
+    t = rdtime();
+    spawnexit(large);
+    t = rdtime() - t;
+    v[i] = t > base ? t - base : 0;
+  }
+  report("exec", "binary=usertests", nsamples);
+}
+
+static void
+sbrks(void)
+{
+  char *a;
+  uint64 t;
+
+  for(int i = 0; i < nsamples; i++){
+    t = rdtime();
+    if((a = sbrk(PGSIZE)) == (char*)-1)
+      die("sbrk");
+    *a = 1;
+    v[i] = rdtime() - t;
+  }
+  report("sbrk", "op=grow", nsamples);
+
+  for(int i = 0; i < nsamples; i++){
+    t = rdtime();
+    if(sbrk(-PGSIZE) == (char*)-1)
+      die("sbrk");
+    v[i] = rdtime() - t;
+  }
+  report("sbrk", "op=shrink", nsamples);
+}
+
+// The child sends the time CSR just before exit() and the
+// parent waits until it has read it, so the child is a
+// zombie, or about to be, when the timed wait starts.
+static void
+reaps(int x)
+{
+  uint64 sent, t;
+  int fds[2], pid, wt, rt;
+
+  for(int i = 0; i < nsamples; i++){
+    if(pipe(fds) < 0)
+      die("pipe");
+    if((pid = fork()) < 0)
+      die("fork");
+    if(pid == 0){
+      close(fds[0]);
+      t = rdtime();
+      write(fds[1], &t, sizeof(t));
+      exit(0);
+    }
+    close(fds[1]);
+    if(read(fds[0], &sent, sizeof(sent)) != sizeof(sent))
+      die("read");
+    close(fds[0]);
+    t = rdtime();
+    if(x)
+      waitx(0, &wt, &rt);
+    else
+      wait(0);
+    done[i] = rdtime();
+    v[i] = done[i] - t;
+    done[i] -= sent;
+  }
+  report("reap", x ? "call=waitx" : "call=wait", nsamples);
+  memmove(v, done, nsamples * sizeof(v[0]));
+  report("reap", x ? "call=waitx_from_exit" : "call=wait_from_exit", nsamples);
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc == 3 && strcmp(argv[1], "-n") == 0)
+    nsamples = atoi(argv[2]);
+  else if(argc != 1){
+    fprintf(2, "usage: procbench [-n samples]\n");
+    exit(1);
+  }
+  if(nsamples < 1 || nsamples > MAXSAMPLES){
+    fprintf(2, "procbench: samples must be 1..%d\n", MAXSAMPLES);
+    exit(1);
+  }
+
+  printf("config samples=%d\n", nsamples);
+  forks();
+  execs();
+  sbrks();
+  reaps(0);
+  reaps(1);
+  exit(0);
+}
@@ -0,0 +1,112 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/schedtrace.h"
+#include "kernel/procsnap.h"
+#include "user/user.h"
+
+// schedlog command [args]
+// runs command with scheduling events logged (kernel/
+// schedtrace.c) and prints every event of every process but
+// itself, one per line, until command has exited:
+//   sev time=T tick=K cpu=C pid=P ev=E policy=S queue=Q prio=R
+// with time in time CSR cycles. Capture the console and feed
+// it to mkfs/schedsim to replay the trace under other
+// policies.
+
+#define NREC 256
+
+struct schedev recs[NREC];
+struct procsnap snap[NPROC];
+
+static char *names[NSEV] = {
+  [SEV_NEW]     "new",
+  [SEV_PICK]    "pick",
+  [SEV_PREEMPT] "preempt",
+  [SEV_SLEEP]   "sleep",
+  [SEV_WAKEUP]  "wakeup",
+  [SEV_PRIO]    "prio",
+  [SEV_EXIT]    "exit",
+};
+
+// records from different harts come out of the kernel in
+// ring order; put a batch back in time order.
+static void
+sortrecs(int n)
+{
+  struct schedev t;
+  int i, j;
+
+  for(i = 1; i < n; i++){
+    t = recs[i];
+    for(j = i; j > 0 && recs[j-1].time > t.time; j--)
+      recs[j] = recs[j-1];
+    recs[j] = t;
+  }
+}
+
+// Has pid exited? For when its exit record was lost to a
+// full ring.
+static int
+exited(int pid)
+{
+  int n = procsnap(snap, NPROC);
+
+  for(int i = 0; i < n; i++)
+    if(snap[i].pid == pid)
+      return snap[i].state == PS_ZOMBIE;
+  return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pid, me = getpid(), n, done = 0;
+  struct schedev *e;
+
+  if(argc < 2){
+    fprintf(2, "usage: schedlog command [args]\n");
+    exit(1);
+  }
+  // drop what an earlier run left behind.
+  while(schedtrace_read(recs, NREC) > 0)
+    ;
+  schedtrace(1);
+  if((pid = fork()) < 0){
+    fprintf(2, "schedlog: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], &argv[1]);
+    fprintf(2, "schedlog: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+
+  // once command's exit is seen, drain what is left.
+  while((n = schedtrace_read(recs, NREC)) > 0 || !done){
+    if(n == 0){
+      done = exited(pid);
+      sleep(1);
+      continue;
+    }
+    sortrecs(n);
+    for(int i = 0; i < n; i++){
+      e = &recs[i];
+      if(e->pid < 0){
+        printf("sev lost=%d cpu=%d\n", e->tick, e->cpu);
+        continue;
+      }
+      if(e->pid == me)
+        continue;
+      if(e->pid == pid && e->type == SEV_EXIT)
+        done = 1;
+      printf("sev time=%l tick=%d cpu=%d pid=%d ev=%s policy=%d queue=%d prio=%d\n",
+             e->time, e->tick, e->cpu, e->pid,
+             e->type < NSEV && names[e->type] ? names[e->type] : "?",
+             e->policy, e->queue, e->prio);
+    }
+  }
+  schedtrace(0);
+  wait(0);
+  exit(0);
+}
@@ -0,0 +1,37 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// schedstat [pid]
+// prints the scheduling statistics and run queue latency
+// histogram of a live process, or of itself.
+int
+main(int argc, char *argv[])
+{
+    struct schedstat st;
+    int pid = 0, last = -1;
+
+    if(argc > 1)
+        pid = atoi(argv[1]);
+    if(schedstat(pid, &st) < 0){
+        fprintf(2, "schedstat: no process %d\n", pid);
+        exit(1);
+    }
+
+    printf("pid %d policy %d runs %d voluntary %d involuntary %d\n",
+           st.pid, st.policy, st.nruns, st.nvcsw, st.nivcsw);
+    printf("running %d ms runnable %d ms\n",
+           (int)(st.rcycles / 10000), (int)(st.waitcycles / 10000));
+
+    // one line per bucket up to the last non-empty one; the
+    // time CSR runs at 10MHz in qemu, so 2^i cycles is
+    // 2^i / 10 us.
+    for(int i = 0; i < NLATBUCKET; i++)
+        if(st.lat[i])
+            last = i;
+    for(int i = 0; i <= last; i++)
+        printf("lat >= 2^%d cycles: %d\n", i, st.lat[i]);
+    exit(0);
+}
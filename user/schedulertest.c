@@ -1,44 +1,250 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/sched.h"
 #include "user/user.h"
 #include "kernel/fcntl.h"
 
+// schedulertest [-n procs] [-i io] [-s sleep] [-r rounds]
+//               [-l iters] [-p iop] [-q cpup] [-t trials]
+//               [-k t1,t2,...] [-d ticks]
+//
+// Forks procs children per trial. The first io of them are
+// I/O bound and sleep rounds times for sleep ticks; the
+// rest are CPU bound and spin for iters iterations. With
+// -p/-q the I/O and CPU bound children get that static
+// priority (PBS and CFS). With -k the CPU bound children
+// get t1, t2, ... tickets in turn (stride class). Without
+// flags it runs the old fixed test.
+//
+// With -d the CPU bound children spin until the test has
+// run for ticks, and instead of waiting for them it samples
+// their run time with schedstat() and prints a "share"
+// record per child: its share of the total run time next
+// to the share its tickets entitle it to, both in 1/1000.
+//
+// Output is one record per line, fields as key=value:
+//   proc       one child: rtime, wtime, turnaround, response
+//   stat       min/median/p99 of a field over a trial
+//   throughput jobs per second of a trial, times 1000
+// followed by the old "Average rtime, wtime" line.
 
-#define NFORK 10
-#define IO 5
+#define MAXPROC  (NPROC - 4)
+#define HZ       (TIMEBASE / TICKCYCLES)
 
-int main() {
-  int n, pid;
+int nproc = 10;
+int nio = 5;
+int sleepticks = 200;
+int rounds = 1;
+int iters = 1000000000;
+int iop = -1, cpup = -1;
+int trials = 1;
+int tickets[MAXPROC], ntickets;
+int duration;
+
+struct result {
+  int pid;
+  int forked;                       // uptime() before fork
+  int rtime, wtime, turnaround, response;
+};
+
+struct result res[MAXPROC];
+
+static void
+child(int n, int fd)
+{
+  int start[2];
+
+  start[0] = n;
+  start[1] = uptime();
+  write(fd, start, sizeof(start));
+  close(fd);
+
+  if(n < nio){
+    for(int r = 0; r < rounds; r++)
+      sleep(sleepticks); // IO bound processes
+  } else if(duration){
+    for(;;) {} // until the parent has measured and kills it
+  } else {
+    for(volatile int i = 0; i < iters; i++) {} // CPU bound process
+  }
+  exit(0);
+}
+
+// -d: measure the CPU bound children's share of the run
+// time against their tickets, then stop them.
+static void
+shares(int trial)
+{
+  // static: a MAXPROC entry array is too big for the one page
+  // user stack.
+  static uint64 rc[MAXPROC];
+  static int tk[MAXPROC];
+  struct schedstat st;
+  uint64 total = 0;
+  int ttotal = 0;
+
+  sleep(duration);
+  for(int i = nio; i < nproc; i++){
+    rc[i] = schedstat(res[i].pid, &st) == 0 ? st.rcycles : 0;
+    tk[i] = ntickets ? tickets[(i - nio) % ntickets] : 100;
+    total += rc[i];
+    ttotal += tk[i];
+  }
+  for(int i = nio; i < nproc; i++){
+    printf("share trial=%d n=%d tickets=%d rcycles=%d measured=%d expected=%d\n",
+           trial, i, tk[i], (int)(rc[i] / 1000),
+           total ? (int)(rc[i] * 1000 / total) : 0, tk[i] * 1000 / ttotal);
+    kill(res[i].pid);
+  }
+}
+
+static void
+sort(int *a, int n)
+{
+  for(int i = 1; i < n; i++){
+    int v = a[i], j;
+    for(j = i; j > 0 && a[j-1] > v; j--)
+      a[j] = a[j-1];
+    a[j] = v;
+  }
+}
+
+// print min, median and nearest-rank p99 of the field at
+// offset off in res[0..n-1].
+static void
+report(int trial, char *name, int off)
+{
+  static int v[MAXPROC];
+
+  for(int i = 0; i < nproc; i++)
+    v[i] = *(int*)((char*)&res[i] + off);
+  sort(v, nproc);
+  printf("stat trial=%d field=%s min=%d median=%d p99=%d\n",
+         trial, name, v[0], v[nproc/2], v[(nproc*99 + 99)/100 - 1]);
+}
+
+static void
+usage(void)
+{
+  fprintf(2, "usage: schedulertest [-n procs] [-i io] [-s sleep] [-r rounds] "
+             "[-l iters] [-p iop] [-q cpup] [-t trials] [-k t1,t2,...] [-d ticks]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n, pid, trial, start, elapsed, fds[2], msg[2];
   int wtime, rtime;
-  int twtime=0, trtime=0;
-  for(n=0; n < NFORK;n++) {
-      pid = fork();
-      if (pid < 0)
-          break;
-      if (pid == 0) {
-#ifndef FCFS
-          if (n < IO) {
-            sleep(200); // IO bound processes
-          } else {
-#endif
-            for (volatile int i = 0; i < 1000000000; i++) {} // CPU bound process 
-#ifndef FCFS
-          }
+  int twtime = 0, trtime = 0;
+
+#ifdef FCFS
+  nio = 0;                          // FCFS: CPU bound only
 #endif
-          printf("Process %d finished", n);
-          exit(0);
-      } else {
 #ifdef PBS
-        set_priority(80, pid); // Will only matter for PBS, set lower priority for IO bound processes 
+  iop = 80;                         // lower priority for IO bound processes
 #endif
+
+  for(int i = 1; i < argc; i++){
+    if(argv[i][0] != '-' || argv[i][2] != 0 || i + 1 >= argc)
+      usage();
+    int v = atoi(argv[++i]);
+    switch(argv[i-1][1]){
+    case 'n': nproc = v; break;
+    case 'i': nio = v; break;
+    case 's': sleepticks = v; break;
+    case 'r': rounds = v; break;
+    case 'l': iters = v; break;
+    case 'p': iop = v; break;
+    case 'q': cpup = v; break;
+    case 't': trials = v; break;
+    case 'd': duration = v; break;
+    case 'k':
+      for(char *s = argv[i]; *s && ntickets < MAXPROC; ){
+        tickets[ntickets++] = atoi(s);
+        while(*s && *s != ',')
+          s++;
+        if(*s == ',')
+          s++;
       }
+      break;
+    default: usage();
+    }
   }
-  for(;n > 0; n--) {
-      if(waitx(0,&wtime,&rtime) >= 0) {
-          trtime += rtime;
-          twtime += wtime;
-      } 
+  if(nproc < 1 || nproc > MAXPROC || trials < 1)
+    usage();
+  if(nio > nproc)
+    nio = nproc;
+
+  printf("config procs=%d io=%d sleep=%d rounds=%d iters=%d iop=%d cpup=%d trials=%d hz=%d\n",
+         nproc, nio, sleepticks, rounds, iters, iop, cpup, trials, HZ);
+
+  for(trial = 1; trial <= trials; trial++){
+    if(pipe(fds) < 0){
+      fprintf(2, "schedulertest: pipe failed\n");
+      exit(1);
+    }
+    start = uptime();
+    for(n = 0; n < nproc; n++){
+      res[n].forked = uptime();
+      pid = fork();
+      if(pid < 0)
+        break;
+      if(pid == 0){
+        close(fds[0]);
+        child(n, fds[1]);
+      }
+      res[n].pid = pid;
+      if(n < nio && iop >= 0)
+        set_priority(iop, pid);
+      if(n >= nio && cpup >= 0)
+        set_priority(cpup, pid);
+      if(n >= nio && ntickets)
+        set_tickets(tickets[(n - nio) % ntickets], pid);
+    }
+    if(n < nproc){
+      fprintf(2, "schedulertest: fork failed\n");
+      nproc = n;
+    }
+    close(fds[1]);
+    if(duration)
+      shares(trial);
+
+    for(int left = nproc; left > 0; left--){
+      if((pid = waitx(0, &wtime, &rtime)) < 0)
+        break;
+      for(int i = 0; i < nproc; i++){
+        if(res[i].pid == pid){
+          res[i].rtime = rtime;
+          res[i].wtime = wtime;
+          res[i].turnaround = rtime + wtime;
+        }
+      }
+      trtime += rtime;
+      twtime += wtime;
+    }
+    elapsed = uptime() - start;
+
+    // every child wrote when it first ran; read to EOF.
+    while(read(fds[0], msg, sizeof(msg)) == sizeof(msg))
+      if(msg[0] >= 0 && msg[0] < nproc)
+        res[msg[0]].response = msg[1] - res[msg[0]].forked;
+    close(fds[0]);
+
+    for(int i = 0; i < nproc; i++)
+      printf("proc trial=%d n=%d kind=%s rtime=%d wtime=%d turnaround=%d response=%d\n",
+             trial, i, i < nio ? "io" : "cpu", res[i].rtime, res[i].wtime,
+             res[i].turnaround, res[i].response);
+    report(trial, "turnaround", (char*)&res[0].turnaround - (char*)&res[0]);
+    report(trial, "response", (char*)&res[0].response - (char*)&res[0]);
+    report(trial, "wtime", (char*)&res[0].wtime - (char*)&res[0]);
+    if(elapsed < 1)
+      elapsed = 1;
+    printf("throughput trial=%d jobs=%d ticks=%d jobs_per_sec_x1000=%d\n",
+           trial, nproc, elapsed, nproc * HZ * 1000 / elapsed);
   }
-  printf("Average rtime %d,  wtime %d\n", trtime / NFORK, twtime / NFORK);
+
+  printf("Average rtime %d,  wtime %d\n", trtime / (nproc * trials), twtime / (nproc * trials));
   exit(0);
 }
@@ -12,6 +12,7 @@
 #define BACK  5
 
 #define MAXARGS 10
+#define MAXSTAGE 10  // pipeline stages the shell runs itself
 
 struct cmd {
   int type;
@@ -52,6 +53,11 @@ struct backcmd {
 int fork1(void);  // Fork but panics on failure.
 void panic(char*);
 struct cmd *parsecmd(char*);
+void freecmd(struct cmd*);
+
+// set by the parser on a syntax error, which it reports
+// itself; the shell doesn't run such a line.
+int badsyntax;
 
 // Execute cmd.  Never returns.
 void
@@ -130,6 +136,133 @@ runcmd(struct cmd *cmd)
   exit(0);
 }
 
+// Start stage c of a pipeline with in and out as its fds 0
+// and 1; the child closes other, the pipe end of the next
+// stage. A plain command is spawned, without copying the
+// shell; anything else is forked and run by runcmd().
+// Returns the child's pid, or -1.
+int
+stage(struct cmd *c, int in, int out, int other)
+{
+  struct execcmd *ecmd;
+  int fdmap[3], pid;
+
+  if(c->type == EXEC){
+    ecmd = (struct execcmd*)c;
+    if(ecmd->argv[0] == 0)
+      return -1;
+    fdmap[0] = in;
+    fdmap[1] = out;
+    fdmap[2] = 2;
+    if((pid = spawn(ecmd->argv[0], ecmd->argv, fdmap)) < 0)
+      fprintf(2, "exec %s failed\n", ecmd->argv[0]);
+    return pid;
+  }
+
+  if((pid = fork1()) == 0){
+    if(in != 0){
+      close(0);
+      dup(in);
+      close(in);
+    }
+    if(out != 1){
+      close(1);
+      dup(out);
+      close(out);
+    }
+    if(other >= 0)
+      close(other);
+    runcmd(c);
+  }
+  return pid;
+}
+
+// Run the pipeline cmd from the shell, one child per stage,
+// and wait for all of them. With timed, report each stage's
+// run and wait time from waitx_ns(), in microseconds.
+void
+runpipe(struct cmd *cmd, int timed)
+{
+  struct cmd *st[MAXSTAGE];
+  int pid[MAXSTAGE], n = 0, in = 0, out, p[2], i, k, left = 0;
+  uint64 rtime[MAXSTAGE], wtime[MAXSTAGE], w, r;
+
+  for(; cmd->type == PIPE && n < MAXSTAGE - 1; cmd = ((struct pipecmd*)cmd)->right)
+    st[n++] = ((struct pipecmd*)cmd)->left;
+  st[n++] = cmd;   // may still be a pipe, which runcmd() can run
+
+  for(i = 0; i < n; i++){
+    p[0] = -1;
+    out = 1;
+    if(i < n - 1){
+      if(pipe(p) < 0)
+        panic("pipe");
+      out = p[1];
+    }
+    if((pid[i] = stage(st[i], in, out, p[0])) >= 0)
+      left++;
+    if(in != 0)
+      close(in);
+    if(out != 1)
+      close(out);
+    in = p[0];
+  }
+
+  while(left > 0 && (k = waitx_ns(0, &w, &r)) >= 0){
+    for(i = 0; i < n; i++){
+      if(pid[i] == k){
+        wtime[i] = w;
+        rtime[i] = r;
+        left--;
+      }
+    }
+  }
+
+  if(timed){
+    for(i = 0; i < n; i++){
+      if(pid[i] < 0)
+        continue;
+      fprintf(2, "time: stage %d", i);
+      if(st[i]->type == EXEC)
+        fprintf(2, " %s", ((struct execcmd*)st[i])->argv[0]);
+      fprintf(2, " pid %d rtime %d us wtime %d us\n", pid[i],
+              (int)(rtime[i] / 1000), (int)(wtime[i] / 1000));
+    }
+  }
+}
+
+// Run cmd from the shell itself: a list one element after
+// another, a pipeline with runpipe(), so that no subshell is
+// forked to run them.
+void
+runtop(struct cmd *cmd, int timed)
+{
+  struct listcmd *lcmd;
+
+  if(cmd == 0)
+    return;
+
+  switch(cmd->type){
+  case LIST:
+    lcmd = (struct listcmd*)cmd;
+    runtop(lcmd->left, timed);
+    runtop(lcmd->right, timed);
+    break;
+
+  case BACK:
+    // runcmd() forks it again and exits, so the shell never
+    // waits for it.
+    if(fork1() == 0)
+      runcmd(cmd);
+    wait(0);
+    break;
+
+  default:
+    runpipe(cmd, timed);
+    break;
+  }
+}
+
 int
 getcmd(char *buf, int nbuf)
 {
@@ -145,7 +278,9 @@ int
 main(void)
 {
   static char buf[100];
-  int fd;
+  int fd, timed;
+  char *s;
+  struct cmd *cmd;
 
   // Ensure that three file descriptors are open.
   while((fd = open("console", O_RDWR)) >= 0){
@@ -164,9 +299,18 @@ main(void)
         fprintf(2, "cannot cd %s\n", buf+3);
       continue;
     }
-    if(fork1() == 0)
-      runcmd(parsecmd(buf));
-    wait(0);
+    // time cmd: report each stage's rtime and wtime.
+    s = buf;
+    timed = 0;
+    if(memcmp(s, "time", 4) == 0 && strchr(" \t\n", s[4])){
+      s += 4;
+      timed = 1;
+    }
+    badsyntax = 0;
+    cmd = parsecmd(s);
+    if(!badsyntax)
+      runtop(cmd, timed);
+    freecmd(cmd);
   }
   exit(0);
 }
@@ -260,6 +404,16 @@ backcmd(struct cmd *subcmd)
 // Parsing
 
 char whitespace[] = " \t\r\n\v";
+
+// Report a syntax error. The shell runs commands it parsed
+// itself, so this can't exit like panic().
+void
+syntax(char *s)
+{
+  if(!badsyntax)
+    fprintf(2, "%s\n", s);
+  badsyntax = 1;
+}
 char symbols[] = "<|>&;()";
 
 int
@@ -335,7 +489,7 @@ parsecmd(char *s)
   peek(&s, es, "");
   if(s != es){
     fprintf(2, "leftovers: %s\n", s);
-    panic("syntax");
+    syntax("syntax");
   }
   nulterminate(cmd);
   return cmd;
@@ -379,8 +533,10 @@ parseredirs(struct cmd *cmd, char **ps, char *es)
 
   while(peek(ps, es, "<>")){
     tok = gettoken(ps, es, 0, 0);
-    if(gettoken(ps, es, &q, &eq) != 'a')
-      panic("missing file for redirection");
+    if(gettoken(ps, es, &q, &eq) != 'a'){
+      syntax("missing file for redirection");
+      break;
+    }
     switch(tok){
     case '<':
       cmd = redircmd(cmd, q, eq, O_RDONLY, 0);
@@ -405,8 +561,10 @@ parseblock(char **ps, char *es)
     panic("parseblock");
   gettoken(ps, es, 0, 0);
   cmd = parseline(ps, es);
-  if(!peek(ps, es, ")"))
-    panic("syntax - missing )");
+  if(!peek(ps, es, ")")){
+    syntax("syntax - missing )");
+    return cmd;
+  }
   gettoken(ps, es, 0, 0);
   cmd = parseredirs(cmd, ps, es);
   return cmd;
@@ -431,13 +589,17 @@ parseexec(char **ps, char *es)
   while(!peek(ps, es, "|)&;")){
     if((tok=gettoken(ps, es, &q, &eq)) == 0)
       break;
-    if(tok != 'a')
-      panic("syntax");
+    if(tok != 'a'){
+      syntax("syntax");
+      break;
+    }
     cmd->argv[argc] = q;
     cmd->eargv[argc] = eq;
     argc++;
-    if(argc >= MAXARGS)
-      panic("too many args");
+    if(argc >= MAXARGS){
+      syntax("too many args");
+      break;
+    }
     ret = parseredirs(ret, ps, es);
   }
   cmd->argv[argc] = 0;
@@ -491,3 +653,27 @@ nulterminate(struct cmd *cmd)
   }
   return cmd;
 }
+
+// Free a parsed command.
+void
+freecmd(struct cmd *cmd)
+{
+  if(cmd == 0)
+    return;
+
+  switch(cmd->type){
+  case REDIR:
+    freecmd(((struct redircmd*)cmd)->cmd);
+    break;
+  case PIPE:
+  case LIST:
+    // same layout
+    freecmd(((struct pipecmd*)cmd)->left);
+    freecmd(((struct pipecmd*)cmd)->right);
+    break;
+  case BACK:
+    freecmd(((struct backcmd*)cmd)->cmd);
+    break;
+  }
+  free(cmd);
+}
@@ -1,14 +1,85 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/syscall.h"
+#include "kernel/trace.h"
 #include "user/user.h"
+#include "user/sysnames.h"
 
+// strace mask command [args]
+// runs command with the syscalls in mask traced. The kernel
+// only logs binary records (kernel/trace.c); they are read
+// back with traceread() and printed here.
+
+#define NREC 64
+
+struct tracerec recs[NREC];
+
+// records from different cpus come out of the kernel in
+// ring order; put a batch back in time order.
+void
+sortrecs(int n)
+{
+    struct tracerec t;
+    int i, j;
+
+    for(i = 1; i < n; i++){
+        t = recs[i];
+        for(j = i; j > 0 && recs[j-1].time > t.time; j--)
+            recs[j] = recs[j-1];
+        recs[j] = t;
+    }
+}
+
+void
+printrec(struct tracerec *r)
+{
+    char *name = " ";
+
+    if(r->pid < 0){
+        printf("strace: %d records lost\n", (int)r->ret);
+        return;
+    }
+    if(r->num > 0 && r->num < NSYSNAMES)
+        name = SystemcallNames[r->num];
+    printf("%d: syscall %s (%d", r->pid, name, (int)r->arg[0]);
+    for(int i = 1; i < r->nargs && i < TRACE_NARG; i++)
+        printf(" %d", (int)r->arg[i]);
+    printf(") -> %d\n", (int)r->ret);
+}
 
 int
 main(int argc, char **argv)
 {
-    int To_trace = atoi(argv[1]); //mask
-    trace(To_trace);
-    exec(argv[2], &argv[2]);
-    printf("error strace did not exec");
-    exit(1);
-}
\ No newline at end of file
+    int pid, n;
+
+    if(argc < 3){
+        fprintf(2, "usage: strace mask command [args]\n");
+        exit(1);
+    }
+
+    pid = fork();
+    if(pid < 0){
+        fprintf(2, "strace: fork failed\n");
+        exit(1);
+    }
+    if(pid == 0){
+        int To_trace = atoi(argv[1]); //mask
+        trace(To_trace);
+        exec(argv[2], &argv[2]);
+        printf("error strace did not exec");
+        exit(1);
+    }
+
+    // drain until the command has exited and nothing is left.
+    while((n = traceread(recs, NREC, pid)) >= 0){
+        if(n == 0){
+            sleep(1);
+            continue;
+        }
+        sortrecs(n);
+        for(int i = 0; i < n; i++)
+            printrec(&recs[i]);
+    }
+    wait(0);
+    exit(0);
+}
@@ -0,0 +1,10 @@
+// Syscall names by number, for strace and sysprof.
+// Needs kernel/syscall.h.
+static char SystemcallNames[][20] = {
+  {" "}, {"fork"}, {"exit"}, {"wait"}, {"pipe"}, {"read"}, {"kill"}, {"exec"}, {"fstat"}, {"chdir"}, {"dup"}, {"getpid"}, {"sbrk"}, {"sleep"}, {"uptime"}, {"open"}, {"write"}, {"mknod"}, {"unlink"}, {"link"}, {"mkdir"}, {"close"}, {"trace"}, {"set_priority"}, {"waitx"},
+  [SYS_set_policy] {"set_policy"}, [SYS_sched_deadline] {"sched_deadline"},
+  [SYS_schedstat] {"schedstat"}, [SYS_traceread] {"traceread"},
+  [SYS_sysprof] {"sysprof"}, [SYS_sched_setaffinity] {"sched_setaffinity"},
+  [SYS_set_tickets] {"set_tickets"}, [SYS_spawn] {"spawn"}, [SYS_mmap] {"mmap"}, [SYS_munmap] {"munmap"}, [SYS_memstat] {"memstat"}, [SYS_sync] {"sync"}, [SYS_splice] {"splice"}, [SYS_readv] {"readv"}, [SYS_writev] {"writev"}, [SYS_ring_enter] {"ring_enter"}, [SYS_clone] {"clone"}, [SYS_join] {"join"}, [SYS_futex_wait] {"futex_wait"}, [SYS_futex_wake] {"futex_wake"}, [SYS_procsnap] {"procsnap"}, [SYS_waitx_ns] {"waitx_ns"}, [SYS_clock_gettime] {"clock_gettime"}, [SYS_mlfqparam] {"mlfqparam"}, [SYS_lseek] {"lseek"}, [SYS_sched_yield] {"sched_yield"}, [SYS_schedtrace] {"schedtrace"}, [SYS_schedtrace_read] {"schedtrace_read"}};
+
+#define NSYSNAMES (sizeof(SystemcallNames) / sizeof(SystemcallNames[0]))
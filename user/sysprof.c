@@ -0,0 +1,46 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/syscall.h"
+#include "kernel/sysprof.h"
+#include "user/user.h"
+#include "user/sysnames.h"
+
+// sysprof [pid]
+// prints how often each syscall was made and how long it
+// took, system wide or for one process, busiest first.
+// Times are in microseconds (10 cycles of the qemu time CSR).
+
+struct sysprof prof[NSYSCALL];
+
+int
+main(int argc, char *argv[])
+{
+    int pid = -1, n, order[NSYSCALL], i, j, t;
+
+    if(argc > 1)
+        pid = atoi(argv[1]);
+    if((n = sysprof(pid, prof, NSYSCALL)) < 0){
+        fprintf(2, "sysprof: no process %d\n", pid);
+        exit(1);
+    }
+
+    for(i = 0; i < n; i++){
+        t = i;
+        for(j = i; j > 0 && prof[order[j-1]].cycles < prof[t].cycles; j--)
+            order[j] = order[j-1];
+        order[j] = t;
+    }
+
+    printf("syscall count total_us avg_us max_us\n");
+    for(i = 0; i < n; i++){
+        struct sysprof *s = &prof[order[i]];
+        if(s->count == 0)
+            continue;
+        printf("%s %d %d %d %d\n",
+               order[i] < NSYSNAMES ? SystemcallNames[order[i]] : "?",
+               (int)s->count, (int)(s->cycles / 10),
+               (int)(s->cycles / s->count / 10), (int)(s->max / 10));
+    }
+    exit(0);
+}
@@ -0,0 +1,34 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// taskset mask command [args]
+// taskset -p mask pid
+// runs command, or moves process pid, on the harts in mask
+// (bit i is hart i). mask 0 with -p prints the current one.
+int
+main(int argc, char *argv[])
+{
+    int mask, old;
+
+    if(argc >= 4 && strcmp(argv[1], "-p") == 0){
+        mask = atoi(argv[2]);
+        if((old = sched_setaffinity(atoi(argv[3]), mask)) < 0){
+            fprintf(2, "taskset: failed\n");
+            exit(1);
+        }
+        printf("%d -> %d\n", old, mask ? mask : old);
+        exit(0);
+    }
+    if(argc < 3){
+        fprintf(2, "usage: taskset mask command [args] | taskset -p mask pid\n");
+        exit(1);
+    }
+    if(sched_setaffinity(0, atoi(argv[1])) < 0){
+        fprintf(2, "taskset: bad mask %s\n", argv[1]);
+        exit(1);
+    }
+    exec(argv[2], &argv[2]);
+    fprintf(2, "taskset: exec %s failed\n", argv[2]);
+    exit(1);
+}
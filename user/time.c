@@ -2,27 +2,34 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/fcntl.h"
+#include "kernel/param.h"
+
+#define HZ (TIMEBASE / TICKCYCLES)
 
 int 
 main(int argc, char ** argv) 
 {
-  int pid = fork();
-  if(pid < 0) {
-    printf("fork(): failed\n");
-    exit(1);
-  } else if(pid == 0) {
-    if(argc == 1) {
+  int pid;
+  if(argc == 1) {
+    pid = fork();
+    if(pid == 0) {
       sleep(10);
       exit(0);
-    } else {
-      exec(argv[1], argv + 1);
-      printf("exec(): failed\n");
-      exit(1);
-    }  
+    }
+  } else {
+    // spawn builds the child straight from the program
+    // file, without copying this process first.
+    pid = spawn(argv[1], argv + 1, 0);
+  }
+  if(pid < 0) {
+    printf("spawn(): failed\n");
+    exit(1);
   } else {
-    int rtime, wtime;
-    waitx(0, &wtime, &rtime);
-    printf("\nwaiting:%d\nrunning:%d\n", wtime, rtime);
+    uint64 rtime, wtime;
+    waitx_ns(0, &wtime, &rtime);
+    // ticks as before, then microseconds.
+    printf("\nwaiting:%d\nrunning:%d\n", (int)(wtime / (1000000000 / HZ)), (int)(rtime / (1000000000 / HZ)));
+    printf("waiting_us:%d\nrunning_us:%d\n", (int)(wtime / 1000), (int)(rtime / 1000));
   }
   exit(0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,125 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/sched.h"
+#include "kernel/procsnap.h"
+#include "user/user.h"
+
+// top [-d ticks] [-n count]
+// samples the process table with procsnap() every ticks
+// (10 by default) and prints, for each process, its cpu
+// share over the interval in 1/10 % of one hart, the time it
+// spent RUNNABLE in that interval, its PBS priority or MLFQ
+// queue and how often it was scheduled. Runs count times, or
+// until killed.
+
+struct procsnap snap[2][NPROC];
+int nsnap[2];
+
+static char *states[] = {
+  [PS_USED]     "used  ",
+  [PS_SLEEPING] "sleep ",
+  [PS_RUNNABLE] "runble",
+  [PS_RUNNING]  "run   ",
+  [PS_ZOMBIE]   "zombie",
+};
+
+static char *policies[] = {
+  [SCHED_DEFAULT] "rr",
+  [SCHED_FCFS]    "fcfs",
+  [SCHED_PBS]     "pbs",
+  [SCHED_MLFQ]    "mlfq",
+  [SCHED_CFS]     "cfs",
+  [SCHED_EDF]     "edf",
+  [SCHED_STRIDE]  "stride",
+};
+
+// The entry of pid in snapshot s, or 0.
+static struct procsnap*
+find(int s, int pid)
+{
+  for(int i = 0; i < nsnap[s]; i++)
+    if(snap[s][i].pid == pid)
+      return &snap[s][i];
+  return 0;
+}
+
+static int
+take(int s)
+{
+  if((nsnap[s] = procsnap(snap[s], NPROC)) < 0)
+    return -1;
+  // built for another layout of the entries.
+  if(nsnap[s] > 0 && snap[s][0].version != PROCSNAP_VERSION)
+    return -1;
+  return 0;
+}
+
+static void
+show(int cur)
+{
+  struct procsnap *p, *o;
+  uint64 dt, drun, dwait;
+  int prio;
+
+  printf("pid  tgid state  policy pri  cpu  share  waitms  sched rtime wtime rss  name\n");
+  for(int i = 0; i < nsnap[cur]; i++){
+    p = &snap[cur][i];
+    o = find(!cur, p->pid);
+    drun = dwait = 0;
+    dt = 1;
+    if(o && p->time > o->time){
+      dt = p->time - o->time;
+      drun = p->rcycles - o->rcycles;
+      dwait = p->waitcycles - o->waitcycles;
+    }
+    prio = p->policy == SCHED_MLFQ ? p->queue : p->priority;
+    printf("%d  %d  %s %s  %d  %d  %d  %d  %d  %d  %d  %d  %s\n",
+           p->pid, p->tgid,
+           p->state > 0 && p->state <= PS_ZOMBIE ? states[p->state] : "???   ",
+           p->policy >= 0 && p->policy < NSCHED ? policies[p->policy] : "?",
+           prio, p->cpu, (int)(drun * 1000 / dt), (int)(dwait / (TIMEBASE / 1000)),
+           p->nscheduled, p->rtime, p->wtime, p->rss, p->name);
+  }
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int interval = 10, count = -1, cur = 0;
+
+  for(int i = 1; i < argc; i++){
+    if(argv[i][0] != '-' || i + 1 >= argc){
+      fprintf(2, "usage: top [-d ticks] [-n count]\n");
+      exit(1);
+    }
+    if(argv[i][1] == 'd')
+      interval = atoi(argv[++i]);
+    else if(argv[i][1] == 'n')
+      count = atoi(argv[++i]);
+    else {
+      fprintf(2, "usage: top [-d ticks] [-n count]\n");
+      exit(1);
+    }
+  }
+  if(interval < 1)
+    interval = 1;
+
+  if(take(!cur) < 0){
+    fprintf(2, "top: procsnap failed\n");
+    exit(1);
+  }
+  while(count != 0){
+    sleep(interval);
+    if(take(cur) < 0){
+      fprintf(2, "top: procsnap failed\n");
+      exit(1);
+    }
+    show(cur);
+    cur = !cur;
+    if(count > 0)
+      count--;
+  }
+  exit(0);
+}
@@ -1,8 +1,39 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/vdso.h"
 #include "user/user.h"
 
+// The kernel keeps these up to date in pages it maps
+// read-only into every process; see kernel/vdso.h.
+#define vdso  ((struct vdso*)VDSO)
+#define vproc ((struct vproc*)VPROC)
+
+// Clock ticks since boot, like the uptime syscall. From the
+// time CSR, since the kernel only brings vdso->ticks up to
+// date when a hart schedules or takes a timer interrupt.
+int
+uptime(void)
+{
+  return (r_time() - vdso->tickbase) / vdso->tickcycles;
+}
+
+// The caller's pid, like the getpid syscall.
+int
+getpid(void)
+{
+  return vproc->pid;
+}
+
+// The time CSR: TIMEBASE cycles per second since boot.
+uint64
+rdtime(void)
+{
+  return r_time();
+}
+
 char*
 strcpy(char *s, const char *t)
 {
@@ -134,3 +165,28 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// A thread made by thread_create() starts here, with fn and
+// its argument at the top of its stack.
+static void
+thread_start(void *top)
+{
+  void **v = top;
+
+  ((void (*)(void*))v[0])(v[1]);
+  exit(0);
+}
+
+// Start fn(arg) in a new thread of this process, on the
+// size bytes of stack at stack. Returns its tid, for join().
+int
+thread_create(void (*fn)(void*), void *arg, void *stack, uint size)
+{
+  void **top;
+
+  // riscv sp must be 16-byte aligned.
+  top = (void**)(((uint64)stack + size - 2*sizeof(void*)) & ~15UL);
+  top[0] = (void*)fn;
+  top[1] = arg;
+  return clone(thread_start, top, top);
+}
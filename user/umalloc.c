@@ -4,7 +4,16 @@
 #include "kernel/param.h"
 
 // Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// The C programming Language, 2nd ed.  Section 8.7,
+// with bins for small sizes in front of it.
+//
+// Blocks of up to MAXSMALL units (header included) are
+// rounded up to a power of two and kept on one free list
+// per size class, so malloc and free of them are O(1). The
+// bins are filled by carving CHUNK units taken from the
+// K&R free list, which handles the larger blocks. When a
+// free block at the top of the heap grows to TRIM units it
+// is given back with sbrk.
 
 typedef long Align;
 
@@ -18,15 +27,46 @@ union header {
 
 typedef union header Header;
 
+#define NCLASS   7                  // classes of 2, 4, ... 128 units
+#define MAXSMALL (2 << (NCLASS-1))
+#define CHUNK    256                // units carved into a class at once
+#define TRIM     16384              // units at the top freed back to the kernel
+
 static Header base;
 static Header *freep;
+static Header *bins[NCLASS];
 
-void
-free(void *ap)
+// Size class for a block of nunits, nunits <= MAXSMALL.
+static int
+sizeclass(uint nunits)
 {
-  Header *bp, *p;
+  int c = 0;
+
+  while((2 << c) < nunits)
+    c++;
+  return c;
+}
+
+// Give the free block bp at the top of the heap back to the
+// kernel. It is linked after prevp.
+static void
+trim(Header *prevp, Header *bp)
+{
+  if(bp->s.size < TRIM || (char*)(bp + bp->s.size) != sbrk(0))
+    return;
+  prevp->s.ptr = bp->s.ptr;
+  freep = prevp;
+  sbrk(-(int)(bp->s.size * sizeof(Header)));
+}
+
+// Put block bp on the K&R free list, merging it with its
+// neighbours. With trimok, a resulting block at the top of
+// the heap may go back to the kernel.
+static void
+bigfree(Header *bp, int trimok)
+{
+  Header *p, *q;
 
-  bp = (Header*)ap - 1;
   for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
     if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
       break;
@@ -38,11 +78,42 @@ free(void *ap)
   if(p + p->s.size == bp){
     p->s.size += bp->s.size;
     p->s.ptr = bp->s.ptr;
-  } else
+    // the merged block is p; find the block before it.
+    if(trimok && p->s.size >= TRIM){
+      for(q = p; q->s.ptr != p; q = q->s.ptr)
+        ;
+      freep = p;
+      trim(q, p);
+      return;
+    }
+  } else {
     p->s.ptr = bp;
+    freep = p;
+    if(trimok)
+      trim(p, bp);
+    return;
+  }
   freep = p;
 }
 
+void
+free(void *ap)
+{
+  Header *bp;
+  int c;
+
+  if(ap == 0)
+    return;
+  bp = (Header*)ap - 1;
+  if(bp->s.size > MAXSMALL){
+    bigfree(bp, 1);
+    return;
+  }
+  c = sizeclass(bp->s.size);
+  bp->s.ptr = bins[c];
+  bins[c] = bp;
+}
+
 static Header*
 morecore(uint nu)
 {
@@ -56,17 +127,16 @@ morecore(uint nu)
     return 0;
   hp = (Header*)p;
   hp->s.size = nu;
-  free((void*)(hp + 1));
+  bigfree(hp, 0);
   return freep;
 }
 
-void*
-malloc(uint nbytes)
+// First fit from the K&R free list, for nunits > MAXSMALL.
+static Header*
+bigalloc(uint nunits)
 {
   Header *p, *prevp;
-  uint nunits;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
   if((prevp = freep) == 0){
     base.s.ptr = freep = prevp = &base;
     base.s.size = 0;
@@ -81,10 +151,41 @@ malloc(uint nbytes)
         p->s.size = nunits;
       }
       freep = prevp;
-      return (void*)(p + 1);
+      return p;
     }
     if(p == freep)
       if((p = morecore(nunits)) == 0)
         return 0;
   }
 }
+
+void*
+malloc(uint nbytes)
+{
+  Header *p;
+  uint nunits, size;
+  int c;
+
+  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
+  if(nunits > MAXSMALL){
+    if((p = bigalloc(nunits)) == 0)
+      return 0;
+    return (void*)(p + 1);
+  }
+
+  c = sizeclass(nunits);
+  if(bins[c] == 0){
+    // carve a chunk into blocks of this class.
+    if((p = bigalloc(CHUNK)) == 0)
+      return 0;
+    size = 2 << c;
+    for(int i = 0; i + size <= CHUNK; i += size){
+      p[i].s.size = size;
+      p[i].s.ptr = bins[c];
+      bins[c] = &p[i];
+    }
+  }
+  p = bins[c];
+  bins[c] = p->s.ptr;
+  return (void*)(p + 1);
+}
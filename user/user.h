@@ -1,5 +1,15 @@
 struct stat;
 struct rtcdate;
+struct schedstat;
+struct tracerec;
+struct sysprof;
+struct memstat;
+struct procsnap;
+struct timespec;
+struct iovec;
+struct ring;
+struct mlfqparam;
+struct schedev;
 
 // system calls
 int fork(void);
@@ -24,8 +34,38 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int trap_getpid(void);
+int trap_uptime(void);
 int trace(int);
 int set_priority(int, int);
+int set_policy(int, int);
+int sched_deadline(int /*runtime*/, int /*period*/, int /*deadline*/);
+int schedstat(int, struct schedstat*);
+int traceread(struct tracerec*, int, int /*pid*/);
+int sysprof(int /*pid*/, struct sysprof*, int);
+int sched_setaffinity(int /*pid*/, int /*mask*/);
+int set_tickets(int, int);
+int spawn(char*, char**, int* /*fdmap[3] or 0*/);
+void* mmap(void*, uint, int, int, int, int);
+int munmap(void*, uint);
+int memstat(int /*pid*/, struct memstat*);
+int sync(void);
+int splice(int, int, int);
+int readv(int, const struct iovec*, int);
+int writev(int, const struct iovec*, int);
+int ring_enter(struct ring*, int);
+int clone(void (*)(void*), void*, void* /*stack top*/);
+int join(int /*tid, or 0*/);
+int futex_wait(int*, int);
+int futex_wake(int*, int);
+int procsnap(struct procsnap*, int);
+int waitx_ns(int*, uint64* /*wtime*/, uint64* /*rtime*/);
+int clock_gettime(int, struct timespec*);
+int sched_yield(void);
+int lseek(int, int /*off*/, int /*whence*/);
+int schedtrace(int /*on*/);
+int schedtrace_read(struct schedev*, int);
+int mlfqparam(struct mlfqparam* /*new, or 0*/, struct mlfqparam* /*old, or 0*/);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -43,3 +83,5 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+uint64 rdtime(void);
+int thread_create(void (*)(void*), void*, void* /*stack*/, uint /*size*/);
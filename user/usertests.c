@@ -7,6 +7,14 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/mman.h"
+#include "kernel/ring.h"
+#include "kernel/uio.h"
+#include "kernel/memstat.h"
+#include "kernel/elf.h"
+#include "kernel/sched.h"
+#include "kernel/procsnap.h"
+#include "kernel/clock.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -2046,7 +2054,7 @@ iref(char *s)
 void
 forktest(char *s)
 {
-  enum{ N = 1000 };
+  enum{ N = NPROC + 10 };
   int n, pid;
 
   for(n=0; n<N; n++){
@@ -2063,7 +2071,7 @@ forktest(char *s)
   }
 
   if(n == N){
-    printf("%s: fork claimed to work 1000 times!\n", s);
+    printf("%s: fork claimed to work %d times!\n", s, N);
     exit(1);
   }
 
@@ -2706,6 +2714,1427 @@ execout(char *s)
   exit(0);
 }
 
+// a MAP_SHARED mapping is the same memory in parent and child.
+void
+mmapshared(char *s)
+{
+  char *m;
+  int pid, xstatus;
+
+  m = mmap(0, 2*4096, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+  if(m == (char*)-1){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  m[0] = 'a';
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(m[0] != 'a')
+      exit(1);
+    m[0] = 'b';
+    m[4096] = 'c';
+    exit(0);
+  }
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: child didn't see the mapping\n", s);
+    exit(1);
+  }
+  if(m[0] != 'b' || m[4096] != 'c'){
+    printf("%s: child's stores not seen\n", s);
+    exit(1);
+  }
+  if(munmap(m, 2*4096) != 0){
+    printf("%s: munmap failed\n", s);
+    exit(1);
+  }
+}
+
+// a MAP_PRIVATE mapping is copied on write after fork.
+void
+mmapprivate(char *s)
+{
+  char *m;
+  int pid, xstatus;
+
+  m = mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+  if(m == (char*)-1){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  m[0] = 'a';
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(m[0] != 'a')
+      exit(1);
+    m[0] = 'b';
+    exit(0);
+  }
+  m[0] = 'p';
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: child saw the parent's store\n", s);
+    exit(1);
+  }
+  if(m[0] != 'p'){
+    printf("%s: parent saw the child's store\n", s);
+    exit(1);
+  }
+}
+
+// after munmap() the pages are gone.
+void
+mmapunmap(char *s)
+{
+  char *m;
+  int pid, xstatus;
+
+  m = mmap(0, 2*4096, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+  if(m == (char*)-1){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  m[0] = 1;
+  m[4096] = 2;
+  if(munmap(m + 1, 4096) != -1){
+    printf("%s: munmap of an unaligned address succeeded\n", s);
+    exit(1);
+  }
+  if(munmap(m, 4096) != 0){
+    printf("%s: munmap failed\n", s);
+    exit(1);
+  }
+  if(m[4096] != 2){
+    printf("%s: the rest of the mapping went too\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    printf("%s: oops could read unmapped %x = %x\n", s, m, m[0]);
+    exit(1);
+  }
+  if(wait(&xstatus) != pid || xstatus != -1){
+    printf("%s: access to an unmapped page didn't fault\n", s);
+    exit(1);
+  }
+}
+
+// the heap can grow up to the lowest mapping, but not into it,
+// and a mapping can't be placed over the heap.
+void
+mmapsbrk(char *s)
+{
+  char *m, *top;
+  uint64 gap;
+
+  m = mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+  if(m == (char*)-1){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  m[0] = 42;
+  // sbrk() only reserves addresses, so this takes no memory.
+  while(sbrk(1 << 30) != (char*)-1)
+    ;
+  top = sbrk(0);
+  if(top > m || (gap = m - top) >= (1 << 30)){
+    printf("%s: heap stopped at %p, mapping at %p\n", s, top, m);
+    exit(1);
+  }
+  if(gap > 0 && sbrk(gap) == (char*)-1){
+    printf("%s: sbrk up to the mapping failed\n", s);
+    exit(1);
+  }
+  if(sbrk(1) != (char*)-1){
+    printf("%s: sbrk into the mapping succeeded\n", s);
+    exit(1);
+  }
+  if(mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0) != (char*)-1){
+    printf("%s: mmap over the heap succeeded\n", s);
+    exit(1);
+  }
+  if(m[0] != 42){
+    printf("%s: mapping changed\n", s);
+    exit(1);
+  }
+}
+
+// put one submission on the ring.
+void
+ringsubmit(struct ring *r, int op, int fd, void *addr, int len, uint64 data)
+{
+  struct sqe *e = &r->sq[r->sqtail % NRING];
+
+  e->op = op;
+  e->fd = fd;
+  e->addr = (uint64)addr;
+  e->len = len;
+  e->data = data;
+  __sync_synchronize();
+  r->sqtail++;
+}
+
+// open, read and close a file through the submission ring,
+// then fill the completion ring.
+void
+ringtest(char *s)
+{
+  struct ring *r;
+  struct cqe *c;
+  char rbuf[8];
+  int fd, i;
+
+  unlink("ringfile");
+  fd = open("ringfile", O_CREATE|O_WRONLY);
+  if(fd < 0 || write(fd, "hello", 5) != 5){
+    printf("%s: create ringfile failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  // the ring must be on a page of its own.
+  r = (struct ring*)PGROUNDUP((uint64)sbrk(2*PGSIZE));
+  memset(r, 0, sizeof(*r));
+
+  ringsubmit(r, RING_OPEN, 0, "ringfile", O_RDONLY, 1);
+  if(ring_enter(r, 1) != 1 || r->cqtail != 1){
+    printf("%s: ring_enter of open failed\n", s);
+    exit(1);
+  }
+  c = &r->cq[r->cqhead++ % NRING];
+  if(c->data != 1 || (fd = c->res) < 0){
+    printf("%s: open through the ring failed\n", s);
+    exit(1);
+  }
+
+  ringsubmit(r, RING_READ, fd, rbuf, sizeof(rbuf), 2);
+  ringsubmit(r, RING_CLOSE, fd, 0, 0, 3);
+  ringsubmit(r, RING_READ, fd, rbuf, sizeof(rbuf), 4);
+  if(ring_enter(r, 3) != 3 || r->cqtail != 4){
+    printf("%s: ring_enter of read and close failed\n", s);
+    exit(1);
+  }
+  c = &r->cq[r->cqhead++ % NRING];
+  if(c->data != 2 || c->res != 5 || memcmp(rbuf, "hello", 5) != 0){
+    printf("%s: read through the ring failed\n", s);
+    exit(1);
+  }
+  c = &r->cq[r->cqhead++ % NRING];
+  if(c->data != 3 || c->res != 0){
+    printf("%s: close through the ring failed\n", s);
+    exit(1);
+  }
+  c = &r->cq[r->cqhead++ % NRING];
+  if(c->data != 4 || c->res != -1){
+    printf("%s: read of a closed fd succeeded\n", s);
+    exit(1);
+  }
+
+  // ring_enter() stops when the completion ring is full.
+  for(i = 0; i < NRING; i++)
+    ringsubmit(r, RING_NOP, 0, 0, 0, 100 + i);
+  if(ring_enter(r, NRING + 1) != NRING){
+    printf("%s: ring_enter of %d nops failed\n", s, NRING);
+    exit(1);
+  }
+  ringsubmit(r, RING_NOP, 0, 0, 0, 100 + NRING);
+  if(ring_enter(r, 1) != 0 || r->sqtail - r->sqhead != 1){
+    printf("%s: ring_enter ran past a full completion ring\n", s);
+    exit(1);
+  }
+  for(i = 0; i < NRING; i++){
+    c = &r->cq[r->cqhead++ % NRING];
+    if(c->data != 100 + i || c->res != 0){
+      printf("%s: nop %d completed out of order\n", s, i);
+      exit(1);
+    }
+  }
+  if(ring_enter(r, 1) != 1 || r->cq[r->cqhead % NRING].data != 100 + NRING){
+    printf("%s: ring_enter after draining the completions failed\n", s);
+    exit(1);
+  }
+  unlink("ringfile");
+}
+
+// threads made with thread_create() share the caller's memory,
+// and join() collects each one once.
+volatile int tcount;
+
+void
+threadadd(void *arg)
+{
+  __sync_fetch_and_add(&tcount, (int)(uint64)arg);
+}
+
+void
+threadjoin(char *s)
+{
+  int tids[4];
+
+  tcount = 0;
+  for(int i = 0; i < 4; i++){
+    tids[i] = thread_create(threadadd, (void*)(uint64)(i+1), malloc(4096), 4096);
+    if(tids[i] < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  for(int i = 0; i < 4; i++){
+    if(join(tids[i]) != tids[i]){
+      printf("%s: join %d failed\n", s, tids[i]);
+      exit(1);
+    }
+  }
+  if(join(0) != -1){
+    printf("%s: join with no threads left succeeded\n", s);
+    exit(1);
+  }
+  if(tcount != 10){
+    printf("%s: threads added up to %d, not 10\n", s, tcount);
+    exit(1);
+  }
+}
+
+void
+threadsleepexit(void *arg)
+{
+  sleep(2);
+  tcount = 1;
+  exit(0);
+}
+
+// a thread that calls exit() ends itself, not the process,
+// and wakes up the leader sleeping in join().
+void
+threadexit(char *s)
+{
+  int tid;
+
+  tcount = 0;
+  if((tid = thread_create(threadsleepexit, 0, malloc(4096), 4096)) < 0){
+    printf("%s: thread_create failed\n", s);
+    exit(1);
+  }
+  if(join(0) != tid){
+    printf("%s: join failed\n", s);
+    exit(1);
+  }
+  if(tcount != 1){
+    printf("%s: thread didn't run\n", s);
+    exit(1);
+  }
+}
+
+void
+threadforker(void *arg)
+{
+  int pid, xstatus;
+
+  if((pid = fork()) < 0)
+    return;
+  if(pid == 0)
+    exit(tcount == 5 ? 42 : 1);
+  if(wait(&xstatus) == pid && xstatus == 42)
+    tcount = 6;
+}
+
+// fork() from a thread copies the group's memory, and the
+// thread waits for the child it made.
+void
+threadfork(char *s)
+{
+  int tid;
+
+  tcount = 5;
+  if((tid = thread_create(threadforker, 0, malloc(4096), 4096)) < 0){
+    printf("%s: thread_create failed\n", s);
+    exit(1);
+  }
+  if(join(tid) != tid){
+    printf("%s: join failed\n", s);
+    exit(1);
+  }
+  if(tcount != 6){
+    printf("%s: forked child didn't see the thread's memory\n", s);
+    exit(1);
+  }
+  if(wait(0) != -1){
+    printf("%s: the thread's child was left to the leader\n", s);
+    exit(1);
+  }
+}
+
+void
+threadspin(void *arg)
+{
+  for(;;)
+    ;
+}
+
+// kill() of the leader takes down its threads too.
+void
+threadkill(char *s)
+{
+  int pid, xstatus;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(int i = 0; i < 3; i++)
+      if(thread_create(threadspin, 0, malloc(4096), 4096) < 0)
+        exit(1);
+    join(0);
+    exit(0);
+  }
+  sleep(2);
+  kill(pid);
+  if(wait(&xstatus) != pid || xstatus != -1){
+    printf("%s: killed thread group didn't exit\n", s);
+    exit(1);
+  }
+}
+
+// a lock that sleeps in futex_wait() while it is held.
+volatile int flock;
+
+void
+futexlock(volatile int *l)
+{
+  while(__sync_lock_test_and_set(l, 1) != 0)
+    futex_wait((int*)l, 1);
+}
+
+void
+futexunlock(volatile int *l)
+{
+  __sync_lock_release(l);
+  futex_wake((int*)l, 1);
+}
+
+void
+futexadd(void *arg)
+{
+  for(int i = 0; i < 1000; i++){
+    futexlock(&flock);
+    tcount = tcount + 1;
+    futexunlock(&flock);
+  }
+}
+
+void
+futextest(char *s)
+{
+  int tids[2], w = 5, pid, xstatus, i;
+  int *f;
+
+  // two threads counting under a futex lock.
+  tcount = 0;
+  flock = 0;
+  for(i = 0; i < 2; i++){
+    if((tids[i] = thread_create(futexadd, 0, malloc(4096), 4096)) < 0){
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  for(i = 0; i < 2; i++)
+    join(tids[i]);
+  if(tcount != 2000){
+    printf("%s: counted %d, not 2000\n", s, tcount);
+    exit(1);
+  }
+
+  // futex_wait() doesn't sleep if the value changed.
+  if(futex_wait(&w, 6) != -1){
+    printf("%s: futex_wait with a stale value didn't fail\n", s);
+    exit(1);
+  }
+
+  // a MAP_SHARED word is the same futex in parent and child.
+  f = mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+  if(f == (int*)-1){
+    printf("%s: mmap failed\n", s);
+    exit(1);
+  }
+  *f = 0;
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(futex_wait(f, 0));
+  for(i = 0; i < 100 && futex_wake(f, 1) == 0; i++)
+    sleep(1);
+  if(i == 100){
+    printf("%s: futex_wake never found the child\n", s);
+    kill(pid);
+    wait(0);
+    exit(1);
+  }
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: child's futex_wait failed\n", s);
+    exit(1);
+  }
+}
+
+// spawn() runs a program in a new process with chosen fds 0..2,
+// and the parent waits for it as for a forked child.
+void
+spawntest(char *s)
+{
+  char *echoargv[] = { "echo", "OK", 0 };
+  char *rmargv[] = { "rm", 0 };
+  int fd, pid, xstatus;
+  int fdmap[3];
+  char buf[3];
+
+  unlink("spawn-ok");
+  fd = open("spawn-ok", O_CREATE|O_WRONLY);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  fdmap[0] = -1;
+  fdmap[1] = fd;
+  fdmap[2] = 2;
+  pid = spawn("echo", echoargv, fdmap);
+  close(fd);
+  if(pid < 0){
+    printf("%s: spawn echo failed\n", s);
+    exit(1);
+  }
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: wait for echo failed\n", s);
+    exit(1);
+  }
+  fd = open("spawn-ok", O_RDONLY);
+  if(fd < 0 || read(fd, buf, 3) != 3 || buf[0] != 'O' || buf[1] != 'K'){
+    printf("%s: wrong output\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("spawn-ok");
+
+  // rm without arguments exits 1.
+  pid = spawn("rm", rmargv, 0);
+  if(pid < 0){
+    printf("%s: spawn rm failed\n", s);
+    exit(1);
+  }
+  if(wait(&xstatus) != pid || xstatus != 1){
+    printf("%s: rm exited %d, not 1\n", s, xstatus);
+    exit(1);
+  }
+
+  if(spawn("nosuchprogram", echoargv, 0) != -1){
+    printf("%s: spawn of a missing program succeeded\n", s);
+    exit(1);
+  }
+  if(wait(0) != -1){
+    printf("%s: a failed spawn left a child\n", s);
+    exit(1);
+  }
+}
+
+// splice() a file into a pipe and the pipe into another file.
+void
+splicetest(char *s)
+{
+  char buf[200];
+  int fd, out, fds[2], i;
+
+  for(i = 0; i < 100; i++)
+    buf[i] = 'a' + i % 26;
+  unlink("splicein");
+  unlink("spliceout");
+  fd = open("splicein", O_CREATE|O_WRONLY);
+  if(fd < 0 || write(fd, buf, 100) != 100){
+    printf("%s: create splicein failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(pipe(fds) < 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+
+  // a file is read until its end, short of n.
+  fd = open("splicein", O_RDONLY);
+  if(fd < 0){
+    printf("%s: open splicein failed\n", s);
+    exit(1);
+  }
+  if(splice(fd, fds[1], sizeof(buf)) != 100){
+    printf("%s: splice of file to pipe failed\n", s);
+    exit(1);
+  }
+  if(splice(fd, fds[1], sizeof(buf)) != 0){
+    printf("%s: splice at end of file not 0\n", s);
+    exit(1);
+  }
+
+  out = open("spliceout", O_CREATE|O_RDWR);
+  if(out < 0){
+    printf("%s: create spliceout failed\n", s);
+    exit(1);
+  }
+  if(splice(fds[0], out, 30) != 30 || splice(fds[0], out, sizeof(buf)) != 70){
+    printf("%s: splice of pipe to file failed\n", s);
+    exit(1);
+  }
+  close(out);
+  out = open("spliceout", O_RDONLY);
+  memset(buf + 100, 0, 100);
+  if(out < 0 || read(out, buf + 100, 100) != 100 || memcmp(buf, buf + 100, 100) != 0){
+    printf("%s: spliceout has the wrong contents\n", s);
+    exit(1);
+  }
+
+  if(splice(fd, out, 1) != -1){
+    printf("%s: splice to a read-only fd succeeded\n", s);
+    exit(1);
+  }
+  if(splice(fds[1], fds[0], 1) != -1){
+    printf("%s: splice from a write-only fd succeeded\n", s);
+    exit(1);
+  }
+  if(splice(fd, fds[1], -1) != -1){
+    printf("%s: splice of -1 bytes succeeded\n", s);
+    exit(1);
+  }
+  if(splice(NOFILE - 1, fds[1], 1) != -1 || splice(fd, -1, 1) != -1){
+    printf("%s: splice of a bad fd succeeded\n", s);
+    exit(1);
+  }
+
+  close(fd);
+  close(out);
+  close(fds[0]);
+  close(fds[1]);
+  unlink("splicein");
+  unlink("spliceout");
+}
+
+// writev() and readv() through several buffers, one of them
+// empty, and the limits argiov() puts on the buffers.
+void
+iovtest(char *s)
+{
+  struct iovec iov[IOV_MAX + 1];
+  char rbuf[16];
+  int fd, i;
+
+  unlink("iovfile");
+  fd = open("iovfile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create iovfile failed\n", s);
+    exit(1);
+  }
+  iov[0].base = (uint64)"hello";
+  iov[0].len = 5;
+  iov[1].base = (uint64)rbuf;
+  iov[1].len = 0;
+  iov[2].base = (uint64)" world";
+  iov[2].len = 6;
+  if(writev(fd, iov, 3) != 11){
+    printf("%s: writev failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("iovfile", O_RDONLY);
+  if(fd < 0){
+    printf("%s: open iovfile failed\n", s);
+    exit(1);
+  }
+  memset(rbuf, 0, sizeof(rbuf));
+  iov[0].base = (uint64)rbuf;
+  iov[0].len = 3;
+  iov[1].base = (uint64)rbuf + 3;
+  iov[1].len = 0;
+  iov[2].base = (uint64)rbuf + 3;
+  iov[2].len = sizeof(rbuf) - 3;
+  if(readv(fd, iov, 3) != 11 || memcmp(rbuf, "hello world", 12) != 0){
+    printf("%s: readv got the wrong bytes\n", s);
+    exit(1);
+  }
+  if(readv(fd, iov, 3) != 0){
+    printf("%s: readv at end of file not 0\n", s);
+    exit(1);
+  }
+
+  for(i = 0; i <= IOV_MAX; i++){
+    iov[i].base = (uint64)rbuf;
+    iov[i].len = 1;
+  }
+  if(readv(fd, iov, IOV_MAX + 1) != -1 || readv(fd, iov, -1) != -1){
+    printf("%s: readv of a bad iovcnt succeeded\n", s);
+    exit(1);
+  }
+  iov[0].len = 0x40000000;
+  iov[1].len = 0x40000000;
+  if(readv(fd, iov, 2) != -1){
+    printf("%s: readv of more than 2^31 bytes succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("iovfile");
+}
+
+// lseek() from each whence, and the offsets it refuses.
+void
+lseektest(char *s)
+{
+  char c;
+  int fd, fds[2];
+
+  unlink("lseekfile");
+  fd = open("lseekfile", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, "0123456789", 10) != 10){
+    printf("%s: create lseekfile failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 3, SEEK_SET) != 3 || read(fd, &c, 1) != 1 || c != '3'){
+    printf("%s: SEEK_SET failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 2, SEEK_CUR) != 6 || read(fd, &c, 1) != 1 || c != '6'){
+    printf("%s: SEEK_CUR failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, -1, SEEK_END) != 9 || read(fd, &c, 1) != 1 || c != '9'){
+    printf("%s: SEEK_END failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 0, SEEK_END) != 10 || read(fd, &c, 1) != 0){
+    printf("%s: read at SEEK_END not 0\n", s);
+    exit(1);
+  }
+
+  // a failed seek leaves the offset alone.
+  lseek(fd, 4, SEEK_SET);
+  if(lseek(fd, 11, SEEK_SET) != -1 || lseek(fd, 1, SEEK_END) != -1 ||
+     lseek(fd, -5, SEEK_CUR) != -1 || lseek(fd, 0, 3) != -1){
+    printf("%s: lseek out of the file succeeded\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 0, SEEK_CUR) != 4){
+    printf("%s: failed lseek moved the offset\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(lseek(fd, 0, SEEK_SET) != -1){
+    printf("%s: lseek on a closed fd succeeded\n", s);
+    exit(1);
+  }
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  if(lseek(fds[0], 0, SEEK_SET) != -1){
+    printf("%s: lseek on a pipe succeeded\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+  unlink("lseekfile");
+}
+
+// after fork() parent and child share their pages copy-on-write;
+// a store by either must not show through to the other.
+void
+cowtest(char *s)
+{
+  char *p, c;
+  int pid, xstatus, fds[2];
+
+  p = sbrk(PGSIZE);
+  if(p == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  memset(p, 'p', PGSIZE);
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    if(p[0] != 'p')
+      exit(1);
+    memset(p, 'c', PGSIZE);
+    exit(p[0] == 'c' && p[PGSIZE-1] == 'c' ? 0 : 1);
+  }
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: child's copy was wrong\n", s);
+    exit(1);
+  }
+  if(p[0] != 'p' || p[PGSIZE-1] != 'p'){
+    printf("%s: child's store changed the parent's page\n", s);
+    exit(1);
+  }
+
+  // and the other way round.
+  if(pipe(fds) < 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[1]);
+    if(read(fds[0], &c, 1) != 1)
+      exit(1);
+    exit(p[0] == 'p' && p[PGSIZE-1] == 'p' ? 0 : 1);
+  }
+  close(fds[0]);
+  memset(p, 'q', PGSIZE);
+  write(fds[1], "x", 1);
+  close(fds[1]);
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: parent's store changed the child's page\n", s);
+    exit(1);
+  }
+}
+
+int countfree();
+
+// a child that breaks copy-on-write on more pages than there
+// is free memory for is killed, and the parent's pages survive.
+void
+cowpressure(char *s)
+{
+  char *p;
+  int i, n, pid, xstatus;
+
+  // the parent holds two thirds of free memory.
+  n = countfree() * 2 / 3;
+  p = sbrk(n * PGSIZE);
+  if(p == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < n; i++)
+    p[i*PGSIZE] = i;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(i = 0; i < n; i++)
+      p[i*PGSIZE] = ~i;
+    exit(0);
+  }
+  if(wait(&xstatus) != pid){
+    printf("%s: wait failed\n", s);
+    exit(1);
+  }
+  if(xstatus != -1){
+    printf("%s: child copied %d pages without running out\n", s, n);
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    if(p[i*PGSIZE] != (char)i){
+      printf("%s: parent's page %d changed\n", s, i);
+      exit(1);
+    }
+  }
+  sbrk(-n * PGSIZE);
+}
+
+// sbrk() only reserves memory: touching two far pages of a
+// large grow brings in just those two, and shrinking over the
+// untouched holes between them frees what was touched.
+void
+sbrkholes(char *s)
+{
+  struct memstat m0, m1;
+  char *p;
+  int n = 1024, pid, xstatus;
+
+  p = sbrk(n * PGSIZE);
+  if(p == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  if(memstat(0, &m0) < 0){
+    printf("%s: memstat failed\n", s);
+    exit(1);
+  }
+  p[(n/2)*PGSIZE] = 1;
+  p[(n-1)*PGSIZE] = 2;
+  if(memstat(0, &m1) < 0 || m1.rss != m0.rss + 2){
+    printf("%s: touching 2 pages brought in %d\n", s, m1.rss - m0.rss);
+    exit(1);
+  }
+  if(p[PGSIZE] != 0 || memstat(0, &m1) < 0 || m1.rss != m0.rss + 3){
+    printf("%s: reading an untouched page failed\n", s);
+    exit(1);
+  }
+
+  sbrk(-n * PGSIZE);
+  if(memstat(0, &m1) < 0 || m1.rss != m0.rss || m1.sz != m0.sz - n * PGSIZE){
+    printf("%s: shrinking left %d pages in\n", s, m1.rss - m0.rss);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    p[(n-1)*PGSIZE] = 3;
+    exit(0);
+  }
+  if(wait(&xstatus) != pid || xstatus != -1){
+    printf("%s: store past the shrunk heap wasn't killed\n", s);
+    exit(1);
+  }
+
+  // growing again gives zeroed pages.
+  if(sbrk(n * PGSIZE) != p || p[(n-1)*PGSIZE] != 0 || p[(n/2)*PGSIZE] != 0){
+    printf("%s: regrown heap not zero\n", s);
+    exit(1);
+  }
+  sbrk(-n * PGSIZE);
+}
+
+extern char etext[];
+
+// exec() loads program pages from the file on first touch:
+// reading this program's text brings in pages that weren't
+// in memory, each with the bytes the file has there.
+void
+demandexec(char *s)
+{
+  struct elfhdr elf;
+  struct proghdr ph;
+  struct memstat m0, m1;
+  char fbuf[512];
+  uint64 a;
+  int fd, i, n;
+
+  fd = open("usertests", O_RDONLY);
+  if(fd < 0 || read(fd, &elf, sizeof(elf)) != sizeof(elf) || elf.magic != ELF_MAGIC){
+    printf("%s: can't read usertests' ELF header\n", s);
+    exit(1);
+  }
+  for(i = 0; i < elf.phnum; i++){
+    if(lseek(fd, elf.phoff + i * sizeof(ph), SEEK_SET) < 0 ||
+       read(fd, &ph, sizeof(ph)) != sizeof(ph)){
+      printf("%s: can't read program header %d\n", s, i);
+      exit(1);
+    }
+    if(ph.type == ELF_PROG_LOAD && ph.vaddr == 0)
+      break;
+  }
+  if(i == elf.phnum || ph.filesz < (uint64)etext){
+    printf("%s: no segment holds the text\n", s);
+    exit(1);
+  }
+
+  if(memstat(0, &m0) < 0){
+    printf("%s: memstat failed\n", s);
+    exit(1);
+  }
+  // page 0 is left out; the compiler may assume 0 isn't read.
+  for(a = PGSIZE; a < (uint64)etext; a += n){
+    n = (uint64)etext - a < sizeof(fbuf) ? (uint64)etext - a : sizeof(fbuf);
+    if(lseek(fd, ph.off + a, SEEK_SET) < 0 || read(fd, fbuf, n) != n){
+      printf("%s: can't read usertests at %p\n", s, a);
+      exit(1);
+    }
+    if(memcmp((char*)a, fbuf, n) != 0){
+      printf("%s: text at %p differs from the file\n", s, a);
+      exit(1);
+    }
+  }
+  if(memstat(0, &m1) < 0 || m1.rss <= m0.rss){
+    printf("%s: reading the text faulted nothing in\n", s);
+    exit(1);
+  }
+  close(fd);
+}
+
+// set_policy() on one process and on all of them, and the
+// policies and pids it refuses.
+void
+setpolicytest(char *s)
+{
+  struct schedstat st;
+  int old, def, pid, xstatus, fds[2];
+  char c;
+
+  if(set_policy(-1, getpid()) != -1 || set_policy(NSCHED, getpid()) != -1){
+    printf("%s: set_policy of a bad policy succeeded\n", s);
+    exit(1);
+  }
+  if(set_policy(SCHED_EDF, getpid()) != -1){
+    printf("%s: set_policy(SCHED_EDF) succeeded\n", s);
+    exit(1);
+  }
+  if(set_policy(SCHED_DEFAULT, 0x7fffffff) != -1){
+    printf("%s: set_policy of a bad pid succeeded\n", s);
+    exit(1);
+  }
+
+  old = set_policy(SCHED_STRIDE, getpid());
+  if(old < 0 || old >= NSCHED){
+    printf("%s: set_policy returned %d\n", s, old);
+    exit(1);
+  }
+  if(schedstat(getpid(), &st) < 0 || st.policy != SCHED_STRIDE ||
+     set_policy(old, getpid()) != SCHED_STRIDE){
+    printf("%s: set_policy didn't change the policy\n", s);
+    exit(1);
+  }
+
+  // pid 0 leaves an EDF process in its class.
+  if(pipe(fds) < 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[1]);
+    if(sched_deadline(1, 100, 100) < 0)
+      exit(1);
+    read(fds[0], &c, 1);
+    exit(0);
+  }
+  close(fds[0]);
+  while(schedstat(pid, &st) == 0 && st.policy != SCHED_EDF)
+    sleep(1);
+  if(st.policy != SCHED_EDF){
+    printf("%s: child's sched_deadline failed\n", s);
+    exit(1);
+  }
+  def = set_policy(SCHED_STRIDE, 0);
+  if(def < 0 || schedstat(getpid(), &st) < 0 || st.policy != SCHED_STRIDE){
+    printf("%s: set_policy(SCHED_STRIDE, 0) failed\n", s);
+    exit(1);
+  }
+  if(schedstat(pid, &st) < 0 || st.policy != SCHED_EDF){
+    printf("%s: set_policy(p, 0) moved an EDF process\n", s);
+    exit(1);
+  }
+  if(set_policy(def, 0) != SCHED_STRIDE){
+    printf("%s: set_policy(p, 0) didn't return the old default\n", s);
+    exit(1);
+  }
+  close(fds[1]);
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: EDF child failed\n", s);
+    exit(1);
+  }
+}
+
+// sched_deadline() refuses bad parameters, and admits
+// processes of 90% of a cpu each only while the online cpus
+// have bandwidth left for them.
+void
+deadlinetest(char *s)
+{
+  int hold[2], res[2], n, pid, xstatus;
+  char c;
+
+  if(sched_deadline(-1, 10, 10) != -1 || sched_deadline(5, 10, 4) != -1 ||
+     sched_deadline(5, 10, 20) != -1 || sched_deadline(1, (1 << 20) + 1, 10) != -1){
+    printf("%s: sched_deadline of bad parameters succeeded\n", s);
+    exit(1);
+  }
+  if(sched_deadline(96, 100, 100) != -1){
+    printf("%s: sched_deadline of 96%% of a cpu succeeded\n", s);
+    exit(1);
+  }
+  if(sched_deadline(0, 0, 0) != 0){
+    printf("%s: sched_deadline(0) of a non-EDF process failed\n", s);
+    exit(1);
+  }
+
+  // each child reports whether it was admitted on res, and
+  // the admitted ones hold their bandwidth until hold closes.
+  if(pipe(hold) < 0 || pipe(res) < 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  for(n = 0; n <= NCPU; n++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(hold[1]);
+      if(sched_deadline(9, 10, 10) < 0){
+        write(res[1], "n", 1);
+        exit(0);
+      }
+      write(res[1], "y", 1);
+      read(hold[0], &c, 1);
+      exit(0);
+    }
+    if(read(res[0], &c, 1) != 1){
+      printf("%s: child didn't report\n", s);
+      exit(1);
+    }
+    if(c == 'n')
+      break;
+  }
+  if(n == 0 || n > NCPU){
+    printf("%s: admitted %d processes of 90%% of a cpu\n", s, n);
+    exit(1);
+  }
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: rejected child failed\n", s);
+    exit(1);
+  }
+
+  // an exit gives its bandwidth back.
+  write(hold[1], "x", 1);
+  if(wait(&xstatus) < 0 || xstatus != 0){
+    printf("%s: EDF child failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(sched_deadline(9, 10, 10) < 0 ? 1 : 0);
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: freed bandwidth wasn't admitted again\n", s);
+    exit(1);
+  }
+
+  close(hold[1]);
+  while(wait(&xstatus) > 0){
+    if(xstatus != 0){
+      printf("%s: EDF child failed\n", s);
+      exit(1);
+    }
+  }
+}
+
+// sched_setaffinity() reads and sets a mask of harts, and
+// refuses one without an online hart in it.
+void
+affinitytest(char *s)
+{
+  int old, online = 0, i;
+
+  old = sched_setaffinity(0, 0);
+  if(old <= 0 || sched_setaffinity(getpid(), 0) != old){
+    printf("%s: reading the mask failed\n", s);
+    exit(1);
+  }
+  if(sched_setaffinity(0x7fffffff, 1) != -1){
+    printf("%s: sched_setaffinity of a bad pid succeeded\n", s);
+    exit(1);
+  }
+
+  // hart 0 is always online.
+  if(sched_setaffinity(0, 1) != old || sched_setaffinity(0, 0) != 1){
+    printf("%s: setting the mask failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < NCPU; i++)
+    if(sched_setaffinity(0, 1 << i) != -1)
+      online |= 1 << i;
+  if((online & 1) == 0){
+    printf("%s: hart 0 is offline\n", s);
+    exit(1);
+  }
+  if(online != (1 << NCPU) - 1){
+    sched_setaffinity(0, 1);
+    if(sched_setaffinity(0, ~online & ((1 << NCPU) - 1)) != -1 ||
+       sched_setaffinity(0, 0) != 1){
+      printf("%s: a mask of offline harts was taken\n", s);
+      exit(1);
+    }
+  }
+  if(sched_setaffinity(0, (1 << NCPU) | 1) < 0 || sched_setaffinity(0, 0) != 1){
+    printf("%s: bits past NCPU weren't ignored\n", s);
+    exit(1);
+  }
+  sched_setaffinity(0, old);
+}
+
+// mlfqparam() reads and sets the MLFQ tunables, and refuses
+// a bad number of levels or a zero slice at a used level.
+void
+mlfqparamtest(char *s)
+{
+  struct mlfqparam old, p, q;
+
+  if(mlfqparam(0, &old) != 0 || old.nlevel < 1 || old.nlevel > NMLFQ){
+    printf("%s: reading the parameters failed\n", s);
+    exit(1);
+  }
+  p = old;
+  p.nlevel = 0;
+  if(mlfqparam(&p, 0) != -1){
+    printf("%s: nlevel 0 was taken\n", s);
+    exit(1);
+  }
+  p.nlevel = NMLFQ + 1;
+  if(mlfqparam(&p, 0) != -1){
+    printf("%s: nlevel %d was taken\n", s, NMLFQ + 1);
+    exit(1);
+  }
+  p.nlevel = 2;
+  p.slice[1] = 0;
+  if(mlfqparam(&p, 0) != -1){
+    printf("%s: a zero slice was taken\n", s);
+    exit(1);
+  }
+  if(mlfqparam((struct mlfqparam*)0xffffffffffffL, 0) != -1 ||
+     mlfqparam(0, (struct mlfqparam*)0xffffffffffffL) != -1){
+    printf("%s: a bad address was taken\n", s);
+    exit(1);
+  }
+  if(mlfqparam(0, &q) != 0 || memcmp(&q, &old, sizeof(q)) != 0){
+    printf("%s: a refused call changed the parameters\n", s);
+    exit(1);
+  }
+
+  // slices past nlevel are unused, and may be 0.
+  p.nlevel = 1;
+  if(mlfqparam(&p, &q) != 0 || memcmp(&q, &old, sizeof(q)) != 0){
+    printf("%s: setting the parameters failed\n", s);
+    exit(1);
+  }
+  if(mlfqparam(&old, &q) != 0 || memcmp(&q, &p, sizeof(q)) != 0){
+    printf("%s: the parameters didn't change\n", s);
+    exit(1);
+  }
+}
+
+// find pid's entry in a procsnap() of up to n processes.
+struct procsnap*
+snapfind(struct procsnap *ps, int n, int pid)
+{
+  int i;
+
+  n = procsnap(ps, n);
+  for(i = 0; i < n; i++)
+    if(ps[i].pid == pid)
+      return &ps[i];
+  return 0;
+}
+
+// procsnap() reports the caller as running, with times that
+// only go forward, and refuses a bad buffer.
+void
+procsnaptest(char *s)
+{
+  struct procsnap *ps, *e, e0;
+  int n = 64;
+  volatile int i;
+
+  ps = (struct procsnap*)sbrk(n * sizeof(*ps));
+  if(ps == (struct procsnap*)0xffffffffffffffffL){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  if((e = snapfind(ps, n, getpid())) == 0){
+    printf("%s: no entry for this process\n", s);
+    exit(1);
+  }
+  if(e->version != PROCSNAP_VERSION || e->state != PS_RUNNING ||
+     e->tgid != getpid() || e->sz != (uint64)sbrk(0) || e->rss == 0){
+    printf("%s: wrong entry for this process\n", s);
+    exit(1);
+  }
+  e0 = *e;
+  for(i = 0; i < 10000000; i++)
+    ;
+  if((e = snapfind(ps, n, getpid())) == 0){
+    printf("%s: no second entry for this process\n", s);
+    exit(1);
+  }
+  if(e->time <= e0.time || e->rcycles <= e0.rcycles ||
+     e->waitcycles < e0.waitcycles || e->nruns < e0.nruns ||
+     e->rtime < e0.rtime || e->wtime < e0.wtime){
+    printf("%s: times went backwards\n", s);
+    exit(1);
+  }
+
+  if(procsnap(ps, 0) != 0 || procsnap(ps, 1) != 1){
+    printf("%s: procsnap past n\n", s);
+    exit(1);
+  }
+  if(procsnap((struct procsnap*)0xffffffffffffL, 1) != -1){
+    printf("%s: procsnap to a bad address succeeded\n", s);
+    exit(1);
+  }
+  sbrk(-n * sizeof(*ps));
+}
+
+// compare two timespecs.
+int
+tscmp(struct timespec *a, struct timespec *b)
+{
+  if(a->sec != b->sec)
+    return a->sec < b->sec ? -1 : 1;
+  if(a->nsec != b->nsec)
+    return a->nsec < b->nsec ? -1 : 1;
+  return 0;
+}
+
+// clock_gettime() clocks only go forward, the CPU time only
+// while running; waitx_ns() reports the times of a child
+// that ran, and fails without one.
+void
+clocktest(char *s)
+{
+  struct timespec m0, m1, c0, c1;
+  uint64 wtime, rtime;
+  int pid, xstatus;
+  volatile int i;
+
+  if(clock_gettime(CLOCK_MONOTONIC, &m0) < 0 ||
+     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &c0) < 0){
+    printf("%s: clock_gettime failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 10000000; i++)
+    ;
+  if(clock_gettime(CLOCK_MONOTONIC, &m1) < 0 ||
+     clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &c1) < 0){
+    printf("%s: clock_gettime failed\n", s);
+    exit(1);
+  }
+  if(tscmp(&m0, &m1) >= 0 || tscmp(&c0, &c1) >= 0 ||
+     m1.nsec >= 1000000000 || c1.nsec >= 1000000000){
+    printf("%s: clocks didn't go forward\n", s);
+    exit(1);
+  }
+  if(tscmp(&c1, &m1) > 0){
+    printf("%s: CPU time past the time since boot\n", s);
+    exit(1);
+  }
+  if(clock_gettime(2, &m0) != -1 || clock_gettime(-1, &m0) != -1){
+    printf("%s: clock_gettime of a bad clock succeeded\n", s);
+    exit(1);
+  }
+  if(clock_gettime(CLOCK_MONOTONIC, (struct timespec*)0xffffffffffffL) != -1){
+    printf("%s: clock_gettime to a bad address succeeded\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(i = 0; i < 10000000; i++)
+      ;
+    exit(7);
+  }
+  if(waitx_ns(&xstatus, &wtime, &rtime) != pid || xstatus != 7 || rtime == 0){
+    printf("%s: waitx_ns got the wrong child times\n", s);
+    exit(1);
+  }
+  if(waitx_ns(&xstatus, &wtime, &rtime) != -1){
+    printf("%s: waitx_ns without a child succeeded\n", s);
+    exit(1);
+  }
+}
+
+// memstat() counts the pages a process touches, and those it
+// shares copy-on-write with a child until either stores.
+void
+memstattest(char *s)
+{
+  struct memstat m0, m1;
+  char *p, c;
+  int i, n = 8, pid, fds[2];
+
+  if(memstat(0, &m0) < 0 || m0.pid != getpid() || m0.sz != (uint64)sbrk(0) ||
+     m0.rss == 0 || m0.ptpages == 0){
+    printf("%s: wrong memstat of this process\n", s);
+    exit(1);
+  }
+  p = sbrk(n * PGSIZE);
+  if(p == (char*)0xffffffffffffffffL){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < n; i++)
+    p[i*PGSIZE] = i;
+  if(memstat(0, &m1) < 0 || m1.rss != m0.rss + n || m1.sz != m0.sz + n * PGSIZE ||
+     m1.ptpages < m0.ptpages){
+    printf("%s: touching %d pages added %d\n", s, n, m1.rss - m0.rss);
+    exit(1);
+  }
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[1]);
+    read(fds[0], &c, 1);
+    exit(0);
+  }
+  close(fds[0]);
+  if(memstat(pid, &m0) < 0 || m0.pid != pid || m0.shared < n || m0.shared > m0.rss){
+    printf("%s: child doesn't share the parent's pages\n", s);
+    exit(1);
+  }
+  for(i = 0; i < n; i++)
+    p[i*PGSIZE] = ~i;
+  if(memstat(pid, &m1) < 0 || m1.shared > m0.shared - n){
+    printf("%s: child still shares pages the parent wrote\n", s);
+    exit(1);
+  }
+  close(fds[1]);
+  wait(0);
+
+  if(memstat(0x7fffffff, &m0) != -1){
+    printf("%s: memstat of a bad pid succeeded\n", s);
+    exit(1);
+  }
+  if(memstat(0, (struct memstat*)0xffffffffffffL) != -1){
+    printf("%s: memstat to a bad address succeeded\n", s);
+    exit(1);
+  }
+  sbrk(-n * PGSIZE);
+}
+
 //
 // use sbrk() to count how many free physical memory pages there are.
 // touches the pages to force allocation.
@@ -2880,6 +4309,31 @@ main(int argc, char *argv[])
     {dirfile, "dirfile"},
     {iref, "iref"},
     {forktest, "forktest"},
+    {mmapshared, "mmapshared"},
+    {mmapprivate, "mmapprivate"},
+    {mmapunmap, "mmapunmap"},
+    {mmapsbrk, "mmapsbrk"},
+    {ringtest, "ring"},
+    {threadjoin, "threadjoin"},
+    {threadexit, "threadexit"},
+    {threadfork, "threadfork"},
+    {threadkill, "threadkill"},
+    {futextest, "futex"},
+    {spawntest, "spawn"},
+    {splicetest, "splice"},
+    {iovtest, "iov"},
+    {lseektest, "lseek"},
+    {cowtest, "cow"},
+    {cowpressure, "cowpressure"},
+    {sbrkholes, "sbrkholes"},
+    {demandexec, "demandexec"},
+    {setpolicytest, "setpolicy"},
+    {deadlinetest, "deadline"},
+    {affinitytest, "affinity"},
+    {mlfqparamtest, "mlfqparam"},
+    {procsnaptest, "procsnap"},
+    {clocktest, "clock"},
+    {memstattest, "memstat"},
     {bigdir, "bigdir"}, // slow
     { 0, 0},
   };
@@ -6,10 +6,13 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry("name", "label") makes the stub for SYS_name under
+# another label, for calls ulib.c answers without a trap.
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $label = shift || $name;
+    print ".global $label\n";
+    print "${label}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
@@ -32,10 +35,38 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
+entry("getpid", "trap_getpid");
 entry("sbrk");
 entry("sleep");
-entry("uptime");
+entry("uptime", "trap_uptime");
 entry("trace");
 entry("set_priority");
-entry("waitx")
+entry("waitx");
+entry("set_policy");
+entry("sched_deadline");
+entry("schedstat");
+entry("traceread");
+entry("sysprof");
+entry("sched_setaffinity");
+entry("set_tickets");
+entry("spawn");
+entry("mmap");
+entry("munmap");
+entry("memstat");
+entry("sync");
+entry("splice");
+entry("readv");
+entry("writev");
+entry("ring_enter");
+entry("clone");
+entry("join");
+entry("futex_wait");
+entry("futex_wake");
+entry("procsnap");
+entry("waitx_ns");
+entry("clock_gettime");
+entry("mlfqparam");
+entry("lseek");
+entry("sched_yield");
+entry("schedtrace");
+entry("schedtrace_read");